@@ -0,0 +1,330 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "attention.h"
+#include "bench.h"
+#include "deconv.h"
+#include "epilogue.h"
+#include "gemm.h"
+#include "log.h"
+#include "quant.h"
+#include "tensor.h"
+#include "utils.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "bench"
+
+// Benchmarks of the library kernels over shape sweeps.
+//
+// usage: bench [--list] [--filter name] [--warmup n] [--reps n]
+//              [--json out.json] [--baseline base.json] [--threshold 0.05]
+//              [--roofline profile.txt]
+//
+// With a roofline profile (--roofline, or OCLABC_ROOFLINE; written by the
+// roofline example) every result also gets its share of the attainable peak.
+// With --baseline every result is compared with the saved run and the exit
+// code is the number of regressions.
+
+using abc::BenchShape;
+using abc::Tensor;
+using abc::clrt;
+
+typedef std::vector<std::unique_ptr<Tensor> > TensorList;
+
+// Device tensors with random contents, owned by the returned list so a
+// BenchRun closure can keep them alive.
+static std::shared_ptr<TensorList> make_tensors(const std::vector<abc::dims4d> &dims,
+                                                abc::TensorDataType dtype = abc::TENSOR_FP16) {
+    std::shared_ptr<TensorList> tensors(new TensorList());
+    for (const abc::dims4d &d : dims) {
+        std::unique_ptr<Tensor> t(new Tensor(abc::make_4d_tensor(d, dtype)));
+        abc::alloc_tensor_host_mem(t.get());
+        if (CL_SUCCESS != abc::alloc_tensor_cl_mem(t.get())) {
+            return nullptr;
+        }
+        if (dtype == abc::TENSOR_INT8) {
+            int8_t *p = (int8_t *)t->hostptr;
+            for (std::size_t i = 0; i < t->num_elem(); ++i) {
+                p[i] = (int8_t)(rand() % 255 - 127);
+            }
+            abc::copy_int8_host_mem_to_cl_mem(t->num_elem(), t->hostptr, t->gptr);
+        } else {
+            abc::init_fp16_host_mem(t->num_elem(), abc::UT_INIT_RANDOM, t->hostptr);
+            abc::copy_fp16_host_mem_to_cl_mem(t->num_elem(), t->hostptr, t->gptr);
+        }
+        tensors->push_back(std::move(t));
+    }
+    return tensors;
+}
+
+static cl_mem gptr(const std::shared_ptr<TensorList> &tensors, int i) {
+    return (*tensors)[i]->gptr;
+}
+
+// Runs enqueue(event) once per iteration and hands back its event.
+template <typename F>
+static abc::BenchRun single_event_run(F enqueue) {
+    return [enqueue](std::vector<cl_event> *events) {
+        cl_event event = NULL;
+        cl_int ret = enqueue(&event);
+        if (event) {
+            events->push_back(event);
+        }
+        return ret;
+    };
+}
+
+// Requant parameters for channels outputs with made-up scales, released
+// with the last closure that holds them.
+static std::shared_ptr<abc::Int8Requant> make_requant(int channels) {
+    std::shared_ptr<abc::Int8Requant> requant(new abc::Int8Requant(), [](abc::Int8Requant *r) {
+        abc::release_int8_requant(r);
+        delete r;
+    });
+    abc::QuantParams in = abc::make_quant_params(1.0f / 255, -128);
+    abc::QuantParams w = abc::make_quant_params(1.0f / 127, 0);
+    abc::QuantParams out = abc::make_quant_params(0.05f, 0);
+    if (CL_SUCCESS != abc::create_int8_requant(channels, in, w, out, NULL, NULL, abc::ACT_NONE, requant.get())) {
+        return nullptr;
+    }
+    return requant;
+}
+
+static const double kHalf = 2.0;  // bytes
+
+static void register_gemm(abc::BenchRegistry *registry) {
+    // {M, N, K}
+    abc::Benchmark b;
+    b.name = "gemm_tiled";
+    b.shapes = {{64, 64, 64}, {256, 256, 256}, {512, 512, 512}, {1024, 1024, 1024}, {512, 3600, 128},
+                {100, 60, 37}};
+    b.setup = [](const BenchShape &s) -> abc::BenchRun {
+        const int M = s[0], N = s[1], K = s[2];
+        auto t = make_tensors({{1, 1, M, K}, {1, 1, K, N}, {1, 1, M, N}});
+        if (!t) return abc::BenchRun();
+        return single_event_run([=](cl_event *event) {
+            return abc::enqueue_gemm_fp16(false, false, M, N, K, gptr(t, 0), gptr(t, 1), gptr(t, 2), 0, NULL,
+                                          event);
+        });
+    };
+    b.flops = [](const BenchShape &s) { return 2.0 * s[0] * s[1] * s[2]; };
+    b.bytes = [](const BenchShape &s) {
+        return kHalf * ((double)s[0] * s[2] + (double)s[2] * s[1] + (double)s[0] * s[1]);
+    };
+    registry->add(b);
+
+    // 1x1 convolution {out channels, pixels, in channels} with a fused
+    // bias + relu epilogue
+    abc::Benchmark e;
+    e.name = "gemm_tiled_bias_relu";
+    e.shapes = {{64, 4096, 64}, {128, 3600, 128}, {256, 1024, 256}};
+    e.setup = [](const BenchShape &s) -> abc::BenchRun {
+        const int M = s[0], N = s[1], K = s[2];
+        auto t = make_tensors({{1, 1, K, M}, {1, 1, K, N}, {1, 1, M, N}, {1, 1, 1, M}});
+        if (!t) return abc::BenchRun();
+        return single_event_run([=](cl_event *event) {
+            abc::Epilogue epilogue;
+            epilogue.bias = gptr(t, 3);
+            epilogue.activation = abc::ACT_RELU;
+            return abc::enqueue_gemm_fp16(true, false, M, N, K, gptr(t, 0), gptr(t, 1), gptr(t, 2), 0, NULL,
+                                          event, NULL, epilogue);
+        });
+    };
+    e.flops = b.flops;
+    e.bytes = [](const BenchShape &s) {
+        return kHalf * ((double)s[0] * s[2] + (double)s[2] * s[1] + (double)s[0] * s[1] + s[0]);
+    };
+    registry->add(e);
+
+    abc::Benchmark q;
+    q.name = "gemm_int8_tiled";
+    q.shapes = b.shapes;
+    q.dtype = abc::ROOFLINE_INT8;
+    q.setup = [](const BenchShape &s) -> abc::BenchRun {
+        const int M = s[0], N = s[1], K = s[2];
+        auto t = make_tensors({{1, 1, M, K}, {1, 1, K, N}, {1, 1, M, N}}, abc::TENSOR_INT8);
+        auto requant = make_requant(M);
+        if (!t || !requant) return abc::BenchRun();
+        return single_event_run([=](cl_event *event) {
+            return abc::enqueue_gemm_int8(false, false, M, N, K, gptr(t, 0), gptr(t, 1), gptr(t, 2), *requant, 0,
+                                          NULL, event);
+        });
+    };
+    q.flops = b.flops;
+    q.bytes = [](const BenchShape &s) {
+        return (double)s[0] * s[2] + (double)s[2] * s[1] + (double)s[0] * s[1] + 2.0 * sizeof(float) * s[0];
+    };
+    registry->add(q);
+}
+
+static void register_deconv(abc::BenchRegistry *registry) {
+    // {IC, OC, IH, IW, kernel, stride, pad}
+    abc::Benchmark b;
+    b.name = "deconv";
+    b.shapes = {{32, 32, 64, 64, 2, 2, 0}, {64, 32, 64, 64, 2, 2, 0}, {32, 16, 64, 64, 3, 2, 1},
+                {16, 16, 128, 128, 4, 2, 1}, {64, 64, 32, 32, 3, 1, 1}};
+    b.setup = [](const BenchShape &s) -> abc::BenchRun {
+        abc::DeconvParams p = abc::make_deconv_params(s[4], s[5], s[6]);
+        abc::dims4d in = {1, s[0], s[2], s[3]};
+        auto t = make_tensors({in, {s[0], s[1], s[4], s[4]}, abc::deconv_output_dims(p, in, s[1])});
+        if (!t) return abc::BenchRun();
+        const int oc = s[1];
+        return single_event_run([=](cl_event *event) {
+            return abc::enqueue_deconv_fp16(p, in, oc, gptr(t, 0), gptr(t, 1), gptr(t, 2), 0, NULL, event);
+        });
+    };
+    b.flops = [](const BenchShape &s) { return 2.0 * s[0] * s[1] * s[2] * s[3] * s[4] * s[4]; };
+    b.bytes = [](const BenchShape &s) {
+        abc::dims4d in = {1, s[0], s[2], s[3]};
+        abc::dims4d out = abc::deconv_output_dims(abc::make_deconv_params(s[4], s[5], s[6]), in, s[1]);
+        return kHalf * ((double)s[0] * s[2] * s[3] + (double)s[0] * s[1] * s[4] * s[4] +
+                        (double)out.c * out.h * out.w);
+    };
+    registry->add(b);
+
+    abc::Benchmark q;
+    q.name = "deconv_int8";
+    q.shapes = b.shapes;
+    q.dtype = abc::ROOFLINE_INT8;
+    q.setup = [](const BenchShape &s) -> abc::BenchRun {
+        abc::DeconvParams p = abc::make_deconv_params(s[4], s[5], s[6]);
+        abc::dims4d in = {1, s[0], s[2], s[3]};
+        const int oc = s[1];
+        // the last tensor stands in for the int32 weight_sums[OC][KH * KW]
+        auto t = make_tensors({in, {s[0], oc, s[4], s[4]}, abc::deconv_output_dims(p, in, oc),
+                               {1, oc, s[4] * s[4], (int)sizeof(int32_t)}},
+                              abc::TENSOR_INT8);
+        auto requant = make_requant(oc);
+        if (!t || !requant) return abc::BenchRun();
+        return single_event_run([=](cl_event *event) {
+            return abc::enqueue_deconv_int8(p, in, oc, -128, gptr(t, 0), gptr(t, 1), gptr(t, 3), gptr(t, 2),
+                                            *requant, 0, NULL, event);
+        });
+    };
+    q.flops = b.flops;
+    q.bytes = [](const BenchShape &s) {
+        abc::dims4d in = {1, s[0], s[2], s[3]};
+        abc::dims4d out = abc::deconv_output_dims(abc::make_deconv_params(s[4], s[5], s[6]), in, s[1]);
+        return (double)s[0] * s[2] * s[3] + (double)s[0] * s[1] * s[4] * s[4] + (double)out.c * out.h * out.w;
+    };
+    registry->add(q);
+}
+
+static void register_attention(abc::BenchRegistry *registry) {
+    // {batch, heads, seq_len, head_dim, causal}
+    abc::Benchmark b;
+    b.name = "attention_fused";
+    b.shapes = {{1, 8, 128, 64, 0}, {1, 8, 512, 64, 0}, {1, 8, 1024, 64, 0}, {1, 8, 1024, 64, 1},
+                {1, 12, 256, 128, 0}};
+    b.setup = [](const BenchShape &s) -> abc::BenchRun {
+        abc::AttentionParams p = {s[0], s[1], s[2], s[3], 0.0f, s[4] != 0};
+        abc::dims4d d = {s[0], s[1], s[2], s[3]};
+        auto t = make_tensors({d, d, d, d});
+        if (!t) return abc::BenchRun();
+        return single_event_run([=](cl_event *event) {
+            return abc::enqueue_attention_fp16(p, gptr(t, 0), gptr(t, 1), gptr(t, 2), gptr(t, 3), 0, NULL,
+                                               event);
+        });
+    };
+    b.flops = [](const BenchShape &s) { return 4.0 * s[0] * s[1] * s[2] * s[2] * s[3] * (s[4] ? 0.5 : 1.0); };
+    b.bytes = [](const BenchShape &s) { return kHalf * 4.0 * s[0] * s[1] * s[2] * s[3]; };
+    registry->add(b);
+}
+
+static void register_epilogue(abc::BenchRegistry *registry) {
+    // {C, H, W}: standalone bias + relu + residual pass, bandwidth bound
+    abc::Benchmark b;
+    b.name = "epilogue_nchw";
+    b.shapes = {{32, 128, 128}, {64, 128, 128}, {256, 64, 64}};
+    b.setup = [](const BenchShape &s) -> abc::BenchRun {
+        abc::dims4d d = {1, s[0], s[1], s[2]};
+        auto t = make_tensors({d, d, {1, 1, 1, s[0]}});
+        if (!t) return abc::BenchRun();
+        return single_event_run([=](cl_event *event) {
+            abc::Epilogue epilogue;
+            epilogue.residual = gptr(t, 1);
+            epilogue.bias = gptr(t, 2);
+            epilogue.activation = abc::ACT_RELU;
+            return abc::enqueue_epilogue_fp16(d, gptr(t, 0), epilogue, 0, NULL, event);
+        });
+    };
+    b.bytes = [](const BenchShape &s) { return kHalf * 3.0 * s[0] * s[1] * s[2]; };
+    registry->add(b);
+}
+
+int main(int argc, char const *argv[]) {
+    abc::BenchOptions options;
+    std::string json_path, baseline_path, roofline_path;
+    bool list = false;
+    for (int i = 1; i < argc; ++i) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--list") == 0) {
+            list = true;
+        } else if (strcmp(argv[i], "--filter") == 0 && has_value) {
+            options.filter = argv[++i];
+        } else if (strcmp(argv[i], "--warmup") == 0 && has_value) {
+            options.warmup = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--reps") == 0 && has_value) {
+            options.reps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--json") == 0 && has_value) {
+            json_path = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && has_value) {
+            baseline_path = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 && has_value) {
+            options.threshold = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--roofline") == 0 && has_value) {
+            roofline_path = argv[++i];
+        } else {
+            LOGE("usage: %s [--list] [--filter name] [--warmup n] [--reps n] [--json out.json] "
+                 "[--baseline base.json] [--threshold 0.05] [--roofline profile.txt]", argv[0]);
+            return 1;
+        }
+    }
+    if (options.reps <= 0 || options.warmup < 0) {
+        LOGE("--reps must be positive and --warmup non-negative.");
+        return 1;
+    }
+
+    abc::BenchRegistry registry;
+    register_gemm(&registry);
+    register_deconv(&registry);
+    register_attention(&registry);
+    register_epilogue(&registry);
+    if (list) {
+        for (const abc::Benchmark &b : registry.benchmarks()) {
+            for (const BenchShape &s : b.shapes) {
+                LOGI("%s %s", b.name.c_str(), abc::bench_shape_string(s).c_str());
+            }
+        }
+        return 0;
+    }
+
+    clrt().init();
+    if (!roofline_path.empty() && CL_SUCCESS != clrt().load_roofline(roofline_path)) {
+        return 1;
+    }
+    LOGI("device %s, warmup %d, reps %d", clrt().device_name().c_str(), options.warmup, options.reps);
+    std::vector<abc::BenchResult> results;
+    registry.run(options, &results);
+    abc::print_bench_results(results);
+    if (!json_path.empty() && CL_SUCCESS == abc::save_bench_json(json_path, results)) {
+        LOGI("Saved %d results to %s", (int)results.size(), json_path.c_str());
+    }
+    if (!baseline_path.empty()) {
+        std::vector<abc::BenchResult> baseline;
+        if (CL_SUCCESS != abc::load_bench_json(baseline_path, &baseline)) {
+            return 1;
+        }
+        int regressions = abc::compare_bench_results(baseline, results, options.threshold);
+        LOGI("%d regression(s) over %.1f%% against %s", regressions, options.threshold * 100.0,
+             baseline_path.c_str());
+        return regressions;
+    }
+    return 0;
+}
@@ -50,4 +50,5 @@ else
     adb ${USE_IP} -s ${ADB_DEVICES} shell "mkdir -v ${ADB_DIR}"
     adb ${USE_IP} -s ${ADB_DEVICES} push ${OCLABC_ROOT}/install-${platform}/lib/* ${ADB_DIR}
     adb ${USE_IP} -s ${ADB_DEVICES} push ${OCLABC_ROOT}/install-${platform}/examples/* ${ADB_DIR}
+    adb ${USE_IP} -s ${ADB_DEVICES} push ${OCLABC_ROOT}/install-${platform}/bench/* ${ADB_DIR}
 fi
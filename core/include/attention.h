@@ -0,0 +1,35 @@
+#ifndef _ATTENTION_H_
+#define _ATTENTION_H_
+
+#include <string>
+
+#include "cl_runtime.h"
+
+namespace abc {
+
+// Multi-head scaled dot-product attention on fp16 tensors laid out as
+// {batch, heads, seq_len, head_dim} (kernel/CL/attention.cl).
+struct AttentionParams {
+    int batch, heads, seq_len, head_dim;
+    float scale;  // 0 picks 1 / sqrt(head_dim)
+    bool causal;  // mask keys after the query
+};
+
+std::string attention_build_options(const AttentionParams &p);
+
+// O = softmax(scale * Q * K^T + mask) * V in a single fused kernel with an
+// online softmax; no score matrix is materialized. head_dim must be a
+// multiple of 4 and at most 256; heads over 64 run the unfused kernels with
+// a score buffer from the pool, the fused one would spill registers.
+cl_int enqueue_attention_fp16(const AttentionParams &p, cl_mem Q, cl_mem K, cl_mem V, cl_mem O,
+                              cl_uint num_wait = 0, const cl_event *wait_list = NULL, cl_event *event = NULL,
+                              cl_command_queue queue = NULL);
+// The same as a gemm -> softmax -> gemm pipeline. scores holds
+// batch * heads * seq_len * seq_len halfs; *event completes with O.
+cl_int enqueue_attention_unfused_fp16(const AttentionParams &p, cl_mem Q, cl_mem K, cl_mem V, cl_mem scores,
+                                      cl_mem O, cl_uint num_wait = 0, const cl_event *wait_list = NULL,
+                                      cl_event *event = NULL, cl_command_queue queue = NULL);
+
+}  // namespace abc
+
+#endif
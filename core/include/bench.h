@@ -0,0 +1,87 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "cl_runtime.h"
+
+namespace abc {
+
+// Kernel benchmark harness. A Benchmark is a kernel plus the shapes it is
+// swept over; for every shape setup() allocates what the kernel needs and
+// returns a BenchRun that enqueues one iteration. The harness runs warmup
+// iterations, then reps timed ones, and records the device time (the sum of
+// get_cl_exec_time over the events the run hands back, so enqueue on the
+// profile queue) and the host wall time from enqueue to completion.
+typedef std::vector<int> BenchShape;
+typedef std::function<cl_int(std::vector<cl_event> *events)> BenchRun;
+
+struct Benchmark {
+    Benchmark() : dtype(ROOFLINE_FP16) {}
+    std::string name;
+    std::vector<BenchShape> shapes;
+    // The closure owns the buffers; they are freed once the shape is done.
+    std::function<BenchRun(const BenchShape &shape)> setup;
+    // Work per iteration, for GFLOPS and GB/s. Either may be empty.
+    std::function<double(const BenchShape &shape)> flops;
+    std::function<double(const BenchShape &shape)> bytes;
+    RooflineDataType dtype;  // which compute roof the kernel is held to
+};
+
+// Nearest-rank percentiles over the timed iterations, in ns.
+struct BenchStats {
+    double min, median, p90, p99;
+};
+
+struct BenchResult {
+    std::string name;
+    std::string shape;  // e.g. "512x512x512"
+    int reps;
+    BenchStats device, wall;
+    double flops, bytes;
+    // share of the roofline for the median time, 0 without a profile
+    double roofline_pct;
+    double gflops() const { return device.median > 0 ? flops / device.median : 0; }
+    double gbps() const { return device.median > 0 ? bytes / device.median : 0; }
+};
+
+struct BenchOptions {
+    BenchOptions() : warmup(3), reps(20), threshold(0.05) {}
+    int warmup, reps;
+    std::string filter;  // run benchmarks whose name contains it
+    // A run is a regression when its median device time exceeds the
+    // baseline's by more than threshold (relative).
+    double threshold;
+};
+
+std::string bench_shape_string(const BenchShape &shape);
+BenchStats compute_bench_stats(std::vector<double> samples);
+
+class BenchRegistry {
+   public:
+    void add(const Benchmark &bench) { benches_.push_back(bench); }
+    const std::vector<Benchmark> &benchmarks() const { return benches_; }
+    // Runs every matching benchmark over all its shapes and appends to
+    // results. Shapes whose setup or run fails are logged and skipped.
+    // roofline_pct is filled in from clrt().roofline() when it is valid.
+    cl_int run(const BenchOptions &options, std::vector<BenchResult> *results) const;
+
+   private:
+    std::vector<Benchmark> benches_;
+};
+
+// Results file: a JSON object with the device name and a "results" array
+// holding one object per line, which is also what load_bench_json() reads.
+cl_int save_bench_json(const std::string &path, const std::vector<BenchResult> &results);
+cl_int load_bench_json(const std::string &path, std::vector<BenchResult> *results);
+// Logs every result next to its baseline entry (matched by name and shape)
+// and returns the number of regressions.
+int compare_bench_results(const std::vector<BenchResult> &baseline, const std::vector<BenchResult> &results,
+                          double threshold);
+void print_bench_results(const std::vector<BenchResult> &results);
+
+}  // namespace abc
+
+#endif
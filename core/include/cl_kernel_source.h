@@ -0,0 +1,12 @@
+#ifndef _CL_KERNEL_SOURCE_H_
+#define _CL_KERNEL_SOURCE_H_
+
+namespace abc {
+
+// Source of kernel/CL/<name>.cl, embedded into the library at configure
+// time. NULL if there is no such file.
+const char *get_cl_kernel_source(const char *name);
+
+}  // namespace abc
+
+#endif
@@ -4,13 +4,37 @@
 #define __SHARP(X) #X
 #define _STR(X) __SHARP(X)
 
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #define CL_TARGET_OPENCL_VERSION 200
 #include "CL/cl.h"
+#include "mem_pool.h"
+#include "program_cache.h"
+#include "roofline.h"
+#include "stream.h"
+#include "tracer.h"
+#include "tuner.h"
 
 namespace abc {
 
+struct DeviceInfo {
+    cl_platform_id platform;
+    cl_device_id device;
+    cl_device_type type;
+    cl_uint compute_units;
+    cl_uint max_clock_mhz;
+    std::string platform_name;
+    std::string device_name;
+};
+
+// Every device of every platform, platforms in clGetPlatformIDs order.
+std::vector<DeviceInfo> enumerate_devices();
+
 class CLRuntime {
    public:
     CLRuntime(const CLRuntime&) = delete;
@@ -21,31 +45,150 @@ class CLRuntime {
     }
 
     ~CLRuntime();
+    // Sets up the device picked by OCLABC_DEVICE (an index into
+    // enumerate_devices()), else the first GPU, else the first device.
     cl_int init();
+    // Sets up the given device with a context and queues of its own.
+    cl_int init_device(cl_platform_id platform, cl_device_id device);
 
     cl_platform_id platform() { return platform_; }
     cl_context context() { return context_; }
     cl_device_id device_id() { return device_id_; }
+    // queue() is the in-order production queue without profiling;
+    // profile_queue() records timestamps for get_cl_exec_time.
     cl_command_queue queue() { return queue_; }
     cl_command_queue profile_queue() { return profile_queue_; }
+    const std::string &device_name() { return device_name_; }
+    const std::string &driver_version() { return driver_version_; }
+    // True when CL_DEVICE_EXTENSIONS lists name.
+    bool has_extension(const char *name);
+    // CL_DEVICE_SVM_CAPABILITIES, 0 on devices without SVM.
+    cl_device_svm_capabilities svm_capabilities() { return svm_capabilities_; }
+
+    // Binaries are cached under dir once it is set, either here or through
+    // the OCLABC_PROGRAM_CACHE_DIR environment variable read by init().
+    void set_program_cache_dir(const std::string &dir) { program_cache_.set_dir(dir); }
+    ProgramCacheStats program_cache_stats() const { return program_cache_.stats(); }
+
+    // Additional queues on the runtime's context, owned by the runtime until
+    // destroy_stream. flags is a mask of StreamFlags.
+    Stream *create_stream(unsigned flags, cl_int *err_ret);
+    void destroy_stream(Stream *stream);
+    // Waits for everything enqueued on queue(), profile_queue() and the
+    // streams.
+    cl_int finish();
+    // Appends a marker for queue(), profile_queue() and every stream, each
+    // completing once everything enqueued on it so far has; the caller
+    // releases them.
+    cl_int enqueue_markers(std::vector<cl_event> *markers);
+    // Frees an SVM allocation once the commands enqueued so far on queue(),
+    // profile_queue() and the streams have completed, without blocking.
+    void enqueue_svm_free(void *ptr);
+
+    // Tuned local work sizes; the database path can also be given through
+    // the OCLABC_TUNING_DB environment variable read by init().
+    LocalSizeTuner &tuner() { return tuner_; }
+
+    // Device buffers behind alloc_tensor_cl_mem are recycled through this pool.
+    MemPool &mem_pool() { return mem_pool_; }
+
+    // Opt-in trace of everything the library enqueues; OCLABC_TRACE=<path>,
+    // read by init(), records the whole run into path.
+    Tracer &tracer() { return tracer_; }
+
+    // Device limits for reporting a kernel's share of peak; invalid unless
+    // loaded here or through the OCLABC_ROOFLINE environment variable.
+    const RooflineProfile &roofline() { return roofline_; }
+    cl_int load_roofline(const std::string &path) { return load_roofline_profile(path, &roofline_); }
 
+    // The caller owns programs returned by the build_program_* functions.
     cl_program build_program_from_source(const char **source, cl_uint source_len, const char *options, cl_int *err_ret);
+    cl_program build_program_from_binary(const std::vector<unsigned char> &binary, const char *options, cl_int *err_ret);
+    cl_program build_program(const std::string &source, const std::string &options, cl_int *err_ret);
+
+    // Programs are built once per (source, options) and kept in a registry.
+    // A build runs outside the registry lock; callers that need the same
+    // program wait for it, everyone else goes on.
+    // Every create_kernel call hands out a kernel that no other caller holds,
+    // reusing an idle one from the pool when possible. Pass it back with
+    // release_kernel once its launches are enqueued; kernels that are never
+    // released stay owned by the runtime.
     cl_kernel create_kernel(const char *name, const char *source, const char *options, cl_int *err_ret);
+    void release_kernel(cl_kernel kernel);
+    // Drops the program and its idle kernels. Kernels still handed out stay
+    // valid and are released when they come back; programs still building
+    // are kept.
+    void evict_program(const char *source, const char *options);
+    void evict_all_programs();
+    std::size_t num_programs();
 
    private:
+    friend class DeviceGroup;
     CLRuntime() = default;
 
-    cl_platform_id platform_;
-    cl_context context_;
-    cl_device_id device_id_;
-    cl_command_queue queue_;
-    cl_command_queue profile_queue_;
-    std::vector<cl_program> programs_;
-    std::vector<cl_kernel> kernels_;
+    struct ProgramEntry {
+        cl_program program;
+        bool building;  // program not there yet, wait on program_built_
+        uint64_t generation;
+        std::map<std::string, std::vector<cl_kernel> > idle_kernels;
+    };
+    struct KernelSlot {
+        std::string program_key;
+        std::string name;
+        uint64_t generation;
+    };
+
+    std::string get_device_info_string(cl_device_info param);
+    cl_int get_program_binary(cl_program program, std::vector<unsigned char> *binary);
+    std::string make_build_options(const char *options);
+    std::string make_program_source(const char *source);
+    void release_program_entry(ProgramEntry *entry);
+
+    cl_platform_id platform_ = NULL;
+    cl_context context_ = NULL;
+    cl_device_id device_id_ = NULL;
+    cl_command_queue queue_ = NULL;
+    cl_command_queue profile_queue_ = NULL;
+    std::mutex registry_mutex_;
+    std::condition_variable program_built_;
+    std::unordered_map<std::string, ProgramEntry> programs_;
+    std::unordered_map<cl_kernel, KernelSlot> kernels_in_use_;
+    uint64_t next_generation_ = 0;
+    std::string device_name_;
+    std::string driver_version_;
+    std::string device_extensions_;
+    cl_device_svm_capabilities svm_capabilities_ = 0;
+    ProgramCache program_cache_;
+    MemPool mem_pool_;
+    LocalSizeTuner tuner_;
+    RooflineProfile roofline_;
+    Tracer tracer_;
+    std::string trace_path_;
+    // the process-wide instance(); only it takes OCLABC_TRACE,
+    // OCLABC_TUNING_DB and OCLABC_ROOFLINE
+    bool primary_ = true;
+    std::vector<Stream *> streams_;
 };
 
+// The runtime library calls on this thread use: the innermost
+// ScopedRuntime's, or CLRuntime::instance().
 CLRuntime& clrt();
 
+// Points clrt() on the calling thread at runtime for the lifetime of the
+// object, so the enqueue_* entry points, tensors and kernels use runtime's
+// device. cl_mem objects belong to one runtime's context; create and
+// release them under the same scope.
+class ScopedRuntime {
+   public:
+    explicit ScopedRuntime(CLRuntime &runtime);
+    ScopedRuntime(const ScopedRuntime &) = delete;
+    ScopedRuntime &operator=(const ScopedRuntime &) = delete;
+    ~ScopedRuntime();
+
+   private:
+    CLRuntime *previous_;
+};
+
 }  // namespace abc
 
 #endif
@@ -0,0 +1,136 @@
+#ifndef _COMMAND_GRAPH_H_
+#define _COMMAND_GRAPH_H_
+
+#include <map>
+#include <vector>
+
+#define CL_TARGET_OPENCL_VERSION 200
+#include "CL/cl.h"
+
+namespace abc {
+
+// How a recorded kernel argument was set: by value, as a buffer (which
+// replay can rebind) or as an SVM pointer.
+enum GraphArgKind { GRAPH_ARG_VALUE, GRAPH_ARG_MEM, GRAPH_ARG_SVM };
+
+// Replaces a buffer used while capturing with another one on replay.
+struct GraphBinding {
+    cl_mem captured;
+    cl_mem replacement;
+};
+
+// A recorded sequence of commands that can be replayed with little host
+// work. Between begin_capture() and end_capture(), everything the calling
+// thread enqueues to the capture queue through the library is recorded
+// instead of run: kernel launches (enqueue_kernel_async, and so every
+// enqueue_* entry point), buffer fills and the *_async host copies. Wait
+// lists between recorded commands become graph dependencies; the events
+// handed back during capture are already complete and only serve that
+// purpose.
+//
+// Every recorded launch gets its own kernel object with its arguments bound
+// once. Replay goes through cl_khr_command_buffer (0.9.5 or later) when the
+// device has it and the graph only holds kernels and fills; otherwise the
+// commands are enqueued back to back with a single flush. Arguments must be
+// set through set_kernel_args/KernelLauncher while capturing so they can be
+// recorded; capture fails for a kernel with arguments set any other way.
+// Buffers used while capturing must stay alive (and keep their contents'
+// meaning) for as long as the graph is replayed without rebinding them.
+class CommandGraph {
+   public:
+    CommandGraph();
+    CommandGraph(const CommandGraph &) = delete;
+    CommandGraph &operator=(const CommandGraph &) = delete;
+    ~CommandGraph();
+
+    // Records commands for queue, or for the profile queue if NULL. One
+    // capture per thread at a time; a graph is captured once.
+    cl_int begin_capture(cl_command_queue queue = NULL);
+    // Stops recording and prepares the replay. Returns the first error
+    // met while capturing.
+    cl_int end_capture();
+
+    // Runs the graph on the capture queue once every event in wait_list
+    // has completed; *event (if not NULL) completes with the whole graph.
+    // Buffers listed in bindings are replaced for this and later replays
+    // until bound to something else.
+    cl_int replay(cl_uint num_wait = 0, const cl_event *wait_list = NULL, cl_event *event = NULL);
+    cl_int replay(const std::vector<GraphBinding> &bindings, cl_uint num_wait = 0, const cl_event *wait_list = NULL,
+                  cl_event *event = NULL);
+
+    std::size_t num_commands() const { return commands_.size(); }
+    bool uses_command_buffer() const { return use_command_buffer_; }
+
+    // Hooks for the enqueue helpers in utils.cpp.
+    cl_int record_kernel(cl_kernel kernel, cl_uint work_dim, const size_t *global, const size_t *local,
+                         cl_uint num_wait, const cl_event *wait_list, cl_event *event);
+    cl_int record_fill(cl_mem mem, const void *pattern, size_t pattern_size, size_t offset, size_t bytes,
+                       cl_uint num_wait, const cl_event *wait_list, cl_event *event);
+    cl_int record_host_copy(bool write, cl_mem mem, void *host, size_t offset, size_t bytes, cl_uint num_wait,
+                            const cl_event *wait_list, cl_event *event);
+    void record_kernel_arg(cl_kernel kernel, cl_uint index, size_t size, const void *value, GraphArgKind kind);
+
+   private:
+    enum CommandType { GRAPH_KERNEL, GRAPH_FILL, GRAPH_WRITE, GRAPH_READ };
+    struct ArgValue {
+        bool set;
+        GraphArgKind kind;
+        std::vector<unsigned char> bytes;
+    };
+    struct Command {
+        CommandType type;
+        cl_kernel kernel;  // GRAPH_KERNEL: a kernel owned by the graph
+        cl_uint work_dim;
+        size_t global[3];
+        size_t local[3];
+        bool has_local;
+        cl_mem mem;  // the other types
+        void *host;
+        std::vector<unsigned char> pattern;
+        size_t offset;
+        size_t bytes;
+        std::vector<int> deps;  // indices of earlier commands
+    };
+    // A buffer argument of a recorded kernel.
+    struct MemSlot {
+        int command;
+        cl_uint index;
+        cl_mem captured;
+        cl_mem current;
+    };
+
+    cl_int add_command(Command *command, cl_uint num_wait, const cl_event *wait_list, cl_event *event);
+    cl_mem resolve(cl_mem captured, const std::vector<GraphBinding> &bindings) const;
+    cl_int apply_bindings(const std::vector<GraphBinding> &bindings);
+    cl_int replay_enqueue(cl_uint num_wait, const cl_event *wait_list, cl_event *event);
+    cl_int replay_command_buffer(cl_uint num_wait, const cl_event *wait_list, cl_event *event);
+    bool command_buffer_supported();
+    void release_command_buffers();
+
+    enum State { GRAPH_EMPTY, GRAPH_CAPTURING, GRAPH_READY, GRAPH_FAILED };
+    State state_;
+    cl_int capture_error_;
+    cl_command_queue queue_;
+    cl_context context_;
+    bool out_of_order_;
+    std::vector<Command> commands_;
+    std::vector<MemSlot> mem_slots_;
+    std::vector<GraphBinding> bindings_;  // applied on every replay
+    std::map<cl_kernel, std::vector<ArgValue> > args_;  // while capturing
+    std::map<cl_event, int> event_commands_;            // while capturing
+    bool use_command_buffer_;
+    bool simultaneous_use_;
+    // one finalized command buffer per set of bound buffers
+    std::map<std::vector<cl_mem>, void *> command_buffers_;
+    cl_event last_replay_;
+};
+
+// The graph capturing queue on this thread, or NULL.
+CommandGraph *capturing_graph(cl_command_queue queue);
+// True while this thread captures; set_kernel_arg() then records arguments.
+bool graph_capture_active();
+void record_graph_kernel_arg(cl_kernel kernel, cl_uint index, size_t size, const void *value, GraphArgKind kind);
+
+}  // namespace abc
+
+#endif
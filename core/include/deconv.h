@@ -0,0 +1,57 @@
+#ifndef _DECONV_H_
+#define _DECONV_H_
+
+#include <string>
+
+#include "cl_runtime.h"
+#include "epilogue.h"
+#include "quant.h"
+#include "type.h"
+
+namespace abc {
+
+// Transposed convolution (ConvTranspose2d) parameters.
+struct DeconvParams {
+    int kernel_h, kernel_w;
+    int stride_h, stride_w;
+    int pad_h, pad_w;
+    int dilation_h, dilation_w;
+    int output_padding_h, output_padding_w;
+};
+
+DeconvParams make_deconv_params(int kernel, int stride, int pad = 0, int dilation = 1, int output_padding = 0);
+// Output shape for input {N, IC, IH, IW}:
+//   OH = (IH - 1) * stride_h - 2 * pad_h + dilation_h * (kernel_h - 1) + output_padding_h + 1
+dims4d deconv_output_dims(const DeconvParams &p, const dims4d &input, int oc);
+// True when stride >= the dilated kernel extent in both directions, i.e.
+// no two taps write the same output and the direct kernel can be used.
+bool deconv_is_non_overlapping(const DeconvParams &p);
+std::string deconv_build_options(const DeconvParams &p);
+
+// output = conv_transpose2d(input, weight) in fp16 NCHW with kernel/CL/deconv.cl.
+// weight is [IC][OC][kernel_h][kernel_w] and output must hold
+// deconv_output_dims(p, input_dims, oc). Commands go to queue, or to the
+// profile queue if NULL; *event (if not NULL) completes with the output.
+// The epilogue runs before the store with the output channel as channel.
+cl_int enqueue_deconv_fp16(const DeconvParams &p, const dims4d &input_dims, int oc,
+                           cl_mem input, cl_mem weight, cl_mem output,
+                           cl_uint num_wait = 0, const cl_event *wait_list = NULL, cl_event *event = NULL,
+                           cl_command_queue queue = NULL, const Epilogue &epilogue = Epilogue());
+// Int8 variant (kernel/CL/deconv_int8.cl) with the same shapes. input is
+// quantized with zero point in_zp, weight symmetrically (per tensor or per
+// output channel). weight_sums is an int32 [OC][kernel_h * kernel_w] buffer
+// of int8_channel_sums(IC, OC * kernel_h * kernel_w, 1, weight); requant is
+// built without weight_sums, the kernel applies the zero point itself.
+cl_int enqueue_deconv_int8(const DeconvParams &p, const dims4d &input_dims, int oc, int in_zp,
+                           cl_mem input, cl_mem weight, cl_mem weight_sums, cl_mem output,
+                           const Int8Requant &requant,
+                           cl_uint num_wait = 0, const cl_event *wait_list = NULL, cl_event *event = NULL,
+                           cl_command_queue queue = NULL);
+// Tunes the local size of the kernel enqueue_deconv_fp16() picks for this
+// shape and records it in clrt().tuner().
+cl_int tune_deconv_fp16(const DeconvParams &p, const dims4d &input_dims, int oc,
+                        cl_mem input, cl_mem weight, cl_mem output);
+
+}  // namespace abc
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef _DEVICE_GROUP_H_
+#define _DEVICE_GROUP_H_
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "cl_runtime.h"
+
+namespace abc {
+
+// Processes items [begin, begin + count) of a batch on device. Called on a
+// thread whose clrt() is that device's runtime, so everything it allocates
+// and enqueues stays on the device; buffers from other devices cannot be
+// used. Tensors remember the runtime they were allocated on and give their
+// memory back to it wherever they are freed.
+typedef std::function<cl_int(int device, int begin, int count)> BatchSliceFn;
+
+// A runtime (context, queues, programs, pool) per device, for data-parallel
+// work: a batch, the n of dims4d, is split across the devices in proportion
+// to their throughput and the slices run concurrently, one host thread per
+// device. Until a device has been measured its share follows compute units
+// * clock; its first measured rate (from calibrate() or a run) takes over
+// and later runs follow up with a moving average, so the split adapts to
+// the devices and the workload.
+class DeviceGroup {
+   public:
+    DeviceGroup() {}
+    DeviceGroup(const DeviceGroup &) = delete;
+    DeviceGroup &operator=(const DeviceGroup &) = delete;
+
+    // Sets up a runtime per device, e.g. for all of enumerate_devices().
+    cl_int init(const std::vector<DeviceInfo> &devices);
+
+    int size() const { return (int)runtimes_.size(); }
+    CLRuntime &runtime(int device) { return *runtimes_[device]; }
+    const DeviceInfo &device(int device) const { return devices_[device]; }
+    // Measured items per second of each device, 0 until it has run.
+    const std::vector<double> &throughput() const { return throughput_; }
+
+    // Items per device for a batch, summing to batch.
+    std::vector<int> split_batch(int batch) const;
+    // Runs split_batch(batch) and returns once every device has finished;
+    // *split (if not NULL) receives the split used.
+    cl_int run_batch(int batch, const BatchSliceFn &fn, std::vector<int> *split = NULL);
+    // Runs counts[i] items on device i, devices with no items skipped.
+    cl_int run_split(const std::vector<int> &counts, const BatchSliceFn &fn);
+    // Times items items on each device alone and takes the rates as the
+    // throughput.
+    cl_int calibrate(int items, const BatchSliceFn &fn);
+
+   private:
+    cl_int run_slices(const std::vector<int> &counts, const BatchSliceFn &fn, std::vector<double> *seconds);
+
+    std::vector<std::unique_ptr<CLRuntime> > runtimes_;
+    std::vector<DeviceInfo> devices_;
+    std::vector<double> prior_;  // compute units * MHz
+    std::vector<double> throughput_;
+};
+
+}  // namespace abc
+
+#endif
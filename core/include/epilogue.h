@@ -0,0 +1,48 @@
+#ifndef _EPILOGUE_H_
+#define _EPILOGUE_H_
+
+#include <string>
+
+#include "cl_runtime.h"
+#include "type.h"
+
+namespace abc {
+
+typedef enum ActivationType {
+    ACT_NONE = 0,
+    ACT_RELU = 1,
+    ACT_RELU6 = 2,
+    ACT_GELU = 3  // tanh approximation
+} ActivationType;
+
+// Output epilogue fused into the gemm and deconv kernels (kernel/CL/epilogue.cl):
+//   out = act(scale * acc + bias[channel] + residual[index])
+// bias holds one half per output channel, residual has the output's layout.
+// Unset stages are compiled out.
+struct Epilogue {
+    Epilogue() : bias(NULL), scale(1.0f), residual(NULL), activation(ACT_NONE) {}
+    bool empty() const { return !bias && scale == 1.0f && !residual && activation == ACT_NONE; }
+    cl_mem bias;
+    float scale;
+    cl_mem residual;
+    ActivationType activation;
+};
+
+std::string epilogue_build_options(const Epilogue &epilogue);
+// The prelude kernel source followed by the named one, built once.
+const std::string &kernel_source_with_prelude(const char *prelude, const char *name);
+// kernel/CL/epilogue.cl followed by the named kernel source, for kernels
+// that take EPILOGUE_PARAMS.
+const std::string &kernel_source_with_epilogue(const char *name);
+// Sets the three EPILOGUE_PARAMS arguments starting at index first_arg.
+cl_int set_epilogue_args(cl_kernel kernel, cl_uint first_arg, const Epilogue &epilogue);
+
+// Applies the epilogue in place to an NCHW tensor as a separate pass, for
+// outputs of kernels without a fused one.
+cl_int enqueue_epilogue_fp16(const dims4d &dims, cl_mem data, const Epilogue &epilogue,
+                             cl_uint num_wait = 0, const cl_event *wait_list = NULL, cl_event *event = NULL,
+                             cl_command_queue queue = NULL);
+
+}  // namespace abc
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef _GEMM_H_
+#define _GEMM_H_
+
+#include <string>
+
+#include "cl_runtime.h"
+#include "epilogue.h"
+#include "quant.h"
+
+namespace abc {
+
+// Tile shape of the gemm_tiled kernel in kernel/CL/gemm.cl.
+struct GemmConfig {
+    int tile_m, tile_n, tile_k;
+    int wpt_m, wpt_n;  // register block of C per work-item
+};
+
+// Picks a tile shape for the problem: large tiles for big outputs, smaller
+// ones when M or N would leave most of a large tile empty.
+GemmConfig select_gemm_config(int M, int N, int K);
+std::string gemm_build_options(const GemmConfig &config, bool trans_a, bool trans_b);
+
+// C[M][N] = op(A) * op(B) in fp16 on packed buffers. A is [M][K], or [K][M]
+// when trans_a; B is [K][N], or [N][K] when trans_b. Commands go to queue,
+// or to the profile queue if NULL. The epilogue runs on C before the store,
+// with row m as the channel.
+cl_int enqueue_gemm_fp16(bool trans_a, bool trans_b, int M, int N, int K,
+                         cl_mem A, cl_mem B, cl_mem C,
+                         cl_uint num_wait = 0, const cl_event *wait_list = NULL, cl_event *event = NULL,
+                         cl_command_queue queue = NULL, const Epilogue &epilogue = Epilogue());
+cl_int enqueue_gemm_fp16_with_config(const GemmConfig &config, bool trans_a, bool trans_b, int M, int N, int K,
+                                     cl_mem A, cl_mem B, cl_mem C,
+                                     cl_uint num_wait = 0, const cl_event *wait_list = NULL, cl_event *event = NULL,
+                                     cl_command_queue queue = NULL, const Epilogue &epilogue = Epilogue());
+
+// C[M][N] = requant(op(A) * op(B)) on int8 buffers (kernel/CL/gemm_int8.cl),
+// same layouts and tile selection as enqueue_gemm_fp16(). A is the weight
+// side: symmetric, per tensor or per row m. The zero point of B is taken
+// care of by building requant with weight_sums = int8_channel_sums() of A's
+// rows; row m is the requant channel.
+cl_int enqueue_gemm_int8(bool trans_a, bool trans_b, int M, int N, int K,
+                         cl_mem A, cl_mem B, cl_mem C, const Int8Requant &requant,
+                         cl_uint num_wait = 0, const cl_event *wait_list = NULL, cl_event *event = NULL,
+                         cl_command_queue queue = NULL);
+
+// 1x1 convolution as a gemm on NC4HW4 images (kernel/CL/gemm_image.cl):
+// output {1, M, H, W} = weight^T * input {1, K, H, W}. weight is an image
+// from create_fp16_weight_image(K, M, 1, ...).
+cl_int enqueue_gemm_fp16_image(int K, int M, int H, int W, cl_mem input, cl_mem weight, cl_mem output,
+                               cl_uint num_wait = 0, const cl_event *wait_list = NULL, cl_event *event = NULL,
+                               cl_command_queue queue = NULL);
+
+}  // namespace abc
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef _HALF_CONVERT_H_
+#define _HALF_CONVERT_H_
+
+#include <cstddef>
+
+#define CL_TARGET_OPENCL_VERSION 200
+#include "CL/cl.h"
+
+namespace abc {
+
+// Bulk fp32 <-> fp16 conversion, bit-exact with to_half()/to_float():
+// fp32 -> fp16 rounds toward zero, clamps finite overflow to +-65504 and
+// turns every NaN into 0x7fff; fp16 -> fp32 is exact and turns every NaN
+// into the default quiet NaN. The SIMD kernel is picked at run time
+// (NEON fcvtn/fcvtl on aarch64, F16C on x86) and arrays of at least
+// kHalfConvertParallelMin elements are split across num_threads threads
+// (0 picks the number of cores).
+static const std::size_t kHalfConvertParallelMin = 1 << 20;
+
+void convert_f32_to_f16(std::size_t n, const float *src, cl_half *dst, int num_threads = 0);
+void convert_f16_to_f32(std::size_t n, const cl_half *src, float *dst, int num_threads = 0);
+
+// The per-element to_half()/to_float() loops the SIMD paths must match.
+void convert_f32_to_f16_scalar(std::size_t n, const float *src, cl_half *dst);
+void convert_f16_to_f32_scalar(std::size_t n, const cl_half *src, float *dst);
+
+// "neon", "f16c" or "scalar": the kernel convert_* run on this CPU.
+const char *half_convert_isa();
+
+}  // namespace abc
+
+#endif
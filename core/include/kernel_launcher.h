@@ -0,0 +1,107 @@
+#ifndef _KERNEL_LAUNCHER_H_
+#define _KERNEL_LAUNCHER_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include <tuple>
+#include <type_traits>
+
+#include "tuner.h"
+#include "utils.h"
+
+namespace abc {
+
+// Typed launcher for a kernel whose leading arguments are Args..., e.g.
+//   KernelLauncher<int, int, cl_mem> launcher(kernel);
+//   ret = launcher.launch(1, work, local, 0, NULL, &event, queue, n, hw, data);
+// bind() only accepts exactly Args..., so a wrong count or type (size_t for
+// int, float for half, ...) fails to compile instead of silently setting
+// garbage. Every value is remembered and clSetKernelArg (or
+// clSetKernelArgSVMPointer for SvmPointer) is skipped for arguments equal to
+// those of the previous bind(), so keeping a launcher across launches costs
+// next to nothing for unchanged sizes and buffers.
+// That cache assumes nothing else sets those argument indices on the kernel;
+// call invalidate() if something does. Arguments past Args... (epilogue,
+// requant) are set by the caller between bind() and enqueue().
+template <typename... Args>
+class KernelLauncher {
+    static_assert(sizeof...(Args) <= 64, "KernelLauncher tracks at most 64 arguments");
+
+   public:
+    explicit KernelLauncher(cl_kernel kernel = NULL) : kernel_(kernel), bound_(0) {}
+
+    cl_kernel kernel() const { return kernel_; }
+    void reset(cl_kernel kernel) {
+        kernel_ = kernel;
+        bound_ = 0;
+    }
+    void invalidate() { bound_ = 0; }
+
+    // Returns the first clSetKernelArg error; arguments after it are left
+    // as they were and will be set again by the next bind().
+    template <typename... Ts>
+    cl_int bind(const Ts &... args) {
+        static_assert(sizeof...(Ts) == sizeof...(Args), "wrong number of kernel arguments");
+        static_assert(std::is_same<std::tuple<typename std::decay<Ts>::type...>, std::tuple<Args...> >::value,
+                      "kernel argument types do not match the launcher signature");
+        if (graph_capture_active()) {
+            bound_ = 0;  // a capture has to see every argument
+        }
+        return bind_from<0>(args...);
+    }
+
+    // work is the problem size; with a local size it is rounded up to a
+    // multiple of it, without one the driver picks. Commands go to queue, or
+    // to the profile queue if NULL.
+    cl_int enqueue(cl_uint work_dim, const size_t *work, const size_t *local, cl_uint num_wait,
+                   const cl_event *wait_list, cl_event *event, cl_command_queue queue = NULL) {
+        size_t global[3];
+        if (local) {
+            LocalSizeTuner::pad_global_size(work_dim, work, local, global);
+            work = global;
+        }
+        return enqueue_kernel_async(kernel_, work_dim, work, local, num_wait, wait_list, event, queue);
+    }
+
+    template <typename... Ts>
+    cl_int launch(cl_uint work_dim, const size_t *work, const size_t *local, cl_uint num_wait,
+                  const cl_event *wait_list, cl_event *event, cl_command_queue queue, const Ts &... args) {
+        cl_int ret = bind(args...);
+        if (CL_SUCCESS != ret) {
+            return ret;
+        }
+        return enqueue(work_dim, work, local, num_wait, wait_list, event, queue);
+    }
+
+   private:
+    template <cl_uint I>
+    cl_int bind_from() {
+        return CL_SUCCESS;
+    }
+
+    template <cl_uint I, typename T, typename... Rest>
+    cl_int bind_from(const T &arg, const Rest &... rest) {
+        static_assert(std::is_trivially_copyable<T>::value, "kernel arguments must be trivially copyable");
+        T &cached = std::get<I>(values_);
+        const uint64_t bit = (uint64_t)1 << I;
+        if (!(bound_ & bit) || memcmp(&cached, &arg, sizeof(T)) != 0) {
+            cl_int ret = set_kernel_arg(kernel_, I, arg);
+            if (CL_SUCCESS != ret) {
+                bound_ &= ~bit;
+                return ret;
+            }
+            cached = arg;
+            bound_ |= bit;
+        }
+        return bind_from<I + 1>(rest...);
+    }
+
+    cl_kernel kernel_;
+    uint64_t bound_;  // bit i: values_ holds what argument i is set to
+    std::tuple<Args...> values_;
+};
+
+}  // namespace abc
+
+#endif
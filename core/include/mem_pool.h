@@ -0,0 +1,88 @@
+#ifndef _MEM_POOL_H_
+#define _MEM_POOL_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#define CL_TARGET_OPENCL_VERSION 200
+#include "CL/cl.h"
+
+namespace abc {
+
+struct MemPoolStats {
+    std::size_t bytes_in_use;    // bucket bytes held by live buffers
+    std::size_t bytes_cached;    // bucket bytes parked in the free lists
+    std::size_t peak_bytes;      // max of bytes_in_use + bytes_cached
+    std::size_t num_acquires;
+    std::size_t num_hits;        // acquires served from the free lists
+    double hit_rate() const { return num_acquires ? (double)num_hits / num_acquires : 0.0; }
+};
+
+// Caching allocator for device buffers. Requests are rounded up to a bucket
+// (quarter steps between powers of two, so at most 25% slack), released
+// buffers go back to the free list of their bucket and later requests of
+// the same bucket reuse them instead of calling clCreateBuffer. Cached
+// bytes are kept below the high-water mark, oldest buffers released first.
+//
+// Commands on any queue may still use a buffer when it is released, so the
+// pool records fence events at release (marker events on every queue of
+// the runtime, see set_fences) and hands the buffer out again only once
+// they have completed; until then its bucket is served by another buffer.
+class MemPool {
+   public:
+    static const std::size_t kDefaultHighWaterMark = 256u << 20;
+    // Appends events completing once everything enqueued so far has; the
+    // pool releases them.
+    typedef std::function<cl_int(std::vector<cl_event> *fences)> FenceFn;
+
+    MemPool() : context_(NULL), high_water_mark_(kDefaultHighWaterMark), clock_(0) {
+        memset(&stats_, 0, sizeof(stats_));
+    }
+    ~MemPool() { trim(0); }
+
+    void set_context(cl_context context) { context_ = context; }
+    void set_fences(const FenceFn &fences) { fences_ = fences; }
+    void set_high_water_mark(std::size_t bytes);
+    std::size_t high_water_mark() const { return high_water_mark_; }
+
+    cl_mem acquire(std::size_t bytes, cl_int *err_ret);
+    void release(cl_mem mem);
+    // Releases cached buffers until at most target_bytes stay cached.
+    void trim(std::size_t target_bytes);
+
+    MemPoolStats stats();
+    // Restarts peak and hit-rate accounting from the current state.
+    void reset_stats();
+
+    static std::size_t bucket_size(std::size_t bytes);
+
+   private:
+    struct CachedBuffer {
+        cl_mem mem;
+        uint64_t stamp;
+        std::vector<cl_event> fences;  // pending until all have completed
+    };
+
+    static bool idle(CachedBuffer *cached);
+    static void release_fences(CachedBuffer *cached);
+    void trim_locked(std::size_t target_bytes);
+
+    cl_context context_;
+    FenceFn fences_;
+    std::size_t high_water_mark_;
+    uint64_t clock_;
+    std::mutex mutex_;
+    std::multimap<std::size_t, CachedBuffer> free_;
+    std::unordered_map<cl_mem, std::size_t> live_;
+    MemPoolStats stats_;
+};
+
+}  // namespace abc
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef _OP_GRAPH_H_
+#define _OP_GRAPH_H_
+
+#include <vector>
+
+#include "cl_runtime.h"
+#include "deconv.h"
+#include "epilogue.h"
+#include "type.h"
+
+namespace abc {
+
+// Epilogue of a graph op. bias and residual are graph tensors, -1 for none.
+struct OpEpilogue {
+    OpEpilogue() : bias(-1), scale(1.0f), residual(-1), activation(ACT_NONE) {}
+    int bias;
+    float scale;
+    int residual;
+    ActivationType activation;
+};
+
+struct OpGraphMemoryPlan {
+    std::size_t num_intermediates;
+    std::size_t naive_bytes;    // every intermediate in a buffer of its own
+    std::size_t planned_bytes;  // sum of the arenas
+    std::size_t num_arenas;
+    std::size_t num_in_place;   // elementwise ops that overwrite their input
+};
+
+// A static graph of fp16 ops (gemm, deconv, elementwise epilogue) over
+// packed NCHW tensors. Ops may be added in any order; compile() schedules
+// them topologically, works out when every intermediate is first written
+// and last read, and places intermediates that are never alive at the same
+// time at overlapping offsets of a few shared arena buffers (greedy by
+// size, best fit). Each intermediate is a sub-buffer of its arena. An
+// elementwise op whose input dies with it writes over that input.
+//
+// Inputs and outputs are caller buffers bound with bind() before run();
+// constants (weights, biases) are given when added or bound the same way.
+// Memory is reused between ops that the queue runs one after the other, so
+// run() needs an in-order queue.
+class OpGraph {
+   public:
+    OpGraph();
+    OpGraph(const OpGraph &) = delete;
+    OpGraph &operator=(const OpGraph &) = delete;
+    ~OpGraph();
+
+    // Tensor ids, or -1 once the graph is compiled.
+    int add_input(const dims4d &dims);
+    int add_output(const dims4d &dims);
+    int add_constant(const dims4d &dims, cl_mem mem = NULL);
+    int add_intermediate(const dims4d &dims);
+
+    // The ops write their last tensor, which must be an output or an
+    // intermediate no other op writes. CL_INVALID_VALUE for unknown
+    // tensors or mismatched shapes.
+    // c[M][N] = op(a) * op(b), as enqueue_gemm_fp16(); a {1, K, H, W}
+    // input is a [K][H * W] matrix, so 1x1 convolutions need no reshape.
+    cl_int add_gemm(bool trans_a, bool trans_b, int M, int N, int K, int a, int b, int c,
+                    const OpEpilogue &epilogue = OpEpilogue());
+    // As enqueue_deconv_fp16(); the output channels are output's dims.c.
+    cl_int add_deconv(const DeconvParams &p, int input, int weight, int output,
+                      const OpEpilogue &epilogue = OpEpilogue());
+    // output = epilogue(input) on tensors of the same dims.
+    cl_int add_elementwise(int input, int output, const OpEpilogue &epilogue);
+
+    // Schedules the ops and allocates the intermediates. Without
+    // share_memory every intermediate gets a pool buffer of its own, which
+    // is what the plan is measured against.
+    cl_int compile(bool share_memory = true);
+    cl_int bind(int tensor, cl_mem mem);
+    // Enqueues every op to queue, or to the profile queue if NULL. The
+    // first command waits for wait_list; *event (if not NULL) completes
+    // with the last one.
+    cl_int run(cl_uint num_wait = 0, const cl_event *wait_list = NULL, cl_event *event = NULL,
+               cl_command_queue queue = NULL);
+
+    const OpGraphMemoryPlan &memory_plan() const { return plan_; }
+    // Op indices in the order run() enqueues them.
+    const std::vector<int> &schedule() const { return schedule_; }
+
+   private:
+    enum TensorKind { OP_TENSOR_INPUT, OP_TENSOR_OUTPUT, OP_TENSOR_CONSTANT, OP_TENSOR_INTERMEDIATE };
+    enum OpType { OP_GEMM, OP_DECONV, OP_ELEMENTWISE };
+    struct TensorInfo {
+        TensorKind kind;
+        dims4d dims;
+        std::size_t bytes;
+        cl_mem mem;
+        int producer;  // op index, -1 if none
+        int root;      // tensor whose storage this one shares
+    };
+    struct Op {
+        OpType type;
+        bool trans_a, trans_b;
+        int M, N, K;
+        DeconvParams deconv;
+        std::vector<int> inputs;
+        int output;
+        OpEpilogue epilogue;
+        bool in_place;
+    };
+
+    int add_tensor(TensorKind kind, const dims4d &dims, cl_mem mem);
+    bool valid_tensor(int tensor) const;
+    cl_int add_epilogue_inputs(Op *op, std::size_t channels);
+    cl_int add_op(Op *op);
+    cl_int schedule_ops();
+    cl_int plan_memory(bool share_memory);
+    cl_int enqueue_op(const Op &op, cl_uint num_wait, const cl_event *wait_list, cl_event *event,
+                      cl_command_queue queue);
+    Epilogue resolve_epilogue(const OpEpilogue &epilogue) const;
+    void release_memory();
+
+    bool compiled_;
+    std::vector<TensorInfo> tensors_;
+    std::vector<Op> ops_;
+    std::vector<int> schedule_;
+    std::vector<cl_mem> arenas_;       // pool buffers
+    std::vector<cl_mem> sub_buffers_;  // intermediates placed in the arenas
+    cl_event last_run_;                // completes with the last run()
+    OpGraphMemoryPlan plan_;
+};
+
+}  // namespace abc
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef _PROGRAM_CACHE_H_
+#define _PROGRAM_CACHE_H_
+
+#include <stdint.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace abc {
+
+struct ProgramCacheStats {
+    std::size_t hits;    // program created from a cached binary
+    std::size_t misses;  // no usable binary, built from source
+    std::size_t stale;   // binary found but rejected by the driver
+    std::size_t stores;  // binaries written back to the cache
+};
+
+// On-disk cache of CL_PROGRAM_BINARIES. An entry is keyed on the device name,
+// the driver version, the final program source and the build options, and is
+// stored as <dir>/<fnv1a64 of the key>.clbin. The header repeats the key
+// fields so that a hash collision or a driver update is detected on load.
+class ProgramCache {
+   public:
+    ProgramCache();
+
+    void set_dir(const std::string &dir);
+    const std::string &dir() const { return dir_; }
+    bool enabled() const { return !dir_.empty(); }
+
+    std::string make_key(const std::string &device_name,
+                         const std::string &driver_version,
+                         const std::string &source,
+                         const std::string &options) const;
+
+    bool load(const std::string &key, std::vector<unsigned char> *binary);
+    bool store(const std::string &key, const std::vector<unsigned char> &binary);
+    void remove(const std::string &key);
+
+    void record_hit();
+    void record_miss();
+    void record_stale();
+    ProgramCacheStats stats() const;
+
+   private:
+    std::string path_of(const std::string &key) const;
+
+    std::string dir_;
+    mutable std::mutex mutex_;
+    ProgramCacheStats stats_;
+};
+
+uint64_t fnv1a64(const void *data, std::size_t len, uint64_t seed = 0xcbf29ce484222325ULL);
+
+}  // namespace abc
+
+#endif
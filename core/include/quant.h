@@ -0,0 +1,76 @@
+#ifndef _QUANT_H_
+#define _QUANT_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#define CL_TARGET_OPENCL_VERSION 200
+#include "CL/cl.h"
+#include "epilogue.h"
+
+namespace abc {
+
+// Affine int8 quantization, real = scale * (q - zero_point), with a single
+// scale/zero point for the whole tensor or one per channel. The int8
+// kernels take per-channel parameters for weights only, and those must be
+// symmetric (zero points of 0).
+struct QuantParams {
+    std::vector<float> scales;
+    std::vector<int> zero_points;
+    bool empty() const { return scales.empty(); }
+    bool per_channel() const { return scales.size() > 1; }
+    float scale(int c) const { return scales[per_channel() ? c : 0]; }
+    int zero_point(int c) const { return zero_points[per_channel() ? c : 0]; }
+};
+
+QuantParams make_quant_params(float scale, int zero_point);
+// Min/max calibration over [outer][channels][inner] data: one scale per
+// channel, or a single one when channels is 1. symmetric keeps the zero
+// points at 0, as the kernels require for weights.
+QuantParams choose_quant_params(std::size_t outer, int channels, std::size_t inner, const float *data,
+                                bool symmetric);
+// [outer][channels][inner] fp32 <-> int8 with round to nearest and
+// saturation; per-tensor params work with any split of the shape.
+void quantize_int8(std::size_t outer, int channels, std::size_t inner, const float *src, const QuantParams &params,
+                   int8_t *dst);
+void dequantize_int8(std::size_t outer, int channels, std::size_t inner, const int8_t *src,
+                     const QuantParams &params, float *dst);
+// Sum of every channel over outer and inner, for the zero-point corrections
+// of the int8 kernels.
+std::vector<int32_t> int8_channel_sums(std::size_t outer, int channels, std::size_t inner, const int8_t *data);
+
+// Requantizing epilogue of the int8 kernels (kernel/CL/quant.cl). The int32
+// accumulator of output channel c becomes
+//   out = clamp(rint(multiplier[c] * acc + offset[c]), act_min, act_max)
+// Built by create_int8_requant(); the buffers are owned by the caller until
+// release_int8_requant().
+struct Int8Requant {
+    Int8Requant() : multiplier(NULL), offset(NULL), act_min(-128), act_max(127) {}
+    cl_mem multiplier;  // float per channel
+    cl_mem offset;      // float per channel
+    int act_min, act_max;
+};
+
+// For an output of `channels` channels computed from input (per tensor) and
+// weight (per tensor or per channel) quantization:
+//   multiplier[c] = s_in * s_w[c] / s_out
+//   offset[c] = bias[c] / s_out + zp_out - multiplier[c] * zp_in * weight_sums[c]
+// bias (fp32, may be NULL) is added in real units. weight_sums (may be NULL)
+// folds the input zero point into the offset when every output of a channel
+// sees the same weights, as in a gemm; see int8_channel_sums(). ReLU and
+// ReLU6 become clamp bounds; GELU is not supported.
+cl_int create_int8_requant(int channels, const QuantParams &input, const QuantParams &weight,
+                           const QuantParams &output, const float *bias, const int32_t *weight_sums,
+                           ActivationType activation, Int8Requant *requant);
+void release_int8_requant(Int8Requant *requant);
+cl_int set_int8_requant_args(cl_kernel kernel, cl_uint first_arg, const Int8Requant &requant);
+
+// -DINT8_DOT for this device: the cl_arm_integer_dot_product_* built-ins
+// when the device advertises them, plain int arithmetic otherwise.
+std::string int8_build_options();
+
+}  // namespace abc
+
+#endif
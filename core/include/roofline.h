@@ -0,0 +1,53 @@
+#ifndef _ROOFLINE_H_
+#define _ROOFLINE_H_
+
+#include <string>
+
+#define CL_TARGET_OPENCL_VERSION 200
+#include "CL/cl.h"
+
+namespace abc {
+
+typedef enum RooflineDataType {
+    ROOFLINE_FP32,
+    ROOFLINE_FP16,
+    ROOFLINE_INT8
+} RooflineDataType;
+
+// Measured limits of the OpenCL device (kernel/CL/roofline.cl). A profile
+// is written once per device with probe_roofline() + save_roofline_profile()
+// and loaded by the tools that report a kernel's share of peak, either
+// explicitly or through the OCLABC_ROOFLINE environment variable read by
+// clrt().init(). The file is text with one tab separated key and value per
+// line; valid() is false until a profile has been probed or loaded.
+struct RooflineProfile {
+    RooflineProfile()
+        : fp32_gflops(0), fp16_gflops(0), int8_gops(0), read_gbps(0), write_gbps(0), copy_gbps(0),
+          local_gbps(0), launch_us(0) {}
+    bool valid() const { return copy_gbps > 0 && fp16_gflops > 0; }
+
+    std::string device;
+    double fp32_gflops, fp16_gflops, int8_gops;  // mad throughput, 2 ops per mad
+    double read_gbps, write_gbps, copy_gbps;     // global memory, copy counts both directions
+    double local_gbps;
+    double launch_us;  // host enqueue to completion of an empty kernel
+};
+
+// Runs the probes on clrt()'s device, taking a few seconds.
+cl_int probe_roofline(RooflineProfile *profile);
+cl_int save_roofline_profile(const std::string &path, const RooflineProfile &profile);
+cl_int load_roofline_profile(const std::string &path, RooflineProfile *profile);
+
+double roofline_peak_gops(const RooflineProfile &profile, RooflineDataType type);
+// min(peak, arithmetic intensity * copy bandwidth) for a kernel doing flops
+// operations over bytes of global traffic.
+double roofline_attainable_gops(const RooflineProfile &profile, RooflineDataType type, double flops,
+                                double bytes);
+// Achieved throughput of a run that took ns, as a percentage of the
+// attainable one; 0 without a valid profile.
+double roofline_percent(const RooflineProfile &profile, RooflineDataType type, double flops, double bytes,
+                        double ns);
+
+}  // namespace abc
+
+#endif
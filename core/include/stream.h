@@ -0,0 +1,48 @@
+#ifndef _STREAM_H_
+#define _STREAM_H_
+
+#define CL_TARGET_OPENCL_VERSION 200
+#include "CL/cl.h"
+
+namespace abc {
+
+typedef enum StreamFlags {
+    STREAM_DEFAULT = 0,         // in-order, no profiling
+    STREAM_OUT_OF_ORDER = 1,    // commands only ordered by their wait lists
+    STREAM_PROFILING = 1 << 1   // events carry timestamps for get_cl_exec_time
+} StreamFlags;
+
+// A command queue on the runtime's context. Streams run independently of
+// each other; order work across them with record() on the producer and
+// wait() on the consumer, which enqueues a barrier on the event instead of
+// blocking the host.
+class Stream {
+   public:
+    Stream(cl_context context, cl_device_id device, unsigned flags, cl_int *err_ret);
+    Stream(const Stream &) = delete;
+    Stream &operator=(const Stream &) = delete;
+    ~Stream();
+
+    cl_command_queue queue() { return queue_; }
+    unsigned flags() const { return flags_; }
+    bool out_of_order() const { return (flags_ & STREAM_OUT_OF_ORDER) != 0; }
+    bool profiling() const { return (flags_ & STREAM_PROFILING) != 0; }
+
+    // Marker completing once all work enqueued so far has completed. The
+    // caller releases *event.
+    cl_int record(cl_event *event);
+    // Work enqueued after this call starts only once event has completed.
+    cl_int wait(cl_event event);
+    // Work enqueued after this call waits for everything enqueued on other.
+    cl_int wait(Stream *other);
+    cl_int flush();
+    cl_int finish();
+
+   private:
+    cl_command_queue queue_;
+    unsigned flags_;
+};
+
+}  // namespace abc
+
+#endif
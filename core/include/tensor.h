@@ -9,22 +9,101 @@
 #include <stdlib.h>
 
 #include "cl_runtime.h"
+#include "quant.h"
 #include "type.h"
 
 namespace abc {
 
+typedef enum TensorMemType {
+    TENSOR_MEM_DEVICE,          // pooled device buffer, host copy in hostptr
+    TENSOR_MEM_ALLOC_HOST_PTR,  // driver-allocated host-visible buffer
+    TENSOR_MEM_USE_HOST_PTR,    // buffer wrapping aligned memory we own
+    TENSOR_MEM_IMAGE2D,         // CL_RGBA half image in NC4HW4 layout
+    TENSOR_MEM_MAPPED_FILE,     // buffer over the pages of a mapped tensor file
+    TENSOR_MEM_SVM_FINE,        // fine-grained SVM, shared by host and device as is
+    TENSOR_MEM_SVM_COARSE       // coarse-grained SVM, host access through map/unmap
+} TensorMemType;
+
+typedef enum TensorDataType {
+    TENSOR_FP16,
+    TENSOR_INT8  // affine int8, described by Tensor::quant
+} TensorDataType;
+
 struct Tensor {
-    Tensor() : hostptr(nullptr), gptr(nullptr) {}
+    Tensor()
+        : hostptr(nullptr), gptr(nullptr), mem_type(TENSOR_MEM_DEVICE), host_backing(nullptr), dtype(TENSOR_FP16),
+          runtime(nullptr) {}
+    Tensor(const Tensor &) = delete;
+    Tensor &operator=(const Tensor &) = delete;
+    Tensor(Tensor &&other);
     ~Tensor();
     std::size_t num_elem();
+    std::size_t elem_size() const { return dtype == TENSOR_INT8 ? 1 : sizeof(cl_half); }
+    std::size_t bytes() { return num_elem() * elem_size(); }
     dims4d dims;
     void *hostptr;
     cl_mem gptr;
+    TensorMemType mem_type;
+    // aligned memory behind a TENSOR_MEM_USE_HOST_PTR buffer, the
+    // MappedTensorFile behind a TENSOR_MEM_MAPPED_FILE one, or the
+    // clSVMAlloc pointer of a TENSOR_MEM_SVM_* tensor
+    void *host_backing;
+    TensorDataType dtype;
+    QuantParams quant;  // TENSOR_INT8 only
+    // clrt() when the device memory was allocated; the destructor releases
+    // it there whichever runtime is current then
+    CLRuntime *runtime;
 };
 
-Tensor make_4d_tensor(const dims4d &dims);
+Tensor make_4d_tensor(const dims4d &dims, TensorDataType dtype = TENSOR_FP16);
 void alloc_tensor_host_mem(Tensor *t);
 cl_int alloc_tensor_cl_mem(Tensor *t);
+// Allocates a host-visible buffer for zero-copy access on unified memory.
+// No hostptr is kept; read and write the data through ScopedTensorMap.
+cl_int alloc_tensor_mapped_mem(Tensor *t, TensorMemType mem_type);
+// Allocates the tensor with clSVMAlloc, fine-grained when the device
+// supports it and coarse-grained otherwise; fails without SVM support. Pass
+// SvmPointer{t->host_backing} to kernels, or gptr, a buffer over the same
+// memory, to the cl_mem entry points. The host reads and writes it through
+// ScopedTensorMap, which only maps coarse-grained memory.
+cl_int alloc_tensor_svm_mem(Tensor *t);
+// Alignment CL_MEM_USE_HOST_PTR memory needs to be zero-copy.
+std::size_t host_ptr_alignment();
+
+// NC4HW4 image layout: channels are split into blocks of four that make up
+// the RGBA components of one pixel, and the blocks are laid side by side:
+//   pixel (c4 * W + w, n * H + h) = channels c4 * 4 .. c4 * 4 + 3
+// Channels past C in the last block are zero.
+void nc4hw4_image_shape(const dims4d &dims, std::size_t *width, std::size_t *height);
+// Allocates the fp16 tensor as a TENSOR_MEM_IMAGE2D image. Upload and download
+// with copy_fp16_host_mem_to_image()/copy_fp16_image_to_host_mem().
+cl_int alloc_tensor_image_mem(Tensor *t);
+// Packs a [IC][OC][kernel_area] weight (kernel_area = 1 for a [K][M] gemm
+// weight) into a read-only image for the *_image kernels:
+//   pixel (ic, k * OC4 + oc4) = weight[ic][oc4 * 4 .. oc4 * 4 + 3][k]
+// The image is IC rounded up to 4 pixels wide; the caller releases it.
+cl_mem create_fp16_weight_image(int ic, int oc, int kernel_area, const void *weight, cl_int *err_ret);
+
+// Maps a tensor's buffer for host access for the lifetime of the object and
+// unmaps it on destruction. Images are not supported. Use CL_MAP_WRITE_INVALIDATE_REGION when the
+// host overwrites the whole tensor so the driver can skip a read back.
+// Fine-grained SVM needs no map; the constructor only waits for the
+// runtime's queues and streams to finish.
+class ScopedTensorMap {
+   public:
+    ScopedTensorMap(Tensor *t, cl_map_flags flags, cl_int *err_ret = nullptr);
+    ScopedTensorMap(const ScopedTensorMap &) = delete;
+    ScopedTensorMap &operator=(const ScopedTensorMap &) = delete;
+    ~ScopedTensorMap();
+
+    void *data() { return ptr_; }
+    cl_int unmap();
+
+   private:
+    cl_mem mem_;
+    void *ptr_;
+    bool svm_;  // ptr_ was mapped with clEnqueueSVMMap
+};
 
 }  // namespace abc
 
@@ -0,0 +1,87 @@
+#ifndef _TENSOR_FILE_H_
+#define _TENSOR_FILE_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "tensor.h"
+#include "type.h"
+
+namespace abc {
+
+// Binary tensor file (.oclt): a 64-byte little-endian header followed by
+// the raw NCHW data, which starts at data_offset, a multiple of alignment.
+// With a page-sized alignment the data can be mapped straight into a
+// CL_MEM_USE_HOST_PTR buffer. scripts/col2im.py writes the same layout.
+typedef enum TensorFileDType {
+    TENSOR_FILE_FP32 = 0,
+    TENSOR_FILE_FP16 = 1
+} TensorFileDType;
+
+static const char kTensorFileMagic[8] = {'O', 'C', 'L', 'A', 'B', 'C', 'T', '\0'};
+static const uint32_t kTensorFileVersion = 1;
+static const std::size_t kTensorFileAlignment = 4096;
+
+struct TensorFileHeader {
+    char magic[8];         // kTensorFileMagic
+    uint32_t version;      // kTensorFileVersion
+    uint32_t dtype;        // TensorFileDType
+    int32_t dims[4];       // n, c, h, w
+    uint32_t alignment;    // of data_offset
+    uint32_t reserved;
+    uint64_t data_offset;  // from the start of the file
+    uint64_t data_bytes;
+    uint8_t pad[8];
+};
+
+std::size_t tensor_file_dtype_size(TensorFileDType dtype);
+
+// Read-only view of a .oclt file or a little-endian, C-order .npy array
+// ('<f4' or '<f2', at most four dimensions, right-aligned into dims4d).
+// The file is mmapped privately, so writes through data() never reach it.
+class MappedTensorFile {
+   public:
+    MappedTensorFile() : map_(nullptr), map_bytes_(0), data_(nullptr), data_bytes_(0), dtype_(TENSOR_FILE_FP32) {}
+    MappedTensorFile(const MappedTensorFile &) = delete;
+    MappedTensorFile &operator=(const MappedTensorFile &) = delete;
+    ~MappedTensorFile() { close(); }
+
+    cl_int open(const std::string &path);
+    void close();
+
+    const dims4d &dims() const { return dims_; }
+    TensorFileDType dtype() const { return dtype_; }
+    void *data() const { return data_; }
+    std::size_t data_bytes() const { return data_bytes_; }
+    std::size_t num_elem() const { return data_bytes_ / tensor_file_dtype_size(dtype_); }
+    // Bytes from data() to the end of the last mapped page.
+    std::size_t mapped_bytes() const;
+
+   private:
+    cl_int parse_oclt(const std::string &path);
+    cl_int parse_npy(const std::string &path);
+
+    void *map_;
+    std::size_t map_bytes_;
+    void *data_;
+    std::size_t data_bytes_;
+    TensorFileDType dtype_;
+    dims4d dims_;
+};
+
+cl_int save_tensor_file(const std::string &path, const dims4d &dims, TensorFileDType dtype, const void *data,
+                        std::size_t alignment = kTensorFileAlignment);
+// Reads a tensor file of num_elem elements into fp16 host memory, converting
+// fp32 data on the way.
+cl_int read_tensor_file_fp16(const std::string &path, std::size_t num_elem, void *f16ptr);
+// Loads a tensor file into device memory and sets t->dims from the file.
+// fp16 data aligned to host_ptr_alignment() is used in place as a
+// TENSOR_MEM_MAPPED_FILE buffer over the mapped pages; anything else goes to
+// a pooled buffer in chunks, converted to fp16 while the previous chunk is
+// being written.
+cl_int load_tensor_file(const std::string &path, Tensor *t);
+
+}  // namespace abc
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef _TRACER_H_
+#define _TRACER_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CL_TARGET_OPENCL_VERSION 200
+#include "CL/cl.h"
+
+namespace abc {
+
+// Opt-in trace of every command the library enqueues (kernels, fills,
+// copies, maps, graph replays) and of TraceRange host ranges. Each command
+// keeps the host time spent in the enqueue call and its event's QUEUED,
+// SUBMIT, START and END timestamps; device timestamps are shifted onto the
+// host clock by the median of host enqueue midpoint - QUEUED.
+//
+// write_chrome_trace() writes Chrome trace JSON (chrome://tracing,
+// ui.perfetto.dev) with a track per host thread, per queue (QUEUED to
+// START, i.e. launch latency) and per queue on the device (START to END
+// plus the idle gaps between commands), and flow arrows from each enqueue
+// to its execution. Device tracks need a queue created with profiling;
+// setting OCLABC_TRACE=<path> before clrt().init() starts the tracer,
+// creates the runtime's queues with profiling and writes the trace to path
+// when the runtime is destroyed.
+class Tracer {
+   public:
+    Tracer() : enabled_(false), first_unresolved_(0) {}
+    Tracer(const Tracer &) = delete;
+    Tracer &operator=(const Tracer &) = delete;
+    ~Tracer() { clear(); }
+
+    // Starts recording, dropping whatever was recorded before.
+    void start();
+    void stop() { enabled_.store(false); }
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+    // Drops the records and the events they hold.
+    void clear();
+    std::size_t num_records();
+    // Label for queue's tracks; unnamed queues are numbered.
+    void name_queue(cl_command_queue queue, const std::string &name);
+
+    // Waits for every recorded command and writes the trace. Recording
+    // goes on; the next write includes these records again.
+    cl_int write_chrome_trace(const std::string &path);
+
+   private:
+    friend class TraceSpan;
+    friend class TraceRange;
+
+    struct Record {
+        std::string name;  // kernel function name, transfer or range
+        bool is_kernel;
+        int thread;
+        cl_command_queue queue;  // NULL for host ranges
+        uint64_t host_begin, host_end;
+        cl_event event;  // held until resolved
+        bool has_device;
+        cl_ulong queued, submit, start, end;
+        cl_uint work_dim;
+        size_t global[3], local[3];
+        bool has_local;
+        std::size_t bytes;
+    };
+
+    void add(Record *record);
+    void resolve_locked(bool wait);
+    int thread_index_locked();
+
+    std::atomic<bool> enabled_;
+    std::mutex mutex_;
+    std::vector<Record> records_;
+    std::size_t first_unresolved_;  // records before it hold no event
+    std::map<std::thread::id, int> threads_;
+    std::map<cl_command_queue, std::string> queue_names_;
+};
+
+// Host clock of the trace, in nanoseconds.
+uint64_t trace_now_ns();
+
+// Times one enqueue for clrt().tracer():
+//   TraceSpan span(queue, event);
+//   ret = clEnqueueNDRangeKernel(..., span.event());
+//   span.kernel(ret, kernel, work_dim, global, local);
+// While tracing, span.event() is a slot of the span's own when the caller
+// passed no event, so every traced command has one. Costs a flag check
+// otherwise.
+class TraceSpan {
+   public:
+    TraceSpan(cl_command_queue queue, cl_event *event);
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+    ~TraceSpan();
+
+    cl_event *event() { return event_; }
+    void kernel(cl_int ret, cl_kernel kernel, cl_uint work_dim, const size_t *global, const size_t *local);
+    // name is a string literal such as "write" or "fill".
+    void transfer(cl_int ret, const char *name, std::size_t bytes);
+
+   private:
+    void end(cl_int ret, uint64_t host_end, Tracer::Record *record);
+
+    Tracer *tracer_;  // NULL when not tracing
+    cl_command_queue queue_;
+    cl_event *user_event_;
+    cl_event own_event_;
+    cl_event *event_;
+    uint64_t host_begin_;
+};
+
+// A named host range on the calling thread's track, e.g. around a graph
+// run, so the enqueues inside it show up grouped.
+class TraceRange {
+   public:
+    explicit TraceRange(const char *name);
+    TraceRange(const TraceRange &) = delete;
+    TraceRange &operator=(const TraceRange &) = delete;
+    ~TraceRange();
+
+   private:
+    Tracer *tracer_;
+    const char *name_;
+    uint64_t host_begin_;
+};
+
+}  // namespace abc
+
+#endif
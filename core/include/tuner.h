@@ -0,0 +1,56 @@
+#ifndef _TUNER_H_
+#define _TUNER_H_
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define CL_TARGET_OPENCL_VERSION 200
+#include "CL/cl.h"
+
+namespace abc {
+
+// Local work-size tuner. tune() times every candidate local size for a
+// kernel with its arguments already set and records the fastest one in a
+// database keyed by device, kernel and shape. local_size() returns the
+// recorded value, or a heuristic one for shapes that were never tuned.
+// The database is a text file with one tab separated entry per line:
+//   <device>\t<kernel>\t<shape>\t<l0>,<l1>,<l2>
+class LocalSizeTuner {
+   public:
+    LocalSizeTuner() : dirty_(false) {}
+    // Writes back entries tuned since the last save().
+    ~LocalSizeTuner();
+
+    // Loads the database at path; save() writes it back there.
+    cl_int set_db_path(const std::string &path);
+    cl_int save();
+
+    // global is the unpadded problem size; launches round it up to local.
+    // With the kernel's fp16 ops and global bytes per launch, the result is
+    // also reported as a share of clrt().roofline() when one is loaded.
+    cl_int tune(const std::string &kernel_name, const std::string &shape, cl_kernel kernel,
+                cl_uint work_dim, const size_t *global, size_t *best_local, int reps = 5,
+                double flops = 0, double bytes = 0);
+    bool lookup(const std::string &kernel_name, const std::string &shape, cl_uint work_dim, size_t *local);
+    void local_size(const std::string &kernel_name, const std::string &shape, cl_kernel kernel,
+                    cl_uint work_dim, const size_t *global, size_t *local);
+
+    static void heuristic_local_size(cl_kernel kernel, cl_uint work_dim, const size_t *global, size_t *local);
+    static void candidate_local_sizes(cl_kernel kernel, cl_uint work_dim, const size_t *global,
+                                      std::vector<std::vector<size_t> > *candidates);
+    static void pad_global_size(cl_uint work_dim, const size_t *global, const size_t *local, size_t *padded);
+
+   private:
+    std::string make_key(const std::string &kernel_name, const std::string &shape);
+
+    std::string db_path_;
+    bool dirty_;
+    std::mutex mutex_;
+    std::map<std::string, std::vector<size_t> > db_;
+};
+
+}  // namespace abc
+
+#endif
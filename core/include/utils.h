@@ -4,48 +4,118 @@
 #include <string>
 
 #include "cl_runtime.h"
+#include "command_graph.h"
 #include "type.h"
 
 namespace abc {
 
-template <typename Tuple, uint32_t N>
-struct DummpyWrapper {
-    static void set_kernel_arg_wrapper(cl_kernel kernel, const Tuple &t)
-    {
-        DummpyWrapper<Tuple, N - 1>::set_kernel_arg_wrapper(kernel, t);
-        auto arg = std::get<N - 1>(t);
-        clSetKernelArg(kernel, N - 1, sizeof(arg), (void *)&arg);
-    }
+// A kernel argument that is an SVM pointer (see alloc_tensor_svm_mem()),
+// set with clSetKernelArgSVMPointer instead of clSetKernelArg.
+struct SvmPointer {
+    const void *ptr;
 };
 
-template <typename Tuple>
-struct DummpyWrapper<Tuple, 0> {
-    static void set_kernel_arg_wrapper(cl_kernel kernel, const Tuple &t)
-    {
-        (void)(kernel);
-        (void)(t);
+// While a CommandGraph captures on this thread the argument is also
+// recorded for it.
+template <typename T>
+inline cl_int set_kernel_arg(cl_kernel kernel, cl_uint index, const T &arg)
+{
+    cl_int ret = clSetKernelArg(kernel, index, sizeof(T), &arg);
+    if (CL_SUCCESS == ret && graph_capture_active()) {
+        record_graph_kernel_arg(kernel, index, sizeof(T), &arg, GRAPH_ARG_VALUE);
     }
-};
+    return ret;
+}
 
-template <typename... Args>
-inline cl_int set_kernel_args(cl_kernel kernel, Args... args)
+// Buffers and images; a graph can rebind these on replay.
+inline cl_int set_kernel_arg(cl_kernel kernel, cl_uint index, const cl_mem &arg)
+{
+    cl_int ret = clSetKernelArg(kernel, index, sizeof(cl_mem), &arg);
+    if (CL_SUCCESS == ret && graph_capture_active()) {
+        record_graph_kernel_arg(kernel, index, sizeof(cl_mem), &arg, GRAPH_ARG_MEM);
+    }
+    return ret;
+}
+
+inline cl_int set_kernel_arg(cl_kernel kernel, cl_uint index, const SvmPointer &arg)
 {
-    std::tuple<Args...> t = std::make_tuple(args...);
-    DummpyWrapper<decltype(t), sizeof...(Args)>::set_kernel_arg_wrapper(kernel, t);
+    cl_int ret = clSetKernelArgSVMPointer(kernel, index, arg.ptr);
+    if (CL_SUCCESS == ret && graph_capture_active()) {
+        record_graph_kernel_arg(kernel, index, sizeof(arg.ptr), &arg.ptr, GRAPH_ARG_SVM);
+    }
+    return ret;
+}
+
+inline cl_int set_kernel_args_from(cl_kernel kernel, cl_uint index)
+{
+    (void)(kernel);
+    (void)(index);
     return CL_SUCCESS;
 }
 
+template <typename T, typename... Rest>
+inline cl_int set_kernel_args_from(cl_kernel kernel, cl_uint index, const T &arg, const Rest &... rest)
+{
+    cl_int ret = set_kernel_arg(kernel, index, arg);
+    if (CL_SUCCESS != ret) {
+        return ret;
+    }
+    return set_kernel_args_from(kernel, index + 1, rest...);
+}
+
+// Sets arguments 0 .. sizeof...(args) - 1 and returns the first error. For
+// kernels launched repeatedly, KernelLauncher (kernel_launcher.h) also
+// checks the argument types and skips unchanged arguments.
+template <typename... Args>
+inline cl_int set_kernel_args(cl_kernel kernel, const Args &... args)
+{
+    return set_kernel_args_from(kernel, 0, args...);
+}
+
 cl_int copy_fp16_host_mem_to_cl_mem(std::size_t num_elem, const void *from, cl_mem to);
 cl_int copy_fp16_cl_mem_to_host_mem(std::size_t num_elem, cl_mem from, void *to);
+cl_int copy_int8_host_mem_to_cl_mem(std::size_t num_elem, const void *from, cl_mem to);
+cl_int copy_int8_cl_mem_to_host_mem(std::size_t num_elem, cl_mem from, void *to);
+
+// Non-blocking variants: the command starts once every event in wait_list
+// has completed, and *event (if not NULL) is set to a new event the caller
+// must release. The host memory must stay untouched until that event
+// completes. Chain upload -> launch -> download through the events and wait
+// once at the end. Commands go to queue, or to the profile queue if NULL.
+cl_int copy_fp16_host_mem_to_cl_mem_async(std::size_t num_elem, const void *from, cl_mem to,
+                                          cl_uint num_wait, const cl_event *wait_list, cl_event *event,
+                                          cl_command_queue queue = NULL);
+cl_int copy_fp16_cl_mem_to_host_mem_async(std::size_t num_elem, cl_mem from, void *to,
+                                          cl_uint num_wait, const cl_event *wait_list, cl_event *event,
+                                          cl_command_queue queue = NULL);
+cl_int enqueue_kernel_async(cl_kernel kernel, cl_uint work_dim, const size_t *global, const size_t *local,
+                            cl_uint num_wait, const cl_event *wait_list, cl_event *event,
+                            cl_command_queue queue = NULL);
+// Fills bytes of mem from offset 0 with copies of pattern.
+cl_int fill_cl_mem_async(cl_mem mem, const void *pattern, std::size_t pattern_size, std::size_t bytes,
+                         cl_uint num_wait, const cl_event *wait_list, cl_event *event,
+                         cl_command_queue queue = NULL);
+// NCHW <-> NC4HW4 repacking of fp16 host data (see nc4hw4_image_shape()).
+// The NC4HW4 side holds width * height * 4 halfs; padding channels are
+// written as zero on pack and skipped on unpack.
+void pack_fp16_nchw_to_nc4hw4(const dims4d &dims, const void *nchw, void *nc4hw4);
+void unpack_fp16_nc4hw4_to_nchw(const dims4d &dims, const void *nc4hw4, void *nchw);
+// Uploads/downloads NCHW host data to/from a TENSOR_MEM_IMAGE2D tensor's image.
+cl_int copy_fp16_host_mem_to_image(const dims4d &dims, const void *from, cl_mem to);
+cl_int copy_fp16_image_to_host_mem(const dims4d &dims, cl_mem from, void *to);
 void init_fp16_host_mem(std::size_t num_elem,
                         UT_RANDOM_TYPE rand_type,
                         void *f16ptr);
+// One float per line; slow for anything but small tensors, use
+// read_tensor_file_fp16() with .oclt or .npy files instead.
 void read_fp16_from_fp32_text(const std::string &filename,
                           std::size_t num_elem,
                           void *f16ptr);
 
 
-
+// START to END of a command on a profiling queue in ns, 0 (and an error
+// log) without profiling info. Tracer (tracer.h) records all timestamps of
+// every command instead.
 double get_cl_exec_time(cl_event event);
 
 }
@@ -0,0 +1,140 @@
+#include "attention.h"
+
+#include <math.h>
+
+#include "cl_kernel_source.h"
+#include "kernel_launcher.h"
+#include "log.h"
+#include "tuner.h"
+#include "utils.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "attention"
+
+namespace abc {
+
+static const int kBlockM = 32;
+static const int kBlockN = 32;
+static const int kSoftmaxWG = 64;
+// Every work-item of attention_fused keeps its query and output rows in
+// registers, head_dim / 2 float4s; past 64 they spill on mobile GPUs, so
+// larger heads take the unfused kernels.
+static const int kMaxFusedHeadDim = 64;
+
+static float attention_scale(const AttentionParams &p) {
+    return p.scale != 0.0f ? p.scale : 1.0f / sqrtf(static_cast<float>(p.head_dim));
+}
+
+static bool check_params(const AttentionParams &p) {
+    if (p.batch <= 0 || p.heads <= 0 || p.seq_len <= 0 || p.head_dim <= 0 || p.head_dim % 4 != 0 ||
+        p.head_dim > 256) {
+        LOGE("Invalid attention shape: batch %d heads %d seq_len %d head_dim %d", p.batch, p.heads, p.seq_len,
+             p.head_dim);
+        return false;
+    }
+    return true;
+}
+
+std::string attention_build_options(const AttentionParams &p) {
+    std::string opt;
+    opt += " -DHEAD_DIM=" + std::to_string(p.head_dim);
+    opt += " -DBLOCK_M=" + std::to_string(kBlockM);
+    opt += " -DBLOCK_N=" + std::to_string(kBlockN);
+    opt += " -DSOFTMAX_WG=" + std::to_string(kSoftmaxWG);
+    if (p.causal) {
+        opt += " -DCAUSAL";
+    }
+    return opt;
+}
+
+cl_int enqueue_attention_fp16(const AttentionParams &p, cl_mem Q, cl_mem K, cl_mem V, cl_mem O,
+                              cl_uint num_wait, const cl_event *wait_list, cl_event *event,
+                              cl_command_queue queue) {
+    if (!check_params(p)) {
+        return CL_INVALID_VALUE;
+    }
+    cl_int ret = CL_SUCCESS;
+    if (p.head_dim > kMaxFusedHeadDim) {
+        const std::size_t bytes = (std::size_t)p.batch * p.heads * p.seq_len * p.seq_len * sizeof(cl_half);
+        cl_mem scores = clrt().mem_pool().acquire(bytes, &ret);
+        if (CL_SUCCESS != ret) {
+            return ret;
+        }
+        ret = enqueue_attention_unfused_fp16(p, Q, K, V, scores, O, num_wait, wait_list, event, queue);
+        // the pool hands it out again once the queues are past the kernels
+        clrt().mem_pool().release(scores);
+        return ret;
+    }
+    std::string opt = attention_build_options(p);
+    cl_kernel kernel = clrt().create_kernel("attention_fused", get_cl_kernel_source("attention"), opt.c_str(), &ret);
+    if (CL_SUCCESS != ret) {
+        LOGE("create_kernel attention_fused failed.");
+        return ret;
+    }
+    KernelLauncher<int, float, cl_mem, cl_mem, cl_mem, cl_mem> launcher(kernel);
+    size_t local[] = {static_cast<size_t>(kBlockM), 1};
+    size_t work[] = {static_cast<size_t>(p.seq_len), static_cast<size_t>(p.batch * p.heads)};
+    ret = launcher.launch(2, work, local, num_wait, wait_list, event, queue, p.seq_len, attention_scale(p), Q, K, V,
+                          O);
+    clrt().release_kernel(kernel);
+    return ret;
+}
+
+cl_int enqueue_attention_unfused_fp16(const AttentionParams &p, cl_mem Q, cl_mem K, cl_mem V, cl_mem scores,
+                                      cl_mem O, cl_uint num_wait, const cl_event *wait_list, cl_event *event,
+                                      cl_command_queue queue) {
+    if (!check_params(p)) {
+        return CL_INVALID_VALUE;
+    }
+    const char *names[] = {"attention_scores", "softmax_rows", "attention_pv"};
+    cl_kernel kernels[3] = {NULL, NULL, NULL};
+    cl_int ret = CL_SUCCESS;
+    std::string opt = attention_build_options(p);
+    for (int i = 0; i < 3 && CL_SUCCESS == ret; ++i) {
+        kernels[i] = clrt().create_kernel(names[i], get_cl_kernel_source("attention"), opt.c_str(), &ret);
+        if (CL_SUCCESS != ret) {
+            LOGE("create_kernel %s failed.", names[i]);
+        }
+    }
+
+    const size_t S = p.seq_len;
+    const size_t BH = p.batch * p.heads;
+    cl_event events[2] = {NULL, NULL};
+    if (CL_SUCCESS == ret) {
+        KernelLauncher<int, int, float, cl_mem, cl_mem, cl_mem> launcher(kernels[0]);
+        size_t work[] = {(S + 3) / 4, (S + 3) / 4, BH};
+        size_t local[3];
+        LocalSizeTuner::heuristic_local_size(kernels[0], 3, work, local);
+        ret = launcher.launch(3, work, local, num_wait, wait_list, &events[0], queue, p.seq_len, (int)BH,
+                              attention_scale(p), Q, K, scores);
+    }
+    if (CL_SUCCESS == ret) {
+        KernelLauncher<int, cl_mem> launcher(kernels[1]);
+        size_t local[] = {static_cast<size_t>(kSoftmaxWG), 1};
+        size_t work[] = {static_cast<size_t>(kSoftmaxWG), BH * S};
+        ret = launcher.launch(2, work, local, 1, &events[0], &events[1], queue, p.seq_len, scores);
+    }
+    if (CL_SUCCESS == ret) {
+        KernelLauncher<int, int, cl_mem, cl_mem, cl_mem> launcher(kernels[2]);
+        size_t work[] = {static_cast<size_t>(p.head_dim / 4), (S + 3) / 4, BH};
+        size_t local[3];
+        LocalSizeTuner::heuristic_local_size(kernels[2], 3, work, local);
+        ret = launcher.launch(3, work, local, 1, &events[1], event, queue, p.seq_len, (int)BH, scores, V, O);
+    }
+
+    for (int i = 0; i < 2; ++i) {
+        if (events[i]) {
+            clReleaseEvent(events[i]);
+        }
+    }
+    for (int i = 0; i < 3; ++i) {
+        if (kernels[i]) {
+            clrt().release_kernel(kernels[i]);
+        }
+    }
+    return ret;
+}
+
+}  // namespace abc
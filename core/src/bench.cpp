@@ -0,0 +1,249 @@
+#include "bench.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
+#include "log.h"
+#include "utils.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "bench"
+
+namespace abc {
+
+std::string bench_shape_string(const BenchShape &shape) {
+    std::string s;
+    for (std::size_t i = 0; i < shape.size(); ++i) {
+        s += (i ? "x" : "") + std::to_string(shape[i]);
+    }
+    return s;
+}
+
+BenchStats compute_bench_stats(std::vector<double> samples) {
+    BenchStats stats = {0, 0, 0, 0};
+    if (samples.empty()) {
+        return stats;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto rank = [&](double q) {
+        std::size_t i = static_cast<std::size_t>(ceil(q * samples.size()));
+        return samples[std::min(std::max<std::size_t>(i, 1), samples.size()) - 1];
+    };
+    stats.min = samples.front();
+    stats.median = rank(0.5);
+    stats.p90 = rank(0.9);
+    stats.p99 = rank(0.99);
+    return stats;
+}
+
+// One iteration: device time summed over the run's events, wall time from
+// before the enqueue until they have all completed.
+static cl_int run_once(const BenchRun &run, double *device_ns, double *wall_ns) {
+    std::vector<cl_event> events;
+    auto t0 = std::chrono::steady_clock::now();
+    cl_int ret = run(&events);
+    if (CL_SUCCESS == ret && !events.empty()) {
+        ret = clWaitForEvents(events.size(), events.data());
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    *wall_ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+    *device_ns = 0;
+    for (cl_event event : events) {
+        if (CL_SUCCESS == ret) {
+            *device_ns += get_cl_exec_time(event);
+        }
+        clReleaseEvent(event);
+    }
+    return ret;
+}
+
+cl_int BenchRegistry::run(const BenchOptions &options, std::vector<BenchResult> *results) const {
+    cl_int status = CL_SUCCESS;
+    for (const Benchmark &bench : benches_) {
+        if (!options.filter.empty() && bench.name.find(options.filter) == std::string::npos) {
+            continue;
+        }
+        for (const BenchShape &shape : bench.shapes) {
+            std::string shape_str = bench_shape_string(shape);
+            BenchRun run = bench.setup(shape);
+            if (!run) {
+                LOGE("%s %s: setup failed, skipped.", bench.name.c_str(), shape_str.c_str());
+                status = CL_INVALID_VALUE;
+                continue;
+            }
+            std::vector<double> device_ns, wall_ns;
+            cl_int ret = CL_SUCCESS;
+            for (int r = 0; r < options.warmup + options.reps && CL_SUCCESS == ret; ++r) {
+                double d = 0, w = 0;
+                ret = run_once(run, &d, &w);
+                if (r >= options.warmup) {
+                    device_ns.push_back(d);
+                    wall_ns.push_back(w);
+                }
+            }
+            if (CL_SUCCESS != ret) {
+                LOGE("%s %s: run failed (%d), skipped.", bench.name.c_str(), shape_str.c_str(), ret);
+                status = ret;
+                continue;
+            }
+            BenchResult result;
+            result.name = bench.name;
+            result.shape = shape_str;
+            result.reps = options.reps;
+            result.device = compute_bench_stats(device_ns);
+            result.wall = compute_bench_stats(wall_ns);
+            result.flops = bench.flops ? bench.flops(shape) : 0;
+            result.bytes = bench.bytes ? bench.bytes(shape) : 0;
+            result.roofline_pct = roofline_percent(clrt().roofline(), bench.dtype, result.flops, result.bytes,
+                                                   result.device.median);
+            results->push_back(result);
+        }
+    }
+    return status;
+}
+
+static std::string json_escape(const std::string &s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out;
+}
+
+static void write_stats(std::ostream &os, const char *key, const BenchStats &s) {
+    os << "\"" << key << "\": {\"min\": " << s.min << ", \"median\": " << s.median << ", \"p90\": " << s.p90
+       << ", \"p99\": " << s.p99 << "}";
+}
+
+cl_int save_bench_json(const std::string &path, const std::vector<BenchResult> &results) {
+    std::ofstream file(path.c_str());
+    if (!file) {
+        LOGE("Failed to open %s for writing.", path.c_str());
+        return CL_INVALID_VALUE;
+    }
+    file.precision(10);
+    file << "{\n";
+    file << "  \"device\": \"" << json_escape(clrt().device_name()) << "\",\n";
+    file << "  \"results\": [\n";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const BenchResult &r = results[i];
+        file << "    {\"name\": \"" << json_escape(r.name) << "\", \"shape\": \"" << r.shape
+             << "\", \"reps\": " << r.reps << ", ";
+        write_stats(file, "device_ns", r.device);
+        file << ", ";
+        write_stats(file, "wall_ns", r.wall);
+        file << ", \"flops\": " << r.flops << ", \"bytes\": " << r.bytes << ", \"gflops\": " << r.gflops()
+             << ", \"gbps\": " << r.gbps() << ", \"roofline_pct\": " << r.roofline_pct << "}"
+             << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    file << "  ]\n}\n";
+    return file ? CL_SUCCESS : CL_INVALID_VALUE;
+}
+
+// Value of "key" in a line written by save_bench_json(), searched from
+// *pos on; *pos moves past it so repeated keys in nested objects are read
+// in order.
+static std::string json_value(const std::string &line, const std::string &key, std::size_t *pos) {
+    std::string pattern = "\"" + key + "\": ";
+    std::size_t at = line.find(pattern, *pos);
+    if (at == std::string::npos) {
+        return "";
+    }
+    at += pattern.size();
+    std::size_t end;
+    if (line[at] == '"') {
+        end = line.find('"', at + 1);
+        *pos = end;
+        return end == std::string::npos ? "" : line.substr(at + 1, end - at - 1);
+    }
+    end = line.find_first_of(",}", at);
+    *pos = end;
+    return line.substr(at, end - at);
+}
+
+static BenchStats read_stats(const std::string &line, const std::string &key, std::size_t *pos) {
+    BenchStats s = {0, 0, 0, 0};
+    std::size_t at = line.find("\"" + key + "\"", *pos);
+    if (at == std::string::npos) {
+        return s;
+    }
+    *pos = at;
+    s.min = atof(json_value(line, "min", pos).c_str());
+    s.median = atof(json_value(line, "median", pos).c_str());
+    s.p90 = atof(json_value(line, "p90", pos).c_str());
+    s.p99 = atof(json_value(line, "p99", pos).c_str());
+    return s;
+}
+
+cl_int load_bench_json(const std::string &path, std::vector<BenchResult> *results) {
+    std::ifstream file(path.c_str());
+    if (!file) {
+        LOGE("Failed to open %s.", path.c_str());
+        return CL_INVALID_VALUE;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.find("\"name\": ") == std::string::npos) {
+            continue;
+        }
+        std::size_t pos = 0;
+        BenchResult r;
+        r.name = json_value(line, "name", &pos);
+        r.shape = json_value(line, "shape", &pos);
+        r.reps = atoi(json_value(line, "reps", &pos).c_str());
+        r.device = read_stats(line, "device_ns", &pos);
+        r.wall = read_stats(line, "wall_ns", &pos);
+        r.flops = atof(json_value(line, "flops", &pos).c_str());
+        r.bytes = atof(json_value(line, "bytes", &pos).c_str());
+        r.roofline_pct = atof(json_value(line, "roofline_pct", &pos).c_str());
+        results->push_back(r);
+    }
+    return CL_SUCCESS;
+}
+
+int compare_bench_results(const std::vector<BenchResult> &baseline, const std::vector<BenchResult> &results,
+                          double threshold) {
+    int regressions = 0;
+    LOGI("%-24s %-20s %12s %12s %8s", "benchmark", "shape", "base(us)", "now(us)", "change");
+    for (const BenchResult &r : results) {
+        const BenchResult *base = NULL;
+        for (const BenchResult &b : baseline) {
+            if (b.name == r.name && b.shape == r.shape) {
+                base = &b;
+                break;
+            }
+        }
+        if (!base || base->device.median <= 0) {
+            LOGI("%-24s %-20s %12s %12.3f %8s", r.name.c_str(), r.shape.c_str(), "-", r.device.median / 1000.0,
+                 "new");
+            continue;
+        }
+        double change = r.device.median / base->device.median - 1.0;
+        bool regressed = change > threshold;
+        regressions += regressed ? 1 : 0;
+        LOGI("%-24s %-20s %12.3f %12.3f %+7.1f%%%s", r.name.c_str(), r.shape.c_str(),
+             base->device.median / 1000.0, r.device.median / 1000.0, change * 100.0, regressed ? " REGRESSION" : "");
+    }
+    return regressions;
+}
+
+void print_bench_results(const std::vector<BenchResult> &results) {
+    LOGI("%-24s %-20s %10s %10s %10s %10s %10s %9s %9s %7s", "benchmark", "shape", "min(us)", "med(us)",
+         "p90(us)", "p99(us)", "wall(us)", "GFLOPS", "GB/s", "%peak");
+    for (const BenchResult &r : results) {
+        LOGI("%-24s %-20s %10.3f %10.3f %10.3f %10.3f %10.3f %9.2f %9.2f %7.1f", r.name.c_str(), r.shape.c_str(),
+             r.device.min / 1000.0, r.device.median / 1000.0, r.device.p90 / 1000.0, r.device.p99 / 1000.0,
+             r.wall.median / 1000.0, r.gflops(), r.gbps(), r.roofline_pct);
+    }
+}
+
+}  // namespace abc
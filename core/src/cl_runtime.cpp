@@ -3,6 +3,7 @@
 #include <string>
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "log.h"
 
@@ -14,13 +15,27 @@
 namespace abc {
 
 CLRuntime::~CLRuntime() {
-    for (cl_kernel k : kernels_) {
-        clReleaseKernel(k);
+    if (!trace_path_.empty()) {
+        tracer_.write_chrome_trace(trace_path_);
     }
+    tracer_.stop();
+    tracer_.clear();
 
-    for (cl_program p : programs_) {
-        clReleaseProgram(p);
+    for (auto &it : kernels_in_use_) {
+        clReleaseKernel(it.first);
     }
+    kernels_in_use_.clear();
+
+    for (auto &it : programs_) {
+        release_program_entry(&it.second);
+    }
+    programs_.clear();
+    mem_pool_.trim(0);
+
+    for (Stream *stream : streams_) {
+        delete stream;
+    }
+    streams_.clear();
 
     if (queue_) {
         clReleaseCommandQueue(queue_);
@@ -40,34 +55,257 @@ CLRuntime::~CLRuntime() {
     }
 }
 
-cl_int CLRuntime::init() {
-    cl_int result = 0;
-    result = clGetPlatformIDs(1, &platform_, NULL);
-    CHECK_ERROR_NO_RETURN(result == CL_SUCCESS, "Failed to get platform id.");
+static std::string platform_info_string(cl_platform_id platform, cl_platform_info param) {
+    size_t size = 0;
+    if (clGetPlatformInfo(platform, param, 0, NULL, &size) != CL_SUCCESS || size == 0) {
+        return std::string();
+    }
+    std::vector<char> buf(size + 1, 0);
+    if (clGetPlatformInfo(platform, param, size, buf.data(), NULL) != CL_SUCCESS) {
+        return std::string();
+    }
+    return std::string(buf.data());
+}
 
-    uint32_t num_devices = 0;
-    result =
-        clGetDeviceIDs(platform_, CL_DEVICE_TYPE_GPU, 0, NULL, &num_devices);
-    CHECK_ERROR_NO_RETURN(result == CL_SUCCESS && num_devices == 1,
-                          "Failed to get num_devices.");
+std::vector<DeviceInfo> enumerate_devices() {
+    std::vector<DeviceInfo> devices;
+    cl_uint num_platforms = 0;
+    if (clGetPlatformIDs(0, NULL, &num_platforms) != CL_SUCCESS || num_platforms == 0) {
+        return devices;
+    }
+    std::vector<cl_platform_id> platforms(num_platforms);
+    if (clGetPlatformIDs(num_platforms, platforms.data(), NULL) != CL_SUCCESS) {
+        return devices;
+    }
+    for (cl_platform_id platform : platforms) {
+        cl_uint num_devices = 0;
+        if (clGetDeviceIDs(platform, CL_DEVICE_TYPE_ALL, 0, NULL, &num_devices) != CL_SUCCESS || num_devices == 0) {
+            continue;
+        }
+        std::vector<cl_device_id> ids(num_devices);
+        if (clGetDeviceIDs(platform, CL_DEVICE_TYPE_ALL, num_devices, ids.data(), NULL) != CL_SUCCESS) {
+            continue;
+        }
+        const std::string platform_name = platform_info_string(platform, CL_PLATFORM_NAME);
+        for (cl_device_id id : ids) {
+            DeviceInfo info;
+            info.platform = platform;
+            info.device = id;
+            info.type = 0;
+            info.compute_units = 0;
+            info.max_clock_mhz = 0;
+            clGetDeviceInfo(id, CL_DEVICE_TYPE, sizeof(info.type), &info.type, NULL);
+            clGetDeviceInfo(id, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(info.compute_units), &info.compute_units, NULL);
+            clGetDeviceInfo(id, CL_DEVICE_MAX_CLOCK_FREQUENCY, sizeof(info.max_clock_mhz), &info.max_clock_mhz, NULL);
+            size_t size = 0;
+            std::vector<char> name;
+            if (clGetDeviceInfo(id, CL_DEVICE_NAME, 0, NULL, &size) == CL_SUCCESS && size > 0) {
+                name.assign(size + 1, 0);
+                clGetDeviceInfo(id, CL_DEVICE_NAME, size, name.data(), NULL);
+            }
+            info.platform_name = platform_name;
+            info.device_name = name.empty() ? std::string() : std::string(name.data());
+            devices.push_back(info);
+        }
+    }
+    return devices;
+}
+
+cl_int CLRuntime::init() {
+    std::vector<DeviceInfo> devices = enumerate_devices();
+    CHECK_ERROR_NO_RETURN(!devices.empty(), "Failed to find an OpenCL device.");
+    if (devices.empty()) {
+        return CL_DEVICE_NOT_FOUND;
+    }
+    // OCLABC_DEVICE picks an index of enumerate_devices(), otherwise the
+    // first GPU and without one the first device of any type (e.g. a pocl
+    // CPU device).
+    std::size_t pick = devices.size();
+    const char *device_index = getenv("OCLABC_DEVICE");
+    if (device_index && device_index[0]) {
+        char *end = NULL;
+        long index = strtol(device_index, &end, 10);
+        pick = *end == '\0' && index >= 0 ? (std::size_t)index : devices.size();
+        if (pick >= devices.size()) {
+            LOGW("OCLABC_DEVICE=%s is not one of the %zu devices.", device_index, devices.size());
+            pick = devices.size();
+        }
+    }
+    for (std::size_t i = 0; i < devices.size() && pick == devices.size(); ++i) {
+        if (devices[i].type & CL_DEVICE_TYPE_GPU) {
+            pick = i;
+        }
+    }
+    if (pick == devices.size()) {
+        pick = 0;
+    }
+    return init_device(devices[pick].platform, devices[pick].device);
+}
 
-    result =
-        clGetDeviceIDs(platform_, CL_DEVICE_TYPE_GPU, 1, &device_id_, NULL);
-    CHECK_ERROR_NO_RETURN(device_id_ && result == CL_SUCCESS,
-                          "Failed to get device id.");
+cl_int CLRuntime::init_device(cl_platform_id platform, cl_device_id device) {
+    cl_int result = CL_SUCCESS;
+    platform_ = platform;
+    device_id_ = device;
+    clRetainDevice(device_id_);
 
     context_ = clCreateContext(0, 1, &device_id_, NULL, NULL, &result);
     CHECK_ERROR_NO_RETURN(result == CL_SUCCESS, "Failed to create context.");
+    mem_pool_.set_context(context_);
+    mem_pool_.set_fences([this](std::vector<cl_event> *fences) { return enqueue_markers(fences); });
+    const char *trace_path = getenv("OCLABC_TRACE");
+    if (primary_ && trace_path && trace_path[0]) {
+        trace_path_ = trace_path;
+    }
 
     profile_queue_ = clCreateCommandQueue(context_, device_id_,
                                           CL_QUEUE_PROFILING_ENABLE, &result);
     CHECK_ERROR_NO_RETURN(profile_queue_ && result == CL_SUCCESS,
                           "Failed to create command queue.");
 
-    queue_ = NULL;
+    // a traced run needs timestamps from the production queue too
+    cl_queue_properties properties[] = {
+        CL_QUEUE_PROPERTIES, trace_path_.empty() ? 0 : (cl_queue_properties)CL_QUEUE_PROFILING_ENABLE, 0};
+    queue_ = clCreateCommandQueueWithProperties(context_, device_id_, properties, &result);
+    CHECK_ERROR_NO_RETURN(queue_ && result == CL_SUCCESS,
+                          "Failed to create command queue.");
+    tracer_.name_queue(queue_, "queue");
+    tracer_.name_queue(profile_queue_, "profile queue");
+    if (!trace_path_.empty()) {
+        tracer_.start();
+    }
+
+    device_name_ = get_device_info_string(CL_DEVICE_NAME);
+    driver_version_ = get_device_info_string(CL_DRIVER_VERSION);
+    device_extensions_ = " " + get_device_info_string(CL_DEVICE_EXTENSIONS) + " ";
+    if (CL_SUCCESS != clGetDeviceInfo(device_id_, CL_DEVICE_SVM_CAPABILITIES, sizeof(svm_capabilities_),
+                                      &svm_capabilities_, NULL)) {
+        svm_capabilities_ = 0;
+    }
+    const char *cache_dir = getenv("OCLABC_PROGRAM_CACHE_DIR");
+    if (!program_cache_.enabled() && cache_dir && cache_dir[0]) {
+        program_cache_.set_dir(cache_dir);
+    }
+    // one file per process: runtimes of a DeviceGroup leave these to
+    // their tuner() and roofline settings
+    const char *tuning_db = getenv("OCLABC_TUNING_DB");
+    if (primary_ && tuning_db && tuning_db[0]) {
+        tuner_.set_db_path(tuning_db);
+    }
+    const char *roofline = getenv("OCLABC_ROOFLINE");
+    if (primary_ && roofline && roofline[0]) {
+        load_roofline(roofline);
+    }
     return result;
 }
 
+Stream *CLRuntime::create_stream(unsigned flags, cl_int *err_ret) {
+    if (!trace_path_.empty()) {
+        flags |= STREAM_PROFILING;
+    }
+    Stream *stream = new Stream(context_, device_id_, flags, err_ret);
+    if (*err_ret != CL_SUCCESS) {
+        delete stream;
+        return NULL;
+    }
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    streams_.push_back(stream);
+    tracer_.name_queue(stream->queue(), "stream " + std::to_string(streams_.size() - 1));
+    return stream;
+}
+
+void CLRuntime::destroy_stream(Stream *stream) {
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    for (auto it = streams_.begin(); it != streams_.end(); ++it) {
+        if (*it == stream) {
+            streams_.erase(it);
+            delete stream;
+            return;
+        }
+    }
+    LOGW("destroy_stream: stream %p is not owned by the runtime.", (void *)stream);
+}
+
+cl_int CLRuntime::finish() {
+    cl_int ret = CL_SUCCESS;
+    const cl_command_queue queues[] = {queue_, profile_queue_};
+    for (cl_command_queue queue : queues) {
+        cl_int err = queue ? clFinish(queue) : CL_SUCCESS;
+        if (CL_SUCCESS == ret) {
+            ret = err;
+        }
+    }
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    for (Stream *stream : streams_) {
+        cl_int err = stream->finish();
+        if (CL_SUCCESS == ret) {
+            ret = err;
+        }
+    }
+    if (CL_SUCCESS != ret) {
+        LOGE("finish failed: %d", ret);
+    }
+    return ret;
+}
+
+cl_int CLRuntime::enqueue_markers(std::vector<cl_event> *markers) {
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    std::vector<cl_command_queue> queues = {queue_, profile_queue_};
+    for (Stream *stream : streams_) {
+        queues.push_back(stream->queue());
+    }
+    for (cl_command_queue queue : queues) {
+        if (!queue) {
+            continue;
+        }
+        cl_event marker = NULL;
+        cl_int ret = clEnqueueMarkerWithWaitList(queue, 0, NULL, &marker);
+        if (CL_SUCCESS != ret) {
+            LOGE("clEnqueueMarkerWithWaitList failed: %d", ret);
+            return ret;
+        }
+        markers->push_back(marker);
+        // so that the marker completes without anyone waiting on the queue
+        clFlush(queue);
+    }
+    return CL_SUCCESS;
+}
+
+void CLRuntime::enqueue_svm_free(void *ptr) {
+    // the free goes to the profile queue behind markers of every queue
+    std::vector<cl_event> markers;
+    cl_int ret = enqueue_markers(&markers);
+    if (CL_SUCCESS == ret) {
+        ret = clEnqueueSVMFree(profile_queue_, 1, &ptr, NULL, NULL, (cl_uint)markers.size(), markers.data(), NULL);
+    }
+    if (CL_SUCCESS == ret) {
+        clFlush(profile_queue_);
+    }
+    for (cl_event marker : markers) {
+        clReleaseEvent(marker);
+    }
+    if (CL_SUCCESS != ret) {
+        LOGW("clEnqueueSVMFree failed (%d); freeing after the queues finish.", ret);
+        finish();
+        clSVMFree(context_, ptr);
+    }
+}
+
+bool CLRuntime::has_extension(const char *name) {
+    return device_extensions_.find(" " + std::string(name) + " ") != std::string::npos;
+}
+
+std::string CLRuntime::get_device_info_string(cl_device_info param) {
+    size_t size = 0;
+    if (clGetDeviceInfo(device_id_, param, 0, NULL, &size) != CL_SUCCESS || size == 0) {
+        return std::string();
+    }
+    std::vector<char> buf(size + 1, 0);
+    if (clGetDeviceInfo(device_id_, param, size, buf.data(), NULL) != CL_SUCCESS) {
+        return std::string();
+    }
+    return std::string(buf.data());
+}
+
 cl_program CLRuntime::build_program_from_source(const char **source, cl_uint source_len, const char *options, cl_int *err_ret)
 {
     cl_int err = 0;
@@ -87,8 +325,8 @@ cl_program CLRuntime::build_program_from_source(const char **source, cl_uint sou
         static const size_t LOG_SIZE = 2048;
         char log[LOG_SIZE];
         log[0] = 0;
-        err = clGetProgramBuildInfo(program, device_id_, CL_PROGRAM_BUILD_LOG, LOG_SIZE, log, nullptr);
-        if (err == CL_INVALID_VALUE)
+        cl_int log_err = clGetProgramBuildInfo(program, device_id_, CL_PROGRAM_BUILD_LOG, LOG_SIZE, log, nullptr);
+        if (log_err == CL_INVALID_VALUE)
         {
             LOGE("There was a build error, but there is insufficient space allocated to show the build logs.");
         }
@@ -96,20 +334,96 @@ cl_program CLRuntime::build_program_from_source(const char **source, cl_uint sou
         {
             LOGE("Build error:\n %s ", log);
         }
+        clReleaseProgram(program);
         *err_ret = err;
         return NULL;
     }
-    programs_.push_back(program);
     return program;
 }
 
-cl_kernel CLRuntime::create_kernel(const char *name, const char *source, const char *options, cl_int *err_ret) {
-    *err_ret = 0;
+cl_program CLRuntime::build_program_from_binary(const std::vector<unsigned char> &binary, const char *options, cl_int *err_ret)
+{
+    cl_int err = CL_SUCCESS;
+    cl_int binary_status = CL_SUCCESS;
+    size_t size = binary.size();
+    const unsigned char *data = binary.data();
+    *err_ret = CL_SUCCESS;
+    cl_program program = clCreateProgramWithBinary(context_, 1, &device_id_, &size, &data, &binary_status, &err);
+    if (err == CL_SUCCESS && binary_status != CL_SUCCESS) {
+        err = binary_status;
+    }
+    if (err != CL_SUCCESS) {
+        if (program) {
+            clReleaseProgram(program);
+        }
+        *err_ret = err;
+        return NULL;
+    }
+    err = clBuildProgram(program, 1, &device_id_, options, nullptr, nullptr);
+    if (err != CL_SUCCESS) {
+        clReleaseProgram(program);
+        *err_ret = err;
+        return NULL;
+    }
+    return program;
+}
+
+cl_int CLRuntime::get_program_binary(cl_program program, std::vector<unsigned char> *binary)
+{
+    size_t size = 0;
+    cl_int err = clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(size), &size, NULL);
+    if (err != CL_SUCCESS || size == 0) {
+        return err != CL_SUCCESS ? err : CL_INVALID_PROGRAM;
+    }
+    binary->resize(size);
+    unsigned char *data = binary->data();
+    return clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(data), &data, NULL);
+}
+
+cl_program CLRuntime::build_program(const std::string &source, const std::string &options, cl_int *err_ret)
+{
+    *err_ret = CL_SUCCESS;
+    std::string key;
+    if (program_cache_.enabled()) {
+        key = program_cache_.make_key(device_name_, driver_version_, source, options);
+        std::vector<unsigned char> binary;
+        if (program_cache_.load(key, &binary)) {
+            cl_int err = CL_SUCCESS;
+            cl_program program = build_program_from_binary(binary, options.c_str(), &err);
+            if (program) {
+                program_cache_.record_hit();
+                return program;
+            }
+            LOGW("Cached program binary rejected (error %d), rebuilding from source.", err);
+            program_cache_.record_stale();
+            program_cache_.remove(key);
+        }
+        program_cache_.record_miss();
+    }
+
+    const char *src_str = source.c_str();
+    cl_program program = build_program_from_source(&src_str, 1, options.c_str(), err_ret);
+    if (*err_ret != CL_SUCCESS) {
+        return NULL;
+    }
+    if (program_cache_.enabled()) {
+        std::vector<unsigned char> binary;
+        if (get_program_binary(program, &binary) == CL_SUCCESS) {
+            program_cache_.store(key, binary);
+        }
+    }
+    return program;
+}
+
+std::string CLRuntime::make_build_options(const char *options) {
     std::string opt = "-cl-std=CL2.0 -DUSE_HALF ";
     if (options) {
         opt += options;
     }
+    return opt;
+}
 
+std::string CLRuntime::make_program_source(const char *source) {
     std::string src = R"(
         #pragma OPENCL EXTENSION cl_khr_3d_image_writes : enable
         #pragma OPENCL EXTENSION cl_khr_fp16 : enable
@@ -129,24 +443,135 @@ cl_kernel CLRuntime::create_kernel(const char *name, const char *source, const c
     if (source) {
         src += source;
     }
-    const char *src_str = src.c_str();
-    cl_program program = build_program_from_source(&src_str, 1, opt.c_str(), err_ret);
-    if (*err_ret != CL_SUCCESS) {
-        LOGE("Failed to build_program_from_source .");
-        return NULL;
+    return src;
+}
+
+void CLRuntime::release_program_entry(ProgramEntry *entry) {
+    for (auto &it : entry->idle_kernels) {
+        for (cl_kernel k : it.second) {
+            clReleaseKernel(k);
+        }
     }
-    cl_kernel kernel = clCreateKernel(program, name, err_ret);
-    clReleaseProgram(program);
-    if (*err_ret != CL_SUCCESS) {
-        LOGE("Failed to create kernel .");
-        return NULL;
+    entry->idle_kernels.clear();
+    if (entry->program) {
+        clReleaseProgram(entry->program);
+        entry->program = NULL;
     }
-    kernels_.push_back(kernel);
+}
+
+cl_kernel CLRuntime::create_kernel(const char *name, const char *source, const char *options, cl_int *err_ret) {
+    *err_ret = 0;
+    std::string opt = make_build_options(options);
+    std::string src = make_program_source(source);
+    std::string key = opt + '\n' + src;
+
+    std::unique_lock<std::mutex> lock(registry_mutex_);
+    auto found = programs_.find(key);
+    while (found != programs_.end() && found->second.building) {
+        program_built_.wait(lock);
+        found = programs_.find(key);
+    }
+    if (found == programs_.end()) {
+        // claim the key, then build without holding up other programs
+        ProgramEntry entry;
+        entry.program = NULL;
+        entry.building = true;
+        entry.generation = next_generation_++;
+        programs_.insert(std::make_pair(key, entry));
+        lock.unlock();
+        cl_program program = build_program(src, opt, err_ret);
+        lock.lock();
+        found = programs_.find(key);
+        if (*err_ret != CL_SUCCESS) {
+            // waiters find the key free and try again themselves
+            programs_.erase(found);
+            program_built_.notify_all();
+            LOGE("Failed to build_program .");
+            return NULL;
+        }
+        found->second.program = program;
+        found->second.building = false;
+        program_built_.notify_all();
+    }
+
+    ProgramEntry &entry = found->second;
+    cl_kernel kernel = NULL;
+    std::vector<cl_kernel> &idle = entry.idle_kernels[name];
+    if (!idle.empty()) {
+        kernel = idle.back();
+        idle.pop_back();
+    } else {
+        kernel = clCreateKernel(entry.program, name, err_ret);
+        if (*err_ret != CL_SUCCESS) {
+            LOGE("Failed to create kernel .");
+            return NULL;
+        }
+    }
+    KernelSlot slot;
+    slot.program_key = key;
+    slot.name = name;
+    slot.generation = entry.generation;
+    kernels_in_use_[kernel] = slot;
     return kernel;
 }
 
+void CLRuntime::release_kernel(cl_kernel kernel) {
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    auto slot = kernels_in_use_.find(kernel);
+    if (slot == kernels_in_use_.end()) {
+        LOGW("release_kernel: kernel %p was not created by create_kernel.", (void *)kernel);
+        return;
+    }
+    auto entry = programs_.find(slot->second.program_key);
+    if (entry != programs_.end() && entry->second.generation == slot->second.generation) {
+        entry->second.idle_kernels[slot->second.name].push_back(kernel);
+    } else {
+        // the program was evicted while this kernel was handed out
+        clReleaseKernel(kernel);
+    }
+    kernels_in_use_.erase(slot);
+}
+
+void CLRuntime::evict_program(const char *source, const char *options) {
+    std::string key = make_build_options(options) + '\n' + make_program_source(source);
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    auto found = programs_.find(key);
+    // a program still building is left to its builder
+    if (found != programs_.end() && !found->second.building) {
+        release_program_entry(&found->second);
+        programs_.erase(found);
+    }
+}
+
+void CLRuntime::evict_all_programs() {
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    for (auto it = programs_.begin(); it != programs_.end();) {
+        if (it->second.building) {
+            ++it;
+            continue;
+        }
+        release_program_entry(&it->second);
+        it = programs_.erase(it);
+    }
+}
+
+std::size_t CLRuntime::num_programs() {
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    return programs_.size();
+}
+
+static thread_local CLRuntime *t_runtime = nullptr;
+
+ScopedRuntime::ScopedRuntime(CLRuntime &runtime) : previous_(t_runtime) {
+    t_runtime = &runtime;
+}
+
+ScopedRuntime::~ScopedRuntime() {
+    t_runtime = previous_;
+}
+
 CLRuntime &clrt() {
-    return CLRuntime::instance();
+    return t_runtime ? *t_runtime : CLRuntime::instance();
 }
 
 }  // namespace abc
\ No newline at end of file
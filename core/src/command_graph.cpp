@@ -0,0 +1,563 @@
+#include "command_graph.h"
+
+#include <string.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "cl_runtime.h"
+#include "log.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "command_graph"
+
+namespace abc {
+
+// cl_khr_command_buffer is newer than the bundled headers. The signatures
+// below are those of version 0.9.5, which added the properties argument to
+// the clCommand* functions; devices with older versions replay without it.
+typedef struct _cl_command_buffer_khr *command_buffer_khr;
+typedef cl_uint sync_point_khr;
+
+static const cl_device_info kDeviceExtensionsWithVersion = 0x1060;
+static const cl_device_info kDeviceCommandBufferCapabilities = 0x12A9;
+static const cl_device_info kDeviceCommandBufferRequiredQueueProperties = 0x12AA;
+static const cl_ulong kCommandBufferCapabilitySimultaneousUse = 1 << 2;
+static const cl_ulong kCommandBufferCapabilityOutOfOrder = 1 << 3;
+static const cl_ulong kCommandBufferFlags = 0x1293;
+static const cl_ulong kCommandBufferSimultaneousUse = 1 << 0;
+static const cl_uint kCommandBufferMinVersion = (0 << 22) | (9 << 12) | 5;
+static const std::size_t kMaxCommandBuffers = 8;
+
+struct NameVersion {
+    cl_uint version;
+    char name[64];
+};
+
+struct CommandBufferApi {
+    command_buffer_khr(CL_API_CALL *create)(cl_uint, const cl_command_queue *, const cl_ulong *, cl_int *);
+    cl_int(CL_API_CALL *finalize)(command_buffer_khr);
+    cl_int(CL_API_CALL *release)(command_buffer_khr);
+    cl_int(CL_API_CALL *enqueue)(cl_uint, cl_command_queue *, command_buffer_khr, cl_uint, const cl_event *,
+                                 cl_event *);
+    cl_int(CL_API_CALL *ndrange)(command_buffer_khr, cl_command_queue, const cl_ulong *, cl_kernel, cl_uint,
+                                 const size_t *, const size_t *, const size_t *, cl_uint, const sync_point_khr *,
+                                 sync_point_khr *, void **);
+    cl_int(CL_API_CALL *fill)(command_buffer_khr, cl_command_queue, const cl_ulong *, cl_mem, const void *, size_t,
+                              size_t, size_t, cl_uint, const sync_point_khr *, sync_point_khr *, void **);
+};
+
+static bool command_buffer_extension_usable(cl_device_id device) {
+    size_t bytes = 0;
+    if (CL_SUCCESS != clGetDeviceInfo(device, kDeviceExtensionsWithVersion, 0, NULL, &bytes) || bytes == 0) {
+        return false;
+    }
+    std::vector<NameVersion> extensions(bytes / sizeof(NameVersion));
+    if (CL_SUCCESS != clGetDeviceInfo(device, kDeviceExtensionsWithVersion, bytes, extensions.data(), NULL)) {
+        return false;
+    }
+    for (const NameVersion &ext : extensions) {
+        if (strncmp(ext.name, "cl_khr_command_buffer", sizeof(ext.name)) == 0) {
+            return ext.version >= kCommandBufferMinVersion;
+        }
+    }
+    return false;
+}
+
+// NULL unless clrt()'s device has a usable cl_khr_command_buffer. Entry
+// points are per platform, so they are resolved once per device.
+static const CommandBufferApi *command_buffer_api() {
+    static std::mutex mutex;
+    static std::map<cl_device_id, CommandBufferApi> apis;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = apis.find(clrt().device_id());
+    if (found == apis.end()) {
+        CommandBufferApi api;
+        memset(&api, 0, sizeof(api));
+        if (command_buffer_extension_usable(clrt().device_id())) {
+            cl_platform_id platform = clrt().platform();
+#define RESOLVE(field, name) \
+    api.field = (decltype(api.field))clGetExtensionFunctionAddressForPlatform(platform, name)
+            RESOLVE(create, "clCreateCommandBufferKHR");
+            RESOLVE(finalize, "clFinalizeCommandBufferKHR");
+            RESOLVE(release, "clReleaseCommandBufferKHR");
+            RESOLVE(enqueue, "clEnqueueCommandBufferKHR");
+            RESOLVE(ndrange, "clCommandNDRangeKernelKHR");
+            RESOLVE(fill, "clCommandFillBufferKHR");
+#undef RESOLVE
+        }
+        found = apis.insert(std::make_pair(clrt().device_id(), api)).first;
+    }
+    const CommandBufferApi &api = found->second;
+    // entries never move once inserted into the map
+    return api.create && api.finalize && api.release && api.enqueue && api.ndrange && api.fill ? &api : NULL;
+}
+
+static thread_local CommandGraph *t_graph = nullptr;
+static thread_local cl_command_queue t_graph_queue = NULL;
+
+CommandGraph *capturing_graph(cl_command_queue queue) {
+    return t_graph && queue == t_graph_queue ? t_graph : nullptr;
+}
+
+bool graph_capture_active() {
+    return t_graph != nullptr;
+}
+
+void record_graph_kernel_arg(cl_kernel kernel, cl_uint index, size_t size, const void *value, GraphArgKind kind) {
+    if (t_graph) {
+        t_graph->record_kernel_arg(kernel, index, size, value, kind);
+    }
+}
+
+CommandGraph::CommandGraph()
+    : state_(GRAPH_EMPTY),
+      capture_error_(CL_SUCCESS),
+      queue_(NULL),
+      context_(NULL),
+      out_of_order_(false),
+      use_command_buffer_(false),
+      simultaneous_use_(false),
+      last_replay_(NULL) {}
+
+CommandGraph::~CommandGraph() {
+    if (t_graph == this) {
+        t_graph = nullptr;
+        t_graph_queue = NULL;
+    }
+    for (auto &it : event_commands_) {
+        clReleaseEvent(it.first);
+    }
+    if (last_replay_) {
+        clWaitForEvents(1, &last_replay_);
+        clReleaseEvent(last_replay_);
+    }
+    release_command_buffers();
+    for (Command &c : commands_) {
+        if (c.kernel) {
+            clReleaseKernel(c.kernel);
+        }
+    }
+}
+
+cl_int CommandGraph::begin_capture(cl_command_queue queue) {
+    if (state_ != GRAPH_EMPTY) {
+        LOGE("A graph is captured only once.");
+        return CL_INVALID_OPERATION;
+    }
+    if (t_graph) {
+        LOGE("This thread is already capturing a graph.");
+        return CL_INVALID_OPERATION;
+    }
+    queue_ = queue ? queue : clrt().profile_queue();
+    cl_command_queue_properties props = 0;
+    cl_int ret = clGetCommandQueueInfo(queue_, CL_QUEUE_PROPERTIES, sizeof(props), &props, NULL);
+    ret |= clGetCommandQueueInfo(queue_, CL_QUEUE_CONTEXT, sizeof(context_), &context_, NULL);
+    if (CL_SUCCESS != ret) {
+        LOGE("Failed to query the capture queue.");
+        return CL_INVALID_COMMAND_QUEUE;
+    }
+    out_of_order_ = (props & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) != 0;
+    state_ = GRAPH_CAPTURING;
+    t_graph = this;
+    t_graph_queue = queue_;
+    return CL_SUCCESS;
+}
+
+cl_int CommandGraph::end_capture() {
+    if (state_ != GRAPH_CAPTURING || t_graph != this) {
+        LOGE("end_capture without begin_capture on this thread.");
+        return CL_INVALID_OPERATION;
+    }
+    t_graph = nullptr;
+    t_graph_queue = NULL;
+    for (auto &it : event_commands_) {
+        clReleaseEvent(it.first);
+    }
+    event_commands_.clear();
+    args_.clear();
+    if (CL_SUCCESS != capture_error_) {
+        state_ = GRAPH_FAILED;
+        return capture_error_;
+    }
+    state_ = GRAPH_READY;
+    use_command_buffer_ = command_buffer_supported();
+    return CL_SUCCESS;
+}
+
+void CommandGraph::record_kernel_arg(cl_kernel kernel, cl_uint index, size_t size, const void *value,
+                                     GraphArgKind kind) {
+    std::vector<ArgValue> &args = args_[kernel];
+    if (args.size() <= index) {
+        args.resize(index + 1);
+    }
+    ArgValue &arg = args[index];
+    arg.set = true;
+    arg.kind = kind;
+    arg.bytes.assign((const unsigned char *)value, (const unsigned char *)value + size);
+}
+
+cl_int CommandGraph::add_command(Command *command, cl_uint num_wait, const cl_event *wait_list, cl_event *event) {
+    for (cl_uint i = 0; i < num_wait; ++i) {
+        auto found = event_commands_.find(wait_list[i]);
+        if (found != event_commands_.end()) {
+            command->deps.push_back(found->second);
+        } else {
+            LOGW("Ignoring a wait on an event from outside the capture.");
+        }
+    }
+    commands_.push_back(std::move(*command));
+    if (!event) {
+        return CL_SUCCESS;
+    }
+    // complete at once; only its identity matters, so keep it alive until
+    // end_capture
+    cl_int ret = CL_SUCCESS;
+    *event = clCreateUserEvent(context_, &ret);
+    if (CL_SUCCESS == ret) {
+        ret = clSetUserEventStatus(*event, CL_COMPLETE);
+    }
+    if (CL_SUCCESS != ret) {
+        LOGE("Failed to create a capture event: %d", ret);
+        if (*event) {
+            clReleaseEvent(*event);
+            *event = NULL;
+        }
+        capture_error_ = CL_SUCCESS == capture_error_ ? ret : capture_error_;
+        return ret;
+    }
+    clRetainEvent(*event);
+    event_commands_[*event] = (int)commands_.size() - 1;
+    return CL_SUCCESS;
+}
+
+cl_int CommandGraph::record_kernel(cl_kernel kernel, cl_uint work_dim, const size_t *global, const size_t *local,
+                                   cl_uint num_wait, const cl_event *wait_list, cl_event *event) {
+    cl_uint num_args = 0;
+    size_t name_bytes = 0;
+    cl_program program = NULL;
+    cl_int ret = clGetKernelInfo(kernel, CL_KERNEL_NUM_ARGS, sizeof(num_args), &num_args, NULL);
+    ret |= clGetKernelInfo(kernel, CL_KERNEL_PROGRAM, sizeof(program), &program, NULL);
+    ret |= clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, 0, NULL, &name_bytes);
+    std::string name(name_bytes, '\0');
+    if (CL_SUCCESS == ret) {
+        ret = clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, name_bytes, &name[0], NULL);
+    }
+    if (CL_SUCCESS != ret || work_dim < 1 || work_dim > 3) {
+        LOGE("Cannot capture the kernel launch.");
+        capture_error_ = CL_SUCCESS == capture_error_ ? CL_INVALID_KERNEL : capture_error_;
+        return CL_INVALID_KERNEL;
+    }
+    name.resize(strlen(name.c_str()));
+    auto found = args_.find(kernel);
+    for (cl_uint a = 0; a < num_args; ++a) {
+        if (found == args_.end() || a >= found->second.size() || !found->second[a].set) {
+            LOGE("Argument %u of %s was not set through set_kernel_args while capturing.", a, name.c_str());
+            capture_error_ = CL_SUCCESS == capture_error_ ? CL_INVALID_KERNEL_ARGS : capture_error_;
+            return CL_INVALID_KERNEL_ARGS;
+        }
+    }
+
+    // a kernel of our own, so later launches cannot change its arguments
+    cl_kernel copy = clCreateKernel(program, name.c_str(), &ret);
+    for (cl_uint a = 0; a < num_args && CL_SUCCESS == ret; ++a) {
+        const ArgValue &arg = found->second[a];
+        if (arg.kind == GRAPH_ARG_SVM) {
+            const void *ptr = NULL;
+            memcpy(&ptr, arg.bytes.data(), sizeof(ptr));
+            ret = clSetKernelArgSVMPointer(copy, a, ptr);
+        } else {
+            ret = clSetKernelArg(copy, a, arg.bytes.size(), arg.bytes.data());
+            if (arg.kind == GRAPH_ARG_MEM) {
+                cl_mem mem = NULL;
+                memcpy(&mem, arg.bytes.data(), sizeof(mem));
+                MemSlot slot = {(int)commands_.size(), a, mem, mem};
+                mem_slots_.push_back(slot);
+            }
+        }
+    }
+    if (CL_SUCCESS != ret) {
+        LOGE("Failed to copy %s for the graph: %d", name.c_str(), ret);
+        if (copy) {
+            clReleaseKernel(copy);
+        }
+        capture_error_ = CL_SUCCESS == capture_error_ ? ret : capture_error_;
+        return ret;
+    }
+
+    Command c;
+    c.type = GRAPH_KERNEL;
+    c.kernel = copy;
+    c.work_dim = work_dim;
+    c.has_local = local != NULL;
+    for (cl_uint d = 0; d < 3; ++d) {
+        c.global[d] = d < work_dim ? global[d] : 1;
+        c.local[d] = d < work_dim && local ? local[d] : 1;
+    }
+    c.mem = NULL;
+    c.host = NULL;
+    c.offset = 0;
+    c.bytes = 0;
+    return add_command(&c, num_wait, wait_list, event);
+}
+
+cl_int CommandGraph::record_fill(cl_mem mem, const void *pattern, size_t pattern_size, size_t offset, size_t bytes,
+                                 cl_uint num_wait, const cl_event *wait_list, cl_event *event) {
+    Command c;
+    c.type = GRAPH_FILL;
+    c.kernel = NULL;
+    c.work_dim = 0;
+    c.has_local = false;
+    c.mem = mem;
+    c.host = NULL;
+    c.pattern.assign((const unsigned char *)pattern, (const unsigned char *)pattern + pattern_size);
+    c.offset = offset;
+    c.bytes = bytes;
+    return add_command(&c, num_wait, wait_list, event);
+}
+
+cl_int CommandGraph::record_host_copy(bool write, cl_mem mem, void *host, size_t offset, size_t bytes,
+                                      cl_uint num_wait, const cl_event *wait_list, cl_event *event) {
+    Command c;
+    c.type = write ? GRAPH_WRITE : GRAPH_READ;
+    c.kernel = NULL;
+    c.work_dim = 0;
+    c.has_local = false;
+    c.mem = mem;
+    c.host = host;
+    c.offset = offset;
+    c.bytes = bytes;
+    return add_command(&c, num_wait, wait_list, event);
+}
+
+cl_mem CommandGraph::resolve(cl_mem captured, const std::vector<GraphBinding> &bindings) const {
+    for (const GraphBinding &b : bindings) {
+        if (b.captured == captured) {
+            return b.replacement;
+        }
+    }
+    return captured;
+}
+
+cl_int CommandGraph::apply_bindings(const std::vector<GraphBinding> &bindings) {
+    for (MemSlot &slot : mem_slots_) {
+        cl_mem target = resolve(slot.captured, bindings);
+        if (target == slot.current) {
+            continue;
+        }
+        cl_int ret = clSetKernelArg(commands_[slot.command].kernel, slot.index, sizeof(cl_mem), &target);
+        if (CL_SUCCESS != ret) {
+            LOGE("Failed to rebind argument %u of graph command %d: %d", slot.index, slot.command, ret);
+            return ret;
+        }
+        slot.current = target;
+    }
+    return CL_SUCCESS;
+}
+
+cl_int CommandGraph::replay(cl_uint num_wait, const cl_event *wait_list, cl_event *event) {
+    return replay(std::vector<GraphBinding>(), num_wait, wait_list, event);
+}
+
+cl_int CommandGraph::replay(const std::vector<GraphBinding> &bindings, cl_uint num_wait, const cl_event *wait_list,
+                            cl_event *event) {
+    if (state_ != GRAPH_READY) {
+        LOGE("Only a successfully captured graph can be replayed.");
+        return CL_INVALID_OPERATION;
+    }
+    TraceRange range("graph replay");
+    for (const GraphBinding &b : bindings) {
+        bool found = false;
+        for (GraphBinding &bound : bindings_) {
+            if (bound.captured == b.captured) {
+                bound.replacement = b.replacement;
+                found = true;
+            }
+        }
+        if (!found) {
+            bindings_.push_back(b);
+        }
+    }
+    cl_int ret = apply_bindings(bindings_);
+    if (CL_SUCCESS != ret) {
+        return ret;
+    }
+    return use_command_buffer_ ? replay_command_buffer(num_wait, wait_list, event)
+                               : replay_enqueue(num_wait, wait_list, event);
+}
+
+cl_int CommandGraph::replay_enqueue(cl_uint num_wait, const cl_event *wait_list, cl_event *event) {
+    const int n = (int)commands_.size();
+    if (n == 0) {
+        return event ? clEnqueueMarkerWithWaitList(queue_, num_wait, wait_list, event) : CL_SUCCESS;
+    }
+    // an in-order queue keeps the recorded order without any events
+    std::vector<cl_event> events(out_of_order_ ? n : 0, NULL);
+    std::vector<cl_event> waits;
+    cl_int ret = CL_SUCCESS;
+    for (int i = 0; i < n && CL_SUCCESS == ret; ++i) {
+        const Command &c = commands_[i];
+        waits.clear();
+        if (out_of_order_) {
+            for (int d : c.deps) {
+                waits.push_back(events[d]);
+            }
+        }
+        if (c.deps.empty() && (out_of_order_ || i == 0)) {
+            waits.insert(waits.end(), wait_list, wait_list + num_wait);
+        }
+        const cl_uint nw = (cl_uint)waits.size();
+        const cl_event *wl = waits.empty() ? NULL : waits.data();
+        TraceSpan span(queue_, out_of_order_ ? &events[i] : (i == n - 1 ? event : NULL));
+        cl_event *out = span.event();
+        switch (c.type) {
+            case GRAPH_KERNEL:
+                ret = clEnqueueNDRangeKernel(queue_, c.kernel, c.work_dim, NULL, c.global, c.has_local ? c.local : NULL,
+                                             nw, wl, out);
+                span.kernel(ret, c.kernel, c.work_dim, c.global, c.has_local ? c.local : NULL);
+                break;
+            case GRAPH_FILL:
+                ret = clEnqueueFillBuffer(queue_, resolve(c.mem, bindings_), c.pattern.data(), c.pattern.size(),
+                                          c.offset, c.bytes, nw, wl, out);
+                span.transfer(ret, "fill", c.bytes);
+                break;
+            case GRAPH_WRITE:
+                ret = clEnqueueWriteBuffer(queue_, resolve(c.mem, bindings_), CL_FALSE, c.offset, c.bytes, c.host, nw,
+                                           wl, out);
+                span.transfer(ret, "write", c.bytes);
+                break;
+            case GRAPH_READ:
+                ret = clEnqueueReadBuffer(queue_, resolve(c.mem, bindings_), CL_FALSE, c.offset, c.bytes, c.host, nw,
+                                          wl, out);
+                span.transfer(ret, "read", c.bytes);
+                break;
+        }
+        if (CL_SUCCESS != ret) {
+            LOGE("Replaying graph command %d failed: %d", i, ret);
+        }
+    }
+    if (CL_SUCCESS == ret && out_of_order_ && event) {
+        ret = clEnqueueMarkerWithWaitList(queue_, (cl_uint)n, events.data(), event);
+    }
+    for (cl_event e : events) {
+        if (e) {
+            clReleaseEvent(e);
+        }
+    }
+    if (CL_SUCCESS == ret) {
+        ret = clFlush(queue_);
+    }
+    return ret;
+}
+
+cl_int CommandGraph::replay_command_buffer(cl_uint num_wait, const cl_event *wait_list, cl_event *event) {
+    const CommandBufferApi *api = command_buffer_api();
+    std::vector<cl_mem> key;
+    for (const MemSlot &slot : mem_slots_) {
+        key.push_back(slot.current);
+    }
+    for (const Command &c : commands_) {
+        if (c.type == GRAPH_FILL) {
+            key.push_back(resolve(c.mem, bindings_));
+        }
+    }
+
+    cl_int ret = CL_SUCCESS;
+    auto found = command_buffers_.find(key);
+    if (found == command_buffers_.end()) {
+        if (command_buffers_.size() >= kMaxCommandBuffers) {
+            release_command_buffers();
+        }
+        // the kernels already hold this binding's arguments
+        const cl_ulong props[] = {kCommandBufferFlags, simultaneous_use_ ? kCommandBufferSimultaneousUse : 0, 0};
+        command_buffer_khr cb = api->create(1, &queue_, props, &ret);
+        std::vector<sync_point_khr> points(commands_.size(), 0);
+        std::vector<sync_point_khr> waits;
+        for (std::size_t i = 0; i < commands_.size() && CL_SUCCESS == ret; ++i) {
+            const Command &c = commands_[i];
+            waits.clear();
+            for (int d : c.deps) {
+                waits.push_back(points[d]);
+            }
+            const sync_point_khr *wl = waits.empty() ? NULL : waits.data();
+            if (c.type == GRAPH_KERNEL) {
+                ret = api->ndrange(cb, NULL, NULL, c.kernel, c.work_dim, NULL, c.global, c.has_local ? c.local : NULL,
+                                   (cl_uint)waits.size(), wl, &points[i], NULL);
+            } else {
+                ret = api->fill(cb, NULL, NULL, resolve(c.mem, bindings_), c.pattern.data(), c.pattern.size(),
+                                c.offset, c.bytes, (cl_uint)waits.size(), wl, &points[i], NULL);
+            }
+        }
+        if (CL_SUCCESS == ret) {
+            ret = api->finalize(cb);
+        }
+        if (CL_SUCCESS != ret) {
+            LOGE("Recording the command buffer failed: %d", ret);
+            if (cb) {
+                api->release(cb);
+            }
+            return ret;
+        }
+        found = command_buffers_.insert(std::make_pair(key, (void *)cb)).first;
+    }
+
+    if (last_replay_) {
+        // without simultaneous use a pending command buffer cannot be
+        // enqueued again
+        if (!simultaneous_use_) {
+            clWaitForEvents(1, &last_replay_);
+        }
+        clReleaseEvent(last_replay_);
+        last_replay_ = NULL;
+    }
+    TraceSpan span(queue_, &last_replay_);
+    ret = api->enqueue(1, &queue_, (command_buffer_khr)found->second, num_wait, wait_list, &last_replay_);
+    span.transfer(ret, "command buffer", 0);
+    if (CL_SUCCESS != ret) {
+        LOGE("clEnqueueCommandBufferKHR failed: %d", ret);
+        last_replay_ = NULL;
+        return ret;
+    }
+    if (event) {
+        clRetainEvent(last_replay_);
+        *event = last_replay_;
+    }
+    return CL_SUCCESS;
+}
+
+bool CommandGraph::command_buffer_supported() {
+    if (!command_buffer_api()) {
+        return false;
+    }
+    for (const Command &c : commands_) {
+        if (c.type == GRAPH_WRITE || c.type == GRAPH_READ) {
+            return false;
+        }
+    }
+    cl_device_id device = NULL;
+    cl_command_queue_properties props = 0, required = 0;
+    cl_ulong caps = 0;
+    cl_int ret = clGetCommandQueueInfo(queue_, CL_QUEUE_DEVICE, sizeof(device), &device, NULL);
+    ret |= clGetCommandQueueInfo(queue_, CL_QUEUE_PROPERTIES, sizeof(props), &props, NULL);
+    ret |= clGetDeviceInfo(device, kDeviceCommandBufferRequiredQueueProperties, sizeof(required), &required, NULL);
+    ret |= clGetDeviceInfo(device, kDeviceCommandBufferCapabilities, sizeof(caps), &caps, NULL);
+    if (CL_SUCCESS != ret || device != clrt().device_id() || (props & required) != required ||
+        (out_of_order_ && !(caps & kCommandBufferCapabilityOutOfOrder))) {
+        return false;
+    }
+    simultaneous_use_ = (caps & kCommandBufferCapabilitySimultaneousUse) != 0;
+    return true;
+}
+
+void CommandGraph::release_command_buffers() {
+    const CommandBufferApi *api = command_buffer_api();
+    for (auto &it : command_buffers_) {
+        api->release((command_buffer_khr)it.second);
+    }
+    command_buffers_.clear();
+}
+
+}  // namespace abc
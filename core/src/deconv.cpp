@@ -0,0 +1,246 @@
+#include "deconv.h"
+
+#include "cl_kernel_source.h"
+#include "kernel_launcher.h"
+#include "log.h"
+#include "utils.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "deconv"
+
+namespace abc {
+
+DeconvParams make_deconv_params(int kernel, int stride, int pad, int dilation, int output_padding) {
+    DeconvParams p = {kernel, kernel, stride, stride, pad, pad, dilation, dilation, output_padding, output_padding};
+    return p;
+}
+
+dims4d deconv_output_dims(const DeconvParams &p, const dims4d &input, int oc) {
+    dims4d out;
+    out.n = input.n;
+    out.c = oc;
+    out.h = (input.h - 1) * p.stride_h - 2 * p.pad_h + p.dilation_h * (p.kernel_h - 1) + p.output_padding_h + 1;
+    out.w = (input.w - 1) * p.stride_w - 2 * p.pad_w + p.dilation_w * (p.kernel_w - 1) + p.output_padding_w + 1;
+    return out;
+}
+
+bool deconv_is_non_overlapping(const DeconvParams &p) {
+    return p.stride_h >= p.dilation_h * (p.kernel_h - 1) + 1 && p.stride_w >= p.dilation_w * (p.kernel_w - 1) + 1;
+}
+
+std::string deconv_build_options(const DeconvParams &p) {
+    std::string opt;
+    opt += " -DKERNEL_H=" + std::to_string(p.kernel_h);
+    opt += " -DKERNEL_W=" + std::to_string(p.kernel_w);
+    opt += " -DSTRIDE_H=" + std::to_string(p.stride_h);
+    opt += " -DSTRIDE_W=" + std::to_string(p.stride_w);
+    opt += " -DPAD_H=" + std::to_string(p.pad_h);
+    opt += " -DPAD_W=" + std::to_string(p.pad_w);
+    opt += " -DDILATION_H=" + std::to_string(p.dilation_h);
+    opt += " -DDILATION_W=" + std::to_string(p.dilation_w);
+    return opt;
+}
+
+static bool check_params(const DeconvParams &p, const dims4d &input, const dims4d &output) {
+    if (p.kernel_h <= 0 || p.kernel_w <= 0 || p.stride_h <= 0 || p.stride_w <= 0 || p.dilation_h <= 0 ||
+        p.dilation_w <= 0 || p.pad_h < 0 || p.pad_w < 0) {
+        LOGE("Invalid deconv kernel %dx%d stride %dx%d pad %dx%d dilation %dx%d", p.kernel_h, p.kernel_w,
+             p.stride_h, p.stride_w, p.pad_h, p.pad_w, p.dilation_h, p.dilation_w);
+        return false;
+    }
+    // same rule as ConvTranspose2d: output_padding only picks among the
+    // output sizes a strided/dilated convolution would map back to
+    int limit_h = p.stride_h > p.dilation_h ? p.stride_h : p.dilation_h;
+    int limit_w = p.stride_w > p.dilation_w ? p.stride_w : p.dilation_w;
+    if (p.output_padding_h < 0 || p.output_padding_w < 0 || p.output_padding_h >= limit_h ||
+        p.output_padding_w >= limit_w) {
+        LOGE("Invalid deconv output_padding %dx%d", p.output_padding_h, p.output_padding_w);
+        return false;
+    }
+    if (input.n <= 0 || input.c <= 0 || input.h <= 0 || input.w <= 0 || output.c <= 0 || output.h <= 0 ||
+        output.w <= 0) {
+        LOGE("Invalid deconv shape: input %dx%dx%dx%d, output %dx%dx%dx%d", input.n, input.c, input.h, input.w,
+             output.n, output.c, output.h, output.w);
+        return false;
+    }
+    return true;
+}
+
+// Outputs the direct kernel never writes: gaps between taps when the stride
+// exceeds the kernel, and the bottom/right rows output_padding adds.
+static bool direct_leaves_gaps(const DeconvParams &p, const dims4d &input, const dims4d &output) {
+    bool dense_h = p.kernel_h == p.stride_h && (p.dilation_h == 1 || p.kernel_h == 1);
+    bool dense_w = p.kernel_w == p.stride_w && (p.dilation_w == 1 || p.kernel_w == 1);
+    return !dense_h || !dense_w || output.h > input.h * p.stride_h - p.pad_h ||
+           output.w > input.w * p.stride_w - p.pad_w;
+}
+
+static std::string shape_string(const DeconvParams &p, const dims4d &input, const dims4d &output) {
+    return "n" + std::to_string(input.n) + "_ic" + std::to_string(input.c) + "_ih" + std::to_string(input.h) +
+           "_iw" + std::to_string(input.w) + "_oc" + std::to_string(output.c) + "_k" + std::to_string(p.kernel_h) +
+           "x" + std::to_string(p.kernel_w) + "_s" + std::to_string(p.stride_h) + "x" + std::to_string(p.stride_w) +
+           "_p" + std::to_string(p.pad_h) + "x" + std::to_string(p.pad_w) + "_d" + std::to_string(p.dilation_h) +
+           "x" + std::to_string(p.dilation_w);
+}
+
+// leading arguments of deconv_nchw_direct and deconv_nchw_gather:
+// N, IC, IH, IW, OC, OH, OW, input, weight, output
+typedef KernelLauncher<int, int, int, int, int, int, int, cl_mem, cl_mem, cl_mem> DeconvLauncher;
+
+struct DeconvLaunch {
+    const char *name;
+    std::string shape;
+    size_t work[3];
+};
+
+// The direct kernel leaves gaps to a zero fill, which would skip the
+// epilogue there, so shapes with gaps and an epilogue use the gather kernel.
+static bool use_direct(const DeconvParams &p, const dims4d &input, const dims4d &output, const Epilogue &epilogue) {
+    return deconv_is_non_overlapping(p) && (epilogue.empty() || !direct_leaves_gaps(p, input, output));
+}
+
+static DeconvLaunch make_launch(const DeconvParams &p, const dims4d &input, const dims4d &output,
+                                const Epilogue &epilogue) {
+    DeconvLaunch launch;
+    if (use_direct(p, input, output, epilogue)) {
+        launch.name = "deconv_nchw_direct";
+        launch.work[0] = (input.w + 3) / 4;
+        launch.work[1] = (output.c * p.kernel_h * p.kernel_w + 3) / 4;
+        launch.work[2] = (size_t)input.n * input.h;
+    } else {
+        launch.name = "deconv_nchw_gather";
+        launch.work[0] = (size_t)p.stride_w * (((output.w + p.stride_w - 1) / p.stride_w + 3) / 4);
+        launch.work[1] = (output.c + 3) / 4;
+        launch.work[2] = (size_t)output.n * output.h;
+    }
+    launch.shape = shape_string(p, input, output);
+    return launch;
+}
+
+static cl_kernel create_deconv_kernel(const DeconvParams &p, const DeconvLaunch &launch, const dims4d &input,
+                                      const dims4d &output, cl_mem in, cl_mem weight, cl_mem out,
+                                      const Epilogue &epilogue, cl_int *err_ret) {
+    std::string opt = deconv_build_options(p) + epilogue_build_options(epilogue);
+    cl_kernel kernel = clrt().create_kernel(launch.name, kernel_source_with_epilogue("deconv").c_str(), opt.c_str(),
+                                            err_ret);
+    if (CL_SUCCESS != *err_ret) {
+        LOGE("create_kernel %s failed.", launch.name);
+        return NULL;
+    }
+    DeconvLauncher launcher(kernel);
+    *err_ret = launcher.bind(input.n, input.c, input.h, input.w, output.c, output.h, output.w, in, weight, out);
+    if (CL_SUCCESS == *err_ret) {
+        *err_ret = set_epilogue_args(kernel, 10, epilogue);
+    }
+    if (CL_SUCCESS != *err_ret) {
+        LOGE("Failed to set %s arguments: %d", launch.name, *err_ret);
+        clrt().release_kernel(kernel);
+        return NULL;
+    }
+    return kernel;
+}
+
+cl_int enqueue_deconv_fp16(const DeconvParams &p, const dims4d &input_dims, int oc,
+                           cl_mem input, cl_mem weight, cl_mem output,
+                           cl_uint num_wait, const cl_event *wait_list, cl_event *event,
+                           cl_command_queue queue, const Epilogue &epilogue) {
+    dims4d output_dims = deconv_output_dims(p, input_dims, oc);
+    if (!check_params(p, input_dims, output_dims)) {
+        return CL_INVALID_VALUE;
+    }
+    cl_int ret = CL_SUCCESS;
+    DeconvLaunch launch = make_launch(p, input_dims, output_dims, epilogue);
+    cl_kernel kernel = create_deconv_kernel(p, launch, input_dims, output_dims, input, weight, output, epilogue,
+                                            &ret);
+    if (CL_SUCCESS != ret) {
+        return ret;
+    }
+
+    cl_event fill_event = NULL;
+    if (use_direct(p, input_dims, output_dims, epilogue) && direct_leaves_gaps(p, input_dims, output_dims)) {
+        cl_half zero = 0;
+        std::size_t bytes = (std::size_t)output_dims.n * output_dims.c * output_dims.h * output_dims.w *
+                            sizeof(cl_half);
+        ret = fill_cl_mem_async(output, &zero, sizeof(zero), bytes, num_wait, wait_list, &fill_event, queue);
+        if (CL_SUCCESS != ret) {
+            clrt().release_kernel(kernel);
+            return ret;
+        }
+        num_wait = 1;
+        wait_list = &fill_event;
+    }
+
+    size_t local[3], global[3];
+    clrt().tuner().local_size(launch.name, launch.shape, kernel, 3, launch.work, local);
+    LocalSizeTuner::pad_global_size(3, launch.work, local, global);
+    ret = enqueue_kernel_async(kernel, 3, global, local, num_wait, wait_list, event, queue);
+    if (fill_event) {
+        clReleaseEvent(fill_event);
+    }
+    clrt().release_kernel(kernel);
+    return ret;
+}
+
+cl_int enqueue_deconv_int8(const DeconvParams &p, const dims4d &input_dims, int oc, int in_zp,
+                           cl_mem input, cl_mem weight, cl_mem weight_sums, cl_mem output,
+                           const Int8Requant &requant,
+                           cl_uint num_wait, const cl_event *wait_list, cl_event *event,
+                           cl_command_queue queue) {
+    dims4d output_dims = deconv_output_dims(p, input_dims, oc);
+    if (!check_params(p, input_dims, output_dims)) {
+        return CL_INVALID_VALUE;
+    }
+    cl_int ret = CL_SUCCESS;
+    std::string opt = deconv_build_options(p) + int8_build_options();
+    const std::string &source = kernel_source_with_prelude("quant", "deconv_int8");
+    cl_kernel kernel = clrt().create_kernel("deconv_nchw_gather_int8", source.c_str(), opt.c_str(), &ret);
+    if (CL_SUCCESS != ret) {
+        LOGE("create_kernel deconv_nchw_gather_int8 failed.");
+        return ret;
+    }
+    KernelLauncher<int, int, int, int, int, int, int, int, cl_mem, cl_mem, cl_mem, cl_mem> launcher(kernel);
+    ret = launcher.bind(input_dims.n, input_dims.c, input_dims.h, input_dims.w, output_dims.c, output_dims.h,
+                        output_dims.w, in_zp, input, weight, weight_sums, output);
+    if (CL_SUCCESS == ret) {
+        ret = set_int8_requant_args(kernel, 12, requant);
+    }
+    if (CL_SUCCESS == ret) {
+        size_t work[] = {(size_t)p.stride_w * (((output_dims.w + p.stride_w - 1) / p.stride_w + 3) / 4),
+                         (size_t)(output_dims.c + 3) / 4, (size_t)output_dims.n * output_dims.h};
+        size_t local[3];
+        clrt().tuner().local_size("deconv_nchw_gather_int8", shape_string(p, input_dims, output_dims), kernel, 3,
+                                  work, local);
+        ret = launcher.enqueue(3, work, local, num_wait, wait_list, event, queue);
+    } else {
+        LOGE("Failed to set deconv_nchw_gather_int8 arguments: %d", ret);
+    }
+    clrt().release_kernel(kernel);
+    return ret;
+}
+
+cl_int tune_deconv_fp16(const DeconvParams &p, const dims4d &input_dims, int oc,
+                        cl_mem input, cl_mem weight, cl_mem output) {
+    dims4d output_dims = deconv_output_dims(p, input_dims, oc);
+    if (!check_params(p, input_dims, output_dims)) {
+        return CL_INVALID_VALUE;
+    }
+    cl_int ret = CL_SUCCESS;
+    DeconvLaunch launch = make_launch(p, input_dims, output_dims, Epilogue());
+    cl_kernel kernel = create_deconv_kernel(p, launch, input_dims, output_dims, input, weight, output, Epilogue(),
+                                            &ret);
+    if (CL_SUCCESS != ret) {
+        return ret;
+    }
+    size_t local[3];
+    double flops = 2.0 * input_dims.n * input_dims.c * input_dims.h * input_dims.w * oc * p.kernel_h * p.kernel_w;
+    double bytes = sizeof(cl_half) * ((double)input_dims.n * input_dims.c * input_dims.h * input_dims.w +
+                                      (double)input_dims.c * oc * p.kernel_h * p.kernel_w +
+                                      (double)output_dims.n * output_dims.c * output_dims.h * output_dims.w);
+    ret = clrt().tuner().tune(launch.name, launch.shape, kernel, 3, launch.work, local, 5, flops, bytes);
+    clrt().release_kernel(kernel);
+    return ret;
+}
+
+}  // namespace abc
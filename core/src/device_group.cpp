@@ -0,0 +1,173 @@
+#include "device_group.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "log.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "device_group"
+
+namespace abc {
+
+// weight of a new observation in the throughput moving average
+static const double kThroughputSmoothing = 0.5;
+
+cl_int DeviceGroup::init(const std::vector<DeviceInfo> &devices) {
+    if (!runtimes_.empty()) {
+        LOGE("The device group is already initialized.");
+        return CL_INVALID_OPERATION;
+    }
+    for (const DeviceInfo &info : devices) {
+        std::unique_ptr<CLRuntime> runtime(new CLRuntime());
+        runtime->primary_ = false;
+        cl_int ret = runtime->init_device(info.platform, info.device);
+        if (CL_SUCCESS != ret) {
+            LOGE("Failed to set up %s (%s): %d", info.device_name.c_str(), info.platform_name.c_str(), ret);
+            runtimes_.clear();
+            devices_.clear();
+            prior_.clear();
+            throughput_.clear();
+            return ret;
+        }
+        runtimes_.push_back(std::move(runtime));
+        devices_.push_back(info);
+        prior_.push_back(std::max(1.0, (double)info.compute_units * std::max<cl_uint>(info.max_clock_mhz, 1)));
+        throughput_.push_back(0.0);
+    }
+    return CL_SUCCESS;
+}
+
+std::vector<int> DeviceGroup::split_batch(int batch) const {
+    const int n = size();
+    std::vector<int> counts(n, 0);
+    // devices not measured yet weigh in with their prior, scaled to items/s
+    // by how the measured ones compare to theirs
+    double measured_rate = 0, measured_prior = 0;
+    for (int i = 0; i < n; ++i) {
+        if (throughput_[i] > 0) {
+            measured_rate += throughput_[i];
+            measured_prior += prior_[i];
+        }
+    }
+    const double prior_scale = measured_prior > 0 ? measured_rate / measured_prior : 1.0;
+    std::vector<double> weights(n);
+    double total = 0;
+    for (int i = 0; i < n; ++i) {
+        weights[i] = throughput_[i] > 0 ? throughput_[i] : prior_[i] * prior_scale;
+        total += weights[i];
+    }
+    if (n == 0 || batch <= 0 || total <= 0) {
+        return counts;
+    }
+    // largest remainder: floor every share, then hand the leftover items
+    // to the largest fractional parts
+    std::vector<std::pair<double, int> > remainders;
+    int assigned = 0;
+    for (int i = 0; i < n; ++i) {
+        double share = batch * weights[i] / total;
+        counts[i] = (int)floor(share);
+        assigned += counts[i];
+        remainders.push_back(std::make_pair(share - counts[i], i));
+    }
+    std::sort(remainders.begin(), remainders.end(),
+              [](const std::pair<double, int> &a, const std::pair<double, int> &b) { return a.first > b.first; });
+    for (int i = 0; assigned < batch; ++i, ++assigned) {
+        counts[remainders[i % n].second]++;
+    }
+    return counts;
+}
+
+cl_int DeviceGroup::run_slices(const std::vector<int> &counts, const BatchSliceFn &fn, std::vector<double> *seconds) {
+    const int n = size();
+    if ((int)counts.size() != n) {
+        LOGE("Got %zu slice sizes for %d devices.", counts.size(), n);
+        return CL_INVALID_VALUE;
+    }
+    std::vector<cl_int> rets(n, CL_SUCCESS);
+    seconds->assign(n, 0.0);
+    std::vector<std::thread> workers;
+    int begin = 0;
+    for (int i = 0; i < n; ++i) {
+        if (counts[i] <= 0) {
+            continue;
+        }
+        workers.push_back(std::thread([&, i, begin]() {
+            CLRuntime &runtime = *runtimes_[i];
+            ScopedRuntime scope(runtime);
+            auto start = std::chrono::steady_clock::now();
+            cl_int ret = fn(i, begin, counts[i]);
+            if (CL_SUCCESS == ret) {
+                ret = clFinish(runtime.queue());
+            }
+            if (CL_SUCCESS == ret) {
+                ret = clFinish(runtime.profile_queue());
+            }
+            (*seconds)[i] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            rets[i] = ret;
+        }));
+        begin += counts[i];
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    for (int i = 0; i < n; ++i) {
+        if (CL_SUCCESS != rets[i]) {
+            LOGE("Slice of %d items on %s failed: %d", counts[i], devices_[i].device_name.c_str(), rets[i]);
+            return rets[i];
+        }
+    }
+    return CL_SUCCESS;
+}
+
+cl_int DeviceGroup::run_split(const std::vector<int> &counts, const BatchSliceFn &fn) {
+    std::vector<double> seconds;
+    cl_int ret = run_slices(counts, fn, &seconds);
+    if (CL_SUCCESS != ret) {
+        return ret;
+    }
+    for (int i = 0; i < size(); ++i) {
+        if (counts[i] > 0 && seconds[i] > 0) {
+            double rate = counts[i] / seconds[i];
+            throughput_[i] = throughput_[i] > 0
+                                 ? (1 - kThroughputSmoothing) * throughput_[i] + kThroughputSmoothing * rate
+                                 : rate;
+        }
+    }
+    return CL_SUCCESS;
+}
+
+cl_int DeviceGroup::run_batch(int batch, const BatchSliceFn &fn, std::vector<int> *split) {
+    std::vector<int> counts = split_batch(batch);
+    if (split) {
+        *split = counts;
+    }
+    return run_split(counts, fn);
+}
+
+cl_int DeviceGroup::calibrate(int items, const BatchSliceFn &fn) {
+    for (int i = 0; i < size(); ++i) {
+        std::vector<int> counts(size(), 0);
+        counts[i] = items;
+        std::vector<double> seconds;
+        // the first run warms up program builds and the pool
+        cl_int ret = run_slices(counts, fn, &seconds);
+        if (CL_SUCCESS == ret) {
+            ret = run_slices(counts, fn, &seconds);
+        }
+        if (CL_SUCCESS != ret) {
+            return ret;
+        }
+        if (seconds[i] > 0) {
+            throughput_[i] = items / seconds[i];
+        }
+    }
+    return CL_SUCCESS;
+}
+
+}  // namespace abc
@@ -0,0 +1,94 @@
+#include "epilogue.h"
+
+#include <map>
+#include <mutex>
+
+#include "cl_kernel_source.h"
+#include "kernel_launcher.h"
+#include "log.h"
+#include "tuner.h"
+#include "utils.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "epilogue"
+
+namespace abc {
+
+std::string epilogue_build_options(const Epilogue &epilogue) {
+    std::string opt;
+    if (epilogue.scale != 1.0f) {
+        opt += " -DEPILOGUE_SCALE";
+    }
+    if (epilogue.bias) {
+        opt += " -DEPILOGUE_BIAS";
+    }
+    if (epilogue.residual) {
+        opt += " -DEPILOGUE_RESIDUAL";
+    }
+    if (epilogue.activation != ACT_NONE) {
+        opt += " -DEPILOGUE_ACT=" + std::to_string(static_cast<int>(epilogue.activation));
+    }
+    return opt;
+}
+
+const std::string &kernel_source_with_prelude(const char *prelude, const char *name) {
+    static std::mutex mutex;
+    static std::map<std::string, std::string> sources;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::string key = std::string(prelude) + "+" + name;
+    auto it = sources.find(key);
+    if (it == sources.end()) {
+        const char *head = get_cl_kernel_source(prelude);
+        const char *source = get_cl_kernel_source(name);
+        it = sources.insert(std::make_pair(key, std::string(head ? head : "") + (source ? source : ""))).first;
+    }
+    return it->second;
+}
+
+const std::string &kernel_source_with_epilogue(const char *name) {
+    return kernel_source_with_prelude("epilogue", name);
+}
+
+cl_int set_epilogue_args(cl_kernel kernel, cl_uint first_arg, const Epilogue &epilogue) {
+    cl_int ret = set_kernel_arg(kernel, first_arg, epilogue.bias);
+    ret |= set_kernel_arg(kernel, first_arg + 1, epilogue.scale);
+    ret |= set_kernel_arg(kernel, first_arg + 2, epilogue.residual);
+    if (CL_SUCCESS != ret) {
+        LOGE("Failed to set epilogue arguments.");
+        return CL_INVALID_ARG_VALUE;
+    }
+    return CL_SUCCESS;
+}
+
+cl_int enqueue_epilogue_fp16(const dims4d &dims, cl_mem data, const Epilogue &epilogue,
+                             cl_uint num_wait, const cl_event *wait_list, cl_event *event,
+                             cl_command_queue queue) {
+    cl_int ret = CL_SUCCESS;
+    std::string opt = epilogue_build_options(epilogue);
+    cl_kernel kernel = clrt().create_kernel("epilogue_nchw", get_cl_kernel_source("epilogue"), opt.c_str(), &ret);
+    if (CL_SUCCESS != ret) {
+        LOGE("create_kernel epilogue_nchw failed.");
+        return ret;
+    }
+    int hw = dims.h * dims.w;
+    KernelLauncher<int, int, int, cl_mem> launcher(kernel);
+    ret = launcher.bind(dims.n, dims.c, hw, data);
+    if (CL_SUCCESS == ret) {
+        ret = set_epilogue_args(kernel, 4, epilogue);
+    }
+    if (CL_SUCCESS == ret) {
+        size_t work[] = {static_cast<size_t>((hw + 3) / 4), static_cast<size_t>(dims.c),
+                         static_cast<size_t>(dims.n)};
+        size_t local[3];
+        LocalSizeTuner::heuristic_local_size(kernel, 3, work, local);
+        ret = launcher.enqueue(3, work, local, num_wait, wait_list, event, queue);
+    } else {
+        LOGE("Failed to set epilogue_nchw arguments: %d", ret);
+    }
+    clrt().release_kernel(kernel);
+    return ret;
+}
+
+}  // namespace abc
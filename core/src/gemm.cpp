@@ -0,0 +1,142 @@
+#include "gemm.h"
+
+#include "cl_kernel_source.h"
+#include "kernel_launcher.h"
+#include "log.h"
+#include "utils.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "gemm"
+
+namespace abc {
+
+// leading arguments of gemm_tiled and gemm_int8_tiled: M, N, K, A, lda, B, ldb, C, ldc
+typedef KernelLauncher<int, int, int, cl_mem, int, cl_mem, int, cl_mem, int> TiledGemmLauncher;
+
+static void tiled_gemm_work_size(const GemmConfig &config, int M, int N, size_t *work, size_t *local) {
+    local[0] = static_cast<size_t>(config.tile_n / config.wpt_n);
+    local[1] = static_cast<size_t>(config.tile_m / config.wpt_m);
+    work[0] = static_cast<size_t>((N + config.tile_n - 1) / config.tile_n) * local[0];
+    work[1] = static_cast<size_t>((M + config.tile_m - 1) / config.tile_m) * local[1];
+}
+
+GemmConfig select_gemm_config(int M, int N, int K) {
+    (void)(K);
+    if (M >= 128 && N >= 128) {
+        GemmConfig config = {64, 64, 16, 8, 4};
+        return config;
+    }
+    if (M >= 32 && N >= 32) {
+        GemmConfig config = {32, 32, 16, 4, 4};
+        return config;
+    }
+    GemmConfig config = {16, 16, 16, 2, 2};
+    return config;
+}
+
+std::string gemm_build_options(const GemmConfig &config, bool trans_a, bool trans_b) {
+    std::string opt;
+    opt += " -DTILE_M=" + std::to_string(config.tile_m);
+    opt += " -DTILE_N=" + std::to_string(config.tile_n);
+    opt += " -DTILE_K=" + std::to_string(config.tile_k);
+    opt += " -DWPT_M=" + std::to_string(config.wpt_m);
+    opt += " -DWPT_N=" + std::to_string(config.wpt_n);
+    opt += " -DTRANS_A=" + std::to_string(trans_a ? 1 : 0);
+    opt += " -DTRANS_B=" + std::to_string(trans_b ? 1 : 0);
+    return opt;
+}
+
+cl_int enqueue_gemm_fp16_with_config(const GemmConfig &config, bool trans_a, bool trans_b, int M, int N, int K,
+                                     cl_mem A, cl_mem B, cl_mem C,
+                                     cl_uint num_wait, const cl_event *wait_list, cl_event *event,
+                                     cl_command_queue queue, const Epilogue &epilogue) {
+    cl_int ret = CL_SUCCESS;
+    std::string opt = gemm_build_options(config, trans_a, trans_b) + epilogue_build_options(epilogue);
+    cl_kernel kernel = clrt().create_kernel("gemm_tiled", kernel_source_with_epilogue("gemm").c_str(), opt.c_str(),
+                                            &ret);
+    if (CL_SUCCESS != ret) {
+        LOGE("create_kernel gemm_tiled failed.");
+        return ret;
+    }
+    TiledGemmLauncher launcher(kernel);
+    ret = launcher.bind(M, N, K, A, trans_a ? M : K, B, trans_b ? K : N, C, N);
+    if (CL_SUCCESS == ret) {
+        ret = set_epilogue_args(kernel, 9, epilogue);
+    }
+    if (CL_SUCCESS == ret) {
+        size_t work[2], local[2];
+        tiled_gemm_work_size(config, M, N, work, local);
+        ret = launcher.enqueue(2, work, local, num_wait, wait_list, event, queue);
+    } else {
+        LOGE("Failed to set gemm_tiled arguments: %d", ret);
+    }
+    clrt().release_kernel(kernel);
+    return ret;
+}
+
+cl_int enqueue_gemm_fp16(bool trans_a, bool trans_b, int M, int N, int K,
+                         cl_mem A, cl_mem B, cl_mem C,
+                         cl_uint num_wait, const cl_event *wait_list, cl_event *event,
+                         cl_command_queue queue, const Epilogue &epilogue) {
+    return enqueue_gemm_fp16_with_config(select_gemm_config(M, N, K), trans_a, trans_b, M, N, K, A, B, C,
+                                         num_wait, wait_list, event, queue, epilogue);
+}
+
+cl_int enqueue_gemm_int8(bool trans_a, bool trans_b, int M, int N, int K,
+                         cl_mem A, cl_mem B, cl_mem C, const Int8Requant &requant,
+                         cl_uint num_wait, const cl_event *wait_list, cl_event *event,
+                         cl_command_queue queue) {
+    cl_int ret = CL_SUCCESS;
+    GemmConfig config = select_gemm_config(M, N, K);
+    std::string opt = gemm_build_options(config, trans_a, trans_b) + int8_build_options();
+    const std::string &source = kernel_source_with_prelude("quant", "gemm_int8");
+    cl_kernel kernel = clrt().create_kernel("gemm_int8_tiled", source.c_str(), opt.c_str(), &ret);
+    if (CL_SUCCESS != ret) {
+        LOGE("create_kernel gemm_int8_tiled failed.");
+        return ret;
+    }
+    TiledGemmLauncher launcher(kernel);
+    ret = launcher.bind(M, N, K, A, trans_a ? M : K, B, trans_b ? K : N, C, N);
+    if (CL_SUCCESS == ret) {
+        ret = set_int8_requant_args(kernel, 9, requant);
+    }
+    if (CL_SUCCESS == ret) {
+        size_t work[2], local[2];
+        tiled_gemm_work_size(config, M, N, work, local);
+        ret = launcher.enqueue(2, work, local, num_wait, wait_list, event, queue);
+    } else {
+        LOGE("Failed to set gemm_int8_tiled arguments: %d", ret);
+    }
+    clrt().release_kernel(kernel);
+    return ret;
+}
+
+cl_int enqueue_gemm_fp16_image(int K, int M, int H, int W, cl_mem input, cl_mem weight, cl_mem output,
+                               cl_uint num_wait, const cl_event *wait_list, cl_event *event,
+                               cl_command_queue queue) {
+    cl_int ret = CL_SUCCESS;
+    cl_kernel kernel = clrt().create_kernel("gemm_nc4hw4_image", get_cl_kernel_source("gemm_image"), NULL, &ret);
+    if (CL_SUCCESS != ret) {
+        LOGE("create_kernel gemm_nc4hw4_image failed.");
+        return ret;
+    }
+    KernelLauncher<int, int, int, int, cl_mem, cl_mem, cl_mem> launcher(kernel);
+    ret = launcher.bind(K, M, H, W, input, weight, output);
+    if (CL_SUCCESS == ret) {
+        size_t work[] = {static_cast<size_t>((W + 3) / 4), static_cast<size_t>((M + 3) / 4),
+                         static_cast<size_t>(H)};
+        std::string shape = "k" + std::to_string(K) + "_m" + std::to_string(M) + "_h" + std::to_string(H) + "_w" +
+                            std::to_string(W);
+        size_t local[3];
+        clrt().tuner().local_size("gemm_nc4hw4_image", shape, kernel, 3, work, local);
+        ret = launcher.enqueue(3, work, local, num_wait, wait_list, event, queue);
+    } else {
+        LOGE("Failed to set gemm_nc4hw4_image arguments: %d", ret);
+    }
+    clrt().release_kernel(kernel);
+    return ret;
+}
+
+}  // namespace abc
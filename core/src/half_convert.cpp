@@ -0,0 +1,177 @@
+#include "half_convert.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "half_float.h"
+
+namespace abc {
+
+void convert_f32_to_f16_scalar(std::size_t n, const float *src, cl_half *dst) {
+    for (std::size_t i = 0; i < n; ++i) {
+        dst[i] = to_half(src[i]);
+    }
+}
+
+void convert_f16_to_f32_scalar(std::size_t n, const cl_half *src, float *dst) {
+    for (std::size_t i = 0; i < n; ++i) {
+        dst[i] = to_float(src[i]);
+    }
+}
+
+typedef void (*F32ToF16)(std::size_t, const float *, cl_half *);
+typedef void (*F16ToF32)(std::size_t, const cl_half *, float *);
+
+// to_half() truncates and hardware rounds to nearest by default, so the
+// SIMD paths convert toward zero. That also makes finite overflow saturate
+// to 65504 like to_half(); only NaNs need patching afterwards.
+static const uint16_t kHalfNaN = 0x7fff;
+static const uint32_t kFloatNaN = 0x7fc00000;
+
+#if defined(__aarch64__)
+
+static const char *kSimdIsa = "neon";
+
+static bool simd_supported() {
+    return true;
+}
+
+static void f32_to_f16_simd(std::size_t n, const float *src, cl_half *dst) {
+    // FPCR.RMode (bits 23:22) = 0b11: round toward zero. The "memory"
+    // clobbers keep the loads after the switch and the stores before the
+    // restore, and the conversions sit between the two.
+    uint64_t fpcr;
+    asm volatile("mrs %0, fpcr" : "=r"(fpcr) : : "memory");
+    asm volatile("msr fpcr, %0" : : "r"(fpcr | (3ull << 22)) : "memory");
+    const uint16x8_t nan = vdupq_n_u16(kHalfNaN);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        float32x4_t a = vld1q_f32(src + i);
+        float32x4_t b = vld1q_f32(src + i + 4);
+        uint16x8_t h = vreinterpretq_u16_f16(vcvt_high_f16_f32(vcvt_f16_f32(a), b));
+        uint16x8_t is_nan = vcombine_u16(vmovn_u32(vmvnq_u32(vceqq_f32(a, a))),
+                                         vmovn_u32(vmvnq_u32(vceqq_f32(b, b))));
+        vst1q_u16(dst + i, vbslq_u16(is_nan, nan, h));
+    }
+    asm volatile("msr fpcr, %0" : : "r"(fpcr) : "memory");
+    convert_f32_to_f16_scalar(n - i, src + i, dst + i);
+}
+
+static void f16_to_f32_simd(std::size_t n, const cl_half *src, float *dst) {
+    const uint32x4_t nan = vdupq_n_u32(kFloatNaN);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        float16x8_t h = vreinterpretq_f16_u16(vld1q_u16(src + i));
+        float32x4_t a = vcvt_f32_f16(vget_low_f16(h));
+        float32x4_t b = vcvt_high_f32_f16(h);
+        uint32x4_t ua = vbslq_u32(vmvnq_u32(vceqq_f32(a, a)), nan, vreinterpretq_u32_f32(a));
+        uint32x4_t ub = vbslq_u32(vmvnq_u32(vceqq_f32(b, b)), nan, vreinterpretq_u32_f32(b));
+        vst1q_f32(dst + i, vreinterpretq_f32_u32(ua));
+        vst1q_f32(dst + i + 4, vreinterpretq_f32_u32(ub));
+    }
+    convert_f16_to_f32_scalar(n - i, src + i, dst + i);
+}
+
+#elif defined(__x86_64__) || defined(__i386__)
+
+static const char *kSimdIsa = "f16c";
+
+static bool simd_supported() {
+    return __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+}
+
+__attribute__((target("avx,f16c"))) static void f32_to_f16_simd(std::size_t n, const float *src, cl_half *dst) {
+    const __m128i nan = _mm_set1_epi16(kHalfNaN);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_loadu_ps(src + i);
+        __m128i h = _mm256_cvtps_ph(v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+        __m256i is_nan32 = _mm256_castps_si256(_mm256_cmp_ps(v, v, _CMP_UNORD_Q));
+        __m128i is_nan = _mm_packs_epi32(_mm256_castsi256_si128(is_nan32), _mm256_extractf128_si256(is_nan32, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_blendv_epi8(h, nan, is_nan));
+    }
+    convert_f32_to_f16_scalar(n - i, src + i, dst + i);
+}
+
+__attribute__((target("avx,f16c"))) static void f16_to_f32_simd(std::size_t n, const cl_half *src, float *dst) {
+    const __m256 nan = _mm256_castsi256_ps(_mm256_set1_epi32(kFloatNaN));
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)));
+        _mm256_storeu_ps(dst + i, _mm256_blendv_ps(v, nan, _mm256_cmp_ps(v, v, _CMP_UNORD_Q)));
+    }
+    convert_f16_to_f32_scalar(n - i, src + i, dst + i);
+}
+
+#else
+
+static const char *kSimdIsa = "scalar";
+
+static bool simd_supported() {
+    return false;
+}
+
+static void f32_to_f16_simd(std::size_t n, const float *src, cl_half *dst) {
+    convert_f32_to_f16_scalar(n, src, dst);
+}
+
+static void f16_to_f32_simd(std::size_t n, const cl_half *src, float *dst) {
+    convert_f16_to_f32_scalar(n, src, dst);
+}
+
+#endif
+
+static bool use_simd() {
+    static const bool supported = simd_supported();
+    return supported;
+}
+
+const char *half_convert_isa() {
+    return use_simd() ? kSimdIsa : "scalar";
+}
+
+// Runs kernel over [0, n) in contiguous chunks, one per thread, with the
+// calling thread taking the first.
+template <typename Src, typename Dst>
+static void parallel_convert(void (*kernel)(std::size_t, const Src *, Dst *), std::size_t n, const Src *src,
+                             Dst *dst, int num_threads) {
+    if (num_threads <= 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (n < kHalfConvertParallelMin || num_threads == 1) {
+        kernel(n, src, dst);
+        return;
+    }
+    // multiples of 64 elements keep every chunk on whole cache lines
+    std::size_t chunk = ((n + num_threads - 1) / num_threads + 63) / 64 * 64;
+    std::vector<std::thread> threads;
+    for (std::size_t begin = chunk; begin < n; begin += chunk) {
+        std::size_t len = std::min(chunk, n - begin);
+        threads.emplace_back(kernel, len, src + begin, dst + begin);
+    }
+    kernel(std::min(chunk, n), src, dst);
+    for (std::thread &t : threads) {
+        t.join();
+    }
+}
+
+void convert_f32_to_f16(std::size_t n, const float *src, cl_half *dst, int num_threads) {
+    parallel_convert<float, cl_half>(use_simd() ? f32_to_f16_simd : convert_f32_to_f16_scalar, n, src, dst,
+                                     num_threads);
+}
+
+void convert_f16_to_f32(std::size_t n, const cl_half *src, float *dst, int num_threads) {
+    parallel_convert<cl_half, float>(use_simd() ? f16_to_f32_simd : convert_f16_to_f32_scalar, n, src, dst,
+                                     num_threads);
+}
+
+}  // namespace abc
@@ -0,0 +1,152 @@
+#include "mem_pool.h"
+
+#include "log.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "mem_pool"
+
+namespace abc {
+
+std::size_t MemPool::bucket_size(std::size_t bytes) {
+    static const std::size_t kMinBucket = 256;
+    if (bytes <= kMinBucket) {
+        return kMinBucket;
+    }
+    std::size_t pow2 = kMinBucket;
+    while (pow2 < bytes) {
+        pow2 <<= 1;
+    }
+    std::size_t step = pow2 >> 3;  // quarter steps of the lower power of two
+    return (bytes + step - 1) / step * step;
+}
+
+bool MemPool::idle(CachedBuffer *cached) {
+    for (cl_event fence : cached->fences) {
+        cl_int status = CL_COMPLETE;
+        if (CL_SUCCESS != clGetEventInfo(fence, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), &status, NULL)) {
+            return false;
+        }
+        // negative: the commands before it were aborted, nothing runs anymore
+        if (status > CL_COMPLETE) {
+            return false;
+        }
+    }
+    release_fences(cached);
+    return true;
+}
+
+void MemPool::release_fences(CachedBuffer *cached) {
+    for (cl_event fence : cached->fences) {
+        clReleaseEvent(fence);
+    }
+    cached->fences.clear();
+}
+
+void MemPool::set_high_water_mark(std::size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    high_water_mark_ = bytes;
+    trim_locked(high_water_mark_);
+}
+
+cl_mem MemPool::acquire(std::size_t bytes, cl_int *err_ret) {
+    std::size_t bucket = bucket_size(bytes);
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.num_acquires++;
+    cl_mem mem = NULL;
+    auto it = free_.lower_bound(bucket);
+    while (it != free_.end() && it->first == bucket && !idle(&it->second)) {
+        ++it;
+    }
+    if (it != free_.end() && it->first == bucket) {
+        mem = it->second.mem;
+        free_.erase(it);
+        stats_.bytes_cached -= bucket;
+        stats_.num_hits++;
+        *err_ret = CL_SUCCESS;
+    } else {
+        mem = clCreateBuffer(context_, CL_MEM_READ_WRITE, bucket, NULL, err_ret);
+        if (*err_ret != CL_SUCCESS) {
+            // the driver may be out of memory because of what we hold, retry
+            // once with an empty cache.
+            trim_locked(0);
+            mem = clCreateBuffer(context_, CL_MEM_READ_WRITE, bucket, NULL, err_ret);
+        }
+        if (*err_ret != CL_SUCCESS) {
+            LOGE("clCreateBuffer of %zu bytes failed: %d", bucket, *err_ret);
+            return NULL;
+        }
+    }
+    live_[mem] = bucket;
+    stats_.bytes_in_use += bucket;
+    if (stats_.bytes_in_use + stats_.bytes_cached > stats_.peak_bytes) {
+        stats_.peak_bytes = stats_.bytes_in_use + stats_.bytes_cached;
+    }
+    return mem;
+}
+
+void MemPool::release(cl_mem mem) {
+    if (!mem) {
+        return;
+    }
+    // before taking the lock: the fences come from the runtime's queues
+    std::vector<cl_event> fences;
+    bool fenced = !fences_ || CL_SUCCESS == fences_(&fences);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = live_.find(mem);
+    if (it == live_.end()) {
+        LOGW("cl_mem %p was not allocated by the pool, releasing it.", (void *)mem);
+        clReleaseMemObject(mem);
+        return;
+    }
+    std::size_t bucket = it->second;
+    live_.erase(it);
+    stats_.bytes_in_use -= bucket;
+    if (bucket > high_water_mark_ || !fenced) {
+        // the driver keeps it alive until queued commands are done with it
+        for (cl_event fence : fences) {
+            clReleaseEvent(fence);
+        }
+        clReleaseMemObject(mem);
+        return;
+    }
+    CachedBuffer cached = {mem, clock_++, fences};
+    free_.insert(std::make_pair(bucket, cached));
+    stats_.bytes_cached += bucket;
+    trim_locked(high_water_mark_);
+}
+
+void MemPool::trim(std::size_t target_bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    trim_locked(target_bytes);
+}
+
+void MemPool::trim_locked(std::size_t target_bytes) {
+    while (stats_.bytes_cached > target_bytes && !free_.empty()) {
+        auto oldest = free_.begin();
+        for (auto it = free_.begin(); it != free_.end(); ++it) {
+            if (it->second.stamp < oldest->second.stamp) {
+                oldest = it;
+            }
+        }
+        release_fences(&oldest->second);
+        clReleaseMemObject(oldest->second.mem);
+        stats_.bytes_cached -= oldest->first;
+        free_.erase(oldest);
+    }
+}
+
+MemPoolStats MemPool::stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void MemPool::reset_stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.peak_bytes = stats_.bytes_in_use + stats_.bytes_cached;
+    stats_.num_acquires = 0;
+    stats_.num_hits = 0;
+}
+
+}  // namespace abc
@@ -0,0 +1,539 @@
+#include "op_graph.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+
+#include "gemm.h"
+#include "log.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "op_graph"
+
+namespace abc {
+
+static std::size_t dims_num_elem(const dims4d &dims) {
+    return (std::size_t)dims.n * (std::size_t)dims.c * (std::size_t)dims.h * (std::size_t)dims.w;
+}
+
+static bool same_dims(const dims4d &a, const dims4d &b) {
+    return a.n == b.n && a.c == b.c && a.h == b.h && a.w == b.w;
+}
+
+static std::size_t align_up(std::size_t bytes, std::size_t align) {
+    return (bytes + align - 1) / align * align;
+}
+
+OpGraph::OpGraph() : compiled_(false), last_run_(NULL) {
+    memset(&plan_, 0, sizeof(plan_));
+}
+
+OpGraph::~OpGraph() {
+    release_memory();
+}
+
+void OpGraph::release_memory() {
+    // the arenas go back to the pool, which may hand them out at once; the
+    // last run() may still be using them on a queue the pool does not know
+    if (last_run_) {
+        clWaitForEvents(1, &last_run_);
+        clReleaseEvent(last_run_);
+        last_run_ = NULL;
+    }
+    for (cl_mem mem : sub_buffers_) {
+        clReleaseMemObject(mem);
+    }
+    sub_buffers_.clear();
+    for (cl_mem mem : arenas_) {
+        clrt().mem_pool().release(mem);
+    }
+    arenas_.clear();
+}
+
+int OpGraph::add_tensor(TensorKind kind, const dims4d &dims, cl_mem mem) {
+    if (compiled_) {
+        LOGE("Tensors cannot be added to a compiled graph.");
+        return -1;
+    }
+    TensorInfo info;
+    info.kind = kind;
+    info.dims = dims;
+    info.bytes = dims_num_elem(dims) * sizeof(cl_half);
+    info.mem = mem;
+    info.producer = -1;
+    info.root = (int)tensors_.size();
+    tensors_.push_back(info);
+    return info.root;
+}
+
+int OpGraph::add_input(const dims4d &dims) {
+    return add_tensor(OP_TENSOR_INPUT, dims, NULL);
+}
+
+int OpGraph::add_output(const dims4d &dims) {
+    return add_tensor(OP_TENSOR_OUTPUT, dims, NULL);
+}
+
+int OpGraph::add_constant(const dims4d &dims, cl_mem mem) {
+    return add_tensor(OP_TENSOR_CONSTANT, dims, mem);
+}
+
+int OpGraph::add_intermediate(const dims4d &dims) {
+    return add_tensor(OP_TENSOR_INTERMEDIATE, dims, NULL);
+}
+
+bool OpGraph::valid_tensor(int tensor) const {
+    return tensor >= 0 && tensor < (int)tensors_.size();
+}
+
+cl_int OpGraph::add_op(Op *op) {
+    if (compiled_) {
+        LOGE("Ops cannot be added to a compiled graph.");
+        return CL_INVALID_OPERATION;
+    }
+    TensorInfo &out = tensors_[op->output];
+    if (out.kind != OP_TENSOR_OUTPUT && out.kind != OP_TENSOR_INTERMEDIATE) {
+        LOGE("Tensor %d is an input or a constant and cannot be written.", op->output);
+        return CL_INVALID_VALUE;
+    }
+    if (out.producer >= 0) {
+        LOGE("Tensor %d is already written by op %d.", op->output, out.producer);
+        return CL_INVALID_VALUE;
+    }
+    for (int t : op->inputs) {
+        if (t == op->output) {
+            LOGE("Op reads the tensor %d it writes.", t);
+            return CL_INVALID_VALUE;
+        }
+    }
+    op->in_place = false;
+    out.producer = (int)ops_.size();
+    ops_.push_back(*op);
+    return CL_SUCCESS;
+}
+
+// Appends the epilogue's tensors to op->inputs after checking them against
+// the output: bias holds one value per channel, residual the whole output.
+cl_int OpGraph::add_epilogue_inputs(Op *op, std::size_t channels) {
+    const OpEpilogue &epilogue = op->epilogue;
+    if (epilogue.bias >= 0) {
+        if (!valid_tensor(epilogue.bias) || dims_num_elem(tensors_[epilogue.bias].dims) != channels) {
+            LOGE("Bias %d does not hold %zu channels.", epilogue.bias, channels);
+            return CL_INVALID_VALUE;
+        }
+        op->inputs.push_back(epilogue.bias);
+    }
+    if (epilogue.residual >= 0) {
+        if (!valid_tensor(epilogue.residual) ||
+            dims_num_elem(tensors_[epilogue.residual].dims) != dims_num_elem(tensors_[op->output].dims)) {
+            LOGE("Residual %d does not match the output.", epilogue.residual);
+            return CL_INVALID_VALUE;
+        }
+        op->inputs.push_back(epilogue.residual);
+    }
+    return CL_SUCCESS;
+}
+
+cl_int OpGraph::add_gemm(bool trans_a, bool trans_b, int M, int N, int K, int a, int b, int c,
+                         const OpEpilogue &epilogue) {
+    if (!valid_tensor(a) || !valid_tensor(b) || !valid_tensor(c)) {
+        LOGE("add_gemm: unknown tensor.");
+        return CL_INVALID_VALUE;
+    }
+    if (dims_num_elem(tensors_[a].dims) != (std::size_t)M * K ||
+        dims_num_elem(tensors_[b].dims) != (std::size_t)K * N ||
+        dims_num_elem(tensors_[c].dims) != (std::size_t)M * N) {
+        LOGE("add_gemm: tensors do not match M = %d, N = %d, K = %d.", M, N, K);
+        return CL_INVALID_VALUE;
+    }
+    Op op;
+    op.type = OP_GEMM;
+    op.trans_a = trans_a;
+    op.trans_b = trans_b;
+    op.M = M;
+    op.N = N;
+    op.K = K;
+    op.inputs = {a, b};
+    op.output = c;
+    op.epilogue = epilogue;
+    cl_int ret = add_epilogue_inputs(&op, M);
+    return CL_SUCCESS == ret ? add_op(&op) : ret;
+}
+
+cl_int OpGraph::add_deconv(const DeconvParams &p, int input, int weight, int output, const OpEpilogue &epilogue) {
+    if (!valid_tensor(input) || !valid_tensor(weight) || !valid_tensor(output)) {
+        LOGE("add_deconv: unknown tensor.");
+        return CL_INVALID_VALUE;
+    }
+    const dims4d &in = tensors_[input].dims;
+    const dims4d &out = tensors_[output].dims;
+    if (!same_dims(deconv_output_dims(p, in, out.c), out) ||
+        dims_num_elem(tensors_[weight].dims) != (std::size_t)in.c * out.c * p.kernel_h * p.kernel_w) {
+        LOGE("add_deconv: output or weight shape does not match the input.");
+        return CL_INVALID_VALUE;
+    }
+    Op op;
+    op.type = OP_DECONV;
+    op.trans_a = op.trans_b = false;
+    op.M = op.N = op.K = 0;
+    op.deconv = p;
+    op.inputs = {input, weight};
+    op.output = output;
+    op.epilogue = epilogue;
+    cl_int ret = add_epilogue_inputs(&op, out.c);
+    return CL_SUCCESS == ret ? add_op(&op) : ret;
+}
+
+cl_int OpGraph::add_elementwise(int input, int output, const OpEpilogue &epilogue) {
+    if (!valid_tensor(input) || !valid_tensor(output)) {
+        LOGE("add_elementwise: unknown tensor.");
+        return CL_INVALID_VALUE;
+    }
+    const dims4d &out = tensors_[output].dims;
+    if (!same_dims(tensors_[input].dims, out)) {
+        LOGE("add_elementwise: input and output dims differ.");
+        return CL_INVALID_VALUE;
+    }
+    Op op;
+    op.type = OP_ELEMENTWISE;
+    op.trans_a = op.trans_b = false;
+    op.M = op.N = op.K = 0;
+    op.inputs = {input};
+    op.output = output;
+    op.epilogue = epilogue;
+    cl_int ret = add_epilogue_inputs(&op, out.c);
+    return CL_SUCCESS == ret ? add_op(&op) : ret;
+}
+
+// Kahn's algorithm; among the ops that are ready the earliest added goes
+// first, so a graph built in execution order keeps that order.
+cl_int OpGraph::schedule_ops() {
+    const int num_ops = (int)ops_.size();
+    std::vector<int> pending(num_ops, 0);
+    std::vector<std::vector<int> > consumers(num_ops);
+    for (int i = 0; i < num_ops; ++i) {
+        std::vector<int> producers;
+        for (int t : ops_[i].inputs) {
+            int p = tensors_[t].producer;
+            if (p >= 0 && std::find(producers.begin(), producers.end(), p) == producers.end()) {
+                producers.push_back(p);
+            }
+        }
+        for (int p : producers) {
+            consumers[p].push_back(i);
+        }
+        pending[i] = (int)producers.size();
+    }
+    std::priority_queue<int, std::vector<int>, std::greater<int> > ready;
+    for (int i = 0; i < num_ops; ++i) {
+        if (pending[i] == 0) {
+            ready.push(i);
+        }
+    }
+    schedule_.clear();
+    while (!ready.empty()) {
+        int op = ready.top();
+        ready.pop();
+        schedule_.push_back(op);
+        for (int c : consumers[op]) {
+            if (--pending[c] == 0) {
+                ready.push(c);
+            }
+        }
+    }
+    if ((int)schedule_.size() != num_ops) {
+        LOGE("The op graph has a cycle.");
+        schedule_.clear();
+        return CL_INVALID_OPERATION;
+    }
+    return CL_SUCCESS;
+}
+
+cl_int OpGraph::plan_memory(bool share_memory) {
+    const int num_tensors = (int)tensors_.size();
+    // live range of every tensor in schedule steps
+    std::vector<int> first(num_tensors, -1), last(num_tensors, -1);
+    for (int step = 0; step < (int)schedule_.size(); ++step) {
+        const Op &op = ops_[schedule_[step]];
+        for (int t : op.inputs) {
+            last[t] = step;
+        }
+        first[op.output] = step;
+        last[op.output] = std::max(last[op.output], step);
+    }
+    memset(&plan_, 0, sizeof(plan_));
+    for (int step = 0; step < (int)schedule_.size() && share_memory; ++step) {
+        Op &op = ops_[schedule_[step]];
+        int input = op.inputs[0];
+        if (op.type == OP_ELEMENTWISE && tensors_[input].kind == OP_TENSOR_INTERMEDIATE &&
+            tensors_[op.output].kind == OP_TENSOR_INTERMEDIATE && last[input] == step) {
+            tensors_[op.output].root = tensors_[input].root;
+            op.in_place = true;
+            plan_.num_in_place++;
+        }
+    }
+
+    struct Block {
+        int root;
+        std::size_t bytes;
+        int first, last;
+        int arena;
+        std::size_t offset;
+    };
+    std::vector<Block> blocks;
+    std::vector<int> block_of(num_tensors, -1);
+    cl_uint align_bits = 0;
+    cl_ulong max_alloc = 0;
+    clGetDeviceInfo(clrt().device_id(), CL_DEVICE_MEM_BASE_ADDR_ALIGN, sizeof(align_bits), &align_bits, NULL);
+    clGetDeviceInfo(clrt().device_id(), CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(max_alloc), &max_alloc, NULL);
+    // sub-buffer origins must be aligned to the base address alignment
+    const std::size_t align = align_bits >= 8 ? align_bits / 8 : 128;
+    for (int t = 0; t < num_tensors; ++t) {
+        const TensorInfo &info = tensors_[t];
+        if (info.kind != OP_TENSOR_INTERMEDIATE) {
+            continue;
+        }
+        if (info.producer < 0) {
+            LOGE("Intermediate %d is never written.", t);
+            return CL_INVALID_OPERATION;
+        }
+        plan_.num_intermediates++;
+        plan_.naive_bytes += info.bytes;
+        int &b = block_of[info.root];
+        if (b < 0) {
+            b = (int)blocks.size();
+            Block block = {info.root, align_up(info.bytes, align), first[t], last[t], -1, 0};
+            blocks.push_back(block);
+        } else {
+            blocks[b].first = std::min(blocks[b].first, first[t]);
+            blocks[b].last = std::max(blocks[b].last, last[t]);
+        }
+        if (max_alloc && blocks[b].bytes > max_alloc) {
+            LOGE("Intermediate %d of %zu bytes exceeds the device allocation limit.", t, info.bytes);
+            return CL_INVALID_BUFFER_SIZE;
+        }
+    }
+
+    // Greedy by size: the largest blocks are placed first, each at the
+    // smallest gap left by the blocks it is alive together with, or past
+    // them. A new arena is opened when a block would cross max_alloc.
+    std::vector<std::size_t> arena_bytes;
+    std::vector<int> order(blocks.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        order[i] = (int)i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return blocks[a].bytes > blocks[b].bytes; });
+    std::vector<int> placed;
+    for (int bi : order) {
+        Block &block = blocks[bi];
+        if (!share_memory) {
+            block.arena = (int)arena_bytes.size();
+            arena_bytes.push_back(block.bytes);
+            continue;
+        }
+        for (int arena = 0; arena < (int)arena_bytes.size() && block.arena < 0; ++arena) {
+            std::vector<std::pair<std::size_t, std::size_t> > busy;
+            for (int pi : placed) {
+                const Block &other = blocks[pi];
+                if (other.arena == arena && other.first <= block.last && block.first <= other.last) {
+                    busy.push_back(std::make_pair(other.offset, other.offset + other.bytes));
+                }
+            }
+            std::sort(busy.begin(), busy.end());
+            std::size_t end = 0, best = 0, best_gap = 0;
+            bool found = false;
+            for (const auto &range : busy) {
+                if (range.first > end) {
+                    std::size_t gap = range.first - end;
+                    if (gap >= block.bytes && (!found || gap < best_gap)) {
+                        best = end;
+                        best_gap = gap;
+                        found = true;
+                    }
+                }
+                end = std::max(end, range.second);
+            }
+            std::size_t offset = found ? best : end;
+            if (!max_alloc || offset + block.bytes <= max_alloc) {
+                block.arena = arena;
+                block.offset = offset;
+                arena_bytes[arena] = std::max(arena_bytes[arena], offset + block.bytes);
+            }
+        }
+        if (block.arena < 0) {
+            block.arena = (int)arena_bytes.size();
+            block.offset = 0;
+            arena_bytes.push_back(block.bytes);
+        }
+        placed.push_back(bi);
+    }
+
+    for (std::size_t bytes : arena_bytes) {
+        cl_int ret = CL_SUCCESS;
+        cl_mem arena = clrt().mem_pool().acquire(bytes, &ret);
+        if (CL_SUCCESS != ret) {
+            LOGE("Failed to allocate an arena of %zu bytes.", bytes);
+            return ret;
+        }
+        arenas_.push_back(arena);
+        plan_.planned_bytes += bytes;
+    }
+    plan_.num_arenas = arenas_.size();
+    std::vector<cl_mem> block_mem(blocks.size(), NULL);
+    for (std::size_t b = 0; b < blocks.size(); ++b) {
+        const Block &block = blocks[b];
+        if (!share_memory) {
+            block_mem[b] = arenas_[block.arena];
+            continue;
+        }
+        cl_buffer_region region = {block.offset, tensors_[block.root].bytes};
+        cl_int ret = CL_SUCCESS;
+        block_mem[b] = clCreateSubBuffer(arenas_[block.arena], CL_MEM_READ_WRITE, CL_BUFFER_CREATE_TYPE_REGION,
+                                         &region, &ret);
+        if (CL_SUCCESS != ret) {
+            LOGE("clCreateSubBuffer at %zu of arena %d failed: %d", block.offset, block.arena, ret);
+            return ret;
+        }
+        sub_buffers_.push_back(block_mem[b]);
+    }
+    for (int t = 0; t < num_tensors; ++t) {
+        if (tensors_[t].kind == OP_TENSOR_INTERMEDIATE) {
+            tensors_[t].mem = block_mem[block_of[tensors_[t].root]];
+        }
+    }
+    return CL_SUCCESS;
+}
+
+cl_int OpGraph::compile(bool share_memory) {
+    if (compiled_) {
+        LOGE("The op graph is already compiled.");
+        return CL_INVALID_OPERATION;
+    }
+    for (std::size_t t = 0; t < tensors_.size(); ++t) {
+        if (tensors_[t].kind == OP_TENSOR_OUTPUT && tensors_[t].producer < 0) {
+            LOGW("Output %zu is never written.", t);
+        }
+    }
+    cl_int ret = schedule_ops();
+    if (CL_SUCCESS == ret) {
+        ret = plan_memory(share_memory);
+    }
+    if (CL_SUCCESS != ret) {
+        release_memory();
+        for (std::size_t t = 0; t < tensors_.size(); ++t) {
+            tensors_[t].root = (int)t;
+        }
+        for (Op &op : ops_) {
+            op.in_place = false;
+        }
+        return ret;
+    }
+    compiled_ = true;
+    return CL_SUCCESS;
+}
+
+cl_int OpGraph::bind(int tensor, cl_mem mem) {
+    if (!valid_tensor(tensor) || tensors_[tensor].kind == OP_TENSOR_INTERMEDIATE) {
+        LOGE("Tensor %d cannot be bound.", tensor);
+        return CL_INVALID_VALUE;
+    }
+    tensors_[tensor].mem = mem;
+    return CL_SUCCESS;
+}
+
+Epilogue OpGraph::resolve_epilogue(const OpEpilogue &epilogue) const {
+    Epilogue resolved;
+    resolved.bias = epilogue.bias >= 0 ? tensors_[epilogue.bias].mem : NULL;
+    resolved.scale = epilogue.scale;
+    resolved.residual = epilogue.residual >= 0 ? tensors_[epilogue.residual].mem : NULL;
+    resolved.activation = epilogue.activation;
+    return resolved;
+}
+
+cl_int OpGraph::enqueue_op(const Op &op, cl_uint num_wait, const cl_event *wait_list, cl_event *event,
+                           cl_command_queue queue) {
+    const Epilogue epilogue = resolve_epilogue(op.epilogue);
+    cl_mem out = tensors_[op.output].mem;
+    switch (op.type) {
+        case OP_GEMM:
+            return enqueue_gemm_fp16(op.trans_a, op.trans_b, op.M, op.N, op.K, tensors_[op.inputs[0]].mem,
+                                     tensors_[op.inputs[1]].mem, out, num_wait, wait_list, event, queue, epilogue);
+        case OP_DECONV:
+            return enqueue_deconv_fp16(op.deconv, tensors_[op.inputs[0]].dims, tensors_[op.output].dims.c,
+                                       tensors_[op.inputs[0]].mem, tensors_[op.inputs[1]].mem, out, num_wait,
+                                       wait_list, event, queue, epilogue);
+        case OP_ELEMENTWISE: {
+            const TensorInfo &in = tensors_[op.inputs[0]];
+            if (!op.in_place) {
+                TraceSpan span(queue, epilogue.empty() ? event : NULL);
+                cl_int ret = clEnqueueCopyBuffer(queue, in.mem, out, 0, 0, in.bytes, num_wait, wait_list,
+                                                 span.event());
+                span.transfer(ret, "copy", in.bytes);
+                if (CL_SUCCESS != ret || epilogue.empty()) {
+                    return ret;
+                }
+                num_wait = 0;
+                wait_list = NULL;
+            } else if (epilogue.empty()) {
+                return num_wait || event ? clEnqueueMarkerWithWaitList(queue, num_wait, wait_list, event) : CL_SUCCESS;
+            }
+            return enqueue_epilogue_fp16(tensors_[op.output].dims, out, epilogue, num_wait, wait_list, event, queue);
+        }
+    }
+    return CL_INVALID_OPERATION;
+}
+
+cl_int OpGraph::run(cl_uint num_wait, const cl_event *wait_list, cl_event *event, cl_command_queue queue) {
+    if (!compiled_) {
+        LOGE("Compile the op graph before running it.");
+        return CL_INVALID_OPERATION;
+    }
+    if (!queue) {
+        queue = clrt().profile_queue();
+    }
+    cl_command_queue_properties props = 0;
+    clGetCommandQueueInfo(queue, CL_QUEUE_PROPERTIES, sizeof(props), &props, NULL);
+    if (props & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) {
+        LOGE("Op graphs need an in-order queue.");
+        return CL_INVALID_COMMAND_QUEUE;
+    }
+    for (std::size_t t = 0; t < tensors_.size(); ++t) {
+        if (!tensors_[t].mem) {
+            LOGE("Tensor %zu is not bound.", t);
+            return CL_INVALID_MEM_OBJECT;
+        }
+    }
+    TraceRange range("op graph run");
+    if (schedule_.empty()) {
+        return num_wait || event ? clEnqueueMarkerWithWaitList(queue, num_wait, wait_list, event) : CL_SUCCESS;
+    }
+    cl_int ret = CL_SUCCESS;
+    for (std::size_t step = 0; step < schedule_.size() && CL_SUCCESS == ret; ++step) {
+        const bool first = step == 0;
+        const bool last = step + 1 == schedule_.size();
+        ret = enqueue_op(ops_[schedule_[step]], first ? num_wait : 0, first ? wait_list : NULL,
+                         last ? event : NULL, queue);
+        if (CL_SUCCESS != ret) {
+            LOGE("Op %d failed: %d", schedule_[step], ret);
+        }
+    }
+    // for release_memory(), also after a failure: earlier ops are queued
+    cl_event done = NULL;
+    cl_int marker_ret = clEnqueueMarkerWithWaitList(queue, 0, NULL, &done);
+    if (CL_SUCCESS == marker_ret) {
+        if (last_run_) {
+            clReleaseEvent(last_run_);
+        }
+        last_run_ = done;
+    } else {
+        // no event to wait on later, wait now
+        clFinish(queue);
+    }
+    return ret;
+}
+
+}  // namespace abc
@@ -0,0 +1,175 @@
+#include "program_cache.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "log.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "program_cache"
+
+namespace abc {
+
+static const char kCacheMagic[4] = {'O', 'C', 'L', 'B'};
+static const uint32_t kCacheVersion = 1;
+
+uint64_t fnv1a64(const void *data, std::size_t len, uint64_t seed) {
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+    uint64_t h = seed;
+    for (std::size_t i = 0; i < len; ++i) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static std::string to_hex(uint64_t v) {
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)v);
+    return std::string(buf);
+}
+
+static bool make_dirs(const std::string &dir) {
+    std::string cur;
+    for (std::size_t i = 0; i <= dir.size(); ++i) {
+        if (i == dir.size() || dir[i] == '/') {
+            if (!cur.empty() && mkdir(cur.c_str(), 0755) != 0 && errno != EEXIST) {
+                return false;
+            }
+        }
+        if (i < dir.size()) {
+            cur += dir[i];
+        }
+    }
+    return true;
+}
+
+ProgramCache::ProgramCache() {
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+void ProgramCache::set_dir(const std::string &dir) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    dir_ = dir;
+    while (dir_.size() > 1 && dir_[dir_.size() - 1] == '/') {
+        dir_.erase(dir_.size() - 1);
+    }
+    if (!dir_.empty() && !make_dirs(dir_)) {
+        LOGW("Failed to create program cache dir %s, cache disabled.", dir_.c_str());
+        dir_.clear();
+    }
+}
+
+std::string ProgramCache::make_key(const std::string &device_name,
+                                   const std::string &driver_version,
+                                   const std::string &source,
+                                   const std::string &options) const {
+    std::string key = device_name;
+    key += '\n';
+    key += driver_version;
+    key += '\n';
+    key += options;
+    key += '\n';
+    key += to_hex(fnv1a64(source.data(), source.size()));
+    key += ':';
+    key += std::to_string(source.size());
+    return key;
+}
+
+std::string ProgramCache::path_of(const std::string &key) const {
+    return dir_ + "/" + to_hex(fnv1a64(key.data(), key.size())) + ".clbin";
+}
+
+bool ProgramCache::load(const std::string &key, std::vector<unsigned char> *binary) {
+    if (!enabled()) {
+        return false;
+    }
+    FILE *f = fopen(path_of(key).c_str(), "rb");
+    if (!f) {
+        return false;
+    }
+    bool ok = false;
+    char magic[4];
+    uint32_t version = 0;
+    uint64_t key_len = 0, bin_len = 0;
+    if (fread(magic, 1, 4, f) == 4 && memcmp(magic, kCacheMagic, 4) == 0 &&
+        fread(&version, sizeof(version), 1, f) == 1 && version == kCacheVersion &&
+        fread(&key_len, sizeof(key_len), 1, f) == 1 && key_len == key.size()) {
+        std::string stored(key_len, '\0');
+        if (fread(&stored[0], 1, key_len, f) == key_len && stored == key &&
+            fread(&bin_len, sizeof(bin_len), 1, f) == 1 && bin_len > 0) {
+            binary->resize(bin_len);
+            ok = fread(binary->data(), 1, bin_len, f) == bin_len;
+        }
+    }
+    fclose(f);
+    if (!ok) {
+        binary->clear();
+    }
+    return ok;
+}
+
+bool ProgramCache::store(const std::string &key, const std::vector<unsigned char> &binary) {
+    if (!enabled() || binary.empty()) {
+        return false;
+    }
+    // write to a private temp file and rename it into place, so concurrent
+    // processes never observe a partially written entry.
+    std::string path = path_of(key);
+    std::string tmp = path + "." + std::to_string((long long)getpid()) + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (!f) {
+        LOGW("Failed to open %s for writing.", tmp.c_str());
+        return false;
+    }
+    uint64_t key_len = key.size(), bin_len = binary.size();
+    bool ok = fwrite(kCacheMagic, 1, 4, f) == 4 &&
+              fwrite(&kCacheVersion, sizeof(kCacheVersion), 1, f) == 1 &&
+              fwrite(&key_len, sizeof(key_len), 1, f) == 1 &&
+              fwrite(key.data(), 1, key_len, f) == key_len &&
+              fwrite(&bin_len, sizeof(bin_len), 1, f) == 1 &&
+              fwrite(binary.data(), 1, bin_len, f) == bin_len;
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        LOGW("Failed to write program cache entry %s.", path.c_str());
+        unlink(tmp.c_str());
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.stores++;
+    return true;
+}
+
+void ProgramCache::remove(const std::string &key) {
+    if (enabled()) {
+        unlink(path_of(key).c_str());
+    }
+}
+
+void ProgramCache::record_hit() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.hits++;
+}
+
+void ProgramCache::record_miss() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.misses++;
+}
+
+void ProgramCache::record_stale() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.stale++;
+}
+
+ProgramCacheStats ProgramCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+}  // namespace abc
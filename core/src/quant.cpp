@@ -0,0 +1,196 @@
+#include "quant.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "cl_runtime.h"
+#include "log.h"
+#include "utils.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "quant"
+
+namespace abc {
+
+QuantParams make_quant_params(float scale, int zero_point) {
+    QuantParams params;
+    params.scales.push_back(scale);
+    params.zero_points.push_back(zero_point);
+    return params;
+}
+
+static void range_to_params(float lo, float hi, bool symmetric, float *scale, int *zero_point) {
+    if (symmetric) {
+        float amax = std::max(fabsf(lo), fabsf(hi));
+        *scale = amax > 0 ? amax / 127.0f : 1.0f;
+        *zero_point = 0;
+        return;
+    }
+    // the range must hold 0 exactly so zero padding stays exact
+    lo = std::min(lo, 0.0f);
+    hi = std::max(hi, 0.0f);
+    if (hi == lo) {
+        *scale = 1.0f;
+        *zero_point = 0;
+        return;
+    }
+    *scale = (hi - lo) / 255.0f;
+    *zero_point = std::min(127, std::max(-128, (int)nearbyintf(-128.0f - lo / *scale)));
+}
+
+QuantParams choose_quant_params(std::size_t outer, int channels, std::size_t inner, const float *data,
+                                bool symmetric) {
+    std::vector<float> lo(channels, 0.0f), hi(channels, 0.0f);
+    for (std::size_t o = 0; o < outer; ++o) {
+        for (int c = 0; c < channels; ++c) {
+            const float *p = data + (o * channels + c) * inner;
+            for (std::size_t i = 0; i < inner; ++i) {
+                lo[c] = std::min(lo[c], p[i]);
+                hi[c] = std::max(hi[c], p[i]);
+            }
+        }
+    }
+    QuantParams params;
+    params.scales.resize(channels);
+    params.zero_points.resize(channels);
+    for (int c = 0; c < channels; ++c) {
+        range_to_params(lo[c], hi[c], symmetric, &params.scales[c], &params.zero_points[c]);
+    }
+    return params;
+}
+
+void quantize_int8(std::size_t outer, int channels, std::size_t inner, const float *src, const QuantParams &params,
+                   int8_t *dst) {
+    for (std::size_t o = 0; o < outer; ++o) {
+        for (int c = 0; c < channels; ++c) {
+            const float inv_scale = 1.0f / params.scale(c);
+            const int zero_point = params.zero_point(c);
+            const std::size_t base = (o * channels + c) * inner;
+            for (std::size_t i = 0; i < inner; ++i) {
+                int q = (int)nearbyintf(src[base + i] * inv_scale) + zero_point;
+                dst[base + i] = (int8_t)std::min(127, std::max(-128, q));
+            }
+        }
+    }
+}
+
+void dequantize_int8(std::size_t outer, int channels, std::size_t inner, const int8_t *src,
+                     const QuantParams &params, float *dst) {
+    for (std::size_t o = 0; o < outer; ++o) {
+        for (int c = 0; c < channels; ++c) {
+            const float scale = params.scale(c);
+            const int zero_point = params.zero_point(c);
+            const std::size_t base = (o * channels + c) * inner;
+            for (std::size_t i = 0; i < inner; ++i) {
+                dst[base + i] = scale * (src[base + i] - zero_point);
+            }
+        }
+    }
+}
+
+std::vector<int32_t> int8_channel_sums(std::size_t outer, int channels, std::size_t inner, const int8_t *data) {
+    std::vector<int32_t> sums(channels, 0);
+    for (std::size_t o = 0; o < outer; ++o) {
+        for (int c = 0; c < channels; ++c) {
+            const int8_t *p = data + (o * channels + c) * inner;
+            for (std::size_t i = 0; i < inner; ++i) {
+                sums[c] += p[i];
+            }
+        }
+    }
+    return sums;
+}
+
+cl_int create_int8_requant(int channels, const QuantParams &input, const QuantParams &weight,
+                           const QuantParams &output, const float *bias, const int32_t *weight_sums,
+                           ActivationType activation, Int8Requant *requant) {
+    if (input.empty() || weight.empty() || output.empty() || input.per_channel() || output.per_channel() ||
+        (weight.per_channel() && (int)weight.scales.size() != channels)) {
+        LOGE("Int8 requant needs per-tensor input/output and per-tensor or %d-channel weight params.", channels);
+        return CL_INVALID_VALUE;
+    }
+    for (int zero_point : weight.zero_points) {
+        if (zero_point != 0) {
+            LOGE("Int8 weights must be quantized symmetrically.");
+            return CL_INVALID_VALUE;
+        }
+    }
+    const float s_out = output.scale(0);
+    const int zp_in = input.zero_point(0), zp_out = output.zero_point(0);
+    requant->act_min = -128;
+    requant->act_max = 127;
+    if (activation == ACT_RELU || activation == ACT_RELU6) {
+        requant->act_min = std::max(-128, zp_out);
+    }
+    if (activation == ACT_RELU6) {
+        requant->act_max = std::min(127, zp_out + (int)nearbyintf(6.0f / s_out));
+    } else if (activation == ACT_GELU) {
+        LOGE("GELU is not supported by the int8 epilogue.");
+        return CL_INVALID_VALUE;
+    }
+
+    std::vector<float> multiplier(channels), offset(channels);
+    for (int c = 0; c < channels; ++c) {
+        multiplier[c] = input.scale(0) * weight.scale(c) / s_out;
+        offset[c] = (bias ? bias[c] / s_out : 0.0f) + zp_out;
+        if (weight_sums) {
+            offset[c] -= multiplier[c] * zp_in * (float)weight_sums[c];
+        }
+    }
+    cl_int ret = CL_SUCCESS;
+    const std::size_t bytes = channels * sizeof(float);
+    requant->multiplier = clCreateBuffer(clrt().context(), CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, bytes,
+                                         multiplier.data(), &ret);
+    if (CL_SUCCESS == ret) {
+        requant->offset = clCreateBuffer(clrt().context(), CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, bytes,
+                                         offset.data(), &ret);
+    }
+    if (CL_SUCCESS != ret) {
+        LOGE("Failed to allocate the requant buffers: %d", ret);
+        release_int8_requant(requant);
+    }
+    return ret;
+}
+
+void release_int8_requant(Int8Requant *requant) {
+    if (requant->multiplier) {
+        clReleaseMemObject(requant->multiplier);
+        requant->multiplier = NULL;
+    }
+    if (requant->offset) {
+        clReleaseMemObject(requant->offset);
+        requant->offset = NULL;
+    }
+}
+
+cl_int set_int8_requant_args(cl_kernel kernel, cl_uint first_arg, const Int8Requant &requant) {
+    cl_int ret = set_kernel_arg(kernel, first_arg, requant.multiplier);
+    if (CL_SUCCESS == ret) {
+        ret = set_kernel_arg(kernel, first_arg + 1, requant.offset);
+    }
+    if (CL_SUCCESS == ret) {
+        ret = set_kernel_arg(kernel, first_arg + 2, requant.act_min);
+    }
+    if (CL_SUCCESS == ret) {
+        ret = set_kernel_arg(kernel, first_arg + 3, requant.act_max);
+    }
+    if (CL_SUCCESS != ret) {
+        LOGE("Failed to set requant arguments: %d", ret);
+    }
+    return ret;
+}
+
+std::string int8_build_options() {
+    if (clrt().has_extension("cl_arm_integer_dot_product_accumulate_int8")) {
+        return " -DINT8_DOT=2";
+    }
+    if (clrt().has_extension("cl_arm_integer_dot_product_int8")) {
+        return " -DINT8_DOT=1";
+    }
+    return " -DINT8_DOT=0";
+}
+
+}  // namespace abc
@@ -0,0 +1,290 @@
+#include "roofline.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <vector>
+
+#include "cl_kernel_source.h"
+#include "cl_runtime.h"
+#include "log.h"
+#include "utils.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "roofline"
+
+namespace abc {
+
+static const int kReps = 5;
+static const int kUnroll = 4;      // UNROLL in roofline.cl
+static const int kBwItems = 16;    // BW_ITEMS
+static const int kLocalWG = 64;    // LOCAL_WG
+static const int kPeakIters = 256;
+
+// Best device time of reps launches after one warmup.
+static cl_int time_kernel(cl_kernel kernel, size_t global, const size_t *local, double *best_ns) {
+    *best_ns = -1;
+    for (int r = 0; r <= kReps; ++r) {
+        cl_event event = NULL;
+        cl_int ret = enqueue_kernel_async(kernel, 1, &global, local, 0, NULL, &event);
+        if (CL_SUCCESS != ret) {
+            return ret;
+        }
+        clWaitForEvents(1, &event);
+        double ns = get_cl_exec_time(event);
+        clReleaseEvent(event);
+        if (r > 0 && (*best_ns < 0 || ns < *best_ns)) {
+            *best_ns = ns;
+        }
+    }
+    return CL_SUCCESS;
+}
+
+static cl_kernel create_probe(const char *name, cl_int *err_ret) {
+    cl_kernel kernel = clrt().create_kernel(name, get_cl_kernel_source("roofline"), NULL, err_ret);
+    if (CL_SUCCESS != *err_ret) {
+        LOGE("create_kernel %s failed.", name);
+        return NULL;
+    }
+    return kernel;
+}
+
+template <typename S>
+static cl_int probe_peak(const char *name, int lanes, size_t global, S b, S c, cl_mem out, double *gops) {
+    cl_int ret = CL_SUCCESS;
+    cl_kernel kernel = create_probe(name, &ret);
+    if (!kernel) {
+        return ret;
+    }
+    ret = set_kernel_args(kernel, kPeakIters, b, c, out);
+    size_t local = kLocalWG;
+    double ns = 0;
+    if (CL_SUCCESS == ret) {
+        ret = time_kernel(kernel, global, &local, &ns);
+    } else {
+        LOGE("Failed to set %s arguments: %d", name, ret);
+    }
+    clrt().release_kernel(kernel);
+    if (CL_SUCCESS == ret) {
+        *gops = (double)global * kPeakIters * kUnroll * 8 * lanes * 2 / ns;
+        LOGI("%-14s %10.2f GOPS", name, *gops);
+    }
+    return ret;
+}
+
+// Bandwidth of a bw_* kernel, moving bytes_per_item per float4 slot.
+// args_ret is the result of setting its arguments; the kernel is released
+// either way.
+static cl_int probe_bandwidth(cl_kernel kernel, cl_int args_ret, const char *name, size_t items, int bytes_per_item,
+                              double *gbps) {
+    size_t global = items / kBwItems;
+    double ns = 0;
+    cl_int ret = args_ret;
+    if (CL_SUCCESS == ret) {
+        ret = time_kernel(kernel, global, NULL, &ns);
+    } else {
+        LOGE("Failed to set %s arguments: %d", name, ret);
+    }
+    clrt().release_kernel(kernel);
+    if (CL_SUCCESS == ret) {
+        *gbps = (double)items * bytes_per_item / ns;
+        LOGI("%-14s %10.2f GB/s", name, *gbps);
+    }
+    return ret;
+}
+
+cl_int probe_roofline(RooflineProfile *profile) {
+    cl_device_id device = clrt().device_id();
+    cl_uint compute_units = 1;
+    cl_ulong max_alloc = 0;
+    clGetDeviceInfo(device, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(compute_units), &compute_units, NULL);
+    clGetDeviceInfo(device, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(max_alloc), &max_alloc, NULL);
+    profile->device = clrt().device_name();
+    LOGI("probing %s: %u compute units", profile->device.c_str(), compute_units);
+
+    // enough work-groups to fill every compute unit several times over
+    const size_t peak_global = (size_t)std::max(compute_units, 1u) * 2048;
+    // float4 slots per buffer, a multiple of BW_ITEMS and large enough to
+    // spill every cache
+    size_t bw_bytes = 64 << 20;
+    if (max_alloc > 0 && bw_bytes > max_alloc / 2) {
+        bw_bytes = max_alloc / 2;
+    }
+    const size_t items = bw_bytes / 16 / (kBwItems * kLocalWG) * (kBwItems * kLocalWG);
+
+    cl_int ret = CL_SUCCESS;
+    cl_context context = clrt().context();
+    cl_mem out = clCreateBuffer(context, CL_MEM_READ_WRITE, peak_global * sizeof(cl_float), NULL, &ret);
+    cl_mem src = CL_SUCCESS == ret ? clCreateBuffer(context, CL_MEM_READ_WRITE, items * 16, NULL, &ret) : NULL;
+    cl_mem dst = CL_SUCCESS == ret ? clCreateBuffer(context, CL_MEM_READ_WRITE, items * 16, NULL, &ret) : NULL;
+    if (CL_SUCCESS != ret) {
+        LOGE("Failed to allocate probe buffers: %d", ret);
+    }
+
+    if (CL_SUCCESS == ret) {
+        ret = probe_peak<cl_float>("peak_mad_fp32", 4, peak_global, 0.999f, 0.001f, out, &profile->fp32_gflops);
+    }
+    if (CL_SUCCESS == ret) {
+        ret = probe_peak<cl_half>("peak_mad_fp16", 8, peak_global, 0x3bff, 0x1419, out, &profile->fp16_gflops);
+    }
+    if (CL_SUCCESS == ret) {
+        ret = probe_peak<cl_char>("peak_mad_int8", 16, peak_global, 3, 1, out, &profile->int8_gops);
+    }
+    if (CL_SUCCESS == ret) {
+        cl_float zero = 0;
+        ret = clEnqueueFillBuffer(clrt().profile_queue(), src, &zero, sizeof(zero), 0, items * 16, 0, NULL, NULL);
+    }
+
+    cl_kernel kernel = NULL;
+    if (CL_SUCCESS == ret && (kernel = create_probe("bw_read", &ret))) {
+        ret = probe_bandwidth(kernel, set_kernel_args(kernel, src, -1.0f, out), "bw_read", items, 16,
+                              &profile->read_gbps);
+    }
+    if (CL_SUCCESS == ret && (kernel = create_probe("bw_write", &ret))) {
+        ret = probe_bandwidth(kernel, set_kernel_args(kernel, 1.0f, dst), "bw_write", items, 16,
+                              &profile->write_gbps);
+    }
+    if (CL_SUCCESS == ret && (kernel = create_probe("bw_copy", &ret))) {
+        ret = probe_bandwidth(kernel, set_kernel_args(kernel, src, dst), "bw_copy", items, 32,
+                              &profile->copy_gbps);
+    }
+    if (CL_SUCCESS == ret && (kernel = create_probe("bw_local", &ret))) {
+        ret = set_kernel_args(kernel, kPeakIters, out);
+        size_t local = kLocalWG;
+        double ns = 0;
+        if (CL_SUCCESS == ret) {
+            ret = time_kernel(kernel, peak_global, &local, &ns);
+        } else {
+            LOGE("Failed to set bw_local arguments: %d", ret);
+        }
+        clrt().release_kernel(kernel);
+        if (CL_SUCCESS == ret) {
+            profile->local_gbps = (double)peak_global * kPeakIters * 8 * 16 / ns;
+            LOGI("%-14s %10.2f GB/s", "bw_local", profile->local_gbps);
+        }
+    }
+    if (CL_SUCCESS == ret && (kernel = create_probe("empty_kernel", &ret))) {
+        ret = set_kernel_args(kernel, out);
+        if (CL_SUCCESS != ret) {
+            LOGE("Failed to set empty_kernel arguments: %d", ret);
+        }
+        const int launches = 50;
+        std::vector<double> us;
+        size_t global = 1;
+        for (int r = 0; r <= launches && CL_SUCCESS == ret; ++r) {
+            auto t0 = std::chrono::steady_clock::now();
+            ret = enqueue_kernel_async(kernel, 1, &global, NULL, 0, NULL, NULL);
+            clFinish(clrt().profile_queue());
+            auto t1 = std::chrono::steady_clock::now();
+            if (r > 0) {
+                us.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+            }
+        }
+        clrt().release_kernel(kernel);
+        if (CL_SUCCESS == ret) {
+            std::sort(us.begin(), us.end());
+            profile->launch_us = us[us.size() / 2];
+            LOGI("%-14s %10.2f us", "launch", profile->launch_us);
+        }
+    }
+
+    cl_mem mems[] = {out, src, dst};
+    for (cl_mem mem : mems) {
+        if (mem) {
+            clReleaseMemObject(mem);
+        }
+    }
+    return ret;
+}
+
+cl_int save_roofline_profile(const std::string &path, const RooflineProfile &profile) {
+    std::ofstream out(path.c_str(), std::ios::trunc);
+    if (!out) {
+        LOGE("Failed to open roofline profile %s", path.c_str());
+        return CL_INVALID_VALUE;
+    }
+    out << "# oclabc roofline profile\n";
+    out << "device\t" << profile.device << '\n';
+    out << "fp32_gflops\t" << profile.fp32_gflops << '\n';
+    out << "fp16_gflops\t" << profile.fp16_gflops << '\n';
+    out << "int8_gops\t" << profile.int8_gops << '\n';
+    out << "read_gbps\t" << profile.read_gbps << '\n';
+    out << "write_gbps\t" << profile.write_gbps << '\n';
+    out << "copy_gbps\t" << profile.copy_gbps << '\n';
+    out << "local_gbps\t" << profile.local_gbps << '\n';
+    out << "launch_us\t" << profile.launch_us << '\n';
+    return out ? CL_SUCCESS : CL_INVALID_VALUE;
+}
+
+cl_int load_roofline_profile(const std::string &path, RooflineProfile *profile) {
+    std::ifstream in(path.c_str());
+    if (!in) {
+        LOGE("Failed to open roofline profile %s", path.c_str());
+        return CL_INVALID_VALUE;
+    }
+    struct Field {
+        const char *key;
+        double *value;
+    };
+    Field fields[] = {{"fp32_gflops", &profile->fp32_gflops}, {"fp16_gflops", &profile->fp16_gflops},
+                      {"int8_gops", &profile->int8_gops},     {"read_gbps", &profile->read_gbps},
+                      {"write_gbps", &profile->write_gbps},   {"copy_gbps", &profile->copy_gbps},
+                      {"local_gbps", &profile->local_gbps},   {"launch_us", &profile->launch_us}};
+    std::string line;
+    while (std::getline(in, line)) {
+        std::size_t tab = line.find('\t');
+        if (line.empty() || line[0] == '#' || tab == std::string::npos) {
+            continue;
+        }
+        std::string key = line.substr(0, tab);
+        std::string value = line.substr(tab + 1);
+        if (key == "device") {
+            profile->device = value;
+        }
+        for (const Field &f : fields) {
+            if (key == f.key) {
+                *f.value = atof(value.c_str());
+            }
+        }
+    }
+    if (!profile->valid()) {
+        LOGE("Roofline profile %s is incomplete.", path.c_str());
+        return CL_INVALID_VALUE;
+    }
+    return CL_SUCCESS;
+}
+
+double roofline_peak_gops(const RooflineProfile &profile, RooflineDataType type) {
+    switch (type) {
+        case ROOFLINE_FP32: return profile.fp32_gflops;
+        case ROOFLINE_INT8: return profile.int8_gops;
+        default: return profile.fp16_gflops;
+    }
+}
+
+double roofline_attainable_gops(const RooflineProfile &profile, RooflineDataType type, double flops,
+                                double bytes) {
+    double peak = roofline_peak_gops(profile, type);
+    if (bytes <= 0) {
+        return peak;
+    }
+    return std::min(peak, flops / bytes * profile.copy_gbps);
+}
+
+double roofline_percent(const RooflineProfile &profile, RooflineDataType type, double flops, double bytes,
+                        double ns) {
+    if (!profile.valid() || ns <= 0) {
+        return 0;
+    }
+    if (flops <= 0) {
+        // pure data movement: share of the copy bandwidth
+        return bytes > 0 ? 100.0 * (bytes / ns) / profile.copy_gbps : 0;
+    }
+    return 100.0 * (flops / ns) / roofline_attainable_gops(profile, type, flops, bytes);
+}
+
+}  // namespace abc
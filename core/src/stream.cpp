@@ -0,0 +1,79 @@
+#include "stream.h"
+
+#include "log.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "stream"
+
+namespace abc {
+
+Stream::Stream(cl_context context, cl_device_id device, unsigned flags, cl_int *err_ret)
+    : queue_(NULL), flags_(flags) {
+    cl_command_queue_properties props = 0;
+    if (flags & STREAM_OUT_OF_ORDER) {
+        props |= CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE;
+    }
+    if (flags & STREAM_PROFILING) {
+        props |= CL_QUEUE_PROFILING_ENABLE;
+    }
+    cl_queue_properties properties[] = {CL_QUEUE_PROPERTIES, props, 0};
+    queue_ = clCreateCommandQueueWithProperties(context, device, properties, err_ret);
+    if (*err_ret != CL_SUCCESS && (flags & STREAM_OUT_OF_ORDER)) {
+        LOGW("Out-of-order queues unsupported (%d), using an in-order queue.", *err_ret);
+        flags_ &= ~STREAM_OUT_OF_ORDER;
+        properties[1] = props & ~(cl_queue_properties)CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE;
+        queue_ = clCreateCommandQueueWithProperties(context, device, properties, err_ret);
+    }
+    if (*err_ret != CL_SUCCESS) {
+        LOGE("Failed to create command queue: %d", *err_ret);
+        queue_ = NULL;
+    }
+}
+
+Stream::~Stream() {
+    if (queue_) {
+        clReleaseCommandQueue(queue_);
+        queue_ = NULL;
+    }
+}
+
+cl_int Stream::record(cl_event *event) {
+    cl_int ret = clEnqueueMarkerWithWaitList(queue_, 0, NULL, event);
+    if (CL_SUCCESS != ret) {
+        LOGE("clEnqueueMarkerWithWaitList failed: %d", ret);
+    }
+    return ret;
+}
+
+cl_int Stream::wait(cl_event event) {
+    cl_int ret = clEnqueueBarrierWithWaitList(queue_, 1, &event, NULL);
+    if (CL_SUCCESS != ret) {
+        LOGE("clEnqueueBarrierWithWaitList failed: %d", ret);
+    }
+    return ret;
+}
+
+cl_int Stream::wait(Stream *other) {
+    cl_event event = NULL;
+    cl_int ret = other->record(&event);
+    if (CL_SUCCESS != ret) {
+        return ret;
+    }
+    // the marker has to reach the device before another queue can wait on it
+    other->flush();
+    ret = wait(event);
+    clReleaseEvent(event);
+    return ret;
+}
+
+cl_int Stream::flush() {
+    return clFlush(queue_);
+}
+
+cl_int Stream::finish() {
+    return clFinish(queue_);
+}
+
+}  // namespace abc
@@ -1,6 +1,10 @@
 #include "tensor.h"
+
+#include <vector>
+
 #include "log.h"
 #include "half_float.h"
+#include "tensor_file.h"
 
 #ifdef TAG
 #undef TAG
@@ -9,12 +13,53 @@
 
 namespace abc {
 
+Tensor::Tensor(Tensor &&other)
+    : dims(other.dims), hostptr(other.hostptr), gptr(other.gptr),
+      mem_type(other.mem_type), host_backing(other.host_backing), dtype(other.dtype),
+      quant(std::move(other.quant)), runtime(other.runtime) {
+    other.hostptr = nullptr;
+    other.gptr = nullptr;
+    other.host_backing = nullptr;
+}
+
+static void CL_CALLBACK free_aligned_backing(cl_mem, void *backing) {
+    free(backing);
+}
+
+static void CL_CALLBACK delete_mapped_file(cl_mem, void *file) {
+    delete reinterpret_cast<MappedTensorFile *>(file);
+}
+
 Tensor::~Tensor() {
     if (hostptr) {
         delete[] reinterpret_cast<char *>(hostptr);
     }
+    CLRuntime &rt = runtime ? *runtime : clrt();
+    const bool svm = mem_type == TENSOR_MEM_SVM_FINE || mem_type == TENSOR_MEM_SVM_COARSE;
+    void(CL_CALLBACK * free_backing)(cl_mem, void *) =
+        mem_type == TENSOR_MEM_MAPPED_FILE ? delete_mapped_file : free_aligned_backing;
+    if (host_backing && gptr && !svm) {
+        // commands enqueued on gptr may still use the host memory; it goes
+        // once the buffer is destroyed, or after the queues drain
+        if (CL_SUCCESS == clSetMemObjectDestructorCallback(gptr, free_backing, host_backing)) {
+            host_backing = nullptr;
+        } else {
+            rt.finish();
+        }
+    }
     if (gptr) {
-        clReleaseMemObject(gptr);
+        if (mem_type == TENSOR_MEM_DEVICE) {
+            rt.mem_pool().release(gptr);
+        } else {
+            clReleaseMemObject(gptr);
+        }
+    }
+    if (host_backing) {
+        if (svm) {
+            rt.enqueue_svm_free(host_backing);
+        } else {
+            free_backing(NULL, host_backing);
+        }
     }
 }
 
@@ -22,23 +67,215 @@ std::size_t Tensor::num_elem() {
     return (std::size_t)(dims.n) * (std::size_t)(dims.c) * (std::size_t)(dims.h) * (std::size_t)(dims.w);
 }
 
-Tensor make_4d_tensor(const dims4d &dims) {
+Tensor make_4d_tensor(const dims4d &dims, TensorDataType dtype) {
     Tensor t;
     t.dims = dims;
+    t.dtype = dtype;
     return t;
 }
 
 void alloc_tensor_host_mem(Tensor *t) {
-    t->hostptr = new char[sizeof(cl_half) * t->num_elem()];
+    t->hostptr = new char[t->bytes()];
 }
 
 cl_int alloc_tensor_cl_mem(Tensor *t) {
     cl_int ret = CL_SUCCESS;
-    std::size_t bytes = t->num_elem() * sizeof(cl_half);
-    t->gptr = clCreateBuffer(clrt().context(), CL_MEM_READ_WRITE, bytes, NULL, &ret);
+    std::size_t bytes = t->bytes();
+    t->runtime = &clrt();
+    t->gptr = t->runtime->mem_pool().acquire(bytes, &ret);
+    if (CL_SUCCESS != ret) {
+        LOGE("alloc_tensor_cl_mem failed. ");
+    }
+    return ret;
+}
+
+std::size_t host_ptr_alignment() {
+    // CL_MEM_USE_HOST_PTR is zero-copy only for page aligned memory on most
+    // drivers; never go below the device's base address alignment.
+    cl_uint align_bits = 0;
+    clGetDeviceInfo(clrt().device_id(), CL_DEVICE_MEM_BASE_ADDR_ALIGN, sizeof(align_bits), &align_bits, NULL);
+    std::size_t align = 4096;
+    if (align_bits / 8 > align) {
+        align = align_bits / 8;
+    }
+    return align;
+}
+
+cl_int alloc_tensor_mapped_mem(Tensor *t, TensorMemType mem_type) {
+    cl_int ret = CL_SUCCESS;
+    std::size_t bytes = t->bytes();
+    t->mem_type = mem_type;
+    t->runtime = &clrt();
+    if (mem_type == TENSOR_MEM_ALLOC_HOST_PTR) {
+        t->gptr = clCreateBuffer(clrt().context(), CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, bytes, NULL, &ret);
+    } else if (mem_type == TENSOR_MEM_USE_HOST_PTR) {
+        std::size_t align = host_ptr_alignment();
+        std::size_t padded = (bytes + align - 1) / align * align;
+        if (posix_memalign(&t->host_backing, align, padded) != 0) {
+            t->host_backing = nullptr;
+            LOGE("posix_memalign of %zu bytes failed.", padded);
+            return CL_OUT_OF_HOST_MEMORY;
+        }
+        t->gptr = clCreateBuffer(clrt().context(), CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, padded, t->host_backing, &ret);
+    } else {
+        return alloc_tensor_cl_mem(t);
+    }
+    if (CL_SUCCESS != ret) {
+        LOGE("alloc_tensor_mapped_mem failed: %d", ret);
+        t->gptr = NULL;
+    }
+    return ret;
+}
+
+cl_int alloc_tensor_svm_mem(Tensor *t) {
+    const cl_device_svm_capabilities caps = clrt().svm_capabilities();
+    if (!(caps & (CL_DEVICE_SVM_COARSE_GRAIN_BUFFER | CL_DEVICE_SVM_FINE_GRAIN_BUFFER))) {
+        LOGE("The device does not support SVM buffers.");
+        return CL_INVALID_OPERATION;
+    }
+    const bool fine = (caps & CL_DEVICE_SVM_FINE_GRAIN_BUFFER) != 0;
+    const std::size_t bytes = t->bytes();
+    cl_svm_mem_flags flags = CL_MEM_READ_WRITE | (fine ? CL_MEM_SVM_FINE_GRAIN_BUFFER : 0);
+    t->host_backing = clSVMAlloc(clrt().context(), flags, bytes, 0);
+    if (!t->host_backing) {
+        LOGE("clSVMAlloc of %zu bytes failed.", bytes);
+        return CL_OUT_OF_RESOURCES;
+    }
+    t->mem_type = fine ? TENSOR_MEM_SVM_FINE : TENSOR_MEM_SVM_COARSE;
+    t->runtime = &clrt();
+    // OpenCL 2.0 lets a USE_HOST_PTR buffer alias an SVM allocation
+    cl_int ret = CL_SUCCESS;
+    t->gptr = clCreateBuffer(clrt().context(), CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, bytes, t->host_backing, &ret);
+    if (CL_SUCCESS != ret) {
+        LOGE("clCreateBuffer over SVM failed: %d", ret);
+        t->gptr = NULL;
+    }
+    return ret;
+}
+
+void nc4hw4_image_shape(const dims4d &dims, std::size_t *width, std::size_t *height) {
+    *width = (std::size_t)((dims.c + 3) / 4) * dims.w;
+    *height = (std::size_t)dims.n * dims.h;
+}
+
+static cl_mem create_half_image(std::size_t width, std::size_t height, cl_mem_flags flags, void *host_ptr,
+                                cl_int *err_ret) {
+    std::size_t max_width = 0, max_height = 0;
+    clGetDeviceInfo(clrt().device_id(), CL_DEVICE_IMAGE2D_MAX_WIDTH, sizeof(max_width), &max_width, NULL);
+    clGetDeviceInfo(clrt().device_id(), CL_DEVICE_IMAGE2D_MAX_HEIGHT, sizeof(max_height), &max_height, NULL);
+    if (width == 0 || height == 0 || (max_width && width > max_width) || (max_height && height > max_height)) {
+        LOGE("Image %zux%zu exceeds the device limit %zux%zu.", width, height, max_width, max_height);
+        *err_ret = CL_INVALID_IMAGE_SIZE;
+        return NULL;
+    }
+    cl_image_format format = {CL_RGBA, CL_HALF_FLOAT};
+    cl_image_desc desc = {};
+    desc.image_type = CL_MEM_OBJECT_IMAGE2D;
+    desc.image_width = width;
+    desc.image_height = height;
+    cl_mem image = clCreateImage(clrt().context(), flags, &format, &desc, host_ptr, err_ret);
+    if (CL_SUCCESS != *err_ret) {
+        LOGE("clCreateImage failed: %d", *err_ret);
+        image = NULL;
+    }
+    return image;
+}
+
+cl_int alloc_tensor_image_mem(Tensor *t) {
+    if (t->dtype != TENSOR_FP16) {
+        LOGE("Only fp16 tensors can be images.");
+        return CL_INVALID_VALUE;
+    }
+    cl_int ret = CL_SUCCESS;
+    std::size_t width = 0, height = 0;
+    nc4hw4_image_shape(t->dims, &width, &height);
+    t->mem_type = TENSOR_MEM_IMAGE2D;
+    t->runtime = &clrt();
+    t->gptr = create_half_image(width, height, CL_MEM_READ_WRITE, NULL, &ret);
+    return ret;
+}
+
+cl_mem create_fp16_weight_image(int ic, int oc, int kernel_area, const void *weight, cl_int *err_ret) {
+    const int ic4 = (ic + 3) / 4 * 4;
+    const int oc4_num = (oc + 3) / 4;
+    const std::size_t width = ic4;
+    const std::size_t height = (std::size_t)kernel_area * oc4_num;
+    std::vector<cl_half> packed(width * height * 4, to_half(0.0f));
+    const cl_half *src = reinterpret_cast<const cl_half *>(weight);
+    for (int i = 0; i < ic; ++i) {
+        for (int o = 0; o < oc; ++o) {
+            for (int k = 0; k < kernel_area; ++k) {
+                std::size_t y = (std::size_t)k * oc4_num + o / 4;
+                packed[(y * width + i) * 4 + o % 4] = src[((std::size_t)i * oc + o) * kernel_area + k];
+            }
+        }
+    }
+    return create_half_image(width, height, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, packed.data(), err_ret);
+}
+
+ScopedTensorMap::ScopedTensorMap(Tensor *t, cl_map_flags flags, cl_int *err_ret)
+    : mem_(t->gptr), ptr_(nullptr), svm_(false) {
+    cl_int ret = CL_SUCCESS;
+    if (t->mem_type == TENSOR_MEM_IMAGE2D) {
+        LOGE("ScopedTensorMap does not map images.");
+        mem_ = NULL;
+        if (err_ret) {
+            *err_ret = CL_INVALID_MEM_OBJECT;
+        }
+        return;
+    }
+    std::size_t bytes = t->bytes();
+    if (t->mem_type == TENSOR_MEM_SVM_FINE) {
+        ret = clrt().finish();
+        ptr_ = CL_SUCCESS == ret ? t->host_backing : nullptr;
+        mem_ = NULL;
+    } else if (t->mem_type == TENSOR_MEM_SVM_COARSE) {
+        TraceSpan span(clrt().profile_queue(), NULL);
+        ret = clEnqueueSVMMap(clrt().profile_queue(), CL_TRUE, flags, t->host_backing, bytes, 0, NULL, span.event());
+        span.transfer(ret, "svm map", bytes);
+        if (CL_SUCCESS != ret) {
+            LOGE("clEnqueueSVMMap failed: %d", ret);
+        } else {
+            ptr_ = t->host_backing;
+            svm_ = true;
+        }
+    } else {
+        TraceSpan span(clrt().profile_queue(), NULL);
+        ptr_ = clEnqueueMapBuffer(clrt().profile_queue(), mem_, CL_TRUE, flags, 0, bytes, 0, NULL, span.event(), &ret);
+        span.transfer(ret, "map", bytes);
+        if (CL_SUCCESS != ret) {
+            LOGE("clEnqueueMapBuffer failed: %d", ret);
+            ptr_ = nullptr;
+        }
+    }
+    if (err_ret) {
+        *err_ret = ret;
+    }
+}
+
+ScopedTensorMap::~ScopedTensorMap() {
+    unmap();
+}
+
+cl_int ScopedTensorMap::unmap() {
+    if (!ptr_) {
+        return CL_SUCCESS;
+    }
+    cl_int ret = CL_SUCCESS;
+    if (svm_) {
+        TraceSpan span(clrt().profile_queue(), NULL);
+        ret = clEnqueueSVMUnmap(clrt().profile_queue(), ptr_, 0, NULL, span.event());
+        span.transfer(ret, "svm unmap", 0);
+    } else if (mem_) {
+        TraceSpan span(clrt().profile_queue(), NULL);
+        ret = clEnqueueUnmapMemObject(clrt().profile_queue(), mem_, ptr_, 0, NULL, span.event());
+        span.transfer(ret, "unmap", 0);
+    }
     if (CL_SUCCESS != ret) {
-        LOGE("clCreateBuffer failed. ");
+        LOGE("Unmapping the tensor failed: %d", ret);
     }
+    ptr_ = nullptr;
+    svm_ = false;
     return ret;
 }
 
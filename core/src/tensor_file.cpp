@@ -0,0 +1,335 @@
+#include "tensor_file.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+#include "half_convert.h"
+#include "log.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "tensor_file"
+
+namespace abc {
+
+// fp16 elements per chunk when streaming a file to the device
+static const std::size_t kStreamChunkElems = 1 << 20;
+
+std::size_t tensor_file_dtype_size(TensorFileDType dtype) {
+    return dtype == TENSOR_FILE_FP16 ? sizeof(cl_half) : sizeof(float);
+}
+
+static std::size_t round_up(std::size_t x, std::size_t align) {
+    return (x + align - 1) / align * align;
+}
+
+cl_int MappedTensorFile::open(const std::string &path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        LOGE("Failed to open tensor file %s", path.c_str());
+        return CL_INVALID_VALUE;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        LOGE("Tensor file %s is empty.", path.c_str());
+        ::close(fd);
+        return CL_INVALID_VALUE;
+    }
+    map_bytes_ = st.st_size;
+    map_ = mmap(NULL, map_bytes_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map_ == MAP_FAILED) {
+        LOGE("mmap of %s failed.", path.c_str());
+        map_ = nullptr;
+        return CL_OUT_OF_HOST_MEMORY;
+    }
+    // the data is read front to back, by the device or by the chunk loop
+    madvise(map_, map_bytes_, MADV_SEQUENTIAL);
+
+    cl_int ret = CL_INVALID_VALUE;
+    const char *bytes = static_cast<const char *>(map_);
+    if (map_bytes_ >= sizeof(TensorFileHeader) && memcmp(bytes, kTensorFileMagic, sizeof(kTensorFileMagic)) == 0) {
+        ret = parse_oclt(path);
+    } else if (map_bytes_ >= 10 && memcmp(bytes, "\x93NUMPY", 6) == 0) {
+        ret = parse_npy(path);
+    } else {
+        LOGE("%s is neither a tensor file nor a .npy array.", path.c_str());
+    }
+    if (CL_SUCCESS != ret) {
+        close();
+    }
+    return ret;
+}
+
+void MappedTensorFile::close() {
+    if (map_) {
+        munmap(map_, map_bytes_);
+    }
+    map_ = nullptr;
+    map_bytes_ = 0;
+    data_ = nullptr;
+    data_bytes_ = 0;
+}
+
+std::size_t MappedTensorFile::mapped_bytes() const {
+    if (!map_) {
+        return 0;
+    }
+    std::size_t page = sysconf(_SC_PAGESIZE);
+    return round_up(map_bytes_, page) - (static_cast<char *>(data_) - static_cast<char *>(map_));
+}
+
+cl_int MappedTensorFile::parse_oclt(const std::string &path) {
+    TensorFileHeader header;
+    memcpy(&header, map_, sizeof(header));
+    if (header.version != kTensorFileVersion || header.dtype > TENSOR_FILE_FP16) {
+        LOGE("%s: unsupported version %u or dtype %u.", path.c_str(), header.version, header.dtype);
+        return CL_INVALID_VALUE;
+    }
+    dtype_ = (TensorFileDType)header.dtype;
+    std::size_t num_elem = 1;
+    for (int i = 0; i < 4; ++i) {
+        if (header.dims[i] <= 0) {
+            LOGE("%s: bad dims.", path.c_str());
+            return CL_INVALID_VALUE;
+        }
+        num_elem *= header.dims[i];
+    }
+    dims_ = {header.dims[0], header.dims[1], header.dims[2], header.dims[3]};
+    if (header.data_bytes != num_elem * tensor_file_dtype_size(dtype_) ||
+        header.data_offset < sizeof(header) || header.data_offset > map_bytes_ ||
+        header.data_bytes > map_bytes_ - header.data_offset) {
+        LOGE("%s: data does not match the header.", path.c_str());
+        return CL_INVALID_VALUE;
+    }
+    data_ = static_cast<char *>(map_) + header.data_offset;
+    data_bytes_ = header.data_bytes;
+    return CL_SUCCESS;
+}
+
+// Header dict of a .npy file, e.g.
+//   {'descr': '<f4', 'fortran_order': False, 'shape': (8, 30, 30), }
+// Only the three keys numpy always writes are looked at.
+cl_int MappedTensorFile::parse_npy(const std::string &path) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(map_);
+    std::size_t header_start = 0, header_len = 0;
+    if (bytes[6] == 1) {
+        header_start = 10;
+        header_len = bytes[8] | bytes[9] << 8;
+    } else if ((bytes[6] == 2 || bytes[6] == 3) && map_bytes_ >= 12) {
+        header_start = 12;
+        header_len = bytes[8] | bytes[9] << 8 | bytes[10] << 16 | (std::size_t)bytes[11] << 24;
+    } else {
+        LOGE("%s: unsupported .npy version %d.", path.c_str(), bytes[6]);
+        return CL_INVALID_VALUE;
+    }
+    if (header_start + header_len > map_bytes_) {
+        LOGE("%s: truncated .npy header.", path.c_str());
+        return CL_INVALID_VALUE;
+    }
+    std::string header(reinterpret_cast<const char *>(bytes) + header_start, header_len);
+
+    std::size_t key = header.find("'descr'");
+    std::size_t open_quote = key == std::string::npos ? key : header.find('\'', header.find(':', key));
+    std::size_t close_quote = open_quote == std::string::npos ? open_quote : header.find('\'', open_quote + 1);
+    std::string descr;
+    if (close_quote != std::string::npos) {
+        descr = header.substr(open_quote + 1, close_quote - open_quote - 1);
+    }
+    // little-endian hosts only, like every device this runs on
+    if (descr == "<f4") {
+        dtype_ = TENSOR_FILE_FP32;
+    } else if (descr == "<f2") {
+        dtype_ = TENSOR_FILE_FP16;
+    } else {
+        LOGE("%s: unsupported .npy dtype '%s'.", path.c_str(), descr.c_str());
+        return CL_INVALID_VALUE;
+    }
+
+    key = header.find("'fortran_order'");
+    std::size_t value = key == std::string::npos ? key : header.find_first_not_of(" :", key + 15);
+    if (value == std::string::npos || header.compare(value, 5, "False") != 0) {
+        LOGE("%s: only C-order .npy arrays are supported.", path.c_str());
+        return CL_INVALID_VALUE;
+    }
+
+    key = header.find("'shape'");
+    std::size_t open_paren = key == std::string::npos ? key : header.find('(', key);
+    std::size_t close_paren = open_paren == std::string::npos ? open_paren : header.find(')', open_paren);
+    if (close_paren == std::string::npos) {
+        LOGE("%s: .npy header has no shape.", path.c_str());
+        return CL_INVALID_VALUE;
+    }
+    std::vector<long> shape;
+    std::string tuple = header.substr(open_paren + 1, close_paren - open_paren - 1);
+    const char *p = tuple.c_str();
+    while (*p) {
+        char *end = nullptr;
+        long v = strtol(p, &end, 10);
+        if (end == p) {
+            ++p;  // separators
+            continue;
+        }
+        shape.push_back(v);
+        p = end;
+    }
+    if (shape.size() > 4) {
+        LOGE("%s: .npy arrays of more than 4 dimensions are not supported.", path.c_str());
+        return CL_INVALID_VALUE;
+    }
+    int dims[4] = {1, 1, 1, 1};
+    std::size_t num_elem = 1;
+    for (std::size_t i = 0; i < shape.size(); ++i) {
+        if (shape[i] <= 0 || shape[i] > 0x7fffffff) {
+            LOGE("%s: bad .npy shape.", path.c_str());
+            return CL_INVALID_VALUE;
+        }
+        dims[4 - shape.size() + i] = (int)shape[i];
+        num_elem *= shape[i];
+    }
+    dims_ = {dims[0], dims[1], dims[2], dims[3]};
+
+    std::size_t offset = header_start + header_len;
+    data_bytes_ = num_elem * tensor_file_dtype_size(dtype_);
+    if (data_bytes_ > map_bytes_ - offset) {
+        LOGE("%s: truncated .npy data.", path.c_str());
+        return CL_INVALID_VALUE;
+    }
+    data_ = static_cast<char *>(map_) + offset;
+    return CL_SUCCESS;
+}
+
+cl_int save_tensor_file(const std::string &path, const dims4d &dims, TensorFileDType dtype, const void *data,
+                        std::size_t alignment) {
+    if (alignment == 0) {
+        LOGE("Tensor file alignment must be positive.");
+        return CL_INVALID_VALUE;
+    }
+    TensorFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kTensorFileMagic, sizeof(kTensorFileMagic));
+    header.version = kTensorFileVersion;
+    header.dtype = dtype;
+    header.dims[0] = dims.n;
+    header.dims[1] = dims.c;
+    header.dims[2] = dims.h;
+    header.dims[3] = dims.w;
+    header.alignment = alignment;
+    header.data_offset = round_up(sizeof(header), alignment);
+    header.data_bytes = (std::size_t)dims.n * dims.c * dims.h * dims.w * tensor_file_dtype_size(dtype);
+
+    std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out) {
+        LOGE("Failed to open tensor file %s", path.c_str());
+        return CL_INVALID_VALUE;
+    }
+    std::vector<char> padding(header.data_offset - sizeof(header), 0);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(padding.data(), padding.size());
+    out.write(static_cast<const char *>(data), header.data_bytes);
+    return out ? CL_SUCCESS : CL_INVALID_VALUE;
+}
+
+cl_int read_tensor_file_fp16(const std::string &path, std::size_t num_elem, void *f16ptr) {
+    MappedTensorFile file;
+    cl_int ret = file.open(path);
+    if (CL_SUCCESS != ret) {
+        return ret;
+    }
+    if (file.num_elem() != num_elem) {
+        LOGE("%s holds %zu elements, expected %zu.", path.c_str(), file.num_elem(), num_elem);
+        return CL_INVALID_VALUE;
+    }
+    if (file.dtype() == TENSOR_FILE_FP16) {
+        memcpy(f16ptr, file.data(), file.data_bytes());
+    } else {
+        convert_f32_to_f16(num_elem, static_cast<const float *>(file.data()), static_cast<cl_half *>(f16ptr));
+    }
+    return CL_SUCCESS;
+}
+
+// Writes the file to a pooled buffer chunk by chunk. fp32 data is converted
+// into one of two staging buffers while the other one is being written.
+static cl_int stream_tensor_file(const MappedTensorFile &file, Tensor *t) {
+    cl_int ret = alloc_tensor_cl_mem(t);
+    if (CL_SUCCESS != ret) {
+        return ret;
+    }
+    cl_command_queue queue = clrt().profile_queue();
+    const std::size_t n = file.num_elem();
+    std::vector<cl_half> staging[2];
+    cl_event pending[2] = {NULL, NULL};
+    int slot = 0;
+    for (std::size_t begin = 0; begin < n && CL_SUCCESS == ret; begin += kStreamChunkElems, slot ^= 1) {
+        std::size_t len = std::min(kStreamChunkElems, n - begin);
+        if (pending[slot]) {
+            // the slot's staging buffer is refilled below
+            clWaitForEvents(1, &pending[slot]);
+            clReleaseEvent(pending[slot]);
+            pending[slot] = NULL;
+        }
+        const void *src = static_cast<const cl_half *>(file.data()) + begin;
+        if (file.dtype() == TENSOR_FILE_FP32) {
+            staging[slot].resize(len);
+            convert_f32_to_f16(len, static_cast<const float *>(file.data()) + begin, staging[slot].data());
+            src = staging[slot].data();
+        }
+        TraceSpan span(queue, &pending[slot]);
+        ret = clEnqueueWriteBuffer(queue, t->gptr, CL_FALSE, begin * sizeof(cl_half), len * sizeof(cl_half), src, 0,
+                                   NULL, span.event());
+        span.transfer(ret, "write", len * sizeof(cl_half));
+        if (CL_SUCCESS != ret) {
+            LOGE("clEnqueueWriteBuffer failed: %d", ret);
+            pending[slot] = NULL;
+        }
+    }
+    for (cl_event event : pending) {
+        if (event) {
+            clWaitForEvents(1, &event);
+            clReleaseEvent(event);
+        }
+    }
+    return ret;
+}
+
+cl_int load_tensor_file(const std::string &path, Tensor *t) {
+    MappedTensorFile *file = new MappedTensorFile();
+    cl_int ret = file->open(path);
+    if (CL_SUCCESS != ret) {
+        delete file;
+        return ret;
+    }
+    t->dims = file->dims();
+    t->dtype = TENSOR_FP16;
+    const std::size_t align = host_ptr_alignment();
+    const std::size_t padded = round_up(file->data_bytes(), align);
+    if (file->dtype() == TENSOR_FILE_FP16 && reinterpret_cast<uintptr_t>(file->data()) % align == 0 &&
+        file->mapped_bytes() >= padded) {
+        t->gptr = clCreateBuffer(clrt().context(), CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, padded, file->data(),
+                                 &ret);
+        if (CL_SUCCESS == ret) {
+            t->mem_type = TENSOR_MEM_MAPPED_FILE;
+            t->host_backing = file;
+            t->runtime = &clrt();
+            return ret;
+        }
+        LOGW("clCreateBuffer over %s failed (%d), copying it instead.", path.c_str(), ret);
+        t->gptr = NULL;
+    }
+    t->mem_type = TENSOR_MEM_DEVICE;
+    ret = stream_tensor_file(*file, t);
+    delete file;
+    return ret;
+}
+
+}  // namespace abc
@@ -0,0 +1,378 @@
+#include "tracer.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "cl_runtime.h"
+#include "log.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "tracer"
+
+namespace abc {
+
+// pids of the three groups of tracks
+static const int kHostPid = 1;
+static const int kQueuePid = 2;
+static const int kDevicePid = 3;
+
+uint64_t trace_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Tracer::start() {
+    clear();
+    enabled_.store(true);
+}
+
+void Tracer::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (Record &r : records_) {
+        if (r.event) {
+            clReleaseEvent(r.event);
+        }
+    }
+    records_.clear();
+    first_unresolved_ = 0;
+}
+
+std::size_t Tracer::num_records() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return records_.size();
+}
+
+void Tracer::name_queue(cl_command_queue queue, const std::string &name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_names_[queue] = name;
+}
+
+int Tracer::thread_index_locked() {
+    auto it = threads_.find(std::this_thread::get_id());
+    if (it == threads_.end()) {
+        it = threads_.insert(std::make_pair(std::this_thread::get_id(), (int)threads_.size())).first;
+    }
+    return it->second;
+}
+
+void Tracer::add(Record *record) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    record->thread = thread_index_locked();
+    records_.push_back(*record);
+    // keep the number of events held bounded on long traces
+    if (records_.size() % 1024 == 0) {
+        resolve_locked(false);
+    }
+}
+
+// Reads the timestamps of completed commands (of all commands with wait)
+// and releases their events.
+void Tracer::resolve_locked(bool wait) {
+    bool all_resolved = true;
+    for (std::size_t i = first_unresolved_; i < records_.size(); ++i) {
+        Record &r = records_[i];
+        if (!r.event) {
+            if (all_resolved) {
+                first_unresolved_ = i + 1;
+            }
+            continue;
+        }
+        cl_int status = CL_COMPLETE;
+        if (wait) {
+            clWaitForEvents(1, &r.event);
+        }
+        clGetEventInfo(r.event, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), &status, NULL);
+        if (status > CL_COMPLETE) {
+            all_resolved = false;
+            continue;
+        }
+        r.has_device = status == CL_COMPLETE &&
+                       CL_SUCCESS == clGetEventProfilingInfo(r.event, CL_PROFILING_COMMAND_QUEUED, sizeof(cl_ulong),
+                                                             &r.queued, NULL) &&
+                       CL_SUCCESS == clGetEventProfilingInfo(r.event, CL_PROFILING_COMMAND_SUBMIT, sizeof(cl_ulong),
+                                                             &r.submit, NULL) &&
+                       CL_SUCCESS == clGetEventProfilingInfo(r.event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong),
+                                                             &r.start, NULL) &&
+                       CL_SUCCESS == clGetEventProfilingInfo(r.event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong),
+                                                             &r.end, NULL);
+        clReleaseEvent(r.event);
+        r.event = NULL;
+        if (all_resolved) {
+            first_unresolved_ = i + 1;
+        }
+    }
+}
+
+static std::string json_string(const std::string &s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+static std::string size_list(cl_uint work_dim, const size_t *sizes) {
+    std::string out = "\"[";
+    for (cl_uint i = 0; i < work_dim; ++i) {
+        out += (i ? ", " : "") + std::to_string(sizes[i]);
+    }
+    return out + "]\"";
+}
+
+cl_int Tracer::write_chrome_trace(const std::string &path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    resolve_locked(true);
+
+    // Device clocks have their own epoch. QUEUED is stamped during the
+    // enqueue call, so host midpoint - QUEUED estimates the offset; the
+    // median keeps a preempted enqueue from skewing it.
+    std::vector<int64_t> offsets;
+    for (const Record &r : records_) {
+        if (r.has_device) {
+            offsets.push_back((int64_t)((r.host_begin + r.host_end) / 2) - (int64_t)r.queued);
+        }
+    }
+    int64_t offset = 0;
+    if (!offsets.empty()) {
+        std::nth_element(offsets.begin(), offsets.begin() + offsets.size() / 2, offsets.end());
+        offset = offsets[offsets.size() / 2];
+    }
+    int64_t origin = INT64_MAX;
+    std::map<cl_command_queue, int> queues;
+    for (const Record &r : records_) {
+        origin = std::min(origin, (int64_t)r.host_begin);
+        if (r.has_device) {
+            origin = std::min(origin, (int64_t)r.queued + offset);
+        }
+        if (r.queue && queues.find(r.queue) == queues.end()) {
+            int index = (int)queues.size();
+            queues[r.queue] = index;
+        }
+    }
+    auto host_us = [&](uint64_t t) { return ((int64_t)t - origin) / 1000.0; };
+    auto device_us = [&](cl_ulong t) { return ((int64_t)t + offset - origin) / 1000.0; };
+
+    FILE *f = fopen(path.c_str(), "w");
+    if (!f) {
+        LOGE("Failed to open %s for writing.", path.c_str());
+        return CL_INVALID_VALUE;
+    }
+    fprintf(f, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+    fprintf(f, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, \"args\": {\"name\": \"host\"}},\n",
+            kHostPid);
+    fprintf(f, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, \"args\": {\"name\": \"queues\"}},\n",
+            kQueuePid);
+    fprintf(f, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, \"args\": {\"name\": \"device\"}},\n",
+            kDevicePid);
+    for (const auto &it : threads_) {
+        fprintf(f, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, "
+                   "\"args\": {\"name\": \"thread %d\"}},\n", kHostPid, it.second, it.second);
+    }
+    for (const auto &it : queues) {
+        auto named = queue_names_.find(it.first);
+        std::string name = named != queue_names_.end() ? named->second : "queue " + std::to_string(it.second);
+        for (int pid : {kQueuePid, kDevicePid}) {
+            fprintf(f, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, "
+                       "\"args\": {\"name\": %s}},\n", pid, it.second, json_string(name).c_str());
+        }
+    }
+
+    double launch_us = 0, enqueue_us = 0, busy_us = 0, idle_us = 0;
+    std::size_t num_commands = 0, num_device = 0;
+    std::map<int, const Record *> last_on_queue;
+    std::vector<std::size_t> order;
+    for (std::size_t i = 0; i < records_.size(); ++i) {
+        const Record &r = records_[i];
+        std::string args;
+        if (r.is_kernel) {
+            args = "\"global\": " + size_list(r.work_dim, r.global) + ", \"local\": " +
+                   (r.has_local ? size_list(r.work_dim, r.local) : std::string("\"driver\""));
+        } else if (r.queue) {
+            args = "\"bytes\": " + std::to_string(r.bytes);
+        }
+        const std::string name = json_string(r.queue ? "enqueue " + r.name : r.name);
+        fprintf(f, "{\"name\": %s, \"cat\": \"host\", \"ph\": \"X\", \"pid\": %d, \"tid\": %d, \"ts\": %.3f, "
+                   "\"dur\": %.3f, \"args\": {%s}},\n", name.c_str(), kHostPid, r.thread, host_us(r.host_begin),
+                (r.host_end - r.host_begin) / 1000.0, args.c_str());
+        if (!r.queue) {
+            continue;
+        }
+        num_commands++;
+        enqueue_us += (r.host_end - r.host_begin) / 1000.0;
+        if (!r.has_device) {
+            continue;
+        }
+        num_device++;
+        order.push_back(i);
+        const int q = queues[r.queue];
+        const std::string label = json_string(r.name);
+        args += std::string(args.empty() ? "" : ", ") + "\"submit_us\": " +
+                std::to_string((r.submit - r.queued) / 1000.0) + ", \"launch_latency_us\": " +
+                std::to_string((r.start - r.queued) / 1000.0);
+        launch_us += (r.start - r.queued) / 1000.0;
+        busy_us += (r.end - r.start) / 1000.0;
+        fprintf(f, "{\"name\": %s, \"cat\": \"queue\", \"ph\": \"b\", \"id\": %zu, \"pid\": %d, \"tid\": %d, "
+                   "\"ts\": %.3f},\n", label.c_str(), i, kQueuePid, q, device_us(r.queued));
+        fprintf(f, "{\"name\": %s, \"cat\": \"queue\", \"ph\": \"e\", \"id\": %zu, \"pid\": %d, \"tid\": %d, "
+                   "\"ts\": %.3f},\n", label.c_str(), i, kQueuePid, q, device_us(r.start));
+        fprintf(f, "{\"name\": %s, \"cat\": \"device\", \"ph\": \"X\", \"pid\": %d, \"tid\": %d, \"ts\": %.3f, "
+                   "\"dur\": %.3f, \"args\": {%s}},\n", label.c_str(), kDevicePid, q, device_us(r.start),
+                (r.end - r.start) / 1000.0, args.c_str());
+        fprintf(f, "{\"name\": \"launch\", \"cat\": \"flow\", \"ph\": \"s\", \"id\": %zu, \"pid\": %d, \"tid\": %d, "
+                   "\"ts\": %.3f},\n", i, kHostPid, r.thread, host_us(r.host_begin));
+        fprintf(f, "{\"name\": \"launch\", \"cat\": \"flow\", \"ph\": \"f\", \"bp\": \"e\", \"id\": %zu, "
+                   "\"pid\": %d, \"tid\": %d, \"ts\": %.3f},\n", i, kDevicePid, q, device_us(r.start));
+    }
+    // gaps between consecutive commands of a queue on the device
+    std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+        return records_[a].start < records_[b].start;
+    });
+    for (std::size_t i : order) {
+        const Record &r = records_[i];
+        const int q = queues[r.queue];
+        const Record *prev = last_on_queue[q];
+        if (prev && r.start > prev->end) {
+            idle_us += (r.start - prev->end) / 1000.0;
+            fprintf(f, "{\"name\": \"idle\", \"cat\": \"idle\", \"ph\": \"X\", \"pid\": %d, \"tid\": %d, "
+                       "\"ts\": %.3f, \"dur\": %.3f},\n", kDevicePid, q, device_us(prev->end),
+                    (r.start - prev->end) / 1000.0);
+        }
+        if (!prev || r.end > prev->end) {
+            last_on_queue[q] = &r;
+        }
+    }
+    fprintf(f, "{\"name\": \"process_sort_index\", \"ph\": \"M\", \"pid\": %d, \"args\": {\"sort_index\": 0}}\n]}\n",
+            kHostPid);
+    bool ok = ferror(f) == 0;
+    ok = fclose(f) == 0 && ok;
+    if (!ok) {
+        LOGE("Failed to write %s.", path.c_str());
+        return CL_INVALID_VALUE;
+    }
+    LOGI("Trace of %zu commands written to %s: host enqueue %.1f us avg", num_commands, path.c_str(),
+         num_commands ? enqueue_us / num_commands : 0.0);
+    if (num_device) {
+        LOGI("  device busy %.1f us, idle %.1f us, launch latency %.1f us avg", busy_us, idle_us,
+             launch_us / num_device);
+    }
+    return CL_SUCCESS;
+}
+
+TraceSpan::TraceSpan(cl_command_queue queue, cl_event *event)
+    : tracer_(NULL), queue_(queue), user_event_(event), own_event_(NULL), event_(event), host_begin_(0) {
+    Tracer &tracer = clrt().tracer();
+    if (tracer.enabled()) {
+        tracer_ = &tracer;
+        if (!event_) {
+            event_ = &own_event_;
+        }
+        host_begin_ = trace_now_ns();
+    }
+}
+
+TraceSpan::~TraceSpan() {
+    if (own_event_) {
+        clReleaseEvent(own_event_);
+    }
+}
+
+void TraceSpan::end(cl_int ret, uint64_t host_end, Tracer::Record *record) {
+    record->host_begin = host_begin_;
+    record->host_end = host_end;
+    Tracer *tracer = tracer_;
+    tracer_ = NULL;
+    if (CL_SUCCESS != ret || !*event_) {
+        return;
+    }
+    record->queue = queue_;
+    if (user_event_) {
+        clRetainEvent(*user_event_);
+        record->event = *user_event_;
+    } else {
+        record->event = own_event_;
+        own_event_ = NULL;
+    }
+    record->has_device = false;
+    record->queued = record->submit = record->start = record->end = 0;
+    tracer->add(record);
+}
+
+void TraceSpan::kernel(cl_int ret, cl_kernel kernel, cl_uint work_dim, const size_t *global, const size_t *local) {
+    if (!tracer_) {
+        return;
+    }
+    // the name lookup is left out of the span
+    const uint64_t host_end = trace_now_ns();
+    Tracer::Record record;
+    char name[128] = {0};
+    if (CL_SUCCESS != clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, sizeof(name) - 1, name, NULL)) {
+        snprintf(name, sizeof(name), "kernel");
+    }
+    record.name = name;
+    record.is_kernel = true;
+    record.work_dim = std::min<cl_uint>(work_dim, 3);
+    record.has_local = local != NULL;
+    for (cl_uint i = 0; i < record.work_dim; ++i) {
+        record.global[i] = global[i];
+        record.local[i] = local ? local[i] : 0;
+    }
+    record.bytes = 0;
+    end(ret, host_end, &record);
+}
+
+void TraceSpan::transfer(cl_int ret, const char *name, std::size_t bytes) {
+    if (!tracer_) {
+        return;
+    }
+    const uint64_t host_end = trace_now_ns();
+    Tracer::Record record;
+    record.name = name;
+    record.is_kernel = false;
+    record.work_dim = 0;
+    record.has_local = false;
+    record.bytes = bytes;
+    end(ret, host_end, &record);
+}
+
+TraceRange::TraceRange(const char *name) : tracer_(NULL), name_(name), host_begin_(0) {
+    Tracer &tracer = clrt().tracer();
+    if (tracer.enabled()) {
+        tracer_ = &tracer;
+        host_begin_ = trace_now_ns();
+    }
+}
+
+TraceRange::~TraceRange() {
+    if (!tracer_) {
+        return;
+    }
+    Tracer::Record record;
+    record.name = name_;
+    record.is_kernel = false;
+    record.thread = 0;
+    record.queue = NULL;
+    record.host_begin = host_begin_;
+    record.host_end = trace_now_ns();
+    record.event = NULL;
+    record.has_device = false;
+    record.queued = record.submit = record.start = record.end = 0;
+    record.work_dim = 0;
+    record.has_local = false;
+    record.bytes = 0;
+    tracer_->add(&record);
+}
+
+}  // namespace abc
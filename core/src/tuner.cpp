@@ -0,0 +1,244 @@
+#include "tuner.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <fstream>
+#include <sstream>
+
+#include "cl_runtime.h"
+#include "log.h"
+#include "utils.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "tuner"
+
+namespace abc {
+
+static size_t next_pow2(size_t v) {
+    size_t p = 1;
+    while (p < v) {
+        p <<= 1;
+    }
+    return p;
+}
+
+struct WorkGroupLimits {
+    size_t kernel_wg_size;
+    size_t preferred_multiple;
+    size_t max_item_sizes[3];
+};
+
+static WorkGroupLimits query_limits(cl_kernel kernel) {
+    WorkGroupLimits limits = {256, 1, {256, 256, 256}};
+    cl_device_id device = clrt().device_id();
+    clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t),
+                             &limits.kernel_wg_size, NULL);
+    clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE, sizeof(size_t),
+                             &limits.preferred_multiple, NULL);
+    clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_ITEM_SIZES, sizeof(limits.max_item_sizes),
+                    limits.max_item_sizes, NULL);
+    if (limits.kernel_wg_size == 0) {
+        limits.kernel_wg_size = 1;
+    }
+    if (limits.preferred_multiple == 0) {
+        limits.preferred_multiple = 1;
+    }
+    return limits;
+}
+
+void LocalSizeTuner::pad_global_size(cl_uint work_dim, const size_t *global, const size_t *local, size_t *padded) {
+    for (cl_uint i = 0; i < work_dim; ++i) {
+        padded[i] = (global[i] + local[i] - 1) / local[i] * local[i];
+    }
+}
+
+void LocalSizeTuner::candidate_local_sizes(cl_kernel kernel, cl_uint work_dim, const size_t *global,
+                                           std::vector<std::vector<size_t> > *candidates) {
+    WorkGroupLimits limits = query_limits(kernel);
+    std::vector<std::vector<size_t> > all(1, std::vector<size_t>());
+    for (cl_uint d = 0; d < work_dim; ++d) {
+        size_t upper = next_pow2(global[d]);
+        if (upper > limits.max_item_sizes[d]) {
+            upper = limits.max_item_sizes[d];
+        }
+        std::vector<std::vector<size_t> > next;
+        for (const std::vector<size_t> &prefix : all) {
+            size_t used = 1;
+            for (size_t v : prefix) {
+                used *= v;
+            }
+            for (size_t l = 1; l <= upper && used * l <= limits.kernel_wg_size; l <<= 1) {
+                std::vector<size_t> c = prefix;
+                c.push_back(l);
+                next.push_back(c);
+            }
+        }
+        all.swap(next);
+    }
+
+    candidates->clear();
+    for (const std::vector<size_t> &c : all) {
+        size_t total = 1;
+        for (size_t v : c) {
+            total *= v;
+        }
+        if (total % limits.preferred_multiple == 0) {
+            candidates->push_back(c);
+        }
+    }
+    if (candidates->empty()) {
+        // problem smaller than the preferred multiple, try everything
+        candidates->swap(all);
+    }
+}
+
+void LocalSizeTuner::heuristic_local_size(cl_kernel kernel, cl_uint work_dim, const size_t *global, size_t *local) {
+    WorkGroupLimits limits = query_limits(kernel);
+    size_t target = limits.kernel_wg_size < 128 ? limits.kernel_wg_size : 128;
+    if (target > limits.preferred_multiple) {
+        target = target / limits.preferred_multiple * limits.preferred_multiple;
+    }
+    // hand the work-group budget to the fastest varying dimension first,
+    // in powers of two, without exceeding the problem size.
+    size_t remaining = target;
+    for (cl_uint d = 0; d < work_dim; ++d) {
+        size_t l = 1;
+        while (l * 2 <= remaining && l * 2 <= next_pow2(global[d]) && l * 2 <= limits.max_item_sizes[d]) {
+            l <<= 1;
+        }
+        local[d] = l;
+        remaining /= l;
+    }
+}
+
+LocalSizeTuner::~LocalSizeTuner() {
+    if (dirty_ && !db_path_.empty()) {
+        save();
+    }
+}
+
+std::string LocalSizeTuner::make_key(const std::string &kernel_name, const std::string &shape) {
+    return clrt().device_name() + '\t' + kernel_name + '\t' + shape;
+}
+
+cl_int LocalSizeTuner::set_db_path(const std::string &path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    db_path_ = path;
+    std::ifstream in(path.c_str());
+    if (!in) {
+        return CL_SUCCESS;  // created by the first save()
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        std::size_t last_tab = line.rfind('\t');
+        if (line.empty() || line[0] == '#' || last_tab == std::string::npos) {
+            continue;
+        }
+        std::vector<size_t> local;
+        std::stringstream ss(line.substr(last_tab + 1));
+        std::string item;
+        while (std::getline(ss, item, ',')) {
+            local.push_back(strtoul(item.c_str(), NULL, 10));
+        }
+        if (!local.empty()) {
+            db_[line.substr(0, last_tab)] = local;
+        }
+    }
+    return CL_SUCCESS;
+}
+
+cl_int LocalSizeTuner::save() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (db_path_.empty()) {
+        return CL_INVALID_VALUE;
+    }
+    std::ofstream out(db_path_.c_str(), std::ios::trunc);
+    if (!out) {
+        LOGE("Failed to open tuning db %s", db_path_.c_str());
+        return CL_INVALID_VALUE;
+    }
+    out << "# device\tkernel\tshape\tlocal\n";
+    for (auto &it : db_) {
+        out << it.first << '\t';
+        for (std::size_t i = 0; i < it.second.size(); ++i) {
+            out << (i ? "," : "") << it.second[i];
+        }
+        out << '\n';
+    }
+    dirty_ = false;
+    return CL_SUCCESS;
+}
+
+bool LocalSizeTuner::lookup(const std::string &kernel_name, const std::string &shape, cl_uint work_dim, size_t *local) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = db_.find(make_key(kernel_name, shape));
+    if (it == db_.end() || it->second.size() != work_dim) {
+        return false;
+    }
+    for (cl_uint d = 0; d < work_dim; ++d) {
+        local[d] = it->second[d];
+    }
+    return true;
+}
+
+void LocalSizeTuner::local_size(const std::string &kernel_name, const std::string &shape, cl_kernel kernel,
+                                cl_uint work_dim, const size_t *global, size_t *local) {
+    if (!lookup(kernel_name, shape, work_dim, local)) {
+        heuristic_local_size(kernel, work_dim, global, local);
+    }
+}
+
+cl_int LocalSizeTuner::tune(const std::string &kernel_name, const std::string &shape, cl_kernel kernel,
+                            cl_uint work_dim, const size_t *global, size_t *best_local, int reps,
+                            double flops, double bytes) {
+    std::vector<std::vector<size_t> > candidates;
+    candidate_local_sizes(kernel, work_dim, global, &candidates);
+    cl_command_queue queue = clrt().profile_queue();
+    double best_ns = -1;
+    size_t padded[3];
+    for (const std::vector<size_t> &local : candidates) {
+        pad_global_size(work_dim, global, local.data(), padded);
+        double min_ns = -1;
+        bool ok = true;
+        for (int r = 0; r <= reps && ok; ++r) {
+            cl_event event;
+            cl_int ret = clEnqueueNDRangeKernel(queue, kernel, work_dim, NULL, padded, local.data(), 0, NULL, &event);
+            if (ret != CL_SUCCESS) {
+                ok = false;
+                break;
+            }
+            clWaitForEvents(1, &event);
+            double ns = get_cl_exec_time(event);
+            clReleaseEvent(event);
+            if (r > 0 && (min_ns < 0 || ns < min_ns)) {  // r == 0 is warmup
+                min_ns = ns;
+            }
+        }
+        if (ok && (best_ns < 0 || min_ns < best_ns)) {
+            best_ns = min_ns;
+            for (cl_uint d = 0; d < work_dim; ++d) {
+                best_local[d] = local[d];
+            }
+        }
+    }
+    if (best_ns < 0) {
+        LOGE("No local size candidate could be launched for %s", kernel_name.c_str());
+        return CL_INVALID_WORK_GROUP_SIZE;
+    }
+    LOGI("tuned %s [%s]: %zu candidates, best %.3f us", kernel_name.c_str(), shape.c_str(),
+         candidates.size(), best_ns / 1000.0);
+    if (clrt().roofline().valid() && (flops > 0 || bytes > 0)) {
+        LOGI("tuned %s [%s]: %.1f%% of roofline", kernel_name.c_str(), shape.c_str(),
+             roofline_percent(clrt().roofline(), ROOFLINE_FP16, flops, bytes, best_ns));
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    db_[make_key(kernel_name, shape)] = std::vector<size_t>(best_local, best_local + work_dim);
+    dirty_ = true;
+    return CL_SUCCESS;
+}
+
+}  // namespace abc
@@ -1,32 +1,210 @@
 #include "utils.h"
 
-#include <cassert>
+#include <vector>
 
+#include "half_convert.h"
 #include "half_float.h"
 #include "log.h"
+#include "tensor.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "utils"
 
 namespace abc {
 
-cl_int copy_fp16_host_mem_to_cl_mem(std::size_t num_elem, const void *from, cl_mem to) {
+static cl_command_queue queue_or_default(cl_command_queue queue) {
+    return queue ? queue : clrt().profile_queue();
+}
+
+static cl_int write_fp16(std::size_t num_elem, const void *from, cl_mem to, cl_bool blocking,
+                         cl_uint num_wait, const cl_event *wait_list, cl_event *event,
+                         cl_command_queue queue) {
     cl_int ret = CL_SUCCESS;
     std::size_t bytes = num_elem * sizeof(cl_half);
-    ret = clEnqueueWriteBuffer(clrt().profile_queue(), to, CL_TRUE, 0, bytes, from, 0, NULL, NULL);
+    CommandGraph *graph = blocking ? nullptr : capturing_graph(queue_or_default(queue));
+    if (graph) {
+        return graph->record_host_copy(true, to, const_cast<void *>(from), 0, bytes, num_wait, wait_list, event);
+    }
+    TraceSpan span(queue_or_default(queue), event);
+    ret = clEnqueueWriteBuffer(queue_or_default(queue), to, blocking, 0, bytes, from, num_wait, wait_list,
+                               span.event());
+    span.transfer(ret, "write", bytes);
     if (CL_SUCCESS != ret) {
         LOGE("clEnqueueWriteBuffer failed.");
     }
     return ret;
 }
 
-cl_int copy_fp16_cl_mem_to_host_mem(std::size_t num_elem, cl_mem from, void *to) {
+static cl_int read_fp16(std::size_t num_elem, cl_mem from, void *to, cl_bool blocking,
+                        cl_uint num_wait, const cl_event *wait_list, cl_event *event,
+                        cl_command_queue queue) {
     cl_int ret = CL_SUCCESS;
     std::size_t bytes = num_elem * sizeof(cl_half);
-    ret = clEnqueueReadBuffer(clrt().profile_queue(), from, CL_TRUE, 0, bytes, to, 0, NULL, NULL);
+    CommandGraph *graph = blocking ? nullptr : capturing_graph(queue_or_default(queue));
+    if (graph) {
+        return graph->record_host_copy(false, from, to, 0, bytes, num_wait, wait_list, event);
+    }
+    TraceSpan span(queue_or_default(queue), event);
+    ret = clEnqueueReadBuffer(queue_or_default(queue), from, blocking, 0, bytes, to, num_wait, wait_list,
+                              span.event());
+    span.transfer(ret, "read", bytes);
+    if (CL_SUCCESS != ret) {
+        LOGE("clEnqueueReadBuffer failed.");
+    }
+    return ret;
+}
+
+cl_int copy_fp16_host_mem_to_cl_mem(std::size_t num_elem, const void *from, cl_mem to) {
+    return write_fp16(num_elem, from, to, CL_TRUE, 0, NULL, NULL, NULL);
+}
+
+cl_int copy_fp16_cl_mem_to_host_mem(std::size_t num_elem, cl_mem from, void *to) {
+    return read_fp16(num_elem, from, to, CL_TRUE, 0, NULL, NULL, NULL);
+}
+
+cl_int copy_int8_host_mem_to_cl_mem(std::size_t num_elem, const void *from, cl_mem to) {
+    TraceSpan span(clrt().profile_queue(), NULL);
+    cl_int ret = clEnqueueWriteBuffer(clrt().profile_queue(), to, CL_TRUE, 0, num_elem, from, 0, NULL, span.event());
+    span.transfer(ret, "write", num_elem);
+    if (CL_SUCCESS != ret) {
+        LOGE("clEnqueueWriteBuffer failed.");
+    }
+    return ret;
+}
+
+cl_int copy_int8_cl_mem_to_host_mem(std::size_t num_elem, cl_mem from, void *to) {
+    TraceSpan span(clrt().profile_queue(), NULL);
+    cl_int ret = clEnqueueReadBuffer(clrt().profile_queue(), from, CL_TRUE, 0, num_elem, to, 0, NULL, span.event());
+    span.transfer(ret, "read", num_elem);
     if (CL_SUCCESS != ret) {
         LOGE("clEnqueueReadBuffer failed.");
     }
     return ret;
 }
 
+cl_int copy_fp16_host_mem_to_cl_mem_async(std::size_t num_elem, const void *from, cl_mem to,
+                                          cl_uint num_wait, const cl_event *wait_list, cl_event *event,
+                                          cl_command_queue queue) {
+    return write_fp16(num_elem, from, to, CL_FALSE, num_wait, wait_list, event, queue);
+}
+
+cl_int copy_fp16_cl_mem_to_host_mem_async(std::size_t num_elem, cl_mem from, void *to,
+                                          cl_uint num_wait, const cl_event *wait_list, cl_event *event,
+                                          cl_command_queue queue) {
+    return read_fp16(num_elem, from, to, CL_FALSE, num_wait, wait_list, event, queue);
+}
+
+cl_int enqueue_kernel_async(cl_kernel kernel, cl_uint work_dim, const size_t *global, const size_t *local,
+                            cl_uint num_wait, const cl_event *wait_list, cl_event *event,
+                            cl_command_queue queue) {
+    if (CommandGraph *graph = capturing_graph(queue_or_default(queue))) {
+        return graph->record_kernel(kernel, work_dim, global, local, num_wait, wait_list, event);
+    }
+    TraceSpan span(queue_or_default(queue), event);
+    cl_int ret = clEnqueueNDRangeKernel(queue_or_default(queue), kernel, work_dim, NULL, global, local,
+                                        num_wait, wait_list, span.event());
+    span.kernel(ret, kernel, work_dim, global, local);
+    if (CL_SUCCESS != ret) {
+        LOGE("clEnqueueNDRangeKernel failed: %d", ret);
+    }
+    return ret;
+}
+
+cl_int fill_cl_mem_async(cl_mem mem, const void *pattern, std::size_t pattern_size, std::size_t bytes,
+                         cl_uint num_wait, const cl_event *wait_list, cl_event *event,
+                         cl_command_queue queue) {
+    if (CommandGraph *graph = capturing_graph(queue_or_default(queue))) {
+        return graph->record_fill(mem, pattern, pattern_size, 0, bytes, num_wait, wait_list, event);
+    }
+    TraceSpan span(queue_or_default(queue), event);
+    cl_int ret = clEnqueueFillBuffer(queue_or_default(queue), mem, pattern, pattern_size, 0, bytes,
+                                     num_wait, wait_list, span.event());
+    span.transfer(ret, "fill", bytes);
+    if (CL_SUCCESS != ret) {
+        LOGE("clEnqueueFillBuffer failed: %d", ret);
+    }
+    return ret;
+}
+
+void pack_fp16_nchw_to_nc4hw4(const dims4d &dims, const void *nchw, void *nc4hw4) {
+    const cl_half *src = reinterpret_cast<const cl_half *>(nchw);
+    cl_half *dst = reinterpret_cast<cl_half *>(nc4hw4);
+    const int c4_num = (dims.c + 3) / 4;
+    const std::size_t hw = (std::size_t)dims.h * dims.w;
+    const cl_half zero = to_half(0.0f);
+    for (int n = 0; n < dims.n; ++n) {
+        for (int h = 0; h < dims.h; ++h) {
+            for (int c4 = 0; c4 < c4_num; ++c4) {
+                for (int w = 0; w < dims.w; ++w) {
+                    for (int i = 0; i < 4; ++i) {
+                        int c = c4 * 4 + i;
+                        *dst++ = c < dims.c ? src[((std::size_t)n * dims.c + c) * hw + (std::size_t)h * dims.w + w]
+                                            : zero;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void unpack_fp16_nc4hw4_to_nchw(const dims4d &dims, const void *nc4hw4, void *nchw) {
+    const cl_half *src = reinterpret_cast<const cl_half *>(nc4hw4);
+    cl_half *dst = reinterpret_cast<cl_half *>(nchw);
+    const int c4_num = (dims.c + 3) / 4;
+    const std::size_t hw = (std::size_t)dims.h * dims.w;
+    for (int n = 0; n < dims.n; ++n) {
+        for (int h = 0; h < dims.h; ++h) {
+            for (int c4 = 0; c4 < c4_num; ++c4) {
+                for (int w = 0; w < dims.w; ++w) {
+                    for (int i = 0; i < 4; ++i, ++src) {
+                        int c = c4 * 4 + i;
+                        if (c < dims.c) {
+                            dst[((std::size_t)n * dims.c + c) * hw + (std::size_t)h * dims.w + w] = *src;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+cl_int copy_fp16_host_mem_to_image(const dims4d &dims, const void *from, cl_mem to) {
+    std::size_t width = 0, height = 0;
+    nc4hw4_image_shape(dims, &width, &height);
+    std::vector<cl_half> packed(width * height * 4);
+    pack_fp16_nchw_to_nc4hw4(dims, from, packed.data());
+    const std::size_t origin[3] = {0, 0, 0};
+    const std::size_t region[3] = {width, height, 1};
+    TraceSpan span(clrt().profile_queue(), NULL);
+    cl_int ret = clEnqueueWriteImage(clrt().profile_queue(), to, CL_TRUE, origin, region, 0, 0, packed.data(),
+                                     0, NULL, span.event());
+    span.transfer(ret, "write image", packed.size() * sizeof(cl_half));
+    if (CL_SUCCESS != ret) {
+        LOGE("clEnqueueWriteImage failed: %d", ret);
+    }
+    return ret;
+}
+
+cl_int copy_fp16_image_to_host_mem(const dims4d &dims, cl_mem from, void *to) {
+    std::size_t width = 0, height = 0;
+    nc4hw4_image_shape(dims, &width, &height);
+    std::vector<cl_half> packed(width * height * 4);
+    const std::size_t origin[3] = {0, 0, 0};
+    const std::size_t region[3] = {width, height, 1};
+    TraceSpan span(clrt().profile_queue(), NULL);
+    cl_int ret = clEnqueueReadImage(clrt().profile_queue(), from, CL_TRUE, origin, region, 0, 0, packed.data(),
+                                    0, NULL, span.event());
+    span.transfer(ret, "read image", packed.size() * sizeof(cl_half));
+    if (CL_SUCCESS != ret) {
+        LOGE("clEnqueueReadImage failed: %d", ret);
+        return ret;
+    }
+    unpack_fp16_nc4hw4_to_nchw(dims, packed.data(), to);
+    return ret;
+}
+
 void init_fp16_host_mem(std::size_t num_elem,
                         UT_RANDOM_TYPE rand_type,
                         void *f16ptr) {
@@ -35,24 +213,23 @@ void init_fp16_host_mem(std::size_t num_elem,
         return;
     }
 
-    cl_half *f16data = (cl_half *)(f16ptr);
+    std::vector<float> f32data(num_elem);
     for (std::size_t i = 0; i < num_elem; i++) {
-        float f32val = rand() % 1000 / 1000.0 - 0.5;
-        f16data[i] = to_half(f32val);
+        f32data[i] = rand() % 1000 / 1000.0 - 0.5;
     }
+    convert_f32_to_f16(num_elem, f32data.data(), (cl_half *)(f16ptr));
 }
 
 void read_fp16_from_fp32_text(const std::string &filename,
                           std::size_t num_elem,
                           void *f16ptr) {
     FILE *f = fopen(filename.c_str(), "r");
-    cl_half *dataPtr = (cl_half *)(f16ptr);
-    float f32val;
+    std::vector<float> f32data(num_elem);
     for (std::size_t i = 0; i < num_elem; ++i) {
-        fscanf(f, "%f", &f32val);
-        dataPtr[i] = to_half(f32val);
+        fscanf(f, "%f", &f32data[i]);
     }
     fclose(f);
+    convert_f32_to_f16(num_elem, f32data.data(), (cl_half *)(f16ptr));
 }
 
 double get_cl_exec_time(cl_event event) {
@@ -61,11 +238,14 @@ double get_cl_exec_time(cl_event event) {
     uint64_t endTime = 0;
     result = clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START,
                                      sizeof(startTime), &startTime, NULL);
-    assert(result == CL_SUCCESS);
-    result = clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END,
-                                     sizeof(endTime), &endTime, NULL);
-    assert(result == CL_SUCCESS);
-    assert(endTime > startTime);
+    if (result == CL_SUCCESS) {
+        result = clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END,
+                                         sizeof(endTime), &endTime, NULL);
+    }
+    if (result != CL_SUCCESS || endTime < startTime) {
+        LOGE("No profiling info for event %p: %d", (void *)event, result);
+        return 0.0;
+    }
     return (double)(endTime - startTime);
 }
 
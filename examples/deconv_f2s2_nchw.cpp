@@ -1,8 +1,13 @@
-#include <cassert>
+#include <math.h>
+
+#include <chrono>
 #include <string>
+#include <vector>
 
+#include "deconv.h"
 #include "log.h"
 #include "tensor.h"
+#include "tensor_file.h"
 #include "half_float.h"
 #include "utils.h"
 
@@ -11,209 +16,128 @@
 #endif
 #define TAG "deconv_f2s2_nchw"
 
-
-std::string makeGEMMKernelString() {
-    // local = {16, 16}
-    // global = {(ih * iw + 3) / 4, (oc * 2 * 2 + 3) / 4}
-    std::string kernel = _STR(
-        __kernel void gemm_nchw(int ic,
-                                       int ih,
-                                       int iw,
-                                       int oc,
-                                       int oh,
-                                       int ow,
-                                       int M,
-                                       int N,
-                                       int K,
-                                       __global const half *input,
-                                       __global const half *weight,
-                                       __global half *output) {
-            const int idx = get_global_id(0) << 2;  // ih * iw
-            const int idy = get_global_id(1) << 2;  // oc * 4
-            if (idx >= N || idy >= M) return;
-            half4 cval[4];
-            cval[0] = (half4)(0);
-            cval[1] = (half4)(0);
-            cval[2] = (half4)(0);
-            cval[3] = (half4)(0);
-            for (int ki = 0; ki < K; ++ki) {
-                half4 weight_val = vload4(0, weight + ki * M + idy);
-                half4 input_val = vload4(0, input + ki * N + idx);
-                cval[0] += weight_val.x * input_val;
-                cval[1] += weight_val.y * input_val;
-                cval[2] += weight_val.z * input_val;
-                cval[3] += weight_val.w * input_val;
-            }
-            vstore4(cval[0], 0, output + idy * N + idx);
-            vstore4(cval[1], 0, output + (idy + 1) * N + idx);
-            vstore4(cval[2], 0, output + (idy + 2) * N + idx);
-            vstore4(cval[3], 0, output + (idy + 3) * N + idx);
-        }
-    );
-    return kernel;
-}
-
-std::string makeDeconvKernelW4String() {
-    // local = {16, 16}
-    // global = {(ih * iw + 3) / 4, (oc * 2 * 2 + 3) / 4}
-    std::string kernel = _STR(
-        __kernel void deconv_f2s2_nchw(int ic,
-                                       int ih,
-                                       int iw,
-                                       int oc,
-                                       int oh,
-                                       int ow,
-                                       int M,
-                                       int N,
-                                       int K,
-                                       __global const half *input,
-                                       __global const half *weight,
-                                       __global half *output) {
-            const int idx = get_global_id(0) << 2;  // ih * iw
-            const int idy = get_global_id(1) << 2;  // oc * 4
-            if (idx >= N || idy >= M) return;
-            half4 cval[4];
-            cval[0] = (half4)(0);
-            cval[1] = (half4)(0);
-            cval[2] = (half4)(0);
-            cval[3] = (half4)(0);
-            for (int ki = 0; ki < K; ++ki) {
-                half4 weight_val = vload4(0, weight + ki * M + idy);
-                half4 input_val = vload4(0, input + ki * N + idx);
-                cval[0] += weight_val.x * input_val;
-                cval[1] += weight_val.y * input_val;
-                cval[2] += weight_val.z * input_val;
-                cval[3] += weight_val.w * input_val;
-            }
-            int oc_idx = idy / 4;
-            int ih_idx = (idx / iw) % ih;
-            int iw_idx = idx % iw;
-            int oh_idx = ih_idx * 2;
-            int ow_idx = iw_idx * 2;
-            int out_pos = oc_idx * oh * ow + oh_idx * ow + ow_idx;
-            //if (oc_idx == 0) {
-            {
-                vstore8((half8)(cval[0].x, cval[1].x, cval[0].y, cval[1].y, cval[0].z, cval[1].z, cval[0].w, cval[1].w), 0, output + out_pos);
-                vstore8((half8)(cval[2].x, cval[3].x, cval[2].y, cval[3].y, cval[2].z, cval[3].z, cval[2].w, cval[3].w), 0, output + out_pos + ow);
-            }
-        }
-    );
-    return kernel;
-}
-
-std::string makeDeconvKernelString() {
-    // local = {16, 16}
-    // global = {(ih * iw + 3) / 4, (oc * 2 * 2 + 3) / 4}
-    std::string kernel = _STR(
-        __kernel void deconv_f2s2_nchw(int ic,
-                                       int ih,
-                                       int iw,
-                                       int oc,
-                                       int oh,
-                                       int ow,
-                                       int M,
-                                       int N,
-                                       int K,
-                                       __global const half *input,
-                                       __global const half *weight,
-                                       __global half *output) {
-            const int idx = get_global_id(0) << 2;  // ih * iw
-            const int idy = get_global_id(1) << 2;  // oc * 4
-            if (idx >= N || idy >= M) return;
-            int iw_idx = idx % iw;
-            int oc_idx = idy / 4;
-            int ih_idx = (idx / iw) % ih;
-            int oh_idx = ih_idx * 2;
-            int ow_idx = iw_idx * 2;
-            int out_pos = oc_idx * oh * ow + oh_idx * ow + ow_idx;
-            half4 cval[4];
-            cval[0] = (half4)(0);
-            cval[1] = (half4)(0);
-            cval[2] = (half4)(0);
-            cval[3] = (half4)(0);
-            for (int ki = 0; ki < K; ++ki) {
-                half4 weight_val = vload4(0, weight + ki * M + idy);
-                half4 input_val = vload4(0, input + ki * N + idx);
-                cval[0] += weight_val.x * input_val;
-                cval[1] += weight_val.y * input_val;
-                cval[2] += weight_val.z * input_val;
-                cval[3] += weight_val.w * input_val;
-            }
-            char iw_remain = ((iw_idx + 4) <= iw) ? 4 : (iw & 3);
-            if (iw_remain == 4) {
-                vstore8((half8)(cval[0].x, cval[1].x, cval[0].y, cval[1].y, cval[0].z, cval[1].z, cval[0].w, cval[1].w), 0, output + out_pos);
-                vstore8((half8)(cval[2].x, cval[3].x, cval[2].y, cval[3].y, cval[2].z, cval[3].z, cval[2].w, cval[3].w), 0, output + out_pos + ow);
-            } else {
-                /*if (iw_remain == 3) {
-                    half3 cval[4];
-                    cval[0] = (half3)(0);
-                    cval[1] = (half3)(0);
-                    cval[2] = (half3)(0);
-                    cval[3] = (half3)(0);
-                    for (int ki = 0; ki < K; ++ki) {
-                        half4 weight_val = vload4(0, weight + ki * M + idy);
-                        half3 input_val = vload3(0, input + ki * N + idx);
-                        cval[0] += weight_val.x * input_val;
-                        cval[1] += weight_val.y * input_val;
-                        cval[2] += weight_val.z * input_val;
-                        cval[3] += weight_val.w * input_val;
+// conv_transpose2d reference on the host, fp32 accumulation
+static void deconv_reference(const abc::DeconvParams &p, const abc::dims4d &in_dims, const abc::dims4d &out_dims,
+                             const cl_half *input, const cl_half *weight, std::vector<float> *output) {
+    output->assign((std::size_t)out_dims.n * out_dims.c * out_dims.h * out_dims.w, 0.0f);
+    for (int n = 0; n < in_dims.n; ++n) {
+        for (int c = 0; c < in_dims.c; ++c) {
+            for (int h = 0; h < in_dims.h; ++h) {
+                for (int w = 0; w < in_dims.w; ++w) {
+                    float x = to_float(input[((n * in_dims.c + c) * in_dims.h + h) * in_dims.w + w]);
+                    for (int o = 0; o < out_dims.c; ++o) {
+                        for (int kh = 0; kh < p.kernel_h; ++kh) {
+                            int oh = h * p.stride_h - p.pad_h + kh * p.dilation_h;
+                            if (oh < 0 || oh >= out_dims.h) continue;
+                            for (int kw = 0; kw < p.kernel_w; ++kw) {
+                                int ow = w * p.stride_w - p.pad_w + kw * p.dilation_w;
+                                if (ow < 0 || ow >= out_dims.w) continue;
+                                float k = to_float(weight[((c * out_dims.c + o) * p.kernel_h + kh) * p.kernel_w + kw]);
+                                (*output)[((n * out_dims.c + o) * out_dims.h + oh) * out_dims.w + ow] += x * k;
+                            }
+                        }
                     }
-                    vstore4((half4)(cval[0].x, cval[1].x, cval[0].y, cval[1].y), 0, output + out_pos);
-                    vstore2((half2)(cval[0].z, cval[1].z), 0, output + out_pos + 4);
-                    vstore4((half4)(cval[2].x, cval[3].x, cval[2].y, cval[3].y), 0, output + out_pos + ow);
-                    vstore2((half2)(cval[2].z, cval[3].z), 0, output + out_pos + ow + 4);
-                } else */
-                if (iw_remain == 2) {
-                    vstore4((half4)(cval[0].x, cval[1].x, cval[0].y, cval[1].y), 0, output + out_pos);
-                    vstore4((half4)(cval[2].x, cval[3].x, cval[2].y, cval[3].y), 0, output + out_pos + ow);
-                    vstore4((half4)(cval[0].z, cval[1].z, cval[0].w, cval[1].w), 0, output + out_pos + ow + 4);
-                    vstore4((half4)(cval[2].z, cval[3].z, cval[2].w, cval[3].w), 0, output + out_pos + ow * 2 + 4);
                 }
-                /* else if (iw_remain == 1) {
-                    half cval[4];
-                    cval[0] = (half)(0);
-                    cval[1] = (half)(0);
-                    cval[2] = (half)(0);
-                    cval[3] = (half)(0);
-                    for (int ki = 0; ki < K; ++ki) {
-                        half4 weight_val = vload4(0, weight + ki * M + idy);
-                        half input_val = input[ki * N + idx];
-                        cval[0] += weight_val.x * input_val;
-                        cval[1] += weight_val.y * input_val;
-                        cval[2] += weight_val.z * input_val;
-                        cval[3] += weight_val.w * input_val;
-                    }
-                    vstore2((half2)(cval[0], cval[1]), 0, output + out_pos);
-                    vstore2((half2)(cval[2], cval[3]), 0, output + out_pos + ow);
-                }*/
             }
         }
-    );
-    return kernel;
+    }
 }
 
 using abc::Tensor;
 using abc::clrt;
+
+// max |device - reference| / max(1, |reference|), fp16 output vs fp32 sums
+static const float kMaxError = 2e-2f;
+
+// Runs one shape through enqueue_deconv_fp16 and compares it with
+// deconv_reference(); returns the error, or a negative value on failure.
+static float check_deconv(const abc::DeconvParams &p, const abc::dims4d &in_dims, int oc) {
+    const abc::dims4d out_dims = abc::deconv_output_dims(p, in_dims, oc);
+    Tensor input = abc::make_4d_tensor(in_dims);
+    Tensor weight = abc::make_4d_tensor({in_dims.c, oc, p.kernel_h, p.kernel_w});
+    Tensor output = abc::make_4d_tensor(out_dims);
+    abc::alloc_tensor_host_mem(&input);
+    abc::alloc_tensor_host_mem(&weight);
+    abc::alloc_tensor_host_mem(&output);
+    abc::init_fp16_host_mem(input.num_elem(), abc::UT_INIT_RANDOM, input.hostptr);
+    abc::init_fp16_host_mem(weight.num_elem(), abc::UT_INIT_RANDOM, weight.hostptr);
+    cl_int ret = abc::alloc_tensor_cl_mem(&input);
+    if (CL_SUCCESS == ret) {
+        ret = abc::alloc_tensor_cl_mem(&weight);
+    }
+    if (CL_SUCCESS == ret) {
+        ret = abc::alloc_tensor_cl_mem(&output);
+    }
+    if (CL_SUCCESS == ret) {
+        ret = abc::copy_fp16_host_mem_to_cl_mem(input.num_elem(), input.hostptr, input.gptr);
+    }
+    if (CL_SUCCESS == ret) {
+        ret = abc::copy_fp16_host_mem_to_cl_mem(weight.num_elem(), weight.hostptr, weight.gptr);
+    }
+    if (CL_SUCCESS == ret) {
+        ret = abc::enqueue_deconv_fp16(p, in_dims, oc, input.gptr, weight.gptr, output.gptr);
+    }
+    if (CL_SUCCESS == ret) {
+        ret = abc::copy_fp16_cl_mem_to_host_mem(output.num_elem(), output.gptr, output.hostptr);
+    }
+    if (CL_SUCCESS != ret) {
+        LOGE("deconv %dx%d/%d failed: %d", p.kernel_h, p.kernel_w, p.stride_h, ret);
+        return -1;
+    }
+    std::vector<float> expected;
+    deconv_reference(p, in_dims, out_dims, reinterpret_cast<const cl_half *>(input.hostptr),
+                     reinterpret_cast<const cl_half *>(weight.hostptr), &expected);
+    const cl_half *result = reinterpret_cast<const cl_half *>(output.hostptr);
+    float max_err = 0;
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+        max_err = fmaxf(max_err, fabsf(to_float(result[i]) - expected[i]) / fmaxf(1.0f, fabsf(expected[i])));
+    }
+    LOGI("kernel %d stride %d pad %d dilation %d output_padding %d (%s): error %g", p.kernel_h, p.stride_h, p.pad_h,
+         p.dilation_h, p.output_padding_h, abc::deconv_is_non_overlapping(p) ? "direct" : "gather", max_err);
+    return max_err;
+}
+
+// Shapes covering the direct and the gather kernel with padding, dilation
+// and output_padding; spatial sizes are odd to hit the row tails.
+static bool check_deconv_shapes() {
+    const abc::DeconvParams shapes[] = {
+        abc::make_deconv_params(2, 2),           abc::make_deconv_params(2, 3, 0, 1, 2),
+        abc::make_deconv_params(3, 2, 1, 1, 1),  abc::make_deconv_params(4, 2, 1),
+        abc::make_deconv_params(3, 1, 1, 2),     abc::make_deconv_params(2, 2, 1, 2, 1),
+    };
+    bool ok = true;
+    for (const abc::DeconvParams &p : shapes) {
+        float err = check_deconv(p, {2, 5, 7, 9}, 6);
+        ok = ok && err >= 0 && err < kMaxError;
+    }
+    return ok;
+}
+
 int main(int argc, char const *argv[])
 {
     clrt().init();
+    if (!check_deconv_shapes()) {
+        LOGE("deconv does not match the reference.");
+        return -1;
+    }
+    // iw is not a multiple of 4 on purpose; the engine handles row tails
     int ic = 8, ih = 30, iw = 30;
-    int oc = 8, oh = 60, ow = 60;
-    int M = oc * 2 * 2;
-    int K = ic;
-    int N = ih * iw;
-    Tensor input_tensor = abc::make_4d_tensor({1, ic, ih, iw});
-    Tensor weight_tensor = abc::make_4d_tensor({ic, oc, 2, 2});
-    Tensor output_tensor = abc::make_4d_tensor({1, oc, oh, ow});
+    int oc = 8;
+    abc::DeconvParams params = abc::make_deconv_params(2, 2);
+    abc::dims4d in_dims = {1, ic, ih, iw};
+    abc::dims4d out_dims = abc::deconv_output_dims(params, in_dims, oc);
+    Tensor input_tensor = abc::make_4d_tensor(in_dims);
+    Tensor weight_tensor = abc::make_4d_tensor({ic, oc, params.kernel_h, params.kernel_w});
+    Tensor output_tensor = abc::make_4d_tensor(out_dims);
 
     abc::alloc_tensor_host_mem(&input_tensor);
     abc::alloc_tensor_cl_mem(&input_tensor);
-    // abc::read_fp16_from_fp32_text("input.txt", input_tensor.num_elem(), input_tensor.hostptr);
+    // abc::read_tensor_file_fp16("input.oclt", input_tensor.num_elem(), input_tensor.hostptr);
     abc::init_fp16_host_mem(input_tensor.num_elem(), abc::UT_INIT_RANDOM, input_tensor.hostptr);
 
     abc::alloc_tensor_host_mem(&weight_tensor);
     abc::alloc_tensor_cl_mem(&weight_tensor);
-    // abc::read_fp16_from_fp32_text("weight.txt", weight_tensor.num_elem(), weight_tensor.hostptr);
+    // abc::read_tensor_file_fp16("weight.oclt", weight_tensor.num_elem(), weight_tensor.hostptr);
     abc::init_fp16_host_mem(weight_tensor.num_elem(), abc::UT_INIT_RANDOM, weight_tensor.hostptr);
 
     abc::alloc_tensor_host_mem(&output_tensor);
@@ -221,30 +145,98 @@ int main(int argc, char const *argv[])
 
     cl_int ret = CL_SUCCESS;
 
-    // Setup the kernel
-    cl_kernel kernel = clrt().create_kernel("deconv_f2s2_nchw", makeDeconvKernelString().c_str(), NULL, &ret);
-    if (CL_SUCCESS != ret) {
-        LOGE("create_kernel failed.");
+    // pass --tune to benchmark local sizes for this shape and store the
+    // winner in the tuning db (OCLABC_TUNING_DB)
+    if (argc > 1 && std::string(argv[1]) == "--tune") {
+        abc::copy_fp16_host_mem_to_cl_mem(input_tensor.num_elem(), input_tensor.hostptr, input_tensor.gptr);
+        abc::copy_fp16_host_mem_to_cl_mem(weight_tensor.num_elem(), weight_tensor.hostptr, weight_tensor.gptr);
+        abc::tune_deconv_fp16(params, in_dims, oc, input_tensor.gptr, weight_tensor.gptr, output_tensor.gptr);
+        clrt().tuner().save();
     }
 
-    cl_uint wd = 2;
-    size_t global[] = {static_cast<size_t>((N + 3) / 4), static_cast<size_t>((M + 3) / 4)};
-    size_t local[] = {32, 16};
-    for (int i = 0; i < wd; ++i) {
-        global[i] = (global[i] + local[i] - 1) / local[i] * local[i];
-    }
+    // upload -> kernel -> download chained through events, one wait at the end
+    auto run_async = [&]() -> cl_int {
+        cl_event uploads[2] = {NULL, NULL}, launch = NULL, download = NULL;
+        ret = abc::copy_fp16_host_mem_to_cl_mem_async(input_tensor.num_elem(), input_tensor.hostptr,
+                                                      input_tensor.gptr, 0, NULL, &uploads[0]);
+        if (CL_SUCCESS == ret) {
+            ret = abc::copy_fp16_host_mem_to_cl_mem_async(weight_tensor.num_elem(), weight_tensor.hostptr,
+                                                          weight_tensor.gptr, 0, NULL, &uploads[1]);
+        }
+        if (CL_SUCCESS == ret) {
+            ret = abc::enqueue_deconv_fp16(params, in_dims, oc, input_tensor.gptr, weight_tensor.gptr,
+                                           output_tensor.gptr, 2, uploads, &launch);
+        }
+        if (CL_SUCCESS == ret) {
+            ret = abc::copy_fp16_cl_mem_to_host_mem_async(output_tensor.num_elem(), output_tensor.gptr,
+                                                          output_tensor.hostptr, 1, &launch, &download);
+        }
+        if (CL_SUCCESS == ret) {
+            ret = clWaitForEvents(1, &download);
+        } else {
+            // let whatever was enqueued finish before the host memory is reused
+            clrt().finish();
+        }
+        for (cl_event event : {uploads[0], uploads[1], launch, download}) {
+            if (event) {
+                clReleaseEvent(event);
+            }
+        }
+        return ret;
+    };
+    // the previous blocking helpers, each stalling the host thread
+    auto run_blocking = [&]() -> cl_int {
+        ret = abc::copy_fp16_host_mem_to_cl_mem(input_tensor.num_elem(), input_tensor.hostptr, input_tensor.gptr);
+        if (CL_SUCCESS == ret) {
+            ret = abc::copy_fp16_host_mem_to_cl_mem(weight_tensor.num_elem(), weight_tensor.hostptr,
+                                                    weight_tensor.gptr);
+        }
+        if (CL_SUCCESS == ret) {
+            ret = abc::enqueue_deconv_fp16(params, in_dims, oc, input_tensor.gptr, weight_tensor.gptr,
+                                           output_tensor.gptr);
+        }
+        if (CL_SUCCESS == ret) {
+            ret = abc::copy_fp16_cl_mem_to_host_mem(output_tensor.num_elem(), output_tensor.gptr,
+                                                    output_tensor.hostptr);
+        }
+        return ret;
+    };
 
-    abc::copy_fp16_host_mem_to_cl_mem(input_tensor.num_elem(), input_tensor.hostptr, input_tensor.gptr);
-    abc::copy_fp16_host_mem_to_cl_mem(weight_tensor.num_elem(), weight_tensor.hostptr, weight_tensor.gptr);
+    if (CL_SUCCESS != (ret = run_async())) {
+        LOGE("Async run failed: %d", ret);
+        return -1;
+    }
 
-    ret = abc::set_kernel_args(kernel, ic, ih, iw, oc, oh, ow, M, N, K, input_tensor.gptr, weight_tensor.gptr, output_tensor.gptr);
-    assert(ret == CL_SUCCESS);
+    std::vector<float> expected;
+    deconv_reference(params, in_dims, out_dims, reinterpret_cast<const cl_half *>(input_tensor.hostptr),
+                     reinterpret_cast<const cl_half *>(weight_tensor.hostptr), &expected);
+    float max_diff = 0;
+    const cl_half *result = reinterpret_cast<const cl_half *>(output_tensor.hostptr);
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+        float d = fabsf(to_float(result[i]) - expected[i]) / fmaxf(1.0f, fabsf(expected[i]));
+        max_diff = d > max_diff ? d : max_diff;
+    }
+    LOGI("max error vs reference: %f", max_diff);
 
-    ret = clEnqueueNDRangeKernel(clrt().profile_queue(), kernel, wd, NULL,
-                                 global, local, 0, NULL, NULL);
-    assert(ret == CL_SUCCESS);
+    const int reps = 50;
+    ret = run_blocking();
+    auto begin = std::chrono::steady_clock::now();
+    for (int r = 0; r < reps && CL_SUCCESS == ret; ++r) {
+        ret = run_blocking();
+    }
+    auto mid = std::chrono::steady_clock::now();
+    for (int r = 0; r < reps && CL_SUCCESS == ret; ++r) {
+        ret = run_async();
+    }
+    if (CL_SUCCESS != ret) {
+        LOGE("Timed runs failed: %d", ret);
+        return -1;
+    }
+    auto end = std::chrono::steady_clock::now();
+    LOGI("end-to-end latency: blocking %.3f ms, async %.3f ms",
+         std::chrono::duration<double, std::milli>(mid - begin).count() / reps,
+         std::chrono::duration<double, std::milli>(end - mid).count() / reps);
 
-    abc::copy_fp16_cl_mem_to_host_mem(output_tensor.num_elem(), output_tensor.gptr, output_tensor.hostptr);
     cl_half *outptr = reinterpret_cast<cl_half *>(output_tensor.hostptr);
     int num_elem = output_tensor.num_elem();
     for (int i = 0; i < num_elem && i < 8; ++i) {
@@ -253,5 +245,12 @@ int main(int argc, char const *argv[])
     }
     printf("\n");
 
-    return 0;
+    abc::ProgramCacheStats cache_stats = clrt().program_cache_stats();
+    LOGI("program cache: %zu hits, %zu misses, %zu stale, %zu stores",
+         cache_stats.hits, cache_stats.misses, cache_stats.stale, cache_stats.stores);
+    abc::MemPoolStats pool_stats = clrt().mem_pool().stats();
+    LOGI("mem pool: %zu bytes in use, %zu cached, %zu peak, hit rate %.2f",
+         pool_stats.bytes_in_use, pool_stats.bytes_cached, pool_stats.peak_bytes, pool_stats.hit_rate());
+
+    return max_diff < kMaxError ? 0 : -1;
 }
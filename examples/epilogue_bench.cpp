@@ -0,0 +1,157 @@
+#include <math.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "deconv.h"
+#include "epilogue.h"
+#include "gemm.h"
+#include "half_float.h"
+#include "log.h"
+#include "tensor.h"
+#include "utils.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "epilogue_bench"
+
+// Fused bias + ReLU + residual epilogue against the same epilogue run as a
+// separate pass over the output. The separate pass reads and writes the
+// output once more on top of reading the residual, i.e. two extra full
+// passes over the output that the fused version saves.
+
+using abc::Tensor;
+using abc::clrt;
+
+// total device time of the commands enqueue() issues, best of reps
+static double min_exec_ns(int reps, const std::function<void(std::vector<cl_event> *)> &enqueue) {
+    double best = -1;
+    for (int r = 0; r <= reps; ++r) {
+        std::vector<cl_event> events;
+        enqueue(&events);
+        clWaitForEvents(events.size(), events.data());
+        double ns = 0;
+        for (cl_event event : events) {
+            ns += abc::get_cl_exec_time(event);
+            clReleaseEvent(event);
+        }
+        if (r > 0 && (best < 0 || ns < best)) {
+            best = ns;
+        }
+    }
+    return best;
+}
+
+static float max_abs_diff(std::size_t num_elem, const void *a, const void *b) {
+    const cl_half *x = reinterpret_cast<const cl_half *>(a);
+    const cl_half *y = reinterpret_cast<const cl_half *>(b);
+    float max_diff = 0;
+    for (std::size_t i = 0; i < num_elem; ++i) {
+        float d = fabsf(to_float(x[i]) - to_float(y[i]));
+        max_diff = d > max_diff ? d : max_diff;
+    }
+    return max_diff;
+}
+
+struct Case {
+    const char *name;
+    abc::dims4d out_dims;
+    // enqueues the op writing to output with the given epilogue
+    std::function<void(cl_mem output, const abc::Epilogue &epilogue, cl_event *event)> run;
+};
+
+static void bench_case(const Case &c, int reps) {
+    Tensor bias = abc::make_4d_tensor({1, 1, 1, c.out_dims.c});
+    Tensor residual = abc::make_4d_tensor(c.out_dims);
+    Tensor out_fused = abc::make_4d_tensor(c.out_dims);
+    Tensor out_split = abc::make_4d_tensor(c.out_dims);
+    Tensor *tensors[] = {&bias, &residual, &out_fused, &out_split};
+    for (Tensor *t : tensors) {
+        abc::alloc_tensor_host_mem(t);
+        abc::alloc_tensor_cl_mem(t);
+    }
+    abc::init_fp16_host_mem(bias.num_elem(), abc::UT_INIT_RANDOM, bias.hostptr);
+    abc::init_fp16_host_mem(residual.num_elem(), abc::UT_INIT_RANDOM, residual.hostptr);
+    abc::copy_fp16_host_mem_to_cl_mem(bias.num_elem(), bias.hostptr, bias.gptr);
+    abc::copy_fp16_host_mem_to_cl_mem(residual.num_elem(), residual.hostptr, residual.gptr);
+
+    abc::Epilogue epilogue;
+    epilogue.bias = bias.gptr;
+    epilogue.residual = residual.gptr;
+    epilogue.activation = abc::ACT_RELU;
+
+    double fused_ns = min_exec_ns(reps, [&](std::vector<cl_event> *events) {
+        events->resize(1);
+        c.run(out_fused.gptr, epilogue, &(*events)[0]);
+    });
+    double split_ns = min_exec_ns(reps, [&](std::vector<cl_event> *events) {
+        events->resize(2);
+        c.run(out_split.gptr, abc::Epilogue(), &(*events)[0]);
+        abc::enqueue_epilogue_fp16(c.out_dims, out_split.gptr, epilogue, 1, &(*events)[0], &(*events)[1]);
+    });
+
+    abc::copy_fp16_cl_mem_to_host_mem(out_fused.num_elem(), out_fused.gptr, out_fused.hostptr);
+    abc::copy_fp16_cl_mem_to_host_mem(out_split.num_elem(), out_split.gptr, out_split.hostptr);
+    double out_mb = out_fused.num_elem() * sizeof(cl_half) / 1e6;
+    // extra traffic past the op itself: fused reads the residual; split
+    // also reads and writes the output again
+    LOGI("%-28s %10.3f %10.3f %10.2f %10.2f %10.4f", c.name, fused_ns / 1000.0, split_ns / 1000.0, out_mb,
+         2 * out_mb, max_abs_diff(out_fused.num_elem(), out_fused.hostptr, out_split.hostptr));
+}
+
+int main(int argc, char const *argv[]) {
+    clrt().init();
+    const int reps = 10;
+    LOGI("bias + relu + residual, best of %d", reps);
+    LOGI("%-28s %10s %10s %10s %10s %10s", "op", "fused(us)", "split(us)", "out(MB)", "saved(MB)", "max_diff");
+
+    // deconv shapes {IC, OC, IH, IW, kernel, stride, pad}
+    const int deconvs[][7] = {{32, 32, 64, 64, 2, 2, 0}, {64, 32, 64, 64, 2, 2, 0}, {32, 16, 64, 64, 3, 2, 1},
+                              {16, 16, 128, 128, 4, 2, 1}};
+    for (const auto &d : deconvs) {
+        abc::DeconvParams params = abc::make_deconv_params(d[4], d[5], d[6]);
+        abc::dims4d in_dims = {1, d[0], d[2], d[3]};
+        Tensor input = abc::make_4d_tensor(in_dims);
+        Tensor weight = abc::make_4d_tensor({d[0], d[1], d[4], d[4]});
+        Tensor *tensors[] = {&input, &weight};
+        for (Tensor *t : tensors) {
+            abc::alloc_tensor_host_mem(t);
+            abc::alloc_tensor_cl_mem(t);
+            abc::init_fp16_host_mem(t->num_elem(), abc::UT_INIT_RANDOM, t->hostptr);
+            abc::copy_fp16_host_mem_to_cl_mem(t->num_elem(), t->hostptr, t->gptr);
+        }
+        std::string name = "deconv ic" + std::to_string(d[0]) + " oc" + std::to_string(d[1]) + " " +
+                           std::to_string(d[2]) + "x" + std::to_string(d[3]) + " k" + std::to_string(d[4]) +
+                           "s" + std::to_string(d[5]);
+        Case c = {name.c_str(), abc::deconv_output_dims(params, in_dims, d[1]),
+                  [&](cl_mem output, const abc::Epilogue &epilogue, cl_event *event) {
+                      abc::enqueue_deconv_fp16(params, in_dims, d[1], input.gptr, weight.gptr, output, 0, NULL,
+                                               event, NULL, epilogue);
+                  }};
+        bench_case(c, reps);
+    }
+
+    // 1x1 conv as gemm {M (out channels), N (pixels), K (in channels)}
+    const int gemms[][3] = {{64, 4096, 64}, {128, 3600, 128}, {256, 1024, 256}};
+    for (const auto &g : gemms) {
+        int M = g[0], N = g[1], K = g[2];
+        Tensor weight = abc::make_4d_tensor({1, 1, K, M});
+        Tensor input = abc::make_4d_tensor({1, 1, K, N});
+        Tensor *tensors[] = {&input, &weight};
+        for (Tensor *t : tensors) {
+            abc::alloc_tensor_host_mem(t);
+            abc::alloc_tensor_cl_mem(t);
+            abc::init_fp16_host_mem(t->num_elem(), abc::UT_INIT_RANDOM, t->hostptr);
+            abc::copy_fp16_host_mem_to_cl_mem(t->num_elem(), t->hostptr, t->gptr);
+        }
+        std::string name = "gemm m" + std::to_string(M) + " n" + std::to_string(N) + " k" + std::to_string(K);
+        Case c = {name.c_str(), {1, M, 1, N}, [&](cl_mem output, const abc::Epilogue &epilogue, cl_event *event) {
+                      abc::enqueue_gemm_fp16(true, false, M, N, K, weight.gptr, input.gptr, output, 0, NULL, event,
+                                             NULL, epilogue);
+                  }};
+        bench_case(c, reps);
+    }
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include <math.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "gemm.h"
+#include "half_float.h"
+#include "log.h"
+#include "tensor.h"
+#include "utils.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "gemm_bench"
+
+// GFLOPS of the tiled gemm in kernel/CL/gemm.cl against the naive kernel
+// from deconv_f2s2_nchw (weights as [K][M], input as [K][N]).
+
+std::string makeNaiveGEMMKernelString() {
+    std::string kernel = _STR(
+        __kernel void gemm_nchw(int M,
+                                int N,
+                                int K,
+                                __global const half *input,
+                                __global const half *weight,
+                                __global half *output) {
+            const int idx = get_global_id(0) << 2;
+            const int idy = get_global_id(1) << 2;
+            if (idx >= N || idy >= M) return;
+            half4 cval[4];
+            cval[0] = (half4)(0);
+            cval[1] = (half4)(0);
+            cval[2] = (half4)(0);
+            cval[3] = (half4)(0);
+            for (int ki = 0; ki < K; ++ki) {
+                half4 weight_val = vload4(0, weight + ki * M + idy);
+                half4 input_val = vload4(0, input + ki * N + idx);
+                cval[0] += weight_val.x * input_val;
+                cval[1] += weight_val.y * input_val;
+                cval[2] += weight_val.z * input_val;
+                cval[3] += weight_val.w * input_val;
+            }
+            vstore4(cval[0], 0, output + idy * N + idx);
+            vstore4(cval[1], 0, output + (idy + 1) * N + idx);
+            vstore4(cval[2], 0, output + (idy + 2) * N + idx);
+            vstore4(cval[3], 0, output + (idy + 3) * N + idx);
+        }
+    );
+    return kernel;
+}
+
+using abc::Tensor;
+using abc::clrt;
+
+static double min_exec_ns(int reps, const std::function<void(cl_event *)> &enqueue) {
+    double best = -1;
+    for (int r = 0; r <= reps; ++r) {
+        cl_event event;
+        enqueue(&event);
+        clWaitForEvents(1, &event);
+        double ns = abc::get_cl_exec_time(event);
+        clReleaseEvent(event);
+        if (r > 0 && (best < 0 || ns < best)) {
+            best = ns;
+        }
+    }
+    return best;
+}
+
+int main(int argc, char const *argv[]) {
+    clrt().init();
+    const int reps = 10;
+    // {M, N, K}; naive needs M and N to be multiples of 4
+    const int shapes[][3] = {{64, 64, 64},    {128, 128, 128}, {256, 256, 256}, {512, 512, 512},
+                             {1024, 1024, 1024}, {32, 3600, 8},  {512, 3600, 128}, {100, 60, 37}};
+    cl_int ret = CL_SUCCESS;
+    cl_kernel naive = clrt().create_kernel("gemm_nchw", makeNaiveGEMMKernelString().c_str(), NULL, &ret);
+    if (CL_SUCCESS != ret) {
+        LOGE("create_kernel failed.");
+        return -1;
+    }
+
+    LOGI("%6s %6s %6s %14s %14s %10s", "M", "N", "K", "naive(GFLOPS)", "tiled(GFLOPS)", "max_diff");
+    for (const auto &shape : shapes) {
+        int M = shape[0], N = shape[1], K = shape[2];
+        Tensor weight = abc::make_4d_tensor({1, 1, K, M});
+        Tensor input = abc::make_4d_tensor({1, 1, K, N});
+        Tensor out_naive = abc::make_4d_tensor({1, 1, M, N});
+        Tensor out_tiled = abc::make_4d_tensor({1, 1, M, N});
+        Tensor *tensors[] = {&weight, &input, &out_naive, &out_tiled};
+        for (Tensor *t : tensors) {
+            abc::alloc_tensor_host_mem(t);
+            abc::alloc_tensor_cl_mem(t);
+        }
+        abc::init_fp16_host_mem(weight.num_elem(), abc::UT_INIT_RANDOM, weight.hostptr);
+        abc::init_fp16_host_mem(input.num_elem(), abc::UT_INIT_RANDOM, input.hostptr);
+        abc::copy_fp16_host_mem_to_cl_mem(weight.num_elem(), weight.hostptr, weight.gptr);
+        abc::copy_fp16_host_mem_to_cl_mem(input.num_elem(), input.hostptr, input.gptr);
+
+        double flops = 2.0 * M * N * K;
+        double naive_gflops = 0;
+        if (M % 4 == 0 && N % 4 == 0) {
+            abc::set_kernel_args(naive, M, N, K, input.gptr, weight.gptr, out_naive.gptr);
+            size_t local[] = {16, 16};
+            size_t work[] = {static_cast<size_t>(N / 4), static_cast<size_t>(M / 4)};
+            size_t global[2];
+            abc::LocalSizeTuner::pad_global_size(2, work, local, global);
+            double ns = min_exec_ns(reps, [&](cl_event *event) {
+                abc::enqueue_kernel_async(naive, 2, global, local, 0, NULL, event);
+            });
+            naive_gflops = flops / ns;
+        }
+        double tiled_ns = min_exec_ns(reps, [&](cl_event *event) {
+            abc::enqueue_gemm_fp16(true, false, M, N, K, weight.gptr, input.gptr, out_tiled.gptr, 0, NULL, event);
+        });
+
+        float max_diff = 0;
+        if (naive_gflops > 0) {
+            abc::copy_fp16_cl_mem_to_host_mem(out_naive.num_elem(), out_naive.gptr, out_naive.hostptr);
+            abc::copy_fp16_cl_mem_to_host_mem(out_tiled.num_elem(), out_tiled.gptr, out_tiled.hostptr);
+            const cl_half *a = reinterpret_cast<const cl_half *>(out_naive.hostptr);
+            const cl_half *b = reinterpret_cast<const cl_half *>(out_tiled.hostptr);
+            for (std::size_t i = 0; i < out_naive.num_elem(); ++i) {
+                float d = fabsf(to_float(a[i]) - to_float(b[i]));
+                max_diff = d > max_diff ? d : max_diff;
+            }
+        }
+        LOGI("%6d %6d %6d %14.2f %14.2f %10.4f", M, N, K, naive_gflops, flops / tiled_ns, max_diff);
+    }
+    clrt().release_kernel(naive);
+    return 0;
+}
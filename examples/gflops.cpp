@@ -1,125 +1,58 @@
-#include <sys/syscall.h>
-#include <sys/time.h>
 #include <sched.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__aarch64__)
+#include <sys/auxv.h>
+#ifndef HWCAP_ASIMDHP
+#define HWCAP_ASIMDHP (1 << 10)
+#endif
+#ifndef HWCAP_ASIMDDP
+#define HWCAP_ASIMDDP (1 << 20)
+#endif
+#elif defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
 #include "log.h"
 
-static int set_thread_affinity(int num)
-{
-    cpu_set_t mask;
-    CPU_ZERO(&mask);
-    CPU_SET(num, &mask);
-    int status = syscall(__NR_sched_setaffinity, gettid(), sizeof(mask), &mask);
-    if (status) {
-        LOGE("fail to set affinity %d", status);
-        return -1;
-    }
-    LOGI("bind core %d", num);
-    return 0;
-}
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "gflops"
 
-static void set_thread_affinity_big() {
-    set_thread_affinity(7);
-}
+// Peak arithmetic throughput of the CPU, per cluster. Clusters are found
+// from /sys/devices/system/cpu (cores with the same maximum frequency), and
+// every cluster is measured on one core and on all its cores with a pinned
+// thread per core. The kernels are picked by what the CPU reports at run
+// time: NEON fp32/fp16/dotprod on aarch64, SSE/AVX2/AVX-512 on x86.
+//
+// usage: gflops [seconds per measurement, default 0.2]
 
-static void set_thread_affinity_mid() {
-    set_thread_affinity(6);
-    set_thread_affinity(5);
-    set_thread_affinity(4);
-}
+struct PeakKernel {
+    const char *name;
+    int64_t ops_per_iter;  // an fma counts as two
+    bool (*supported)();
+    void (*run)(int64_t loop);
+};
 
-static void set_thread_affinity_small() {
-    set_thread_affinity(3);
-    set_thread_affinity(2);
-    set_thread_affinity(1);
-    set_thread_affinity(0);
+static bool always() {
+    return true;
 }
 
-void mvm_row_kernel(uint32_t N, uint32_t K, float *matrix, float *vector, float *result)
-{
-    int KTail = K % 4;
-    int KInner = K - KTail;
-    float *w0 = matrix;
-    float *w1 = matrix + K * N;
-    float *w2 = matrix + K * 2 * N;
-    float *w3 = matrix + K * 3 * N;
-    asm volatile("mov x19, %5\n"
-                 "ld1 {v18.s}[0], [x19]\n"
-                 "add x19, x19, %8\n"
-                 "ld1 {v18.s}[1], [x19]\n"
-                 "add x19, x19, %8\n"
-                 "ld1 {v18.s}[2], [x19]\n"
-                 "add x19, x19, %8\n"
-                 "ld1 {v18.s}[3], [x19]\n"
-
-                 "movi v17.4s, #0x0\n"
-                 "movi v16.4s, #0x0\n"
-                 "movi v9.4s, #0x0\n"
-                 "movi v10.4s, #0x0\n"
-                 "movi v11.4s, #0x0\n"
-                 "movi v12.4s, #0x0\n"
-                 "mov x20, %6\n"
-                 "cmp x20, #0x0\n"
-                 "beq 3f\n"
-                 "0:\n"
-
-                 "ld1 {v0.4s}, [%0], #16\n"
-                 "ld1 {v1.4s}, [%1], #16\n"
-                 "ld1 {v2.4s}, [%2], #16\n"
-                 "ld1 {v3.4s}, [%3], #16\n"
-                 "ld1 {v4.4s}, [%4], #16\n"
-
-                 "fmla v9.4s,  v1.4s, v0.4s\n"
-                 "fmla v10.4s,  v2.4s, v0.4s\n"
-                 "fmla v11.4s,  v3.4s, v0.4s\n"
-                 "fmla v12.4s,  v4.4s, v0.4s\n"
-
-                 "subs x20, x20, #4\n"
-                 "bne 0b\n"
-
-                 "faddp v13.4s,  v9.4s, v10.4s\n"
-                 "faddp v14.4s, v11.4s, v12.4s\n"
-                 "faddp v17.4s, v13.4s, v14.4s\n"
-                 "3:\n"
-                 "mov x16, %7\n"
-                 "cmp x16, #0x0\n"
-                 "beq 2f\n"
-
-                 "1:\n"
-                 "ld1 {v8.s}[0], [%0], #4\n"
-
-                 "ld1 {v1.s}[0], [%1], #4\n"
-                 "ld1 {v1.s}[1], [%2], #4\n"
-                 "ld1 {v1.s}[2], [%3], #4\n"
-                 "ld1 {v1.s}[3], [%4], #4\n"
-                 "fmla v16.4s,  v1.4s, v8.s[0]\n"
-
-                 "subs x16, x16, 0x1\n"
-                 "bne 1b\n"
-
-                 "fadd v17.4s, v17.4s, v16.4s\n"
-
-                 "2:\n"
-
-                 "fadd v17.4s, v17.4s, v18.4s\n"
-                 "mov x19, %5\n"
-                 "st1 {v17.s}[0], [x19]\n"
-                 "add x19, x19, %8\n"
-                 "st1 {v17.s}[1], [x19]\n"
-                 "add x19, x19, %8\n"
-                 "st1 {v17.s}[2], [x19]\n"
-                 "add x19, x19, %8\n"
-                 "st1 {v17.s}[3], [x19]\n"
-                 : "+r"(vector), "+r"(w0), "+r"(w1), "+r"(w2), "+r"(w3), "+r"(result)
-                 : "r"((int64_t)KInner), "r"((int64_t)KTail), "r"((int64_t)N * 4)
-                 : "memory", "cc", "x19", "x20", "x21", "x22", "x23", "x24", "x15", "x16", "v0",
-                 "v1", "v2", "v3", "v4", "v8", "v9", "v10", "v11", "v12", "v13", "v14", "v16",
-                 "v17", "v18");
-}
+#if defined(__aarch64__)
 
-static void freefma_a53(int64_t loop, int64_t *num_mac)
-{
+// 16 independent accumulators hide the fmla latency on every core we ship on.
+static void neon_fp32(int64_t loop) {
     asm volatile(
         "mov x9, %0\n"
         "0:\n"
@@ -127,18 +60,27 @@ static void freefma_a53(int64_t loop, int64_t *num_mac)
         "fmla v1.4s,  v12.4s, v13.s[1]\n"
         "fmla v2.4s,  v12.4s, v13.s[2]\n"
         "fmla v3.4s,  v12.4s, v13.s[3]\n"
-        "subs x9, x9, #1\n"
         "fmla v4.4s,  v12.4s, v13.s[0]\n"
+        "fmla v5.4s,  v12.4s, v13.s[1]\n"
+        "fmla v6.4s,  v12.4s, v13.s[2]\n"
+        "fmla v7.4s,  v12.4s, v13.s[3]\n"
+        "subs x9, x9, #1\n"
+        "fmla v8.4s,  v12.4s, v13.s[0]\n"
+        "fmla v9.4s,  v12.4s, v13.s[1]\n"
+        "fmla v10.4s, v12.4s, v13.s[2]\n"
+        "fmla v11.4s, v12.4s, v13.s[3]\n"
+        "fmla v14.4s, v12.4s, v13.s[0]\n"
+        "fmla v15.4s, v12.4s, v13.s[1]\n"
+        "fmla v16.4s, v12.4s, v13.s[2]\n"
+        "fmla v17.4s, v12.4s, v13.s[3]\n"
         "bne 0b\n"
         :
         : "r"(loop)
-        : "x9", "v0", "v1", "v2", "v3", "v4",
-          "v12", "v13");
-    *num_mac = 5 * 4;
+        : "cc", "x9", "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7", "v8", "v9", "v10", "v11", "v12", "v13",
+          "v14", "v15", "v16", "v17");
 }
 
-static void freefma_f16_a55(int64_t loop, int64_t *num_mac)
-{
+static void neon_fp16(int64_t loop) {
     asm volatile(
         "mov x9, %0\n"
         "0:\n"
@@ -146,139 +88,289 @@ static void freefma_f16_a55(int64_t loop, int64_t *num_mac)
         "fmla v1.8h,  v12.8h, v13.h[1]\n"
         "fmla v2.8h,  v12.8h, v13.h[2]\n"
         "fmla v3.8h,  v12.8h, v13.h[3]\n"
-        "subs x9, x9, #1\n"
         "fmla v4.8h,  v12.8h, v13.h[4]\n"
+        "fmla v5.8h,  v12.8h, v13.h[5]\n"
+        "fmla v6.8h,  v12.8h, v13.h[6]\n"
+        "fmla v7.8h,  v12.8h, v13.h[7]\n"
+        "subs x9, x9, #1\n"
+        "fmla v8.8h,  v12.8h, v13.h[0]\n"
+        "fmla v9.8h,  v12.8h, v13.h[1]\n"
+        "fmla v10.8h, v12.8h, v13.h[2]\n"
+        "fmla v11.8h, v12.8h, v13.h[3]\n"
+        "fmla v14.8h, v12.8h, v13.h[4]\n"
+        "fmla v15.8h, v12.8h, v13.h[5]\n"
+        "fmla v16.8h, v12.8h, v13.h[6]\n"
+        "fmla v17.8h, v12.8h, v13.h[7]\n"
         "bne 0b\n"
         :
         : "r"(loop)
-        : "x9", "v0", "v1", "v2", "v3", "v4", "v12", "v13");
-    *num_mac = 5 * 8;
+        : "cc", "x9", "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7", "v8", "v9", "v10", "v11", "v12", "v13",
+          "v14", "v15", "v16", "v17");
 }
 
-static void freefma_a76(int64_t loop, int64_t *num_mac)
-{
+// sdot: 16 int8 multiply-adds per instruction
+static void neon_dotprod(int64_t loop) {
     asm volatile(
         "mov x9, %0\n"
         "0:\n"
-        "fmla v0.4s,  v12.4s, v13.s[0]\n"
-        "fmla v1.4s,  v12.4s, v13.s[1]\n"
-        "fmla v2.4s,  v12.4s, v13.s[2]\n"
-        "fmla v3.4s,  v12.4s, v13.s[3]\n"
+        "sdot v0.4s,  v12.16b, v13.4b[0]\n"
+        "sdot v1.4s,  v12.16b, v13.4b[1]\n"
+        "sdot v2.4s,  v12.16b, v13.4b[2]\n"
+        "sdot v3.4s,  v12.16b, v13.4b[3]\n"
+        "sdot v4.4s,  v12.16b, v13.4b[0]\n"
+        "sdot v5.4s,  v12.16b, v13.4b[1]\n"
+        "sdot v6.4s,  v12.16b, v13.4b[2]\n"
+        "sdot v7.4s,  v12.16b, v13.4b[3]\n"
         "subs x9, x9, #1\n"
-        "fmla v4.4s,  v12.4s, v13.s[0]\n"
-        "fmla v5.4s,  v12.4s, v13.s[1]\n"
-        "fmla v6.4s,  v12.4s, v13.s[2]\n"
-        "fmla v7.4s,  v12.4s, v13.s[3]\n"
+        "sdot v8.4s,  v12.16b, v13.4b[0]\n"
+        "sdot v9.4s,  v12.16b, v13.4b[1]\n"
+        "sdot v10.4s, v12.16b, v13.4b[2]\n"
+        "sdot v11.4s, v12.16b, v13.4b[3]\n"
+        "sdot v14.4s, v12.16b, v13.4b[0]\n"
+        "sdot v15.4s, v12.16b, v13.4b[1]\n"
+        "sdot v16.4s, v12.16b, v13.4b[2]\n"
+        "sdot v17.4s, v12.16b, v13.4b[3]\n"
         "bne 0b\n"
         :
         : "r"(loop)
-        : "x9", "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7",
-          "v12", "v13");
-    *num_mac = 8 * 4;
+        : "cc", "x9", "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7", "v8", "v9", "v10", "v11", "v12", "v13",
+          "v14", "v15", "v16", "v17");
 }
 
-static void freefma_x1(int64_t loop, int64_t *num_mac)
-{
-    asm volatile(
-        "mov x9, %0\n"
-        "0:\n"
-        "fmla v0.4s,  v12.4s, v13.s[0]\n"
-        "fmla v1.4s,  v12.4s, v13.s[1]\n"
-        "fmla v2.4s,  v12.4s, v13.s[2]\n"
-        "fmla v3.4s,  v12.4s, v13.s[3]\n"
+static bool has_fp16() {
+    return (getauxval(AT_HWCAP) & HWCAP_ASIMDHP) != 0;
+}
 
-        "fmla v4.4s,  v12.4s, v13.s[0]\n"
-        "fmla v5.4s,  v12.4s, v13.s[1]\n"
-        "fmla v6.4s,  v12.4s, v13.s[2]\n"
-        "fmla v7.4s,  v12.4s, v13.s[3]\n"
+static bool has_dotprod() {
+    return (getauxval(AT_HWCAP) & HWCAP_ASIMDDP) != 0;
+}
 
-        "subs x9, x9, #1\n"
+static const PeakKernel kKernels[] = {
+    {"neon fp32 fmla", 16 * 4 * 2, always, neon_fp32},
+    {"neon fp16 fmla", 16 * 8 * 2, has_fp16, neon_fp16},
+    {"neon int8 sdot", 16 * 16 * 2, has_dotprod, neon_dotprod},
+};
 
-        "fmla v8.4s,  v12.4s, v13.s[0]\n"
-        "fmla v9.4s,  v12.4s, v13.s[1]\n"
-        "fmla v10.4s,  v12.4s, v13.s[2]\n"
-        "fmla v11.4s,  v12.4s, v13.s[3]\n"
+#elif defined(__x86_64__) || defined(__i386__)
 
-        "fmla v14.4s,  v12.4s, v13.s[0]\n"
-        "fmla v15.4s,  v12.4s, v13.s[1]\n"
-        "fmla v16.4s,  v12.4s, v13.s[2]\n"
-        "fmla v17.4s,  v12.4s, v13.s[3]\n"
-        "bne 0b\n"
-        :
-        : "r"(loop)
-        : "x9", "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7",
-          "v12", "v13", "v14", "v15", "v16", "v17");
-    *num_mac = 16 * 4;
+// The operands come from volatiles so nothing folds at compile time, and
+// the accumulators go to a volatile sink so the chains stay live. Twelve
+// of them cover the latency * throughput of two FMA ports.
+static volatile float g_init = 0.5f, g_mul = 0.999f, g_add = 0.001f;
+static volatile float g_sink;
+
+template <typename V>
+static float sum_lanes(const V &v) {
+    const float *f = reinterpret_cast<const float *>(&v);
+    float s = 0;
+    for (std::size_t i = 0; i < sizeof(V) / sizeof(float); ++i) {
+        s += f[i];
+    }
+    return s;
 }
 
-int main(int argc, char const *argv[])
-{
-    int64_t loop = 1024 * 1024 * 1024;
-    int64_t warmup = 1024 * 1024;
-    {
-        set_thread_affinity_small();
-        int64_t macs = 0;
-        freefma_a53(warmup, &macs);
-        timeval begin, end;
-        gettimeofday(&begin, NULL);
-        freefma_a53(loop, &macs);
-        gettimeofday(&end, NULL);
-        float lt = (end.tv_sec - begin.tv_sec) * 1000.0f +
-                   (end.tv_usec - begin.tv_usec) / 1000.0f;
-        float gfp = loop * macs * 2.0f / lt * 1000.0f / 1000.0f /
-                    1000.0f / 1000.0f;
-        LOGI("time elapsed: %.4f ms", lt);
-        LOGI("F32 GFLOPS: %.4f", gfp);
+#define DECLARE_ACCS(T, INIT) T a0 = INIT, a1 = INIT, a2 = INIT, a3 = INIT, a4 = INIT, a5 = INIT, \
+    a6 = INIT, a7 = INIT, a8 = INIT, a9 = INIT, a10 = INIT, a11 = INIT
+#define APPLY_ACCS(OP) OP(a0); OP(a1); OP(a2); OP(a3); OP(a4); OP(a5); OP(a6); OP(a7); OP(a8); OP(a9); \
+    OP(a10); OP(a11)
+#define SUM_ACCS (sum_lanes(a0) + sum_lanes(a1) + sum_lanes(a2) + sum_lanes(a3) + sum_lanes(a4) + \
+    sum_lanes(a5) + sum_lanes(a6) + sum_lanes(a7) + sum_lanes(a8) + sum_lanes(a9) + sum_lanes(a10) + \
+    sum_lanes(a11))
+
+// no fma before AVX2: a separate mul and add per lane
+static void sse_fp32(int64_t loop) {
+    const __m128 b = _mm_set1_ps(g_mul), c = _mm_set1_ps(g_add);
+    DECLARE_ACCS(__m128, _mm_set1_ps(g_init));
+#define SSE_OP(a) a = _mm_add_ps(_mm_mul_ps(a, b), c)
+    for (int64_t i = 0; i < loop; ++i) {
+        APPLY_ACCS(SSE_OP);
     }
+#undef SSE_OP
+    g_sink = SUM_ACCS;
+}
 
-    {
-        set_thread_affinity_small();
-        int64_t macs = 0;
-        freefma_f16_a55(warmup, &macs);
-        timeval begin, end;
-        gettimeofday(&begin, NULL);
-        freefma_f16_a55(loop, &macs);
-        gettimeofday(&end, NULL);
-        float lt = (end.tv_sec - begin.tv_sec) * 1000.0f +
-                   (end.tv_usec - begin.tv_usec) / 1000.0f;
-        float gfp = loop * macs * 2.0f / lt * 1000.0f / 1000.0f /
-                    1000.0f / 1000.0f;
-        LOGI("time elapsed: %.4f ms", lt);
-        LOGI("F16 GFLOPS: %.4f", gfp);
+__attribute__((target("avx2,fma"))) static void avx2_fp32(int64_t loop) {
+    const __m256 b = _mm256_set1_ps(g_mul), c = _mm256_set1_ps(g_add);
+    DECLARE_ACCS(__m256, _mm256_set1_ps(g_init));
+#define AVX2_OP(a) a = _mm256_fmadd_ps(a, b, c)
+    for (int64_t i = 0; i < loop; ++i) {
+        APPLY_ACCS(AVX2_OP);
     }
+#undef AVX2_OP
+    g_sink = SUM_ACCS;
+}
 
-    {
-        set_thread_affinity_mid();
-        int64_t macs = 0;
-        freefma_a76(warmup, &macs);
-        timeval begin, end;
-        gettimeofday(&begin, NULL);
-        freefma_a76(loop, &macs);
-        gettimeofday(&end, NULL);
-        float lt = (end.tv_sec - begin.tv_sec) * 1000.0f +
-                   (end.tv_usec - begin.tv_usec) / 1000.0f;
-        float gfp = loop * macs * 2.0f / lt * 1000.0f / 1000.0f /
-                    1000.0f / 1000.0f;
-        LOGI("time elapsed: %.4f ms", lt);
-        LOGI("F32 GFLOPS: %.4f", gfp);
+__attribute__((target("avx512f"))) static void avx512_fp32(int64_t loop) {
+    const __m512 b = _mm512_set1_ps(g_mul), c = _mm512_set1_ps(g_add);
+    DECLARE_ACCS(__m512, _mm512_set1_ps(g_init));
+#define AVX512_OP(a) a = _mm512_fmadd_ps(a, b, c)
+    for (int64_t i = 0; i < loop; ++i) {
+        APPLY_ACCS(AVX512_OP);
     }
+#undef AVX512_OP
+    g_sink = SUM_ACCS;
+}
+
+static bool has_avx2_fma() {
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+
+static bool has_avx512f() {
+    return __builtin_cpu_supports("avx512f");
+}
+
+static const PeakKernel kKernels[] = {
+    {"sse fp32 mul+add", 12 * 4 * 2, always, sse_fp32},
+    {"avx2 fp32 fma", 12 * 8 * 2, has_avx2_fma, avx2_fp32},
+    {"avx512 fp32 fma", 12 * 16 * 2, has_avx512f, avx512_fp32},
+};
+
+#else
+#error "gflops: no peak kernels for this architecture"
+#endif
+
+struct CpuCluster {
+    long max_khz;  // 0 when cpufreq is not exposed
+    std::vector<int> cpus;
+};
 
-    {
-        set_thread_affinity_big();
-        int64_t macs = 0;
-        freefma_a76(warmup, &macs);
-        timeval begin, end;
-        gettimeofday(&begin, NULL);
-        freefma_a76(loop, &macs);
-        gettimeofday(&end, NULL);
-        float lt = (end.tv_sec - begin.tv_sec) * 1000.0f +
-                   (end.tv_usec - begin.tv_usec) / 1000.0f;
-        float gfp = loop * macs * 2.0f / lt * 1000.0f / 1000.0f /
-                    1000.0f / 1000.0f;
-        LOGI("time elapsed: %.4f ms", lt);
-        LOGI("F32 GFLOPS: %.4f", gfp);
+static long read_long(const std::string &path, long fallback) {
+    FILE *f = fopen(path.c_str(), "r");
+    if (!f) {
+        return fallback;
     }
+    long v = fallback;
+    if (fscanf(f, "%ld", &v) != 1) {
+        v = fallback;
+    }
+    fclose(f);
+    return v;
+}
 
-    return 0;
+// Groups the CPUs we may run on by cpuinfo_max_freq, fastest cluster
+// first. That splits big.LITTLE parts into their clusters and leaves
+// homogeneous hosts as a single one.
+static std::vector<CpuCluster> discover_clusters() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            CPU_SET(cpu, &allowed);
+        }
+    }
+    long num_cpus = sysconf(_SC_NPROCESSORS_CONF);
+    std::vector<CpuCluster> clusters;
+    for (int cpu = 0; cpu < num_cpus && cpu < CPU_SETSIZE; ++cpu) {
+        std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+        if (!CPU_ISSET(cpu, &allowed) || read_long(dir + "/online", 1) == 0) {
+            continue;
+        }
+        long khz = read_long(dir + "/cpufreq/cpuinfo_max_freq", 0);
+        auto it = std::find_if(clusters.begin(), clusters.end(),
+                               [khz](const CpuCluster &c) { return c.max_khz == khz; });
+        if (it == clusters.end()) {
+            clusters.push_back(CpuCluster{khz, std::vector<int>()});
+            it = clusters.end() - 1;
+        }
+        it->cpus.push_back(cpu);
+    }
+    std::sort(clusters.begin(), clusters.end(),
+              [](const CpuCluster &a, const CpuCluster &b) { return a.max_khz > b.max_khz; });
+    return clusters;
 }
 
+static int set_thread_affinity(int cpu) {
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(cpu, &mask);
+    int status = sched_setaffinity(0, sizeof(mask), &mask);
+    if (status) {
+        LOGE("fail to bind core %d: %d", cpu, status);
+    }
+    return status;
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// Iterations that take about target_s on the calling thread's core.
+static int64_t calibrate(const PeakKernel &k, double target_s) {
+    int64_t loop = 1 << 16;
+    k.run(loop);  // warmup, lets the governor ramp up
+    for (;;) {
+        auto t0 = std::chrono::steady_clock::now();
+        k.run(loop);
+        double s = seconds_since(t0);
+        if (s > target_s / 10 || loop > (int64_t(1) << 40)) {
+            return std::max<int64_t>(1, static_cast<int64_t>(loop * target_s / s));
+        }
+        loop *= 8;
+    }
+}
+
+// GOPS of k on all of cpus at once, one pinned thread per core, started
+// together and timed until the last one finishes.
+static double measure(const PeakKernel &k, const std::vector<int> &cpus, int64_t loop) {
+    std::atomic<int> ready(0);
+    std::atomic<bool> go(false);
+    std::vector<double> seconds(cpus.size(), 0);
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < cpus.size(); ++i) {
+        threads.emplace_back([&, i]() {
+            set_thread_affinity(cpus[i]);
+            k.run(loop / 16);  // warmup
+            ready.fetch_add(1);
+            while (!go.load()) {
+            }
+            auto t0 = std::chrono::steady_clock::now();
+            k.run(loop);
+            seconds[i] = seconds_since(t0);
+        });
+    }
+    while (ready.load() < static_cast<int>(cpus.size())) {
+    }
+    go.store(true);
+    for (std::thread &t : threads) {
+        t.join();
+    }
+    double slowest = *std::max_element(seconds.begin(), seconds.end());
+    return static_cast<double>(loop) * k.ops_per_iter * cpus.size() / slowest / 1e9;
+}
+
+int main(int argc, char const *argv[]) {
+    double target_s = argc > 1 ? atof(argv[1]) : 0.2;
+    if (target_s <= 0) {
+        LOGE("usage: %s [seconds per measurement]", argv[0]);
+        return 1;
+    }
+    std::vector<CpuCluster> clusters = discover_clusters();
+    if (clusters.empty()) {
+        LOGE("no usable cpu found");
+        return 1;
+    }
+    for (std::size_t c = 0; c < clusters.size(); ++c) {
+        const CpuCluster &cluster = clusters[c];
+        std::string cpus;
+        for (int cpu : cluster.cpus) {
+            cpus += (cpus.empty() ? "" : ",") + std::to_string(cpu);
+        }
+        LOGI("cluster %zu: cpus %s, max %ld MHz", c, cpus.c_str(), cluster.max_khz / 1000);
+        for (const PeakKernel &k : kKernels) {
+            if (!k.supported()) {
+                LOGI("  %-18s not supported", k.name);
+                continue;
+            }
+            set_thread_affinity(cluster.cpus[0]);
+            int64_t loop = calibrate(k, target_s);
+            double single = measure(k, std::vector<int>(1, cluster.cpus[0]), loop);
+            double all = measure(k, cluster.cpus, loop);
+            // ops per cycle tells the core's SIMD width and issue rate apart
+            // from its clock
+            double per_cycle = cluster.max_khz > 0 ? single * 1e6 / cluster.max_khz : 0;
+            LOGI("  %-18s 1 core %9.2f GOPS (%5.1f ops/cycle), %zu cores %9.2f GOPS", k.name, single, per_cycle,
+                 cluster.cpus.size(), all);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,167 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <functional>
+#include <vector>
+
+#include "command_graph.h"
+#include "gemm.h"
+#include "log.h"
+#include "tensor.h"
+#include "utils.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "graph_bench"
+
+// Launch rate of a stack of small 1x1 convolutions (gemm + bias + relu),
+// enqueued layer by layer through the library (eager) against a captured
+// CommandGraph replayed as is and replayed with its input rebound every
+// run. Host is the enqueue time per run, launches/s counts kernels over the
+// whole loop including the device. The replays and the rebound replay must
+// produce the output of the eager run on the same input.
+//
+// usage: graph_bench [runs] [layers] [channels] [pixels]
+
+using abc::Tensor;
+using abc::clrt;
+
+static Tensor device_tensor(const abc::dims4d &dims) {
+    Tensor t = abc::make_4d_tensor(dims);
+    abc::alloc_tensor_host_mem(&t);
+    abc::alloc_tensor_cl_mem(&t);
+    abc::init_fp16_host_mem(t.num_elem(), abc::UT_INIT_RANDOM, t.hostptr);
+    abc::copy_fp16_host_mem_to_cl_mem(t.num_elem(), t.hostptr, t.gptr);
+    return t;
+}
+
+// host microseconds per run and launches per second of the whole loop
+static cl_int time_runs(const char *mode, int runs, int launches_per_run, cl_command_queue queue,
+                        const std::function<cl_int(int)> &run) {
+    cl_int ret = run(0);  // warmup
+    clFinish(queue);
+    if (CL_SUCCESS != ret) {
+        LOGE("%s run failed: %d", mode, ret);
+        return ret;
+    }
+    double host_us = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int r = 0; r < runs; ++r) {
+        auto t0 = std::chrono::steady_clock::now();
+        if (CL_SUCCESS != (ret = run(r))) {
+            LOGE("%s run failed: %d", mode, ret);
+            clFinish(queue);
+            return ret;
+        }
+        host_us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+    }
+    clFinish(queue);
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    LOGI("%-16s host %8.1f us/run  %10.0f launches/s", mode, host_us / runs, (double)runs * launches_per_run / sec);
+    return CL_SUCCESS;
+}
+
+// Runs once, waits and reads output back into *data.
+static cl_int run_and_read(cl_command_queue queue, const std::function<cl_int()> &run, Tensor *output,
+                           std::vector<cl_half> *data) {
+    cl_int ret = run();
+    cl_int finish = clFinish(queue);
+    ret = CL_SUCCESS == ret ? finish : ret;
+    data->resize(output->num_elem());
+    if (CL_SUCCESS == ret) {
+        ret = abc::copy_fp16_cl_mem_to_host_mem(output->num_elem(), output->gptr, data->data());
+    }
+    return ret;
+}
+
+int main(int argc, char const *argv[]) {
+    clrt().init();
+    const int runs = argc > 1 ? atoi(argv[1]) : 200;
+    const int layers = argc > 2 ? atoi(argv[2]) : 16;
+    const int C = argc > 3 ? atoi(argv[3]) : 32;
+    const int P = argc > 4 ? atoi(argv[4]) : 256;
+    cl_command_queue queue = clrt().queue();
+
+    std::vector<Tensor> weights, biases;
+    for (int l = 0; l < layers; ++l) {
+        weights.push_back(device_tensor({1, 1, C, C}));
+        biases.push_back(device_tensor({1, 1, 1, C}));
+    }
+    Tensor inputs[] = {device_tensor({1, 1, C, P}), device_tensor({1, 1, C, P})};
+    Tensor act[] = {device_tensor({1, 1, C, P}), device_tensor({1, 1, C, P})};
+
+    // layer l reads in (act[l % 2] after the first) and writes act[(l + 1) % 2]
+    auto forward = [&](cl_mem in) {
+        cl_int ret = CL_SUCCESS;
+        for (int l = 0; l < layers && CL_SUCCESS == ret; ++l) {
+            abc::Epilogue epilogue;
+            epilogue.bias = biases[l].gptr;
+            epilogue.activation = abc::ACT_RELU;
+            cl_mem src = l == 0 ? in : act[l % 2].gptr;
+            ret = abc::enqueue_gemm_fp16(false, false, C, P, C, weights[l].gptr, src, act[(l + 1) % 2].gptr, 0, NULL,
+                                         NULL, queue, epilogue);
+        }
+        return ret;
+    };
+
+    LOGI("%d layers of %dx%d gemm over %d pixels", layers, C, C, P);
+    if (CL_SUCCESS != time_runs("eager", runs, layers, queue, [&](int r) {
+            cl_int ret = forward(inputs[r % 2].gptr);
+            return CL_SUCCESS == ret ? clFlush(queue) : ret;
+        })) {
+        return -1;
+    }
+    // what the graph has to reproduce, for each input
+    Tensor *output = &act[layers % 2];
+    std::vector<cl_half> expected[2];
+    for (int i = 0; i < 2; ++i) {
+        if (CL_SUCCESS != run_and_read(queue, [&]() { return forward(inputs[i].gptr); }, output, &expected[i])) {
+            LOGE("Eager run failed.");
+            return -1;
+        }
+    }
+
+    abc::CommandGraph graph;
+    cl_int ret = graph.begin_capture(queue);
+    if (CL_SUCCESS == ret) {
+        ret = forward(inputs[0].gptr);
+        cl_int end = graph.end_capture();
+        ret = CL_SUCCESS == ret ? end : ret;
+    }
+    if (CL_SUCCESS != ret) {
+        LOGE("Capture failed: %d", ret);
+        return -1;
+    }
+    LOGI("captured %zu commands, replay through %s", graph.num_commands(),
+         graph.uses_command_buffer() ? "cl_khr_command_buffer" : "pre-bound enqueues");
+
+    // one run against the eager output on the same input
+    auto matches_eager = [&](const char *mode, int input, const std::function<cl_int()> &run) {
+        std::vector<cl_half> actual;
+        if (CL_SUCCESS != run_and_read(queue, run, output, &actual)) {
+            LOGE("%s run failed.", mode);
+            return false;
+        }
+        const std::vector<cl_half> &want = expected[input];
+        const bool same = memcmp(actual.data(), want.data(), want.size() * sizeof(cl_half)) == 0;
+        LOGI("%-18s %s the eager output", mode, same ? "matches" : "DIFFERS from");
+        return same;
+    };
+    if (!matches_eager("graph", 0, [&]() { return graph.replay(); })) {
+        return -1;
+    }
+    if (CL_SUCCESS != time_runs("graph", runs, layers, queue, [&](int) { return graph.replay(); }) ||
+        CL_SUCCESS != time_runs("graph rebinding", runs, layers, queue, [&](int r) {
+            return graph.replay({{inputs[0].gptr, inputs[r % 2].gptr}});
+        })) {
+        return -1;
+    }
+    // a binding holds for later replays until bound to something else
+    bool ok = matches_eager("graph rebound", 1, [&]() { return graph.replay({{inputs[0].gptr, inputs[1].gptr}}); });
+    ok = ok && matches_eager("graph kept", 1, [&]() { return graph.replay(); });
+    ok = ok && matches_eager("graph rebound back", 0,
+                             [&]() { return graph.replay({{inputs[0].gptr, inputs[0].gptr}}); });
+    return ok ? 0 : -1;
+}
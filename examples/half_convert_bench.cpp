@@ -0,0 +1,113 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "half_convert.h"
+#include "log.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "half_convert_bench"
+
+// Throughput of the bulk fp16 <-> fp32 conversions: the to_half()/to_float()
+// loops, the SIMD kernel on one thread and on every core. Also checks that
+// the fast paths are bit-exact with the scalar ones, on every fp16 value and
+// on a sweep of fp32 bit patterns (every one of them with --exhaustive).
+//
+// usage: half_convert_bench [num_elem, default 16M] [--exhaustive]
+
+static double best_seconds(int reps, const std::function<void()> &run) {
+    double best = -1;
+    for (int r = 0; r <= reps; ++r) {
+        auto t0 = std::chrono::steady_clock::now();
+        run();
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        if (r > 0 && (best < 0 || s < best)) {
+            best = s;
+        }
+    }
+    return best;
+}
+
+// fp32 bit patterns base, base + step, ... covering zeros, subnormals,
+// the fp16 range edges, infinities and NaNs of both signs
+static long check_f32_to_f16(uint64_t step) {
+    const std::size_t chunk = 1 << 22;
+    std::vector<uint32_t> bits(chunk);
+    std::vector<cl_half> fast(chunk), ref(chunk);
+    long mismatches = 0;
+    for (uint64_t base = 0; base < (1ull << 32); base += chunk * step) {
+        std::size_t n = 0;
+        for (; n < chunk && base + n * step < (1ull << 32); ++n) {
+            bits[n] = static_cast<uint32_t>(base + n * step);
+        }
+        const float *src = reinterpret_cast<const float *>(bits.data());
+        abc::convert_f32_to_f16(n, src, fast.data());
+        abc::convert_f32_to_f16_scalar(n, src, ref.data());
+        for (std::size_t i = 0; i < n; ++i) {
+            if (fast[i] != ref[i] && mismatches++ < 8) {
+                LOGE("f32 0x%08x: 0x%04x, to_half 0x%04x", bits[i], fast[i], ref[i]);
+            }
+        }
+    }
+    return mismatches;
+}
+
+static long check_f16_to_f32() {
+    std::vector<cl_half> h(1 << 16);
+    for (std::size_t i = 0; i < h.size(); ++i) {
+        h[i] = static_cast<cl_half>(i);
+    }
+    std::vector<float> fast(h.size()), ref(h.size());
+    abc::convert_f16_to_f32(h.size(), h.data(), fast.data());
+    abc::convert_f16_to_f32_scalar(h.size(), h.data(), ref.data());
+    long mismatches = 0;
+    for (std::size_t i = 0; i < h.size(); ++i) {
+        mismatches += memcmp(&fast[i], &ref[i], sizeof(float)) != 0;
+    }
+    return mismatches;
+}
+
+int main(int argc, char const *argv[]) {
+    std::size_t n = 16 << 20;
+    bool exhaustive = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--exhaustive") == 0) {
+            exhaustive = true;
+        } else {
+            n = strtoull(argv[i], NULL, 10);
+        }
+    }
+
+    long bad16 = check_f16_to_f32();
+    long bad32 = check_f32_to_f16(exhaustive ? 1 : 4099);
+    LOGI("bit-exact check: f16->f32 %ld, f32->f16 %ld mismatches (%s)", bad16, bad32,
+         exhaustive ? "all fp32 values" : "every 4099th fp32 value");
+
+    std::vector<float> f32(n), back(n);
+    std::vector<cl_half> f16(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        f32[i] = (static_cast<int>(i % 2001) - 1000) * 0.37f;
+    }
+    const int reps = 5;
+    const int cores = std::max(1u, std::thread::hardware_concurrency());
+    const double mb = n * (sizeof(float) + sizeof(cl_half)) / 1e6;
+    LOGI("%zu elements, simd kernel: %s, %d cores, best of %d", n, abc::half_convert_isa(), cores, reps);
+    LOGI("%-12s %12s %12s %12s", "", "scalar", "1 thread", "all cores");
+    double s = best_seconds(reps, [&]() { abc::convert_f32_to_f16_scalar(n, f32.data(), f16.data()); });
+    double t1 = best_seconds(reps, [&]() { abc::convert_f32_to_f16(n, f32.data(), f16.data(), 1); });
+    double tn = best_seconds(reps, [&]() { abc::convert_f32_to_f16(n, f32.data(), f16.data(), cores); });
+    LOGI("%-12s %9.0f MB/s %9.0f MB/s %9.0f MB/s", "f32 -> f16", mb / s, mb / t1, mb / tn);
+    s = best_seconds(reps, [&]() { abc::convert_f16_to_f32_scalar(n, f16.data(), back.data()); });
+    t1 = best_seconds(reps, [&]() { abc::convert_f16_to_f32(n, f16.data(), back.data(), 1); });
+    tn = best_seconds(reps, [&]() { abc::convert_f16_to_f32(n, f16.data(), back.data(), cores); });
+    LOGI("%-12s %9.0f MB/s %9.0f MB/s %9.0f MB/s", "f16 -> f32", mb / s, mb / t1, mb / tn);
+    return bad16 || bad32 ? 1 : 0;
+}
@@ -0,0 +1,209 @@
+#include <math.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "cl_kernel_source.h"
+#include "gemm.h"
+#include "half_float.h"
+#include "log.h"
+#include "tensor.h"
+#include "utils.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "image_bench"
+
+// Image (NC4HW4, texture cache) vs buffer (NCHW) storage for the same
+// 1x1-conv gemm and 2x2 stride 2 deconv. The buffer gemm is the tiled
+// kernel from kernel/CL/gemm.cl; the buffer deconv below does the same work
+// per work-item as deconv_f2s2_nc4hw4_image so only the storage differs.
+
+std::string makeDeconvBufferKernelString() {
+    std::string kernel = _STR(
+        // weight is [IC][OC][2][2]; OC must be a multiple of 4
+        __kernel void deconv_f2s2_nchw_buffer(int IC,
+                                              int OC,
+                                              int IH,
+                                              int IW,
+                                              __global const half *input,
+                                              __global const half *weight,
+                                              __global half *output) {
+            const int iw = get_global_id(0);
+            const int oc4 = get_global_id(1);
+            const int ih = get_global_id(2);
+            if (iw >= IW || (oc4 << 2) >= OC || ih >= IH) return;
+            half16 acc = (half16)(0);
+            for (int ic = 0; ic < IC; ++ic) {
+                half in = input[(ic * IH + ih) * IW + iw];
+                acc += in * vload16(0, weight + (ic * OC + (oc4 << 2)) * 4);
+            }
+            const int OH = IH << 1;
+            const int OW = IW << 1;
+            __global half *out = output + ((oc4 << 2) * OH + (ih << 1)) * OW + (iw << 1);
+            const int plane = OH * OW;
+            vstore2(acc.s01, 0, out);
+            vstore2(acc.s23, 0, out + OW);
+            vstore2(acc.s45, 0, out + plane);
+            vstore2(acc.s67, 0, out + plane + OW);
+            vstore2(acc.s89, 0, out + 2 * plane);
+            vstore2(acc.sab, 0, out + 2 * plane + OW);
+            vstore2(acc.scd, 0, out + 3 * plane);
+            vstore2(acc.sef, 0, out + 3 * plane + OW);
+        }
+    );
+    return kernel;
+}
+
+using abc::Tensor;
+using abc::clrt;
+
+static double min_exec_ns(int reps, const std::function<void(cl_event *)> &enqueue) {
+    double best = -1;
+    for (int r = 0; r <= reps; ++r) {
+        cl_event event;
+        enqueue(&event);
+        clWaitForEvents(1, &event);
+        double ns = abc::get_cl_exec_time(event);
+        clReleaseEvent(event);
+        if (r > 0 && (best < 0 || ns < best)) {
+            best = ns;
+        }
+    }
+    return best;
+}
+
+static float max_abs_diff(std::size_t num_elem, const void *a, const void *b) {
+    const cl_half *x = reinterpret_cast<const cl_half *>(a);
+    const cl_half *y = reinterpret_cast<const cl_half *>(b);
+    float max_diff = 0;
+    for (std::size_t i = 0; i < num_elem; ++i) {
+        float d = fabsf(to_float(x[i]) - to_float(y[i]));
+        max_diff = d > max_diff ? d : max_diff;
+    }
+    return max_diff;
+}
+
+static void bench_gemm(int reps) {
+    // {K, M, H, W}: input {1, K, H, W}, output {1, M, H, W}
+    const int shapes[][4] = {{32, 32, 60, 60}, {64, 64, 60, 60}, {128, 128, 30, 30}, {256, 256, 16, 16}};
+    LOGI("gemm (1x1 conv)");
+    LOGI("%5s %5s %5s %5s %14s %14s %10s", "K", "M", "H", "W", "buffer(GFLOPS)", "image(GFLOPS)", "max_diff");
+    for (const auto &shape : shapes) {
+        int K = shape[0], M = shape[1], H = shape[2], W = shape[3];
+        Tensor weight = abc::make_4d_tensor({1, 1, K, M});
+        Tensor input = abc::make_4d_tensor({1, K, H, W});
+        Tensor out_buffer = abc::make_4d_tensor({1, M, H, W});
+        Tensor input_image = abc::make_4d_tensor({1, K, H, W});
+        Tensor out_image = abc::make_4d_tensor({1, M, H, W});
+        Tensor *buffers[] = {&weight, &input, &out_buffer};
+        for (Tensor *t : buffers) {
+            abc::alloc_tensor_host_mem(t);
+            abc::alloc_tensor_cl_mem(t);
+        }
+        abc::alloc_tensor_host_mem(&out_image);
+        if (abc::alloc_tensor_image_mem(&input_image) != CL_SUCCESS ||
+            abc::alloc_tensor_image_mem(&out_image) != CL_SUCCESS) {
+            continue;
+        }
+        abc::init_fp16_host_mem(weight.num_elem(), abc::UT_INIT_RANDOM, weight.hostptr);
+        abc::init_fp16_host_mem(input.num_elem(), abc::UT_INIT_RANDOM, input.hostptr);
+        abc::copy_fp16_host_mem_to_cl_mem(weight.num_elem(), weight.hostptr, weight.gptr);
+        abc::copy_fp16_host_mem_to_cl_mem(input.num_elem(), input.hostptr, input.gptr);
+        abc::copy_fp16_host_mem_to_image(input_image.dims, input.hostptr, input_image.gptr);
+        cl_int ret = CL_SUCCESS;
+        cl_mem weight_image = abc::create_fp16_weight_image(K, M, 1, weight.hostptr, &ret);
+        if (CL_SUCCESS != ret) {
+            continue;
+        }
+
+        const int N = H * W;
+        double buffer_ns = min_exec_ns(reps, [&](cl_event *event) {
+            abc::enqueue_gemm_fp16(true, false, M, N, K, weight.gptr, input.gptr, out_buffer.gptr, 0, NULL, event);
+        });
+        double image_ns = min_exec_ns(reps, [&](cl_event *event) {
+            abc::enqueue_gemm_fp16_image(K, M, H, W, input_image.gptr, weight_image, out_image.gptr, 0, NULL, event);
+        });
+
+        abc::copy_fp16_cl_mem_to_host_mem(out_buffer.num_elem(), out_buffer.gptr, out_buffer.hostptr);
+        abc::copy_fp16_image_to_host_mem(out_image.dims, out_image.gptr, out_image.hostptr);
+        double flops = 2.0 * M * N * K;
+        LOGI("%5d %5d %5d %5d %14.2f %14.2f %10.4f", K, M, H, W, flops / buffer_ns, flops / image_ns,
+             max_abs_diff(out_buffer.num_elem(), out_buffer.hostptr, out_image.hostptr));
+        clReleaseMemObject(weight_image);
+    }
+}
+
+static void bench_deconv(int reps) {
+    // {IC, OC, IH, IW}
+    const int shapes[][4] = {{8, 8, 60, 60}, {32, 32, 60, 60}, {64, 32, 64, 64}, {128, 64, 32, 32}};
+    cl_int ret = CL_SUCCESS;
+    cl_kernel buffer_kernel = clrt().create_kernel("deconv_f2s2_nchw_buffer",
+                                                   makeDeconvBufferKernelString().c_str(), NULL, &ret);
+    cl_kernel image_kernel = clrt().create_kernel("deconv_f2s2_nc4hw4_image",
+                                                  abc::get_cl_kernel_source("deconv_image"), NULL, &ret);
+    if (!buffer_kernel || !image_kernel) {
+        LOGE("create_kernel failed.");
+        return;
+    }
+    LOGI("deconv f2s2");
+    LOGI("%5s %5s %5s %5s %14s %14s %10s", "IC", "OC", "IH", "IW", "buffer(us)", "image(us)", "max_diff");
+    for (const auto &shape : shapes) {
+        int IC = shape[0], OC = shape[1], IH = shape[2], IW = shape[3];
+        Tensor weight = abc::make_4d_tensor({IC, OC, 2, 2});
+        Tensor input = abc::make_4d_tensor({1, IC, IH, IW});
+        Tensor out_buffer = abc::make_4d_tensor({1, OC, IH * 2, IW * 2});
+        Tensor input_image = abc::make_4d_tensor({1, IC, IH, IW});
+        Tensor out_image = abc::make_4d_tensor({1, OC, IH * 2, IW * 2});
+        Tensor *buffers[] = {&weight, &input, &out_buffer};
+        for (Tensor *t : buffers) {
+            abc::alloc_tensor_host_mem(t);
+            abc::alloc_tensor_cl_mem(t);
+        }
+        abc::alloc_tensor_host_mem(&out_image);
+        if (abc::alloc_tensor_image_mem(&input_image) != CL_SUCCESS ||
+            abc::alloc_tensor_image_mem(&out_image) != CL_SUCCESS) {
+            continue;
+        }
+        abc::init_fp16_host_mem(weight.num_elem(), abc::UT_INIT_RANDOM, weight.hostptr);
+        abc::init_fp16_host_mem(input.num_elem(), abc::UT_INIT_RANDOM, input.hostptr);
+        abc::copy_fp16_host_mem_to_cl_mem(weight.num_elem(), weight.hostptr, weight.gptr);
+        abc::copy_fp16_host_mem_to_cl_mem(input.num_elem(), input.hostptr, input.gptr);
+        abc::copy_fp16_host_mem_to_image(input_image.dims, input.hostptr, input_image.gptr);
+        cl_mem weight_image = abc::create_fp16_weight_image(IC, OC, 4, weight.hostptr, &ret);
+        if (CL_SUCCESS != ret) {
+            continue;
+        }
+
+        size_t work[] = {static_cast<size_t>(IW), static_cast<size_t>((OC + 3) / 4), static_cast<size_t>(IH)};
+        size_t local[3], global[3];
+        abc::LocalSizeTuner::heuristic_local_size(buffer_kernel, 3, work, local);
+        abc::LocalSizeTuner::pad_global_size(3, work, local, global);
+        abc::set_kernel_args(buffer_kernel, IC, OC, IH, IW, input.gptr, weight.gptr, out_buffer.gptr);
+        double buffer_ns = min_exec_ns(reps, [&](cl_event *event) {
+            abc::enqueue_kernel_async(buffer_kernel, 3, global, local, 0, NULL, event);
+        });
+        abc::set_kernel_args(image_kernel, IC, OC, IH, IW, input_image.gptr, weight_image, out_image.gptr);
+        double image_ns = min_exec_ns(reps, [&](cl_event *event) {
+            abc::enqueue_kernel_async(image_kernel, 3, global, local, 0, NULL, event);
+        });
+
+        abc::copy_fp16_cl_mem_to_host_mem(out_buffer.num_elem(), out_buffer.gptr, out_buffer.hostptr);
+        abc::copy_fp16_image_to_host_mem(out_image.dims, out_image.gptr, out_image.hostptr);
+        LOGI("%5d %5d %5d %5d %14.3f %14.3f %10.4f", IC, OC, IH, IW, buffer_ns / 1000.0, image_ns / 1000.0,
+             max_abs_diff(out_buffer.num_elem(), out_buffer.hostptr, out_image.hostptr));
+        clReleaseMemObject(weight_image);
+    }
+    clrt().release_kernel(buffer_kernel);
+    clrt().release_kernel(image_kernel);
+}
+
+int main(int argc, char const *argv[]) {
+    clrt().init();
+    const int reps = 10;
+    bench_gemm(reps);
+    bench_deconv(reps);
+    return 0;
+}
@@ -0,0 +1,258 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "deconv.h"
+#include "gemm.h"
+#include "half_convert.h"
+#include "log.h"
+#include "quant.h"
+#include "tensor.h"
+#include "utils.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "int8_bench"
+
+// Accuracy and speed of the int8 gemm and deconv kernels against the fp16
+// ones on the same fp32 data. Weights are quantized per output channel,
+// activations per tensor, and the output range is calibrated on the fp32
+// reference. Accuracy is the SQNR against that reference (higher is better);
+// the bench fails when an int8 kernel falls below kMinInt8SqnrDb.
+//
+// usage: int8_bench [reps]
+
+using abc::Tensor;
+using abc::clrt;
+
+// Lowest int8 SQNR accepted. 8-bit outputs top out near 48 dB; a wrong
+// requant scale or zero point lands far below this.
+static const double kMinInt8SqnrDb = 30.0;
+
+struct ErrorStats {
+    double max_abs;
+    double sqnr_db;
+};
+
+static ErrorStats error_stats(const std::vector<float> &ref, const std::vector<float> &out) {
+    ErrorStats stats = {0, 0};
+    double signal = 0, noise = 0;
+    for (std::size_t i = 0; i < ref.size(); ++i) {
+        double d = (double)out[i] - ref[i];
+        stats.max_abs = fmax(stats.max_abs, fabs(d));
+        signal += (double)ref[i] * ref[i];
+        noise += d * d;
+    }
+    stats.sqnr_db = noise > 0 ? 10.0 * log10(signal / noise) : INFINITY;
+    return stats;
+}
+
+static std::vector<float> random_floats(std::size_t n, float lo, float hi) {
+    std::vector<float> v(n);
+    for (float &x : v) {
+        x = lo + (hi - lo) * (rand() % 10000) / 10000.0f;
+    }
+    return v;
+}
+
+static double min_exec_ns(int reps, const std::function<cl_int(cl_event *)> &enqueue) {
+    double best = -1;
+    for (int r = 0; r <= reps; ++r) {
+        cl_event event = NULL;
+        if (CL_SUCCESS != enqueue(&event)) {
+            return -1;
+        }
+        clWaitForEvents(1, &event);
+        double ns = abc::get_cl_exec_time(event);
+        clReleaseEvent(event);
+        if (r > 0 && (best < 0 || ns < best)) {
+            best = ns;
+        }
+    }
+    return best;
+}
+
+static Tensor fp16_tensor(const abc::dims4d &dims, const float *data) {
+    Tensor t = abc::make_4d_tensor(dims);
+    abc::alloc_tensor_host_mem(&t);
+    abc::alloc_tensor_cl_mem(&t);
+    if (data) {
+        abc::convert_f32_to_f16(t.num_elem(), data, (cl_half *)t.hostptr);
+        abc::copy_fp16_host_mem_to_cl_mem(t.num_elem(), t.hostptr, t.gptr);
+    }
+    return t;
+}
+
+static std::vector<float> read_fp16_tensor(Tensor *t) {
+    std::vector<float> out(t->num_elem());
+    abc::copy_fp16_cl_mem_to_host_mem(t->num_elem(), t->gptr, t->hostptr);
+    abc::convert_f16_to_f32(out.size(), (const cl_half *)t->hostptr, out.data());
+    return out;
+}
+
+// [outer][channels][inner] fp32 data quantized into a new int8 tensor
+static Tensor int8_tensor(const abc::dims4d &dims, std::size_t outer, int channels, std::size_t inner,
+                          const float *data, const abc::QuantParams &params) {
+    Tensor t = abc::make_4d_tensor(dims, abc::TENSOR_INT8);
+    t.quant = params;
+    abc::alloc_tensor_host_mem(&t);
+    abc::alloc_tensor_cl_mem(&t);
+    if (data) {
+        abc::quantize_int8(outer, channels, inner, data, params, (int8_t *)t.hostptr);
+        abc::copy_int8_host_mem_to_cl_mem(t.num_elem(), t.hostptr, t.gptr);
+    }
+    return t;
+}
+
+static std::vector<float> read_int8_tensor(Tensor *t) {
+    std::vector<float> out(t->num_elem());
+    abc::copy_int8_cl_mem_to_host_mem(t->num_elem(), t->gptr, t->hostptr);
+    abc::dequantize_int8(1, 1, out.size(), (const int8_t *)t->hostptr, t->quant, out.data());
+    return out;
+}
+
+// Logs a line; false if a kernel failed or the int8 one is too inaccurate.
+static bool report(const std::string &name, double fp16_ns, const ErrorStats &fp16, double int8_ns,
+                   const ErrorStats &int8) {
+    LOGI("%-26s fp16 %9.1f us %6.1f dB | int8 %9.1f us %6.1f dB  %.2fx  max err %.4f / %.4f", name.c_str(),
+         fp16_ns / 1e3, fp16.sqnr_db, int8_ns / 1e3, int8.sqnr_db, int8_ns > 0 ? fp16_ns / int8_ns : 0,
+         fp16.max_abs, int8.max_abs);
+    if (fp16_ns < 0 || int8_ns < 0) {
+        LOGE("%s: a kernel failed to run.", name.c_str());
+        return false;
+    }
+    if (int8.sqnr_db < kMinInt8SqnrDb) {
+        LOGE("%s: int8 SQNR %.1f dB is below %.1f dB.", name.c_str(), int8.sqnr_db, kMinInt8SqnrDb);
+        return false;
+    }
+    return true;
+}
+
+// 1x1 convolution as a gemm: C[M][N] = A[M][K] * B[K][N]
+static bool run_gemm(int M, int N, int K, int reps) {
+    std::vector<float> a = random_floats((std::size_t)M * K, -0.5f, 0.5f);
+    std::vector<float> b = random_floats((std::size_t)K * N, 0.0f, 1.0f);
+    std::vector<float> ref((std::size_t)M * N);
+    for (int m = 0; m < M; ++m) {
+        for (int n = 0; n < N; ++n) {
+            double acc = 0;
+            for (int k = 0; k < K; ++k) {
+                acc += (double)a[(std::size_t)m * K + k] * b[(std::size_t)k * N + n];
+            }
+            ref[(std::size_t)m * N + n] = (float)acc;
+        }
+    }
+
+    Tensor a16 = fp16_tensor({1, 1, M, K}, a.data());
+    Tensor b16 = fp16_tensor({1, 1, K, N}, b.data());
+    Tensor c16 = fp16_tensor({1, 1, M, N}, NULL);
+    double fp16_ns = min_exec_ns(reps, [&](cl_event *event) {
+        return abc::enqueue_gemm_fp16(false, false, M, N, K, a16.gptr, b16.gptr, c16.gptr, 0, NULL, event);
+    });
+    ErrorStats fp16 = error_stats(ref, read_fp16_tensor(&c16));
+
+    abc::QuantParams wq = abc::choose_quant_params(1, M, K, a.data(), true);
+    abc::QuantParams xq = abc::choose_quant_params(1, 1, b.size(), b.data(), false);
+    abc::QuantParams yq = abc::choose_quant_params(1, 1, ref.size(), ref.data(), false);
+    Tensor a8 = int8_tensor({1, 1, M, K}, 1, M, K, a.data(), wq);
+    Tensor b8 = int8_tensor({1, 1, K, N}, 1, 1, b.size(), b.data(), xq);
+    Tensor c8 = int8_tensor({1, 1, M, N}, 1, 1, ref.size(), NULL, yq);
+    std::vector<int32_t> sums = abc::int8_channel_sums(1, M, K, (const int8_t *)a8.hostptr);
+    abc::Int8Requant requant;
+    if (CL_SUCCESS != abc::create_int8_requant(M, xq, wq, yq, NULL, sums.data(), abc::ACT_NONE, &requant)) {
+        LOGE("Failed to prepare the int8 gemm.");
+        return false;
+    }
+    double int8_ns = min_exec_ns(reps, [&](cl_event *event) {
+        return abc::enqueue_gemm_int8(false, false, M, N, K, a8.gptr, b8.gptr, c8.gptr, requant, 0, NULL, event);
+    });
+    ErrorStats int8 = error_stats(ref, read_int8_tensor(&c8));
+    abc::release_int8_requant(&requant);
+
+    return report("gemm " + std::to_string(M) + "x" + std::to_string(N) + "x" + std::to_string(K), fp16_ns, fp16,
+                  int8_ns, int8);
+}
+
+static bool run_deconv(int ic, int oc, int ih, int iw, int kernel, int stride, int pad, int reps) {
+    abc::DeconvParams p = abc::make_deconv_params(kernel, stride, pad);
+    abc::dims4d in_dims = {1, ic, ih, iw};
+    abc::dims4d out_dims = abc::deconv_output_dims(p, in_dims, oc);
+    const int area = kernel * kernel;
+    std::vector<float> x = random_floats((std::size_t)ic * ih * iw, 0.0f, 1.0f);
+    std::vector<float> w = random_floats((std::size_t)ic * oc * area, -0.5f, 0.5f);
+    std::vector<float> ref((std::size_t)oc * out_dims.h * out_dims.w, 0.0f);
+    for (int i = 0; i < ic; ++i) {
+        for (int h = 0; h < ih; ++h) {
+            for (int v = 0; v < iw; ++v) {
+                for (int o = 0; o < oc; ++o) {
+                    for (int kh = 0; kh < kernel; ++kh) {
+                        for (int kw = 0; kw < kernel; ++kw) {
+                            int oh = h * stride - pad + kh, ow = v * stride - pad + kw;
+                            if (oh < 0 || oh >= out_dims.h || ow < 0 || ow >= out_dims.w) continue;
+                            ref[((std::size_t)o * out_dims.h + oh) * out_dims.w + ow] +=
+                                x[((std::size_t)i * ih + h) * iw + v] * w[((std::size_t)i * oc + o) * area +
+                                                                          kh * kernel + kw];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    Tensor x16 = fp16_tensor(in_dims, x.data());
+    Tensor w16 = fp16_tensor({ic, oc, kernel, kernel}, w.data());
+    Tensor y16 = fp16_tensor(out_dims, NULL);
+    double fp16_ns = min_exec_ns(reps, [&](cl_event *event) {
+        return abc::enqueue_deconv_fp16(p, in_dims, oc, x16.gptr, w16.gptr, y16.gptr, 0, NULL, event);
+    });
+    ErrorStats fp16 = error_stats(ref, read_fp16_tensor(&y16));
+
+    abc::QuantParams wq = abc::choose_quant_params(ic, oc, area, w.data(), true);
+    abc::QuantParams xq = abc::choose_quant_params(1, 1, x.size(), x.data(), false);
+    abc::QuantParams yq = abc::choose_quant_params(1, 1, ref.size(), ref.data(), false);
+    Tensor x8 = int8_tensor(in_dims, 1, 1, x.size(), x.data(), xq);
+    Tensor w8 = int8_tensor({ic, oc, kernel, kernel}, ic, oc, area, w.data(), wq);
+    Tensor y8 = int8_tensor(out_dims, 1, 1, ref.size(), NULL, yq);
+    std::vector<int32_t> sums = abc::int8_channel_sums(ic, oc * area, 1, (const int8_t *)w8.hostptr);
+    cl_int ret = CL_SUCCESS;
+    cl_mem sums_mem = clCreateBuffer(clrt().context(), CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                     sums.size() * sizeof(int32_t), sums.data(), &ret);
+    abc::Int8Requant requant;
+    if (CL_SUCCESS != ret ||
+        CL_SUCCESS != abc::create_int8_requant(oc, xq, wq, yq, NULL, NULL, abc::ACT_NONE, &requant)) {
+        LOGE("Failed to prepare the int8 deconv.");
+        if (sums_mem) {
+            clReleaseMemObject(sums_mem);
+        }
+        return false;
+    }
+    double int8_ns = min_exec_ns(reps, [&](cl_event *event) {
+        return abc::enqueue_deconv_int8(p, in_dims, oc, xq.zero_point(0), x8.gptr, w8.gptr, sums_mem, y8.gptr,
+                                        requant, 0, NULL, event);
+    });
+    ErrorStats int8 = error_stats(ref, read_int8_tensor(&y8));
+    abc::release_int8_requant(&requant);
+    clReleaseMemObject(sums_mem);
+
+    return report("deconv ic" + std::to_string(ic) + " oc" + std::to_string(oc) + " " + std::to_string(ih) + "x" +
+                      std::to_string(iw) + " k" + std::to_string(kernel) + "s" + std::to_string(stride),
+                  fp16_ns, fp16, int8_ns, int8);
+}
+
+int main(int argc, char const *argv[]) {
+    clrt().init();
+    const int reps = argc > 1 ? atoi(argv[1]) : 10;
+    LOGI("int8 dot product:%s", abc::int8_build_options().c_str());
+    // every shape runs even after a failure, so the whole table is printed
+    bool ok = run_gemm(128, 3600, 128, reps);
+    ok = run_gemm(256, 1024, 256, reps) && ok;
+    ok = run_gemm(512, 512, 512, reps) && ok;
+    ok = run_deconv(64, 32, 64, 64, 2, 2, 0, reps) && ok;
+    ok = run_deconv(32, 16, 64, 64, 3, 2, 1, reps) && ok;
+    ok = run_deconv(64, 64, 32, 32, 3, 1, 1, reps) && ok;
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,97 @@
+#include <stdlib.h>
+
+#include <chrono>
+
+#include "kernel_launcher.h"
+#include "log.h"
+#include "tensor.h"
+#include "utils.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "launch_overhead"
+
+// Host-side cost per launch of a kernel with the gemm_tiled signature:
+// set_kernel_args + enqueue_kernel_async against a KernelLauncher kept
+// across launches, with all arguments unchanged and with one of them
+// changing every launch. The kernel does no work, so with enqueues the
+// numbers are dominated by the driver; the bind-only rows show the part the
+// launcher saves.
+//
+// usage: launch_overhead [iters]
+
+static const char *kKernelSource =
+    "__kernel void noop(int M, int N, int K, __global const half *A, int lda,"
+    "                   __global const half *B, int ldb, __global half *C, int ldc) {"
+    "    if (get_global_id(0) == 0 && M < 0) C[0] = A[lda] + B[ldb + N + K + ldc];"
+    "}";
+
+using abc::clrt;
+
+template <typename Fn>
+static double ns_per_call(int iters, Fn fn) {
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < iters; ++i) {
+        fn(i);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - begin).count() / iters;
+}
+
+int main(int argc, char const *argv[]) {
+    clrt().init();
+    int iters = argc > 1 ? atoi(argv[1]) : 100000;
+    cl_int ret = CL_SUCCESS;
+    cl_kernel kernel = clrt().create_kernel("noop", kKernelSource, NULL, &ret);
+    abc::Tensor a = abc::make_4d_tensor({1, 1, 64, 64});
+    abc::Tensor b = abc::make_4d_tensor({1, 1, 64, 64});
+    abc::Tensor c = abc::make_4d_tensor({1, 1, 64, 64});
+    if (CL_SUCCESS != ret || CL_SUCCESS != abc::alloc_tensor_cl_mem(&a) ||
+        CL_SUCCESS != abc::alloc_tensor_cl_mem(&b) || CL_SUCCESS != abc::alloc_tensor_cl_mem(&c)) {
+        LOGE("Setup failed: %d", ret);
+        return -1;
+    }
+    cl_command_queue queue = clrt().queue();
+    const int M = 64, N = 64, K = 64;
+    size_t work[] = {16, 16};
+    size_t local[] = {16, 16};
+
+    abc::KernelLauncher<int, int, int, cl_mem, int, cl_mem, int, cl_mem, int> launcher(kernel);
+    double set_args_ns = ns_per_call(iters, [&](int) {
+        abc::set_kernel_args(kernel, M, N, K, a.gptr, K, b.gptr, N, c.gptr, N);
+    });
+    launcher.invalidate();
+    double bind_ns = ns_per_call(iters, [&](int) {
+        launcher.bind(M, N, K, a.gptr, K, b.gptr, N, c.gptr, N);
+    });
+    double bind_changed_ns = ns_per_call(iters, [&](int i) {
+        launcher.bind(M, N, i & 63, a.gptr, K, b.gptr, N, c.gptr, N);
+    });
+    LOGI("bind only       set_kernel_args %8.1f ns  launcher %8.1f ns  launcher, K changing %8.1f ns",
+         set_args_ns, bind_ns, bind_changed_ns);
+
+    const int launches = iters / 10 > 0 ? iters / 10 : 1;
+    double set_args_launch_ns = ns_per_call(launches, [&](int i) {
+        abc::set_kernel_args(kernel, M, N, K, a.gptr, K, b.gptr, N, c.gptr, N);
+        abc::enqueue_kernel_async(kernel, 2, work, local, 0, NULL, NULL, queue);
+        if ((i & 255) == 255) clFinish(queue);
+    });
+    clFinish(queue);
+    launcher.invalidate();
+    double launcher_ns = ns_per_call(launches, [&](int i) {
+        launcher.launch(2, work, local, 0, NULL, NULL, queue, M, N, K, a.gptr, K, b.gptr, N, c.gptr, N);
+        if ((i & 255) == 255) clFinish(queue);
+    });
+    clFinish(queue);
+    double launcher_changed_ns = ns_per_call(launches, [&](int i) {
+        launcher.launch(2, work, local, 0, NULL, NULL, queue, M, N, i & 63, a.gptr, K, b.gptr, N, c.gptr, N);
+        if ((i & 255) == 255) clFinish(queue);
+    });
+    clFinish(queue);
+    LOGI("bind + enqueue  set_kernel_args %8.1f ns  launcher %8.1f ns  launcher, K changing %8.1f ns",
+         set_args_launch_ns, launcher_ns, launcher_changed_ns);
+
+    clrt().release_kernel(kernel);
+    return 0;
+}
@@ -0,0 +1,167 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <functional>
+#include <vector>
+
+#include "attention.h"
+#include "half_float.h"
+#include "log.h"
+#include "tensor.h"
+#include "utils.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "mhsa"
+
+// Multi-head self-attention: the fused kernel against the unfused
+// gemm -> softmax -> gemm pipeline, which writes and reads the
+// [B * H][S][S] score matrix three times.
+//
+// usage: mhsa [heads] [seq_len] [head_dim] [batch] [--causal]
+
+using abc::Tensor;
+using abc::clrt;
+
+// wall time of enqueue() from an idle queue to its completion, best of
+// reps; the unfused pipeline hands back only its last event
+static double min_wall_ns(int reps, const std::function<void()> &enqueue) {
+    double best = -1;
+    for (int r = 0; r <= reps; ++r) {
+        clFinish(clrt().profile_queue());
+        auto t0 = std::chrono::steady_clock::now();
+        enqueue();
+        clFinish(clrt().profile_queue());
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+        if (r > 0 && (best < 0 || ns < best)) {
+            best = ns;
+        }
+    }
+    return best;
+}
+
+// O = softmax(scale * Q * K^T + mask) * V per (batch, head) in fp32
+static void attention_reference(const abc::AttentionParams &p, float scale, const cl_half *Q, const cl_half *K,
+                                const cl_half *V, std::vector<float> *O) {
+    const int S = p.seq_len, D = p.head_dim;
+    O->assign((std::size_t)p.batch * p.heads * S * D, 0.0f);
+    std::vector<float> s(S);
+    for (int bh = 0; bh < p.batch * p.heads; ++bh) {
+        const std::size_t base = (std::size_t)bh * S * D;
+        for (int i = 0; i < S; ++i) {
+            const int keys = p.causal ? i + 1 : S;
+            float row_max = -INFINITY;
+            for (int j = 0; j < keys; ++j) {
+                float acc = 0;
+                for (int d = 0; d < D; ++d) {
+                    acc += to_float(Q[base + i * D + d]) * to_float(K[base + j * D + d]);
+                }
+                s[j] = acc * scale;
+                row_max = s[j] > row_max ? s[j] : row_max;
+            }
+            float sum = 0;
+            for (int j = 0; j < keys; ++j) {
+                s[j] = expf(s[j] - row_max);
+                sum += s[j];
+            }
+            float *o = O->data() + base + i * D;
+            for (int j = 0; j < keys; ++j) {
+                const float w = s[j] / sum;
+                for (int d = 0; d < D; ++d) {
+                    o[d] += w * to_float(V[base + j * D + d]);
+                }
+            }
+        }
+    }
+}
+
+static float max_abs_diff(const std::vector<float> &ref, const void *out) {
+    const cl_half *y = reinterpret_cast<const cl_half *>(out);
+    float max_diff = 0;
+    for (std::size_t i = 0; i < ref.size(); ++i) {
+        float d = fabsf(ref[i] - to_float(y[i]));
+        max_diff = d > max_diff ? d : max_diff;
+    }
+    return max_diff;
+}
+
+int main(int argc, char const *argv[]) {
+    abc::AttentionParams p = {1, 8, 512, 64, 0.0f, false};
+    int positional = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--causal") == 0) {
+            p.causal = true;
+            continue;
+        }
+        int v = atoi(argv[i]);
+        switch (positional++) {
+            case 0: p.heads = v; break;
+            case 1: p.seq_len = v; break;
+            case 2: p.head_dim = v; break;
+            case 3: p.batch = v; break;
+            default: LOGW("Ignoring extra argument %s", argv[i]); break;
+        }
+    }
+    if (p.batch <= 0 || p.heads <= 0 || p.seq_len <= 0 || p.head_dim <= 0 || p.head_dim % 4 != 0) {
+        LOGE("usage: %s [heads] [seq_len] [head_dim (multiple of 4)] [batch] [--causal]", argv[0]);
+        return 1;
+    }
+    const float scale = 1.0f / sqrtf(static_cast<float>(p.head_dim));
+
+    clrt().init();
+    abc::dims4d dims = {p.batch, p.heads, p.seq_len, p.head_dim};
+    Tensor q = abc::make_4d_tensor(dims);
+    Tensor k = abc::make_4d_tensor(dims);
+    Tensor v = abc::make_4d_tensor(dims);
+    Tensor out_fused = abc::make_4d_tensor(dims);
+    Tensor out_unfused = abc::make_4d_tensor(dims);
+    Tensor scores = abc::make_4d_tensor({p.batch, p.heads, p.seq_len, p.seq_len});
+    Tensor *tensors[] = {&q, &k, &v, &out_fused, &out_unfused};
+    for (Tensor *t : tensors) {
+        abc::alloc_tensor_host_mem(t);
+        abc::alloc_tensor_cl_mem(t);
+    }
+    abc::alloc_tensor_cl_mem(&scores);
+    Tensor *inputs[] = {&q, &k, &v};
+    for (Tensor *t : inputs) {
+        abc::init_fp16_host_mem(t->num_elem(), abc::UT_INIT_RANDOM, t->hostptr);
+        abc::copy_fp16_host_mem_to_cl_mem(t->num_elem(), t->hostptr, t->gptr);
+    }
+
+    const int reps = 10;
+    double fused_ns = min_wall_ns(reps, [&]() {
+        abc::enqueue_attention_fp16(p, q.gptr, k.gptr, v.gptr, out_fused.gptr);
+    });
+    double unfused_ns = min_wall_ns(reps, [&]() {
+        abc::enqueue_attention_unfused_fp16(p, q.gptr, k.gptr, v.gptr, scores.gptr, out_unfused.gptr);
+    });
+
+    abc::copy_fp16_cl_mem_to_host_mem(out_fused.num_elem(), out_fused.gptr, out_fused.hostptr);
+    abc::copy_fp16_cl_mem_to_host_mem(out_unfused.num_elem(), out_unfused.gptr, out_unfused.hostptr);
+    std::vector<float> ref;
+    attention_reference(p, scale, reinterpret_cast<const cl_half *>(q.hostptr),
+                        reinterpret_cast<const cl_half *>(k.hostptr), reinterpret_cast<const cl_half *>(v.hostptr),
+                        &ref);
+    float fused_diff = max_abs_diff(ref, out_fused.hostptr);
+    float unfused_diff = max_abs_diff(ref, out_unfused.hostptr);
+
+    // Q * K^T and P * V; causal masking skips about half of both
+    double flops = 4.0 * p.batch * p.heads * p.seq_len * p.seq_len * p.head_dim * (p.causal ? 0.5 : 1.0);
+    double score_mb = scores.num_elem() * sizeof(cl_half) / 1e6;
+    LOGI("batch %d heads %d seq_len %d head_dim %d%s, best of %d", p.batch, p.heads, p.seq_len, p.head_dim,
+         p.causal ? " causal" : "", reps);
+    LOGI("%-8s %10s %10s %10s", "", "time(us)", "GFLOPS", "max_diff");
+    LOGI("%-8s %10.3f %10.2f %10.4f", "fused", fused_ns / 1000.0, flops / fused_ns, fused_diff);
+    LOGI("%-8s %10.3f %10.2f %10.4f", "unfused", unfused_ns / 1000.0, flops / unfused_ns, unfused_diff);
+    LOGI("score matrix the fused kernel keeps on chip: %.2f MB (x3 traffic unfused)", score_mb);
+
+    const float tol = 1e-2f;
+    if (fused_diff > tol || unfused_diff > tol) {
+        LOGE("Mismatch against the CPU reference (tolerance %g).", tol);
+        return 1;
+    }
+    return 0;
+}
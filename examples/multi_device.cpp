@@ -0,0 +1,166 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "deconv.h"
+#include "device_group.h"
+#include "half_float.h"
+#include "log.h"
+#include "tensor.h"
+#include "utils.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "multi_device"
+
+// Data-parallel scaling of a batched deconv 2x2/2 + bias, relu over all (or
+// the chosen) OpenCL devices. Each device gets its own copy of the weights
+// and a share of the batch in proportion to its measured throughput; every
+// slice is uploaded, run and downloaded on its device. Prints the time of
+// every device alone, the split, the time of the group and checks the
+// output against the last single-device run. The kernels need cl_khr_fp16,
+// which the pocl CPU device has, so this also runs without a GPU.
+//
+// usage: multi_device [runs] [batch] [channels] [height] [width] [device index ...]
+
+using abc::Tensor;
+using abc::clrt;
+
+struct DeviceWeights {
+    explicit DeviceWeights(int C)
+        : weight(abc::make_4d_tensor({C, C, 2, 2})), bias(abc::make_4d_tensor({1, 1, 1, C})) {}
+    Tensor weight, bias;
+};
+
+static cl_int upload(const cl_half *data, Tensor *t) {
+    cl_int ret = abc::alloc_tensor_cl_mem(t);
+    if (CL_SUCCESS == ret) {
+        ret = abc::copy_fp16_host_mem_to_cl_mem(t->num_elem(), data, t->gptr);
+    }
+    return ret;
+}
+
+int main(int argc, char const *argv[]) {
+    const int runs = argc > 1 ? atoi(argv[1]) : 10;
+    const int batch = argc > 2 ? atoi(argv[2]) : 32;
+    const int C = argc > 3 ? atoi(argv[3]) : 32;
+    const int H = argc > 4 ? atoi(argv[4]) : 64;
+    const int W = argc > 5 ? atoi(argv[5]) : 64;
+    if (runs < 1 || batch < 1 || C < 1 || H < 1 || W < 1) {
+        LOGE("usage: multi_device [runs] [batch] [channels] [height] [width] [device index ...]");
+        return -1;
+    }
+
+    std::vector<abc::DeviceInfo> all = abc::enumerate_devices();
+    for (std::size_t i = 0; i < all.size(); ++i) {
+        LOGI("device %zu: %s (%s), %u compute units @ %u MHz", i, all[i].device_name.c_str(),
+             all[i].platform_name.c_str(), all[i].compute_units, all[i].max_clock_mhz);
+    }
+    std::vector<abc::DeviceInfo> chosen;
+    for (int a = 6; a < argc; ++a) {
+        std::size_t index = (std::size_t)atoi(argv[a]);
+        if (index >= all.size()) {
+            LOGE("No device %zu.", index);
+            return -1;
+        }
+        chosen.push_back(all[index]);
+    }
+    if (chosen.empty()) {
+        chosen = all;
+    }
+    abc::DeviceGroup group;
+    if (chosen.empty() || CL_SUCCESS != group.init(chosen)) {
+        LOGE("No usable OpenCL device.");
+        return -1;
+    }
+
+    const abc::DeconvParams p = abc::make_deconv_params(2, 2);
+    const abc::dims4d item = {1, C, H, W};
+    const abc::dims4d item_out = abc::deconv_output_dims(p, item, C);
+    const std::size_t in_elems = (std::size_t)C * H * W;
+    const std::size_t out_elems = (std::size_t)item_out.c * item_out.h * item_out.w;
+    std::vector<cl_half> input(in_elems * batch), weight((std::size_t)C * C * 4), bias(C);
+    abc::init_fp16_host_mem(input.size(), abc::UT_INIT_RANDOM, input.data());
+    abc::init_fp16_host_mem(weight.size(), abc::UT_INIT_RANDOM, weight.data());
+    abc::init_fp16_host_mem(bias.size(), abc::UT_INIT_RANDOM, bias.data());
+
+    std::vector<std::unique_ptr<DeviceWeights> > weights(group.size());
+    for (int d = 0; d < group.size(); ++d) {
+        abc::ScopedRuntime scope(group.runtime(d));
+        weights[d].reset(new DeviceWeights(C));
+        cl_int ret = upload(weight.data(), &weights[d]->weight);
+        if (CL_SUCCESS == ret) {
+            ret = upload(bias.data(), &weights[d]->bias);
+        }
+        if (CL_SUCCESS != ret) {
+            LOGE("Failed to upload the weights to %s.", group.device(d).device_name.c_str());
+            return -1;
+        }
+    }
+
+    std::vector<cl_half> reference(out_elems * batch), output(out_elems * batch);
+    cl_half *out = reference.data();
+    abc::BatchSliceFn slice = [&](int device, int begin, int count) -> cl_int {
+        abc::dims4d dims = item;
+        dims.n = count;
+        Tensor x = abc::make_4d_tensor(dims);
+        cl_int ret = upload(input.data() + (std::size_t)begin * in_elems, &x);
+        Tensor y = abc::make_4d_tensor(abc::deconv_output_dims(p, dims, C));
+        if (CL_SUCCESS == ret) {
+            ret = abc::alloc_tensor_cl_mem(&y);
+        }
+        if (CL_SUCCESS == ret) {
+            abc::Epilogue e;
+            e.bias = weights[device]->bias.gptr;
+            e.activation = abc::ACT_RELU;
+            ret = abc::enqueue_deconv_fp16(p, dims, C, x.gptr, weights[device]->weight.gptr, y.gptr, 0, NULL, NULL,
+                                           NULL, e);
+        }
+        if (CL_SUCCESS == ret) {
+            ret = abc::copy_fp16_cl_mem_to_host_mem(y.num_elem(), y.gptr, out + (std::size_t)begin * out_elems);
+        }
+        return ret;
+    };
+
+    // every device alone on the whole batch; this also seeds the split
+    if (CL_SUCCESS != group.calibrate(batch, slice)) {
+        return -1;
+    }
+    double best_single_ms = 0;
+    for (int d = 0; d < group.size(); ++d) {
+        double ms = 1e3 * batch / group.throughput()[d];
+        LOGI("%-40s alone %9.3f ms/batch  %8.1f items/s", group.device(d).device_name.c_str(), ms,
+             group.throughput()[d]);
+        if (d == 0 || ms < best_single_ms) {
+            best_single_ms = ms;
+        }
+    }
+
+    out = output.data();
+    std::vector<int> split;
+    double total_ms = 0;
+    for (int r = 0; r < runs; ++r) {
+        auto begin = std::chrono::steady_clock::now();
+        if (CL_SUCCESS != group.run_batch(batch, slice, &split)) {
+            return -1;
+        }
+        total_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    }
+    const double group_ms = total_ms / runs;
+    for (int d = 0; d < group.size(); ++d) {
+        LOGI("%-40s %4d of %d items", group.device(d).device_name.c_str(), split[d], batch);
+    }
+    LOGI("%d device(s) %9.3f ms/batch, %.2fx the best single device", group.size(), group_ms,
+         group_ms > 0 ? best_single_ms / group_ms : 0.0);
+
+    float max_diff = 0;
+    for (std::size_t i = 0; i < output.size(); ++i) {
+        max_diff = fmaxf(max_diff, fabsf(to_float(output[i]) - to_float(reference[i])));
+    }
+    LOGI("max |group - single device| = %g", max_diff);
+    return max_diff < 1e-2f ? 0 : -1;
+}
@@ -0,0 +1,287 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "half_float.h"
+#include "log.h"
+#include "op_graph.h"
+#include "tensor.h"
+#include "utils.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "op_graph"
+
+// A small decoder run through OpGraph twice: with the intermediates planned
+// into shared arenas and with a buffer per intermediate. Prints the memory
+// both need, the end-to-end latency (enqueue to clFinish) and checks that
+// the outputs agree, and checks a small decoder against a host reference.
+//
+// usage: op_graph [runs] [channels] [height] [width]
+
+using abc::Tensor;
+using abc::clrt;
+
+static Tensor device_tensor(const abc::dims4d &dims, abc::UT_RANDOM_TYPE init = abc::UT_INIT_RANDOM) {
+    Tensor t = abc::make_4d_tensor(dims);
+    abc::alloc_tensor_host_mem(&t);
+    abc::alloc_tensor_cl_mem(&t);
+    if (init == abc::UT_INIT_ZERO) {
+        memset(t.hostptr, 0, t.num_elem() * sizeof(cl_half));
+    } else {
+        abc::init_fp16_host_mem(t.num_elem(), init, t.hostptr);
+    }
+    abc::copy_fp16_host_mem_to_cl_mem(t.num_elem(), t.hostptr, t.gptr);
+    return t;
+}
+
+struct Weights {
+    Tensor w0, b0, w1, b1, d0, db0, w2, d1;
+};
+
+static Weights make_weights(int C) {
+    return {device_tensor({1, 1, C, C}), device_tensor({1, 1, 1, C}),
+            device_tensor({1, 1, C, C}), device_tensor({1, 1, 1, C}),
+            device_tensor({C, C / 2, 2, 2}), device_tensor({1, 1, 1, C / 2}),
+            device_tensor({1, 1, C / 2, C / 2}), device_tensor({C / 2, C / 4, 2, 2})};
+}
+
+static std::vector<float> host_values(Tensor &t) {
+    const cl_half *data = reinterpret_cast<const cl_half *>(t.hostptr);
+    std::vector<float> values(t.num_elem());
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        values[i] = to_float(data[i]);
+    }
+    return values;
+}
+
+// c[M][N] = a[M][K] * b[K][N]
+static std::vector<float> gemm_reference(int M, int N, int K, const std::vector<float> &a,
+                                         const std::vector<float> &b) {
+    std::vector<float> c((std::size_t)M * N, 0.0f);
+    for (int m = 0; m < M; ++m) {
+        for (int k = 0; k < K; ++k) {
+            for (int n = 0; n < N; ++n) {
+                c[(std::size_t)m * N + n] += a[(std::size_t)m * K + k] * b[(std::size_t)k * N + n];
+            }
+        }
+    }
+    return c;
+}
+
+// deconv 2x2/2 of x {C, H, W} by w {C, O, 2, 2} to {O, 2H, 2W}
+static std::vector<float> deconv_reference(int C, int O, int H, int W, const std::vector<float> &x,
+                                           const std::vector<float> &w) {
+    std::vector<float> y((std::size_t)O * H * 2 * W * 2, 0.0f);
+    for (int c = 0; c < C; ++c) {
+        for (int o = 0; o < O; ++o) {
+            for (int h = 0; h < H; ++h) {
+                for (int x_w = 0; x_w < W; ++x_w) {
+                    for (int k = 0; k < 4; ++k) {
+                        y[((std::size_t)o * H * 2 + h * 2 + k / 2) * W * 2 + x_w * 2 + k % 2] +=
+                            x[((std::size_t)c * H + h) * W + x_w] * w[((std::size_t)c * O + o) * 4 + k];
+                    }
+                }
+            }
+        }
+    }
+    return y;
+}
+
+// t = act(scale * t + bias[channel] + residual), rounded to fp16 as the
+// device stores it
+static void epilogue_reference(int channels, const std::vector<float> *bias, float scale,
+                               const std::vector<float> *residual, abc::ActivationType activation,
+                               std::vector<float> *t) {
+    const std::size_t plane = t->size() / channels;
+    for (std::size_t i = 0; i < t->size(); ++i) {
+        float v = scale * (*t)[i];
+        if (bias) {
+            v += (*bias)[i / plane];
+        }
+        if (residual) {
+            v += (*residual)[i];
+        }
+        if (activation == abc::ACT_RELU) {
+            v = fmaxf(v, 0.0f);
+        } else if (activation == abc::ACT_RELU6) {
+            v = fminf(fmaxf(v, 0.0f), 6.0f);
+        }
+        (*t)[i] = to_float(to_half(v));
+    }
+}
+
+// The decoder of build_decoder() on the host.
+static std::vector<float> decoder_reference(Weights &w, int C, int H, int W, Tensor &input) {
+    const int HW = H * W;
+    const std::vector<float> b0 = host_values(w.b0), b1 = host_values(w.b1), db0 = host_values(w.db0);
+    std::vector<float> t0 = gemm_reference(C, HW, C, host_values(w.w0), host_values(input));
+    epilogue_reference(C, &b0, 1.0f, NULL, abc::ACT_RELU, &t0);
+    std::vector<float> t1 = gemm_reference(C, HW, C, host_values(w.w1), t0);
+    epilogue_reference(C, &b1, 1.0f, &t0, abc::ACT_RELU, &t1);
+    epilogue_reference(C, NULL, 0.5f, NULL, abc::ACT_RELU6, &t1);
+    std::vector<float> u0 = deconv_reference(C, C / 2, H, W, t1, host_values(w.d0));
+    epilogue_reference(C / 2, &db0, 1.0f, NULL, abc::ACT_RELU, &u0);
+    std::vector<float> u1 = gemm_reference(C / 2, HW * 4, C / 2, host_values(w.w2), u0);
+    epilogue_reference(C / 2, NULL, 1.0f, NULL, abc::ACT_RELU, &u1);
+    std::vector<float> y = deconv_reference(C / 2, C / 4, H * 2, W * 2, u1, host_values(w.d1));
+    epilogue_reference(C / 4, NULL, 1.0f, NULL, abc::ACT_RELU, &y);
+    return y;
+}
+
+//   x {C, H, W} -> 1x1 conv + bias, relu -> 1x1 conv + bias + residual, relu
+//     -> * 0.5, relu6 -> deconv 2x2/2 to C/2 + bias, relu -> 1x1 conv, relu
+//     -> deconv 2x2/2 to C/4, relu -> y {C/4, 4H, 4W}
+// The ops are added back to front; compile() finds the order.
+static cl_int build_decoder(abc::OpGraph *g, Weights *w, int C, int H, int W, int *x, int *y) {
+    const int HW = H * W;
+    const abc::DeconvParams up = abc::make_deconv_params(2, 2);
+    *x = g->add_input({1, C, H, W});
+    *y = g->add_output({1, C / 4, H * 4, W * 4});
+    int w0 = g->add_constant({1, 1, C, C}, w->w0.gptr);
+    int b0 = g->add_constant({1, 1, 1, C}, w->b0.gptr);
+    int w1 = g->add_constant({1, 1, C, C}, w->w1.gptr);
+    int b1 = g->add_constant({1, 1, 1, C}, w->b1.gptr);
+    int d0 = g->add_constant({C, C / 2, 2, 2}, w->d0.gptr);
+    int db0 = g->add_constant({1, 1, 1, C / 2}, w->db0.gptr);
+    int w2 = g->add_constant({1, 1, C / 2, C / 2}, w->w2.gptr);
+    int d1 = g->add_constant({C / 2, C / 4, 2, 2}, w->d1.gptr);
+    int t0 = g->add_intermediate({1, C, H, W});
+    int t1 = g->add_intermediate({1, C, H, W});
+    int t2 = g->add_intermediate({1, C, H, W});
+    int u0 = g->add_intermediate({1, C / 2, H * 2, W * 2});
+    int u1 = g->add_intermediate({1, C / 2, H * 2, W * 2});
+
+    abc::OpEpilogue relu;
+    relu.activation = abc::ACT_RELU;
+    cl_int ret = g->add_deconv(up, u1, d1, *y, relu);
+    if (CL_SUCCESS == ret) {
+        ret = g->add_gemm(false, false, C / 2, HW * 4, C / 2, w2, u0, u1, relu);
+    }
+    if (CL_SUCCESS == ret) {
+        abc::OpEpilogue e = relu;
+        e.bias = db0;
+        ret = g->add_deconv(up, t2, d0, u0, e);
+    }
+    if (CL_SUCCESS == ret) {
+        abc::OpEpilogue e;
+        e.scale = 0.5f;
+        e.activation = abc::ACT_RELU6;
+        ret = g->add_elementwise(t1, t2, e);
+    }
+    if (CL_SUCCESS == ret) {
+        abc::OpEpilogue e = relu;
+        e.bias = b1;
+        e.residual = t0;
+        ret = g->add_gemm(false, false, C, HW, C, w1, t0, t1, e);
+    }
+    if (CL_SUCCESS == ret) {
+        abc::OpEpilogue e = relu;
+        e.bias = b0;
+        ret = g->add_gemm(false, false, C, HW, C, w0, *x, t0, e);
+    }
+    return ret;
+}
+
+// Runs the decoder once for warmup and then runs times; returns ms per run.
+static double run_decoder(bool share_memory, int runs, Weights *w, int C, int H, int W, cl_mem input, cl_mem output,
+                          abc::OpGraphMemoryPlan *plan) {
+    abc::OpGraph g;
+    int x = -1, y = -1;
+    cl_int ret = build_decoder(&g, w, C, H, W, &x, &y);
+    if (CL_SUCCESS == ret) {
+        ret = g.compile(share_memory);
+    }
+    if (CL_SUCCESS != ret) {
+        LOGE("Failed to build the decoder: %d", ret);
+        return -1;
+    }
+    g.bind(x, input);
+    g.bind(y, output);
+    *plan = g.memory_plan();
+    cl_command_queue queue = clrt().queue();
+    g.run(0, NULL, NULL, queue);
+    clFinish(queue);
+    auto begin = std::chrono::steady_clock::now();
+    for (int r = 0; r < runs; ++r) {
+        if (CL_SUCCESS != (ret = g.run(0, NULL, NULL, queue))) {
+            LOGE("Run failed: %d", ret);
+            return -1;
+        }
+        clFinish(queue);
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count() / runs;
+}
+
+// Runs a small decoder (odd spatial sizes, so the kernels' tails are hit)
+// with planned memory and compares it with decoder_reference().
+static bool check_against_reference() {
+    const int C = 8, H = 3, W = 5;
+    Weights w = make_weights(C);
+    Tensor input = device_tensor({1, C, H, W});
+    Tensor output = device_tensor({1, C / 4, H * 4, W * 4}, abc::UT_INIT_ZERO);
+    abc::OpGraphMemoryPlan plan;
+    if (run_decoder(true, 1, &w, C, H, W, input.gptr, output.gptr, &plan) < 0) {
+        return false;
+    }
+    abc::copy_fp16_cl_mem_to_host_mem(output.num_elem(), output.gptr, output.hostptr);
+    const std::vector<float> expected = decoder_reference(w, C, H, W, input);
+    const std::vector<float> actual = host_values(output);
+    float max_err = 0;
+    for (std::size_t i = 0; i < actual.size(); ++i) {
+        max_err = fmaxf(max_err, fabsf(actual[i] - expected[i]) / fmaxf(1.0f, fabsf(expected[i])));
+    }
+    LOGI("max error against the host reference = %g", max_err);
+    return max_err < 2e-2f;
+}
+
+int main(int argc, char const *argv[]) {
+    clrt().init();
+    const int runs = argc > 1 ? atoi(argv[1]) : 20;
+    const int C = argc > 2 ? atoi(argv[2]) : 64;
+    const int H = argc > 3 ? atoi(argv[3]) : 32;
+    const int W = argc > 4 ? atoi(argv[4]) : 32;
+    if (C < 4 || C % 4 != 0) {
+        LOGE("channels must be a positive multiple of 4.");
+        return -1;
+    }
+
+    if (!check_against_reference()) {
+        LOGE("The decoder does not match the host reference.");
+        return -1;
+    }
+
+    Weights w = make_weights(C);
+    Tensor input = device_tensor({1, C, H, W});
+    Tensor planned_out = device_tensor({1, C / 4, H * 4, W * 4}, abc::UT_INIT_ZERO);
+    Tensor naive_out = device_tensor({1, C / 4, H * 4, W * 4}, abc::UT_INIT_ZERO);
+
+    abc::OpGraphMemoryPlan planned, naive;
+    double planned_ms = run_decoder(true, runs, &w, C, H, W, input.gptr, planned_out.gptr, &planned);
+    double naive_ms = run_decoder(false, runs, &w, C, H, W, input.gptr, naive_out.gptr, &naive);
+    if (planned_ms < 0 || naive_ms < 0) {
+        return -1;
+    }
+
+    const double mb = 1.0 / (1 << 20);
+    LOGI("%zu intermediates, %zu elementwise op(s) in place", planned.num_intermediates, planned.num_in_place);
+    LOGI("naive   %8.3f MB in %zu buffers  %8.3f ms/run", naive.planned_bytes * mb, naive.num_arenas, naive_ms);
+    const double share = naive.planned_bytes ? 100.0 * planned.planned_bytes / naive.planned_bytes : 0.0;
+    LOGI("planned %8.3f MB in %zu arena(s) %8.3f ms/run  (%.1f%% of naive)", planned.planned_bytes * mb,
+         planned.num_arenas, planned_ms, share);
+
+    abc::copy_fp16_cl_mem_to_host_mem(planned_out.num_elem(), planned_out.gptr, planned_out.hostptr);
+    abc::copy_fp16_cl_mem_to_host_mem(naive_out.num_elem(), naive_out.gptr, naive_out.hostptr);
+    const cl_half *a = reinterpret_cast<const cl_half *>(planned_out.hostptr);
+    const cl_half *b = reinterpret_cast<const cl_half *>(naive_out.hostptr);
+    float max_diff = 0;
+    for (std::size_t i = 0; i < planned_out.num_elem(); ++i) {
+        max_diff = fmaxf(max_diff, fabsf(to_float(a[i]) - to_float(b[i])));
+    }
+    LOGI("max |planned - naive| = %g", max_diff);
+    return max_diff == 0 ? 0 : -1;
+}
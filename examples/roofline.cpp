@@ -0,0 +1,37 @@
+#include <string>
+
+#include "cl_runtime.h"
+#include "log.h"
+#include "roofline.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "roofline"
+
+// Measures the roofline of the OpenCL device and writes the profile that
+// bench --roofline and OCLABC_ROOFLINE load.
+//
+// usage: roofline [profile.txt]
+
+using abc::clrt;
+
+int main(int argc, char const *argv[]) {
+    std::string path = argc > 1 ? argv[1] : "roofline.txt";
+    clrt().init();
+    abc::RooflineProfile profile;
+    cl_int ret = abc::probe_roofline(&profile);
+    if (CL_SUCCESS != ret) {
+        LOGE("Roofline probe failed: %d", ret);
+        return 1;
+    }
+    // arithmetic intensity (ops per byte of global traffic) at which a
+    // kernel turns from bandwidth bound to compute bound
+    LOGI("ridge point fp32 %.1f, fp16 %.1f, int8 %.1f ops/byte", profile.fp32_gflops / profile.copy_gbps,
+         profile.fp16_gflops / profile.copy_gbps, profile.int8_gops / profile.copy_gbps);
+    if (CL_SUCCESS != abc::save_roofline_profile(path, profile)) {
+        return 1;
+    }
+    LOGI("Saved roofline profile to %s", path.c_str());
+    return 0;
+}
@@ -0,0 +1,101 @@
+#include <dlfcn.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <vector>
+
+#include "libopencl.h"
+#include "log.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "stub_overhead"
+
+// Per-call cost of the libopencl-stub wrappers against calling the vendor
+// library directly (what linking against it would give), and against the
+// old scheme of a dlsym() per call. Runs on any platform, e.g. pocl on Linux:
+//   LIBOPENCL_SO_PATH=/usr/lib/x86_64-linux-gnu/libpocl.so.2 ./stub_overhead
+
+static const char *kKernelSource =
+    "__kernel void noop(int a, __global int *b) {"
+    "    if (get_global_id(0) == 0 && a < 0) b[0] = a;"
+    "}";
+
+template <typename Fn>
+static double ns_per_call(int iters, Fn fn) {
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < iters; ++i) {
+        fn(i);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - begin).count() / iters;
+}
+
+int main(int argc, char const *argv[]) {
+    int iters = argc > 1 ? atoi(argv[1]) : 1000000;
+    void *handle = libopencl_stub_so_handle();
+    if (!handle) {
+        LOGE("No OpenCL library found, set LIBOPENCL_SO_PATH.");
+        return -1;
+    }
+    LOGI("vendor library: %s", libopencl_stub_so_path());
+    for (int i = 0; i < libopencl_stub_num_missing_symbols(); ++i) {
+        LOGI("not exported: %s", libopencl_stub_missing_symbol(i));
+    }
+
+    cl_platform_id platform;
+    cl_device_id device;
+    cl_int err = clGetPlatformIDs(1, &platform, NULL);
+    err |= clGetDeviceIDs(platform, CL_DEVICE_TYPE_ALL, 1, &device, NULL);
+    cl_context context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+    cl_command_queue queue = clCreateCommandQueueWithProperties(context, device, NULL, &err);
+    cl_program program = clCreateProgramWithSource(context, 1, &kKernelSource, NULL, &err);
+    err |= clBuildProgram(program, 1, &device, NULL, NULL, NULL);
+    cl_kernel kernel = clCreateKernel(program, "noop", &err);
+    cl_mem buf = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(int), NULL, &err);
+    if (err != CL_SUCCESS || !kernel || !buf) {
+        LOGE("OpenCL setup failed: %d", err);
+        return -1;
+    }
+
+    f_clSetKernelArg direct_set_arg = (f_clSetKernelArg)dlsym(handle, "clSetKernelArg");
+    f_clEnqueueNDRangeKernel direct_enqueue =
+        (f_clEnqueueNDRangeKernel)dlsym(handle, "clEnqueueNDRangeKernel");
+
+    double stub_ns = ns_per_call(iters, [&](int i) {
+        clSetKernelArg(kernel, 0, sizeof(i), &i);
+    });
+    double direct_ns = ns_per_call(iters, [&](int i) {
+        direct_set_arg(kernel, 0, sizeof(i), &i);
+    });
+    double dlsym_ns = ns_per_call(iters, [&](int i) {
+        f_clSetKernelArg fn = (f_clSetKernelArg)dlsym(handle, "clSetKernelArg");
+        fn(kernel, 0, sizeof(i), &i);
+    });
+    LOGI("clSetKernelArg        stub %8.2f ns  direct %8.2f ns  dlsym-per-call %8.2f ns",
+         stub_ns, direct_ns, dlsym_ns);
+
+    int launches = iters / 100 > 0 ? iters / 100 : 1;
+    size_t global = 1;
+    clSetKernelArg(kernel, 1, sizeof(cl_mem), &buf);
+    stub_ns = ns_per_call(launches, [&](int i) {
+        clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global, NULL, 0, NULL, NULL);
+        if ((i & 255) == 255) clFinish(queue);
+    });
+    clFinish(queue);
+    direct_ns = ns_per_call(launches, [&](int i) {
+        direct_enqueue(queue, kernel, 1, NULL, &global, NULL, 0, NULL, NULL);
+        if ((i & 255) == 255) clFinish(queue);
+    });
+    clFinish(queue);
+    LOGI("clEnqueueNDRangeKernel stub %8.2f ns  direct %8.2f ns", stub_ns, direct_ns);
+
+    clReleaseMemObject(buf);
+    clReleaseKernel(kernel);
+    clReleaseProgram(program);
+    clReleaseCommandQueue(queue);
+    clReleaseContext(context);
+    return 0;
+}
@@ -0,0 +1,137 @@
+#include <chrono>
+#include <string>
+
+#include "log.h"
+#include "tensor.h"
+#include "half_float.h"
+#include "utils.h"
+
+#ifdef TAG
+#undef TAG
+#endif
+#define TAG "zero_copy"
+
+// Round trip host -> kernel -> host with a pooled device buffer plus explicit
+// copies, against CL_MEM_ALLOC_HOST_PTR / CL_MEM_USE_HOST_PTR buffers that
+// the host touches through map/unmap, and against SVM (fine-grained when the
+// device has it, coarse-grained otherwise) passed to the kernel as an SVM
+// pointer. The SVM column is "-" on devices without SVM.
+
+std::string makeScaleKernelString() {
+    std::string kernel = _STR(
+        __kernel void scale_f16(int n, __global half *data) {
+            const int idx = get_global_id(0);
+            if (idx >= n) return;
+            data[idx] = data[idx] * (half)(2);
+        }
+    );
+    return kernel;
+}
+
+using abc::Tensor;
+using abc::clrt;
+
+static void fill_host(std::size_t num_elem, void *ptr) {
+    cl_half *f16data = reinterpret_cast<cl_half *>(ptr);
+    cl_half one = to_half(1.0f);
+    for (std::size_t i = 0; i < num_elem; ++i) {
+        f16data[i] = one;
+    }
+}
+
+static float checksum_host(std::size_t num_elem, const void *ptr) {
+    const cl_half *f16data = reinterpret_cast<const cl_half *>(ptr);
+    float sum = 0;
+    for (std::size_t i = 0; i < num_elem; i += 4096) {
+        sum += to_float(f16data[i]);
+    }
+    return sum;
+}
+
+static void launch(cl_kernel kernel, Tensor *t) {
+    int n = static_cast<int>(t->num_elem());
+    size_t local = 64;
+    size_t global = (t->num_elem() + local - 1) / local * local;
+    if (t->mem_type == abc::TENSOR_MEM_SVM_FINE || t->mem_type == abc::TENSOR_MEM_SVM_COARSE) {
+        abc::set_kernel_args(kernel, n, abc::SvmPointer{t->host_backing});
+    } else {
+        abc::set_kernel_args(kernel, n, t->gptr);
+    }
+    clEnqueueNDRangeKernel(clrt().profile_queue(), kernel, 1, NULL, &global, &local, 0, NULL, NULL);
+}
+
+static double run_copy(cl_kernel kernel, Tensor *t, int reps) {
+    auto begin = std::chrono::steady_clock::now();
+    for (int r = 0; r < reps; ++r) {
+        fill_host(t->num_elem(), t->hostptr);
+        abc::copy_fp16_host_mem_to_cl_mem(t->num_elem(), t->hostptr, t->gptr);
+        launch(kernel, t);
+        abc::copy_fp16_cl_mem_to_host_mem(t->num_elem(), t->gptr, t->hostptr);
+        checksum_host(t->num_elem(), t->hostptr);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - begin).count() / reps;
+}
+
+static double run_mapped(cl_kernel kernel, Tensor *t, int reps) {
+    auto begin = std::chrono::steady_clock::now();
+    for (int r = 0; r < reps; ++r) {
+        {
+            abc::ScopedTensorMap map(t, CL_MAP_WRITE_INVALIDATE_REGION);
+            fill_host(t->num_elem(), map.data());
+        }
+        launch(kernel, t);
+        {
+            abc::ScopedTensorMap map(t, CL_MAP_READ);
+            checksum_host(t->num_elem(), map.data());
+        }
+    }
+    clFinish(clrt().profile_queue());
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - begin).count() / reps;
+}
+
+int main(int argc, char const *argv[]) {
+    clrt().init();
+    int reps = argc > 1 ? atoi(argv[1]) : 20;
+    cl_int ret = CL_SUCCESS;
+    cl_kernel kernel = clrt().create_kernel("scale_f16", makeScaleKernelString().c_str(), NULL, &ret);
+    if (CL_SUCCESS != ret) {
+        LOGE("create_kernel failed.");
+        return -1;
+    }
+
+    const char *svm_name = (clrt().svm_capabilities() & CL_DEVICE_SVM_FINE_GRAIN_BUFFER) ? "svm_fine(ms)"
+                                                                                          : "svm_coarse(ms)";
+    LOGI("%10s %12s %14s %14s %14s", "elements", "copy(ms)", "alloc_host(ms)", "use_host(ms)", svm_name);
+    for (int w = 64; w <= 4096; w *= 2) {
+        abc::dims4d dims = {1, 4, w, w / 4};
+        Tensor copy_tensor = abc::make_4d_tensor(dims);
+        abc::alloc_tensor_host_mem(&copy_tensor);
+        abc::alloc_tensor_cl_mem(&copy_tensor);
+        Tensor alloc_tensor = abc::make_4d_tensor(dims);
+        abc::alloc_tensor_mapped_mem(&alloc_tensor, abc::TENSOR_MEM_ALLOC_HOST_PTR);
+        Tensor use_tensor = abc::make_4d_tensor(dims);
+        abc::alloc_tensor_mapped_mem(&use_tensor, abc::TENSOR_MEM_USE_HOST_PTR);
+        Tensor svm_tensor = abc::make_4d_tensor(dims);
+        const bool has_svm = clrt().svm_capabilities() && CL_SUCCESS == abc::alloc_tensor_svm_mem(&svm_tensor);
+
+        // warmup
+        run_copy(kernel, &copy_tensor, 1);
+        run_mapped(kernel, &alloc_tensor, 1);
+        run_mapped(kernel, &use_tensor, 1);
+        if (has_svm) {
+            run_mapped(kernel, &svm_tensor, 1);
+        }
+        double copy_ms = run_copy(kernel, &copy_tensor, reps);
+        double alloc_ms = run_mapped(kernel, &alloc_tensor, reps);
+        double use_ms = run_mapped(kernel, &use_tensor, reps);
+        char svm_ms[32] = "-";
+        if (has_svm) {
+            snprintf(svm_ms, sizeof(svm_ms), "%.3f", run_mapped(kernel, &svm_tensor, reps));
+        }
+        LOGI("%10zu %12.3f %14.3f %14.3f %14s", copy_tensor.num_elem(), copy_ms, alloc_ms, use_ms, svm_ms);
+    }
+    clrt().release_kernel(kernel);
+    return 0;
+}
@@ -0,0 +1,218 @@
+// Multi-head scaled dot-product attention, fp16 in and out, fp32 math:
+//   O = softmax(scale * Q * K^T + mask) * V
+// Q, K, V and O are [B * H][S][HEAD_DIM]; CAUSAL masks keys after the query.
+//
+// attention_fused computes it in one pass, FlashAttention style: a
+// work-group owns BLOCK_M query rows (one per work-item) and streams K and V
+// through local memory BLOCK_N keys at a time. Every work-item keeps its
+// running max, softmax denominator and output row in registers and rescales
+// them as new keys arrive (online softmax), so the S x S score matrix is
+// never written to global memory. The rows take HEAD_DIM / 2 float4
+// registers, so the host only runs it up to HEAD_DIM 64.
+//
+// attention_scores, softmax_rows and attention_pv are the unfused
+// gemm -> softmax -> gemm pipeline through a [B * H][S][S] score buffer.
+
+#ifndef HEAD_DIM
+#define HEAD_DIM 64
+#endif
+#ifndef BLOCK_M
+#define BLOCK_M 32
+#endif
+#ifndef BLOCK_N
+#define BLOCK_N 32
+#endif
+#ifndef SOFTMAX_WG
+#define SOFTMAX_WG 64
+#endif
+
+#define D4 (HEAD_DIM / 4)
+
+#if defined(CAUSAL)
+#define MASKED(q, k) ((k) >= S || (k) > (q))
+#else
+#define MASKED(q, k) ((k) >= S)
+#endif
+
+// Launch: local = {BLOCK_M, 1}, global = {ceil(S / BLOCK_M) * BLOCK_M, B * H}
+__attribute__((reqd_work_group_size(BLOCK_M, 1, 1)))
+__kernel void attention_fused(int S,
+                              float scale,
+                              __global const half *Q,
+                              __global const half *K,
+                              __global const half *V,
+                              __global half *O) {
+    const int tid = get_local_id(0);
+    const int m0 = get_group_id(0) * BLOCK_M;
+    const int qi = m0 + tid;
+    const int bh = get_group_id(1);
+    const int base = bh * S * HEAD_DIM;
+
+    __local half4 Ks[BLOCK_N][D4];
+    __local half4 Vs[BLOCK_N][D4];
+
+    float4 q[D4];
+    float4 o[D4];
+    for (int d = 0; d < D4; ++d) {
+        q[d] = qi < S ? convert_float4(vload4(d, Q + base + qi * HEAD_DIM)) * scale : (float4)(0);
+        o[d] = (float4)(0);
+    }
+    float row_max = -INFINITY;
+    float row_sum = 0.0f;
+
+#if defined(CAUSAL)
+    const int n_end = min(S, m0 + BLOCK_M);
+#else
+    const int n_end = S;
+#endif
+    for (int n0 = 0; n0 < n_end; n0 += BLOCK_N) {
+        for (int idx = tid; idx < BLOCK_N * D4; idx += BLOCK_M) {
+            const int j = idx / D4;
+            const int d = idx - j * D4;
+            const bool valid = n0 + j < S;
+            Ks[j][d] = valid ? vload4(d, K + base + (n0 + j) * HEAD_DIM) : (half4)(0);
+            Vs[j][d] = valid ? vload4(d, V + base + (n0 + j) * HEAD_DIM) : (half4)(0);
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        float s[BLOCK_N];
+        float block_max = -INFINITY;
+        for (int j = 0; j < BLOCK_N; ++j) {
+            float4 dot4 = (float4)(0);
+            for (int d = 0; d < D4; ++d) {
+                dot4 = mad(q[d], convert_float4(Ks[j][d]), dot4);
+            }
+            s[j] = MASKED(qi, n0 + j) ? -INFINITY : dot4.s0 + dot4.s1 + dot4.s2 + dot4.s3;
+            block_max = fmax(block_max, s[j]);
+        }
+        const float new_max = fmax(row_max, block_max);
+        // key 0 is never masked, so new_max is finite from the first block on
+        const float correction = exp(row_max - new_max);
+        row_sum *= correction;
+        for (int d = 0; d < D4; ++d) {
+            o[d] *= correction;
+        }
+        for (int j = 0; j < BLOCK_N; ++j) {
+            const float p = exp(s[j] - new_max);
+            row_sum += p;
+            for (int d = 0; d < D4; ++d) {
+                o[d] = mad((float4)(p), convert_float4(Vs[j][d]), o[d]);
+            }
+        }
+        row_max = new_max;
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if (qi < S) {
+        const float inv = 1.0f / row_sum;
+        for (int d = 0; d < D4; ++d) {
+            vstore4(convert_half4(o[d] * inv), d, O + base + qi * HEAD_DIM);
+        }
+    }
+}
+
+// P[bh][i][j] = scale * Q[bh][i] . K[bh][j], -inf where masked.
+// Every work-item computes a 4 x 4 block of P.
+// Launch: global = {ceil(S / 4), ceil(S / 4), B * H}, padded up to the local size
+__kernel void attention_scores(int S,
+                               int BH,
+                               float scale,
+                               __global const half *Q,
+                               __global const half *K,
+                               __global half *P) {
+    const int j0 = get_global_id(0) << 2;
+    const int i0 = get_global_id(1) << 2;
+    const int bh = get_global_id(2);
+    if (j0 >= S || i0 >= S || bh >= BH) return;
+    const int base = bh * S * HEAD_DIM;
+    float4 acc[4];
+    for (int r = 0; r < 4; ++r) {
+        acc[r] = (float4)(0);
+    }
+    for (int d = 0; d < D4; ++d) {
+        float4 k[4];
+        for (int c = 0; c < 4; ++c) {
+            k[c] = j0 + c < S ? convert_float4(vload4(d, K + base + (j0 + c) * HEAD_DIM)) : (float4)(0);
+        }
+        for (int r = 0; r < 4; ++r) {
+            if (i0 + r >= S) break;
+            float4 q = convert_float4(vload4(d, Q + base + (i0 + r) * HEAD_DIM));
+            acc[r] += (float4)(dot(q, k[0]), dot(q, k[1]), dot(q, k[2]), dot(q, k[3]));
+        }
+    }
+    for (int r = 0; r < 4 && i0 + r < S; ++r) {
+        const int qi = i0 + r;
+        __global half *row = P + ((size_t)bh * S + qi) * S;
+        float v[4] = {acc[r].s0, acc[r].s1, acc[r].s2, acc[r].s3};
+        for (int c = 0; c < 4 && j0 + c < S; ++c) {
+            row[j0 + c] = MASKED(qi, j0 + c) ? (half)(-INFINITY) : (half)(v[c] * scale);
+        }
+    }
+}
+
+// In-place softmax over each row of P; one work-group per row.
+// Launch: local = {SOFTMAX_WG, 1}, global = {SOFTMAX_WG, B * H * S}
+__attribute__((reqd_work_group_size(SOFTMAX_WG, 1, 1)))
+__kernel void softmax_rows(int S, __global half *P) {
+    const int tid = get_local_id(0);
+    __global half *row = P + (size_t)get_global_id(1) * S;
+    __local float scratch[SOFTMAX_WG];
+
+    float m = -INFINITY;
+    for (int j = tid; j < S; j += SOFTMAX_WG) {
+        m = fmax(m, (float)(row[j]));
+    }
+    scratch[tid] = m;
+    barrier(CLK_LOCAL_MEM_FENCE);
+    for (int step = SOFTMAX_WG / 2; step > 0; step >>= 1) {
+        if (tid < step) scratch[tid] = fmax(scratch[tid], scratch[tid + step]);
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    m = scratch[0];
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    float sum = 0.0f;
+    for (int j = tid; j < S; j += SOFTMAX_WG) {
+        sum += exp((float)(row[j]) - m);
+    }
+    scratch[tid] = sum;
+    barrier(CLK_LOCAL_MEM_FENCE);
+    for (int step = SOFTMAX_WG / 2; step > 0; step >>= 1) {
+        if (tid < step) scratch[tid] += scratch[tid + step];
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    const float inv = 1.0f / scratch[0];
+    for (int j = tid; j < S; j += SOFTMAX_WG) {
+        row[j] = (half)(exp((float)(row[j]) - m) * inv);
+    }
+}
+
+// O[bh][i] = sum_j P[bh][i][j] * V[bh][j]. Every work-item computes four
+// rows by four columns of O.
+// Launch: global = {D4, ceil(S / 4), B * H}, padded up to the local size
+__kernel void attention_pv(int S,
+                           int BH,
+                           __global const half *P,
+                           __global const half *V,
+                           __global half *O) {
+    const int d = get_global_id(0);
+    const int i0 = get_global_id(1) << 2;
+    const int bh = get_global_id(2);
+    if (d >= D4 || i0 >= S || bh >= BH) return;
+    const int base = bh * S * HEAD_DIM;
+    __global const half *p = P + ((size_t)bh * S + i0) * S;
+    const int rows = min(4, S - i0);
+    float4 acc[4];
+    for (int r = 0; r < 4; ++r) {
+        acc[r] = (float4)(0);
+    }
+    for (int j = 0; j < S; ++j) {
+        float4 v = convert_float4(vload4(d, V + base + j * HEAD_DIM));
+        for (int r = 0; r < rows; ++r) {
+            acc[r] = mad((float4)(p[r * S + j]), v, acc[r]);
+        }
+    }
+    for (int r = 0; r < rows; ++r) {
+        vstore4(convert_half4(acc[r]), d, O + base + (i0 + r) * HEAD_DIM);
+    }
+}
@@ -0,0 +1,243 @@
+// fp16 transposed convolution in NCHW.
+//   input  [N][IC][IH][IW]
+//   weight [IC][OC][KERNEL_H][KERNEL_W] (ConvTranspose2d layout)
+//   output [N][OC][OH][OW],
+//   OH = (IH - 1) * STRIDE_H - 2 * PAD_H + DILATION_H * (KERNEL_H - 1) + output_padding_h + 1
+//
+// As a gemm this is columns[OC * KERNEL_H * KERNEL_W][IH * IW] = weight^T * input
+// followed by a col2im scatter-add of the columns into the output (see
+// scripts/col2im.py). Both kernels fold the col2im into the gemm, so the
+// column matrix never goes through global memory:
+//   deconv_nchw_direct - STRIDE >= dilated kernel extent. Taps never overlap,
+//                        so every accumulator is stored straight to its
+//                        output position.
+//   deconv_nchw_gather - any shape. Each work-item owns output elements and
+//                        sums the taps that land on them, so no atomics.
+// Both apply the epilogue of kernel/CL/epilogue.cl with oc as the channel.
+
+#ifndef KERNEL_H
+#define KERNEL_H 2
+#endif
+#ifndef KERNEL_W
+#define KERNEL_W 2
+#endif
+#ifndef STRIDE_H
+#define STRIDE_H 2
+#endif
+#ifndef STRIDE_W
+#define STRIDE_W 2
+#endif
+#ifndef PAD_H
+#define PAD_H 0
+#endif
+#ifndef PAD_W
+#define PAD_W 0
+#endif
+#ifndef DILATION_H
+#define DILATION_H 1
+#endif
+#ifndef DILATION_W
+#define DILATION_W 1
+#endif
+
+#define KERNEL_AREA (KERNEL_H * KERNEL_W)
+
+// four consecutive halfs at p[i .. i + 3], zero outside [0, n)
+inline half4 load4_guarded(__global const half *p, int i, int n) {
+    if (i >= 0 && i + 4 <= n) {
+        return vload4(0, p + i);
+    }
+    half4 v = (half4)(0);
+    if (i >= 0 && i < n) v.s0 = p[i];
+    if (i + 1 >= 0 && i + 1 < n) v.s1 = p[i + 1];
+    if (i + 2 >= 0 && i + 2 < n) v.s2 = p[i + 2];
+    if (i + 3 >= 0 && i + 3 < n) v.s3 = p[i + 3];
+    return v;
+}
+
+// Every work-item computes four rows m = (oc * KERNEL_H + kh) * KERNEL_W + kw
+// of the column matrix for four consecutive iw of one input row, then stores
+// each element to oh = ih * STRIDE_H - PAD_H + kh * DILATION_H,
+// ow = iw * STRIDE_W - PAD_W + kw * DILATION_W. Blocks never wrap to the next
+// input row, so any IW works. Outputs no tap reaches (stride larger than the
+// kernel, output_padding) must be zeroed beforehand.
+//
+// Launch: global = {ceil(IW / 4), ceil(OC * KERNEL_AREA / 4), N * IH}
+__kernel void deconv_nchw_direct(int N,
+                                 int IC,
+                                 int IH,
+                                 int IW,
+                                 int OC,
+                                 int OH,
+                                 int OW,
+                                 __global const half *input,
+                                 __global const half *weight,
+                                 __global half *output,
+                                 EPILOGUE_PARAMS) {
+    const int iw0 = get_global_id(0) << 2;
+    const int m0 = get_global_id(1) << 2;
+    const int nh = get_global_id(2);
+    const int M = OC * KERNEL_AREA;
+    if (iw0 >= IW || m0 >= M || nh >= N * IH) return;
+    const int n = nh / IH;
+    const int ih = nh - n * IH;
+
+    half4 acc0 = (half4)(0);
+    half4 acc1 = (half4)(0);
+    half4 acc2 = (half4)(0);
+    half4 acc3 = (half4)(0);
+    __global const half *in = input + (n * IC * IH + ih) * IW;
+    __global const half *w = weight;
+    const int in_step = IH * IW;
+    for (int ic = 0; ic < IC; ++ic) {
+        half4 x = load4_guarded(in, iw0, IW);
+        half4 wv = load4_guarded(w, m0, M);
+        acc0 += wv.s0 * x;
+        acc1 += wv.s1 * x;
+        acc2 += wv.s2 * x;
+        acc3 += wv.s3 * x;
+        in += in_step;
+        w += M;
+    }
+
+    const int iw_num = min(4, IW - iw0);
+#if KERNEL_W == 2 && STRIDE_W == 2 && DILATION_W == 1
+    // rows (m0, m0 + 1) and (m0 + 2, m0 + 3) are kw = 0, 1 of one (oc, kh):
+    // interleaved they make eight contiguous outputs.
+    for (int r = 0; r < 4 && m0 + r < M; r += 2) {
+        const int oc = (m0 + r) / KERNEL_AREA;
+        const int kh = ((m0 + r) - oc * KERNEL_AREA) / KERNEL_W;
+        const int oh = ih * STRIDE_H - PAD_H + kh * DILATION_H;
+        if (oh < 0 || oh >= OH) continue;
+        const half4 a = r == 0 ? acc0 : acc2;
+        const half4 b = r == 0 ? acc1 : acc3;
+        const int row = ((n * OC + oc) * OH + oh) * OW;
+        __global half *out = output + row;
+        const int ow0 = iw0 * 2 - PAD_W;
+        half4 v0 = (half4)(a.s0, b.s0, a.s1, b.s1);
+        half4 v1 = (half4)(a.s2, b.s2, a.s3, b.s3);
+        if (iw_num == 4 && ow0 >= 0 && ow0 + 8 <= OW) {
+            vstore4(epilogue4(v0, oc, row + ow0, EPILOGUE_ARGS), 0, out + ow0);
+            vstore4(epilogue4(v1, oc, row + ow0 + 4, EPILOGUE_ARGS), 0, out + ow0 + 4);
+        } else {
+#define STORE_TAIL(j, val, valid)                                              \
+    if ((valid) && ow0 + (j) >= 0 && ow0 + (j) < OW) {                         \
+        out[ow0 + (j)] = epilogue1(val, oc, row + ow0 + (j), EPILOGUE_ARGS); \
+    }
+            STORE_TAIL(0, v0.s0, 1)
+            STORE_TAIL(1, v0.s1, 1)
+            STORE_TAIL(2, v0.s2, iw_num > 1)
+            STORE_TAIL(3, v0.s3, iw_num > 1)
+            STORE_TAIL(4, v1.s0, iw_num > 2)
+            STORE_TAIL(5, v1.s1, iw_num > 2)
+            STORE_TAIL(6, v1.s2, iw_num > 3)
+            STORE_TAIL(7, v1.s3, iw_num > 3)
+#undef STORE_TAIL
+        }
+    }
+#else
+    for (int r = 0; r < 4 && m0 + r < M; ++r) {
+        const int m = m0 + r;
+        const int oc = m / KERNEL_AREA;
+        const int k = m - oc * KERNEL_AREA;
+        const int kh = k / KERNEL_W;
+        const int kw = k - kh * KERNEL_W;
+        const int oh = ih * STRIDE_H - PAD_H + kh * DILATION_H;
+        if (oh < 0 || oh >= OH) continue;
+        const half4 a = r == 0 ? acc0 : (r == 1 ? acc1 : (r == 2 ? acc2 : acc3));
+        const int row = ((n * OC + oc) * OH + oh) * OW;
+        __global half *out = output + row;
+        const int ow0 = iw0 * STRIDE_W - PAD_W + kw * DILATION_W;
+#define STORE_TAIL(j, val)                                                                          \
+    if (iw_num > (j) && ow0 + (j) * STRIDE_W >= 0 && ow0 + (j) * STRIDE_W < OW) {                \
+        out[ow0 + (j) * STRIDE_W] = epilogue1(val, oc, row + ow0 + (j) * STRIDE_W, EPILOGUE_ARGS); \
+    }
+        STORE_TAIL(0, a.s0)
+        STORE_TAIL(1, a.s1)
+        STORE_TAIL(2, a.s2)
+        STORE_TAIL(3, a.s3)
+#undef STORE_TAIL
+    }
+#endif
+}
+
+// Every work-item computes four output channels at four outputs
+// ow = px + (q0 + j) * STRIDE_W, j = 0..3, of one output row. Outputs with
+// the same phase px = ow % STRIDE_W take the same kw taps, and the input
+// columns they read are consecutive, so the inner loop is the same 4x4
+// register block as the direct path.
+//
+// Launch: global = {STRIDE_W * ceil(ceil(OW / STRIDE_W) / 4), ceil(OC / 4), N * OH}
+__kernel void deconv_nchw_gather(int N,
+                                 int IC,
+                                 int IH,
+                                 int IW,
+                                 int OC,
+                                 int OH,
+                                 int OW,
+                                 __global const half *input,
+                                 __global const half *weight,
+                                 __global half *output,
+                                 EPILOGUE_PARAMS) {
+    const int px = get_global_id(0) % STRIDE_W;
+    const int q0 = (get_global_id(0) / STRIDE_W) << 2;
+    const int oc0 = get_global_id(1) << 2;
+    const int nh = get_global_id(2);
+    const int ow0 = px + q0 * STRIDE_W;
+    if (ow0 >= OW || oc0 >= OC || nh >= N * OH) return;
+    const int n = nh / OH;
+    const int oh = nh - n * OH;
+    const int oc_num = min(4, OC - oc0);
+
+    half4 acc0 = (half4)(0);
+    half4 acc1 = (half4)(0);
+    half4 acc2 = (half4)(0);
+    half4 acc3 = (half4)(0);
+    const int in_step = IH * IW;
+    const int w_step = OC * KERNEL_AREA;
+    for (int kh = 0; kh < KERNEL_H; ++kh) {
+        const int th = oh + PAD_H - kh * DILATION_H;
+        if (th < 0 || th % STRIDE_H != 0) continue;
+        const int ih = th / STRIDE_H;
+        if (ih >= IH) continue;
+        for (int kw = 0; kw < KERNEL_W; ++kw) {
+            const int tw = px + PAD_W - kw * DILATION_W;
+            if (tw % STRIDE_W != 0) continue;
+            const int iw0 = tw / STRIDE_W + q0;
+            if (iw0 + 4 <= 0 || iw0 >= IW) continue;
+            __global const half *in = input + (n * IC * IH + ih) * IW;
+            __global const half *w = weight + (oc0 * KERNEL_H + kh) * KERNEL_W + kw;
+            for (int ic = 0; ic < IC; ++ic) {
+                half4 x = load4_guarded(in, iw0, IW);
+                acc0 += w[0] * x;
+                if (oc_num > 1) acc1 += w[KERNEL_AREA] * x;
+                if (oc_num > 2) acc2 += w[2 * KERNEL_AREA] * x;
+                if (oc_num > 3) acc3 += w[3 * KERNEL_AREA] * x;
+                in += in_step;
+                w += w_step;
+            }
+        }
+    }
+
+    for (int r = 0; r < oc_num; ++r) {
+        const half4 a = r == 0 ? acc0 : (r == 1 ? acc1 : (r == 2 ? acc2 : acc3));
+        const int oc = oc0 + r;
+        const int row = ((n * OC + oc) * OH + oh) * OW;
+        __global half *out = output + row;
+#if STRIDE_W == 1
+        if (ow0 + 4 <= OW) {
+            vstore4(epilogue4(a, oc, row + ow0, EPILOGUE_ARGS), 0, out + ow0);
+            continue;
+        }
+#endif
+#define STORE_TAIL(j, val)                                                                          \
+    if (ow0 + (j) * STRIDE_W < OW) {                                                             \
+        out[ow0 + (j) * STRIDE_W] = epilogue1(val, oc, row + ow0 + (j) * STRIDE_W, EPILOGUE_ARGS); \
+    }
+        STORE_TAIL(0, a.s0)
+        STORE_TAIL(1, a.s1)
+        STORE_TAIL(2, a.s2)
+        STORE_TAIL(3, a.s3)
+#undef STORE_TAIL
+    }
+}
@@ -0,0 +1,47 @@
+// 2x2 stride 2 transposed convolution on NC4HW4 images.
+// input  NC4HW4 image of {1, IC, IH, IW}
+// weight image of [IC][OC][2][2]: pixel (ic, kpos * OC4 + oc4), kpos = kh * 2 + kw,
+//        holds weight[ic][oc4 * 4 .. oc4 * 4 + 3][kh][kw]
+// output NC4HW4 image of {1, OC, 2 * IH, 2 * IW}
+//
+// Every work-item reads one input pixel per ic4 block and writes the 2x2
+// output pixels it covers, for four output channels.
+//
+// Launch: global = {IW, ceil(OC / 4), IH}
+
+__kernel void deconv_f2s2_nc4hw4_image(int IC,
+                                       int OC,
+                                       int IH,
+                                       int IW,
+                                       __read_only image2d_t input,
+                                       __read_only image2d_t weight,
+                                       __write_only image2d_t output) {
+    const int iw = get_global_id(0);
+    const int oc4 = get_global_id(1);
+    const int ih = get_global_id(2);
+    const int oc4_num = (OC + 3) >> 2;
+    if (iw >= IW || oc4 >= oc4_num || ih >= IH) return;
+
+    half4 acc[4];
+    for (int k = 0; k < 4; ++k) {
+        acc[k] = (half4)(0);
+    }
+    const int ic4_num = (IC + 3) >> 2;
+    for (int ic4 = 0; ic4 < ic4_num; ++ic4) {
+        half4 in = READ_IMAGE_2D(input, ic4 * IW + iw, ih);
+        const int ic = ic4 << 2;
+        for (int k = 0; k < 4; ++k) {
+            const int y = k * oc4_num + oc4;
+            acc[k] += in.x * READ_IMAGE_2D(weight, ic, y) + in.y * READ_IMAGE_2D(weight, ic + 1, y) +
+                      in.z * READ_IMAGE_2D(weight, ic + 2, y) + in.w * READ_IMAGE_2D(weight, ic + 3, y);
+        }
+    }
+
+    const int OW = IW << 1;
+    const int x = oc4 * OW + (iw << 1);
+    const int y = ih << 1;
+    WRITE_IMAGE_2D(output, acc[0], x, y);
+    WRITE_IMAGE_2D(output, acc[1], x + 1, y);
+    WRITE_IMAGE_2D(output, acc[2], x, y + 1);
+    WRITE_IMAGE_2D(output, acc[3], x + 1, y + 1);
+}
@@ -0,0 +1,166 @@
+// Int8 transposed convolution in NCHW, int32 accumulation. Same layouts,
+// parameters and launch as deconv_nchw_gather in deconv.cl:
+//   input  [N][IC][IH][IW], quantized with zero point in_zp
+//   weight [IC][OC][KERNEL_H][KERNEL_W], symmetric
+//   output [N][OC][OH][OW]
+// Every work-item computes four output channels at four outputs of one row
+// that share a stride phase. Input channels are consumed four at a time:
+// the four channels of each output are packed into a char4 and multiplied
+// with the matching weights by DOT4_ACC (kernel/CL/quant.cl).
+//
+// Which taps reach an output depends on its position, so the input zero
+// point cannot be folded into the requant offset as in the gemm. Instead
+// the kernel adds up weight_sums[oc][tap] (the sum of the tap's weights over
+// IC, see int8_channel_sums()) for every tap it visits and subtracts
+// in_zp times that. Inputs past the row edge read as in_zp, which that
+// correction cancels.
+//
+// Launch: global = {STRIDE_W * ceil(ceil(OW / STRIDE_W) / 4), ceil(OC / 4), N * OH}
+
+#ifndef KERNEL_H
+#define KERNEL_H 2
+#endif
+#ifndef KERNEL_W
+#define KERNEL_W 2
+#endif
+#ifndef STRIDE_H
+#define STRIDE_H 2
+#endif
+#ifndef STRIDE_W
+#define STRIDE_W 2
+#endif
+#ifndef PAD_H
+#define PAD_H 0
+#endif
+#ifndef PAD_W
+#define PAD_W 0
+#endif
+#ifndef DILATION_H
+#define DILATION_H 1
+#endif
+#ifndef DILATION_W
+#define DILATION_W 1
+#endif
+
+#define KERNEL_AREA (KERNEL_H * KERNEL_W)
+
+// four consecutive chars at p[i .. i + 3], pad outside [0, n)
+inline char4 load4_int8_guarded(__global const char *p, int i, int n, char pad) {
+    if (i >= 0 && i + 4 <= n) {
+        return vload4(0, p + i);
+    }
+    char4 v = (char4)(pad);
+    if (i >= 0 && i < n) v.s0 = p[i];
+    if (i + 1 >= 0 && i + 1 < n) v.s1 = p[i + 1];
+    if (i + 2 >= 0 && i + 2 < n) v.s2 = p[i + 2];
+    if (i + 3 >= 0 && i + 3 < n) v.s3 = p[i + 3];
+    return v;
+}
+
+__kernel void deconv_nchw_gather_int8(int N,
+                                      int IC,
+                                      int IH,
+                                      int IW,
+                                      int OC,
+                                      int OH,
+                                      int OW,
+                                      int in_zp,
+                                      __global const char *input,
+                                      __global const char *weight,
+                                      __global const int *weight_sums,
+                                      __global char *output,
+                                      REQUANT_PARAMS) {
+    const int px = get_global_id(0) % STRIDE_W;
+    const int q0 = (get_global_id(0) / STRIDE_W) << 2;
+    const int oc0 = get_global_id(1) << 2;
+    const int nh = get_global_id(2);
+    const int ow0 = px + q0 * STRIDE_W;
+    if (ow0 >= OW || oc0 >= OC || nh >= N * OH) return;
+    const int n = nh / OH;
+    const int oh = nh - n * OH;
+    const int oc_num = min(4, OC - oc0);
+    const char pad = (char)in_zp;
+
+    int4 acc0 = (int4)(0);
+    int4 acc1 = (int4)(0);
+    int4 acc2 = (int4)(0);
+    int4 acc3 = (int4)(0);
+    int4 corr = (int4)(0);  // per output channel
+    const int in_step = IH * IW;
+    const int w_step = OC * KERNEL_AREA;
+    for (int kh = 0; kh < KERNEL_H; ++kh) {
+        const int th = oh + PAD_H - kh * DILATION_H;
+        if (th < 0 || th % STRIDE_H != 0) continue;
+        const int ih = th / STRIDE_H;
+        if (ih >= IH) continue;
+        for (int kw = 0; kw < KERNEL_W; ++kw) {
+            const int tw = px + PAD_W - kw * DILATION_W;
+            if (tw % STRIDE_W != 0) continue;
+            const int iw0 = tw / STRIDE_W + q0;
+            if (iw0 + 4 <= 0 || iw0 >= IW) continue;
+            const int tap = kh * KERNEL_W + kw;
+            __global const char *in = input + (n * IC * IH + ih) * IW;
+            __global const char *w = weight + oc0 * KERNEL_AREA + tap;
+            for (int ic = 0; ic < IC; ic += 4) {
+                const int ic_num = min(4, IC - ic);
+                // xk: input channel ic + k at the four outputs
+                const char4 x0 = load4_int8_guarded(in, iw0, IW, pad);
+                const char4 x1 = ic_num > 1 ? load4_int8_guarded(in + in_step, iw0, IW, pad) : (char4)(0);
+                const char4 x2 = ic_num > 2 ? load4_int8_guarded(in + 2 * in_step, iw0, IW, pad) : (char4)(0);
+                const char4 x3 = ic_num > 3 ? load4_int8_guarded(in + 3 * in_step, iw0, IW, pad) : (char4)(0);
+                // lj: the four input channels of output j
+                const char4 l0 = (char4)(x0.s0, x1.s0, x2.s0, x3.s0);
+                const char4 l1 = (char4)(x0.s1, x1.s1, x2.s1, x3.s1);
+                const char4 l2 = (char4)(x0.s2, x1.s2, x2.s2, x3.s2);
+                const char4 l3 = (char4)(x0.s3, x1.s3, x2.s3, x3.s3);
+#define WEIGHT4(r)                                                                                       \
+    ((r) < oc_num ? (char4)(w[(r) * KERNEL_AREA], ic_num > 1 ? w[w_step + (r) * KERNEL_AREA] : 0,       \
+                            ic_num > 2 ? w[2 * w_step + (r) * KERNEL_AREA] : 0,                          \
+                            ic_num > 3 ? w[3 * w_step + (r) * KERNEL_AREA] : 0)                          \
+                  : (char4)(0))
+#define DOT_ROW(acc, wv)                                                                                 \
+    acc = (int4)(DOT4_ACC(wv, l0, acc.s0), DOT4_ACC(wv, l1, acc.s1), DOT4_ACC(wv, l2, acc.s2),           \
+                 DOT4_ACC(wv, l3, acc.s3))
+                const char4 w0 = WEIGHT4(0);
+                const char4 w1 = WEIGHT4(1);
+                const char4 w2 = WEIGHT4(2);
+                const char4 w3 = WEIGHT4(3);
+                DOT_ROW(acc0, w0);
+                DOT_ROW(acc1, w1);
+                DOT_ROW(acc2, w2);
+                DOT_ROW(acc3, w3);
+#undef DOT_ROW
+#undef WEIGHT4
+                in += 4 * in_step;
+                w += 4 * w_step;
+            }
+            __global const int *sums = weight_sums + oc0 * KERNEL_AREA + tap;
+            corr += (int4)(sums[0], oc_num > 1 ? sums[KERNEL_AREA] : 0, oc_num > 2 ? sums[2 * KERNEL_AREA] : 0,
+                           oc_num > 3 ? sums[3 * KERNEL_AREA] : 0);
+        }
+    }
+    corr *= in_zp;
+
+    for (int r = 0; r < oc_num; ++r) {
+        const int4 a = r == 0 ? acc0 - corr.s0
+                              : (r == 1 ? acc1 - corr.s1 : (r == 2 ? acc2 - corr.s2 : acc3 - corr.s3));
+        const int oc = oc0 + r;
+        const int row = ((n * OC + oc) * OH + oh) * OW;
+        __global char *out = output + row;
+#if STRIDE_W == 1
+        if (ow0 + 4 <= OW) {
+            vstore4(requant4(a, oc, REQUANT_ARGS), 0, out + ow0);
+            continue;
+        }
+#endif
+#define STORE_TAIL(j, val)                                                       \
+    if (ow0 + (j) * STRIDE_W < OW) {                                            \
+        out[ow0 + (j) * STRIDE_W] = requant1(val, oc, REQUANT_ARGS);            \
+    }
+        STORE_TAIL(0, a.s0)
+        STORE_TAIL(1, a.s1)
+        STORE_TAIL(2, a.s2)
+        STORE_TAIL(3, a.s3)
+#undef STORE_TAIL
+    }
+}
@@ -0,0 +1,80 @@
+// Output epilogue shared by the gemm and deconv kernels. The host prepends
+// this file to their source and selects the stages with build options:
+//   -DEPILOGUE_SCALE     v *= scale
+//   -DEPILOGUE_BIAS      v += bias[channel]
+//   -DEPILOGUE_RESIDUAL  v += residual[index], same layout as the output
+//   -DEPILOGUE_ACT=n     0 none, 1 ReLU, 2 ReLU6, 3 GELU (tanh approximation)
+// applied in that order, in fp32 registers, right before the store:
+//   out = act(scale * acc + bias[c] + residual[i])
+// Kernels always take the three EPILOGUE_PARAMS arguments; the ones a build
+// does not use may be NULL.
+
+#ifndef EPILOGUE_ACT
+#define EPILOGUE_ACT 0
+#endif
+
+#define EPILOGUE_PARAMS __global const half *epi_bias, float epi_scale, __global const half *epi_residual
+#define EPILOGUE_ARGS epi_bias, epi_scale, epi_residual
+
+inline float epilogue_act(float v) {
+#if EPILOGUE_ACT == 1
+    v = fmax(v, 0.0f);
+#elif EPILOGUE_ACT == 2
+    v = fmin(fmax(v, 0.0f), 6.0f);
+#elif EPILOGUE_ACT == 3
+    v = 0.5f * v * (1.0f + tanh(0.7978845608f * (v + 0.044715f * v * v * v)));
+#endif
+    return v;
+}
+
+// one element of channel c at output index i
+inline half epilogue1(float acc, int c, int i, EPILOGUE_PARAMS) {
+    float v = acc;
+#ifdef EPILOGUE_SCALE
+    v *= epi_scale;
+#endif
+#ifdef EPILOGUE_BIAS
+    v += vload_half(c, epi_bias);
+#endif
+#ifdef EPILOGUE_RESIDUAL
+    v += vload_half(i, epi_residual);
+#endif
+    return (half)(epilogue_act(v));
+}
+
+// four contiguous elements of channel c starting at output index i
+inline half4 epilogue4(half4 acc, int c, int i, EPILOGUE_PARAMS) {
+    float4 v = convert_float4(acc);
+#ifdef EPILOGUE_SCALE
+    v *= epi_scale;
+#endif
+#ifdef EPILOGUE_BIAS
+    v += vload_half(c, epi_bias);
+#endif
+#ifdef EPILOGUE_RESIDUAL
+    v += vload_half4(0, epi_residual + i);
+#endif
+    v.s0 = epilogue_act(v.s0);
+    v.s1 = epilogue_act(v.s1);
+    v.s2 = epilogue_act(v.s2);
+    v.s3 = epilogue_act(v.s3);
+    return convert_half4(v);
+}
+
+// Standalone pass over an NCHW tensor, for outputs of kernels without a
+// fused epilogue. Every work-item handles four elements of one channel row.
+// Launch: global = {ceil(HW / 4), C, N}, padded up to the local size
+__kernel void epilogue_nchw(int N, int C, int HW, __global half *data, EPILOGUE_PARAMS) {
+    const int i0 = get_global_id(0) << 2;
+    const int c = get_global_id(1);
+    const int n = get_global_id(2);
+    if (i0 >= HW || c >= C || n >= N) return;
+    const int base = (n * C + c) * HW + i0;
+    if (i0 + 4 <= HW) {
+        vstore4(epilogue4(vload4(0, data + base), c, base, EPILOGUE_ARGS), 0, data + base);
+    } else {
+        for (int i = 0; i < HW - i0; ++i) {
+            data[base + i] = epilogue1(data[base + i], c, base + i, EPILOGUE_ARGS);
+        }
+    }
+}
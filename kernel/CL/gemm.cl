@@ -0,0 +1,149 @@
+// Tiled fp16 GEMM: C[M][N] = op(A) * op(B)
+//   TRANS_A == 0: A is [M][K] (lda >= K), TRANS_A == 1: A is [K][M] (lda >= M)
+//   TRANS_B == 0: B is [K][N] (ldb >= N), TRANS_B == 1: B is [N][K] (ldb >= K)
+//   C is [M][N] (ldc >= N)
+//
+// A work-group computes a TILE_M x TILE_N block of C. Each K step stages a
+// TILE_K deep slice of A and B in local memory, and every work-item keeps a
+// WPT_M x WPT_N register block of C. Work-items own rows/columns strided by
+// the work-group size, which keeps local reads conflict free and global
+// stores coalesced. Loads past M/N/K read zero and stores are guarded, so
+// any M, N and K is supported.
+//
+// The epilogue (kernel/CL/epilogue.cl) treats row m of C as the channel, as
+// in the conv-as-gemm layout C[OC][H * W] = weight^T * input.
+//
+// Launch: local = {TILE_N / WPT_N, TILE_M / WPT_M}
+//         global = {ceil(N / TILE_N) * local[0], ceil(M / TILE_M) * local[1]}
+
+#ifndef TILE_M
+#define TILE_M 32
+#endif
+#ifndef TILE_N
+#define TILE_N 32
+#endif
+#ifndef TILE_K
+#define TILE_K 16
+#endif
+#ifndef WPT_M
+#define WPT_M 4
+#endif
+#ifndef WPT_N
+#define WPT_N 4
+#endif
+#ifndef TRANS_A
+#define TRANS_A 0
+#endif
+#ifndef TRANS_B
+#define TRANS_B 0
+#endif
+
+#define RTS_M (TILE_M / WPT_M)
+#define RTS_N (TILE_N / WPT_N)
+#define WG_SIZE (RTS_M * RTS_N)
+
+#if defined(GEMM_ACC_FLOAT)
+#define ACC_T float
+#define TO_ACC(x) convert_float(x)
+#else
+#define ACC_T half
+#define TO_ACC(x) (x)
+#endif
+
+#if TRANS_A
+#define A_AT(m, k) A[(k) * lda + (m)]
+#else
+#define A_AT(m, k) A[(m) * lda + (k)]
+#endif
+
+#if TRANS_B
+#define B_AT(k, n) B[(n) * ldb + (k)]
+#else
+#define B_AT(k, n) B[(k) * ldb + (n)]
+#endif
+
+__attribute__((reqd_work_group_size(RTS_N, RTS_M, 1)))
+__kernel void gemm_tiled(int M,
+                         int N,
+                         int K,
+                         __global const half *A,
+                         int lda,
+                         __global const half *B,
+                         int ldb,
+                         __global half *C,
+                         int ldc,
+                         EPILOGUE_PARAMS) {
+    const int tx = get_local_id(0);
+    const int ty = get_local_id(1);
+    const int tid = ty * RTS_N + tx;
+    const int m0 = get_group_id(1) * TILE_M;
+    const int n0 = get_group_id(0) * TILE_N;
+
+    __local half As[TILE_K][TILE_M];
+    __local half Bs[TILE_K][TILE_N];
+
+    ACC_T acc[WPT_M][WPT_N];
+    for (int i = 0; i < WPT_M; ++i) {
+        for (int j = 0; j < WPT_N; ++j) {
+            acc[i][j] = 0;
+        }
+    }
+
+    for (int k0 = 0; k0 < K; k0 += TILE_K) {
+        for (int idx = tid; idx < TILE_K * TILE_M; idx += WG_SIZE) {
+#if TRANS_A
+            // A is [K][M]: consecutive work-items read consecutive m
+            const int kk = idx / TILE_M;
+            const int mm = idx % TILE_M;
+#else
+            // A is [M][K]: consecutive work-items read consecutive k
+            const int mm = idx / TILE_K;
+            const int kk = idx % TILE_K;
+#endif
+            const int gm = m0 + mm;
+            const int gk = k0 + kk;
+            As[kk][mm] = (gm < M && gk < K) ? A_AT(gm, gk) : (half)(0);
+        }
+        for (int idx = tid; idx < TILE_K * TILE_N; idx += WG_SIZE) {
+#if TRANS_B
+            const int nn = idx / TILE_K;
+            const int kk = idx % TILE_K;
+#else
+            const int kk = idx / TILE_N;
+            const int nn = idx % TILE_N;
+#endif
+            const int gn = n0 + nn;
+            const int gk = k0 + kk;
+            Bs[kk][nn] = (gn < N && gk < K) ? B_AT(gk, gn) : (half)(0);
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for (int kk = 0; kk < TILE_K; ++kk) {
+            ACC_T a_reg[WPT_M];
+            ACC_T b_reg[WPT_N];
+            for (int i = 0; i < WPT_M; ++i) {
+                a_reg[i] = TO_ACC(As[kk][ty + i * RTS_M]);
+            }
+            for (int j = 0; j < WPT_N; ++j) {
+                b_reg[j] = TO_ACC(Bs[kk][tx + j * RTS_N]);
+            }
+            for (int i = 0; i < WPT_M; ++i) {
+                for (int j = 0; j < WPT_N; ++j) {
+                    acc[i][j] = mad(a_reg[i], b_reg[j], acc[i][j]);
+                }
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    for (int i = 0; i < WPT_M; ++i) {
+        const int gm = m0 + ty + i * RTS_M;
+        if (gm >= M) break;
+        for (int j = 0; j < WPT_N; ++j) {
+            const int gn = n0 + tx + j * RTS_N;
+            if (gn < N) {
+                C[gm * ldc + gn] = epilogue1(acc[i][j], gm, gm * ldc + gn, EPILOGUE_ARGS);
+            }
+        }
+    }
+}
@@ -0,0 +1,51 @@
+// fp16 GEMM on NC4HW4 images, i.e. a 1x1 convolution:
+//   output[m][h][w] = sum_k weight[k][m] * input[k][h][w]
+// input  NC4HW4 image of {1, K, H, W}: pixel (k4 * W + w, h) = k4 * 4 .. k4 * 4 + 3
+// weight image of [K][M]: pixel (k, m4) = weight[k][m4 * 4 .. m4 * 4 + 3]
+// output NC4HW4 image of {1, M, H, W}
+//
+// Every work-item computes four consecutive w of one m4 block. Channels and
+// weights past K and M are zero in the packed images, and reads past the
+// image edge return zero through the CLK_ADDRESS_CLAMP sampler.
+//
+// Launch: global = {ceil(W / 4), ceil(M / 4), H}
+
+__kernel void gemm_nc4hw4_image(int K,
+                                int M,
+                                int H,
+                                int W,
+                                __read_only image2d_t input,
+                                __read_only image2d_t weight,
+                                __write_only image2d_t output) {
+    const int w0 = get_global_id(0) << 2;
+    const int m4 = get_global_id(1);
+    const int h = get_global_id(2);
+    if (w0 >= W || m4 >= ((M + 3) >> 2) || h >= H) return;
+
+    half4 acc0 = (half4)(0);
+    half4 acc1 = (half4)(0);
+    half4 acc2 = (half4)(0);
+    half4 acc3 = (half4)(0);
+    const int k4_num = (K + 3) >> 2;
+    for (int k4 = 0; k4 < k4_num; ++k4) {
+        const int x = k4 * W + w0;
+        half4 in0 = READ_IMAGE_2D(input, x, h);
+        half4 in1 = (w0 + 1 < W) ? READ_IMAGE_2D(input, x + 1, h) : (half4)(0);
+        half4 in2 = (w0 + 2 < W) ? READ_IMAGE_2D(input, x + 2, h) : (half4)(0);
+        half4 in3 = (w0 + 3 < W) ? READ_IMAGE_2D(input, x + 3, h) : (half4)(0);
+        half4 wt0 = READ_IMAGE_2D(weight, (k4 << 2), m4);
+        half4 wt1 = READ_IMAGE_2D(weight, (k4 << 2) + 1, m4);
+        half4 wt2 = READ_IMAGE_2D(weight, (k4 << 2) + 2, m4);
+        half4 wt3 = READ_IMAGE_2D(weight, (k4 << 2) + 3, m4);
+        acc0 += in0.x * wt0 + in0.y * wt1 + in0.z * wt2 + in0.w * wt3;
+        acc1 += in1.x * wt0 + in1.y * wt1 + in1.z * wt2 + in1.w * wt3;
+        acc2 += in2.x * wt0 + in2.y * wt1 + in2.z * wt2 + in2.w * wt3;
+        acc3 += in3.x * wt0 + in3.y * wt1 + in3.z * wt2 + in3.w * wt3;
+    }
+
+    const int x = m4 * W + w0;
+    WRITE_IMAGE_2D(output, acc0, x, h);
+    if (w0 + 1 < W) WRITE_IMAGE_2D(output, acc1, x + 1, h);
+    if (w0 + 2 < W) WRITE_IMAGE_2D(output, acc2, x + 2, h);
+    if (w0 + 3 < W) WRITE_IMAGE_2D(output, acc3, x + 3, h);
+}
@@ -0,0 +1,138 @@
+// Tiled int8 GEMM: C[M][N] = requant(op(A) * op(B)), int32 accumulation.
+// Same layouts, tiling and launch as gemm_tiled in gemm.cl:
+//   TRANS_A == 0: A is [M][K] (lda >= K), TRANS_A == 1: A is [K][M] (lda >= M)
+//   TRANS_B == 0: B is [K][N] (ldb >= N), TRANS_B == 1: B is [N][K] (ldb >= K)
+//   C is [M][N] (ldc >= N)
+//
+// Whatever the layout in global memory, the local tiles keep four
+// consecutive k of one row/column together, so the inner loop is a char4
+// dot product (DOT4_ACC, kernel/CL/quant.cl) per element of the register
+// block. A is the weight side and must have a zero point of 0; the zero
+// point of B is folded into the requant offset through the row sums of A.
+// Row m of C is the requant channel.
+//
+// Launch: local = {TILE_N / WPT_N, TILE_M / WPT_M}
+//         global = {ceil(N / TILE_N) * local[0], ceil(M / TILE_M) * local[1]}
+
+#ifndef TILE_M
+#define TILE_M 32
+#endif
+#ifndef TILE_N
+#define TILE_N 32
+#endif
+#ifndef TILE_K
+#define TILE_K 16
+#endif
+#ifndef WPT_M
+#define WPT_M 4
+#endif
+#ifndef WPT_N
+#define WPT_N 4
+#endif
+#ifndef TRANS_A
+#define TRANS_A 0
+#endif
+#ifndef TRANS_B
+#define TRANS_B 0
+#endif
+
+#define RTS_M (TILE_M / WPT_M)
+#define RTS_N (TILE_N / WPT_N)
+#define WG_SIZE (RTS_M * RTS_N)
+
+#if TRANS_A
+#define A_AT(m, k) A[(k) * lda + (m)]
+#else
+#define A_AT(m, k) A[(m) * lda + (k)]
+#endif
+
+#if TRANS_B
+#define B_AT(k, n) B[(n) * ldb + (k)]
+#else
+#define B_AT(k, n) B[(k) * ldb + (n)]
+#endif
+
+__attribute__((reqd_work_group_size(RTS_N, RTS_M, 1)))
+__kernel void gemm_int8_tiled(int M,
+                              int N,
+                              int K,
+                              __global const char *A,
+                              int lda,
+                              __global const char *B,
+                              int ldb,
+                              __global char *C,
+                              int ldc,
+                              REQUANT_PARAMS) {
+    const int tx = get_local_id(0);
+    const int ty = get_local_id(1);
+    const int tid = ty * RTS_N + tx;
+    const int m0 = get_group_id(1) * TILE_M;
+    const int n0 = get_group_id(0) * TILE_N;
+
+    // element (k, m) at As[k / 4][m * 4 + k % 4]
+    __local char As[TILE_K / 4][TILE_M * 4];
+    __local char Bs[TILE_K / 4][TILE_N * 4];
+
+    int acc[WPT_M][WPT_N];
+    for (int i = 0; i < WPT_M; ++i) {
+        for (int j = 0; j < WPT_N; ++j) {
+            acc[i][j] = 0;
+        }
+    }
+
+    for (int k0 = 0; k0 < K; k0 += TILE_K) {
+        for (int idx = tid; idx < TILE_K * TILE_M; idx += WG_SIZE) {
+#if TRANS_A
+            const int kk = idx / TILE_M;
+            const int mm = idx % TILE_M;
+#else
+            const int mm = idx / TILE_K;
+            const int kk = idx % TILE_K;
+#endif
+            const int gm = m0 + mm;
+            const int gk = k0 + kk;
+            As[kk >> 2][(mm << 2) + (kk & 3)] = (gm < M && gk < K) ? A_AT(gm, gk) : 0;
+        }
+        for (int idx = tid; idx < TILE_K * TILE_N; idx += WG_SIZE) {
+#if TRANS_B
+            const int nn = idx / TILE_K;
+            const int kk = idx % TILE_K;
+#else
+            const int kk = idx / TILE_N;
+            const int nn = idx % TILE_N;
+#endif
+            const int gn = n0 + nn;
+            const int gk = k0 + kk;
+            Bs[kk >> 2][(nn << 2) + (kk & 3)] = (gn < N && gk < K) ? B_AT(gk, gn) : 0;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for (int k4 = 0; k4 < TILE_K / 4; ++k4) {
+            char4 a_reg[WPT_M];
+            char4 b_reg[WPT_N];
+            for (int i = 0; i < WPT_M; ++i) {
+                a_reg[i] = vload4(ty + i * RTS_M, As[k4]);
+            }
+            for (int j = 0; j < WPT_N; ++j) {
+                b_reg[j] = vload4(tx + j * RTS_N, Bs[k4]);
+            }
+            for (int i = 0; i < WPT_M; ++i) {
+                for (int j = 0; j < WPT_N; ++j) {
+                    acc[i][j] = DOT4_ACC(a_reg[i], b_reg[j], acc[i][j]);
+                }
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    for (int i = 0; i < WPT_M; ++i) {
+        const int gm = m0 + ty + i * RTS_M;
+        if (gm >= M) break;
+        for (int j = 0; j < WPT_N; ++j) {
+            const int gn = n0 + tx + j * RTS_N;
+            if (gn < N) {
+                C[gm * ldc + gn] = requant1(acc[i][j], gm, REQUANT_ARGS);
+            }
+        }
+    }
+}
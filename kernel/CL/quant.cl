@@ -0,0 +1,42 @@
+// Int8 helpers shared by the int8 gemm and deconv kernels. The host
+// prepends this file to their source and picks the dot product with
+//   -DINT8_DOT=0  char4 dot product in int arithmetic, any device
+//   -DINT8_DOT=1  arm_dot (cl_arm_integer_dot_product_int8)
+//   -DINT8_DOT=2  arm_dot_acc (cl_arm_integer_dot_product_accumulate_int8)
+// The requantizing epilogue turns the int32 accumulator of channel c into
+//   out = clamp(rint(multiplier[c] * acc + offset[c]), act_min, act_max)
+// in fp32; the input/output zero points, bias and ReLU bounds are folded
+// into offset and the clamp range on the host (see create_int8_requant()).
+
+#ifndef INT8_DOT
+#define INT8_DOT 0
+#endif
+
+#if INT8_DOT == 2
+#pragma OPENCL EXTENSION cl_arm_integer_dot_product_accumulate_int8 : enable
+#define DOT4_ACC(a, b, acc) arm_dot_acc((a), (b), (acc))
+#elif INT8_DOT == 1
+#pragma OPENCL EXTENSION cl_arm_integer_dot_product_int8 : enable
+#define DOT4_ACC(a, b, acc) ((acc) + arm_dot((a), (b)))
+#else
+inline int dot4_int8(char4 a, char4 b) {
+    int4 p = convert_int4(a) * convert_int4(b);
+    return p.x + p.y + p.z + p.w;
+}
+#define DOT4_ACC(a, b, acc) ((acc) + dot4_int8((a), (b)))
+#endif
+
+#define REQUANT_PARAMS __global const float *rq_multiplier, __global const float *rq_offset, int rq_min, int rq_max
+#define REQUANT_ARGS rq_multiplier, rq_offset, rq_min, rq_max
+
+// one element of channel c
+inline char requant1(int acc, int c, REQUANT_PARAMS) {
+    float v = rint(mad((float)acc, rq_multiplier[c], rq_offset[c]));
+    return convert_char(clamp(v, (float)rq_min, (float)rq_max));
+}
+
+// four elements of channel c
+inline char4 requant4(int4 acc, int c, REQUANT_PARAMS) {
+    float4 v = rint(mad(convert_float4(acc), (float4)(rq_multiplier[c]), (float4)(rq_offset[c])));
+    return convert_char4(clamp(v, (float4)(rq_min), (float4)(rq_max)));
+}
@@ -0,0 +1,119 @@
+// Device roofline probes (core/src/roofline.cpp).
+//
+// peak_mad_*: every work-item runs iters rounds of eight independent mad
+// chains on a full vector, UNROLL times per round, so the ALUs never wait
+// on a previous result. b and c come in as arguments so nothing folds, and
+// the sum goes to out so nothing is dead.
+//   ops per work-item = iters * UNROLL * 8 chains * lanes * 2
+//
+// bw_*: every work-item moves BW_ITEMS float4s, spaced a global size apart
+// so consecutive work-items touch consecutive addresses.
+//
+// bw_local: every work-item reads iters * 8 float4s from a local tile.
+
+#ifndef UNROLL
+#define UNROLL 4
+#endif
+#ifndef BW_ITEMS
+#define BW_ITEMS 16
+#endif
+#ifndef LOCAL_WG
+#define LOCAL_WG 64
+#endif
+
+#define INT_MAD(a, b, c) ((a) * (b) + (c))
+
+#define MAD8(MAD)            \
+    a0 = MAD(a0, b, c);      \
+    a1 = MAD(a1, b, c);      \
+    a2 = MAD(a2, b, c);      \
+    a3 = MAD(a3, b, c);      \
+    a4 = MAD(a4, b, c);      \
+    a5 = MAD(a5, b, c);      \
+    a6 = MAD(a6, b, c);      \
+    a7 = MAD(a7, b, c);
+
+#define PEAK_MAD_KERNEL(NAME, T, S, MAD)                                                \
+    __kernel void NAME(int iters, S sb, S sc, __global S *out) {                        \
+        const int gid = get_global_id(0);                                               \
+        const T b = (T)(sb);                                                            \
+        const T c = (T)(sc);                                                            \
+        T a0 = (T)((S)(gid & 7));                                                       \
+        T a1 = a0 + (T)(1);                                                             \
+        T a2 = a0 + (T)(2);                                                             \
+        T a3 = a0 + (T)(3);                                                             \
+        T a4 = a0 + (T)(4);                                                             \
+        T a5 = a0 + (T)(5);                                                             \
+        T a6 = a0 + (T)(6);                                                             \
+        T a7 = a0 + (T)(7);                                                             \
+        for (int i = 0; i < iters; ++i) {                                               \
+            for (int u = 0; u < UNROLL; ++u) {                                          \
+                MAD8(MAD)                                                               \
+            }                                                                           \
+        }                                                                               \
+        T s = ((a0 + a1) + (a2 + a3)) + ((a4 + a5) + (a6 + a7));                        \
+        out[gid] = s.s0 + s.s1;                                                         \
+    }
+
+PEAK_MAD_KERNEL(peak_mad_fp32, float4, float, mad)
+PEAK_MAD_KERNEL(peak_mad_fp16, half8, half, mad)
+PEAK_MAD_KERNEL(peak_mad_int8, char16, char, INT_MAD)
+
+// out is only written when the sum hits sentinel, which the host never
+// passes, so the loads stay live without a store per work-item.
+__kernel void bw_read(__global const float4 *src, float sentinel, __global float *out) {
+    const int gid = get_global_id(0);
+    const int n = get_global_size(0);
+    float4 s = (float4)(0);
+    for (int k = 0; k < BW_ITEMS; ++k) {
+        s += src[gid + k * n];
+    }
+    const float t = s.s0 + s.s1 + s.s2 + s.s3;
+    if (t == sentinel) {
+        out[0] = t;
+    }
+}
+
+__kernel void bw_write(float value, __global float4 *dst) {
+    const int gid = get_global_id(0);
+    const int n = get_global_size(0);
+    const float4 v = (float4)(value) + (float4)(gid);
+    for (int k = 0; k < BW_ITEMS; ++k) {
+        dst[gid + k * n] = v;
+    }
+}
+
+__kernel void bw_copy(__global const float4 *src, __global float4 *dst) {
+    const int gid = get_global_id(0);
+    const int n = get_global_size(0);
+    for (int k = 0; k < BW_ITEMS; ++k) {
+        dst[gid + k * n] = src[gid + k * n];
+    }
+}
+
+// Launch: local = {LOCAL_WG}
+__attribute__((reqd_work_group_size(LOCAL_WG, 1, 1)))
+__kernel void bw_local(int iters, __global float *out) {
+    const int lid = get_local_id(0);
+    __local float4 tile[LOCAL_WG];
+    tile[lid] = (float4)(lid);
+    barrier(CLK_LOCAL_MEM_FENCE);
+    float4 s = (float4)(0);
+    for (int i = 0; i < iters; ++i) {
+        // neighbouring work-items read neighbouring slots: no bank conflicts
+        const int base = lid + i;
+        s += tile[base % LOCAL_WG];
+        s += tile[(base + 1) % LOCAL_WG];
+        s += tile[(base + 2) % LOCAL_WG];
+        s += tile[(base + 3) % LOCAL_WG];
+        s += tile[(base + 4) % LOCAL_WG];
+        s += tile[(base + 5) % LOCAL_WG];
+        s += tile[(base + 6) % LOCAL_WG];
+        s += tile[(base + 7) % LOCAL_WG];
+    }
+    out[get_global_id(0)] = s.s0 + s.s1 + s.s2 + s.s3;
+}
+
+__kernel void empty_kernel(__global float *out) {
+    (void)(out);
+}
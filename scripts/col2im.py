@@ -1,3 +1,5 @@
+import struct
+
 import numpy as np
 from numpy.core.fromnumeric import size
 from numpy.matrixlib.defmatrix import _from_string
@@ -10,6 +12,26 @@ def dumpNpArr(nparr, txt):
         for val in nparr:
             f.write("{}\n".format(val))
 
+# Binary tensor file read by abc::MappedTensorFile (core/include/tensor_file.h):
+# a 64-byte little-endian header, then the NCHW data at a multiple of alignment.
+TENSOR_FILE_MAGIC = b"OCLABCT\0"
+TENSOR_FILE_VERSION = 1
+TENSOR_FILE_DTYPES = {np.dtype(np.float32): 0, np.dtype(np.float16): 1}
+
+def dumpTensor(nparr, path, dtype=np.float16, alignment=4096):
+    arr = np.ascontiguousarray(nparr, dtype=dtype)
+    if arr.ndim > 4:
+        raise ValueError("tensor files hold at most 4 dimensions")
+    dims = (1,) * (4 - arr.ndim) + arr.shape
+    data_offset = (64 + alignment - 1) // alignment * alignment
+    header = struct.pack("<8sII4iIIQQ8x", TENSOR_FILE_MAGIC, TENSOR_FILE_VERSION,
+                         TENSOR_FILE_DTYPES[arr.dtype], *dims, alignment, 0,
+                         data_offset, arr.nbytes)
+    with open(path, 'wb') as f:
+        f.write(header)
+        f.write(b"\0" * (data_offset - len(header)))
+        f.write(arr.astype(arr.dtype.newbyteorder('<')).tobytes())
+
 def printFlatten(nparr):
     num_elem = 1024 if nparr.size > 1024 else nparr.size
     flatarr = nparr.flatten()
@@ -213,10 +235,9 @@ if __name__ == "__main__":
     # gemm_out = col2im(tmp, (1, 4, 120, 120), 2, 2, 2, 0)
     # print(gemm_out, gemm_out.shape)
 
-    in_tensor = in_tensor.numpy().flatten()
-    weight = weight.numpy().flatten()
-    dumpNpArr(in_tensor, "input.txt")
-    dumpNpArr(weight, "weight.txt")
+    # fp16 inputs are used in place by abc::load_tensor_file()
+    dumpTensor(in_tensor.numpy(), "input.oclt")
+    dumpTensor(weight.numpy(), "weight.oclt")
 
 
     # otensor = np.zeros(oc * oh * ow, dtype=np.float32)
@@ -226,6 +247,6 @@ if __name__ == "__main__":
     # print(tmp, tmp.shape)
 
     print(out_tensor, out_tensor.shape)
-    dumpNpArr(out_tensor.numpy().flatten(), "output.txt")
+    dumpTensor(out_tensor.numpy(), "output.oclt", dtype=np.float32)
     printFlatten(out_tensor.numpy())
     # print(np.sum(tmp != otensor))
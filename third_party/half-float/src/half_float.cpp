@@ -46,18 +46,18 @@ cl_half to_half(float f)
     const unsigned int sign       = (value.bits & float32_params_sign_bit_mask) >> (float16_params_num_frac_bits + float16_params_num_exp_bits + 1);
     cl_half          half       = 0;
 
-    if (isnan(value.f))
+    if (std::isnan(value.f))
     {
         half = static_cast<cl_half>(float16_params_exp_mask | float16_params_frac_mask);
     }
-    else if (isinf(value.f))
+    else if (std::isinf(value.f))
     {
         half = static_cast<cl_half>(is_neg ? float16_params_sign_mask | float16_params_exp_mask : float16_params_exp_mask);
     }
     else if (f_abs_bits > float16_params_max_normal)
     {
-        // Clamp to max float 16 value
-        half = static_cast<cl_half>(sign | (((1 << float16_params_num_exp_bits) - 1) << float16_params_num_frac_bits) | float16_params_frac_mask);
+        // Clamp to max float 16 value (an all-ones exponent would be NaN)
+        half = static_cast<cl_half>(sign | (((1 << float16_params_num_exp_bits) - 2) << float16_params_num_frac_bits) | float16_params_frac_mask);
     }
     else if (f_abs_bits < float16_params_min_normal)
     {
@@ -39,6 +39,20 @@ typedef cl_command_queue (*f_clCreateCommandQueue) (cl_context, cl_device_id, cl
 
 #ifdef CL_VERSION_2_0
 typedef cl_command_queue (*f_clCreateCommandQueueWithProperties) (cl_context, cl_device_id, const cl_queue_properties *, cl_int *);
+
+typedef void * (*f_clSVMAlloc) (cl_context, cl_svm_mem_flags, size_t, cl_uint);
+
+typedef void (*f_clSVMFree) (cl_context, void *);
+
+typedef cl_int (*f_clSetKernelArgSVMPointer) (cl_kernel, cl_uint, const void *);
+
+typedef cl_int (*f_clEnqueueSVMMemcpy) (cl_command_queue, cl_bool, void *, const void *, size_t, cl_uint, const cl_event *, cl_event *);
+
+typedef cl_int (*f_clEnqueueSVMMap) (cl_command_queue, cl_bool, cl_map_flags, void *, size_t, cl_uint, const cl_event *, cl_event *);
+
+typedef cl_int (*f_clEnqueueSVMUnmap) (cl_command_queue, void *, cl_uint, const cl_event *, cl_event *);
+
+typedef cl_int (*f_clEnqueueSVMFree) (cl_command_queue, cl_uint, void *[], void (CL_CALLBACK *)(cl_command_queue, cl_uint, void *[], void *), void *, cl_uint, const cl_event *, cl_event *);
 #endif
 
 typedef cl_int (*f_clRetainCommandQueue) (cl_command_queue);
@@ -231,4 +245,11 @@ typedef cl_mem (*f_clCreateFromGLTexture3D) (cl_context, cl_mem_flags, cl_GLenum
 typedef cl_int (*f_clGetGLContextInfoKHR) (const cl_context_properties *, cl_gl_context_info, size_t,
                                         void *, size_t *);
 
+// The stub resolves every entry point once, when it is loaded. These report
+// which library was picked and which entry points it does not export.
+void* libopencl_stub_so_handle(void);
+const char* libopencl_stub_so_path(void);
+int libopencl_stub_num_missing_symbols(void);
+const char* libopencl_stub_missing_symbol(int index);
+
 #endif    // LIBOPENCL_STUB_H
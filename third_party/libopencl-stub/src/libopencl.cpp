@@ -13,6 +13,7 @@
 #include "libopencl.h"
 #include <dlfcn.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 
 #if defined(__APPLE__) || defined(__MACOSX)
@@ -45,7 +46,7 @@ static int access_file(const char* filename) {
     return (stat(filename, &buffer) == 0);
 }
 
-static int open_libopencl_so(void** so_handle) {
+static int open_libopencl_so(void** so_handle, const char** so_path) {
     char *path = NULL, *str = NULL;
     int i;
 
@@ -70,38 +71,227 @@ static int open_libopencl_so(void** so_handle) {
 
     if (path) {
         *so_handle = dlopen(path, RTLD_LAZY);
+        *so_path = path;
         return 0;
     } else {
         return -1;
     }
 }
 
+#define LIBOPENCL_STUB_ENTRY_POINTS(F)              \
+    F(clGetPlatformIDs)                             \
+    F(clGetPlatformInfo)                            \
+    F(clGetDeviceIDs)                               \
+    F(clGetDeviceInfo)                              \
+    F(clCreateSubDevices)                           \
+    F(clRetainDevice)                               \
+    F(clReleaseDevice)                              \
+    F(clCreateContext)                              \
+    F(clCreateContextFromType)                      \
+    F(clRetainContext)                              \
+    F(clReleaseContext)                             \
+    F(clGetContextInfo)                             \
+    F(clCreateCommandQueue)                         \
+    F(clRetainCommandQueue)                         \
+    F(clReleaseCommandQueue)                        \
+    F(clGetCommandQueueInfo)                        \
+    F(clCreateBuffer)                               \
+    F(clCreateSubBuffer)                            \
+    F(clCreateImage)                                \
+    F(clRetainMemObject)                            \
+    F(clReleaseMemObject)                           \
+    F(clGetSupportedImageFormats)                   \
+    F(clGetMemObjectInfo)                           \
+    F(clGetImageInfo)                               \
+    F(clSetMemObjectDestructorCallback)             \
+    F(clCreateSampler)                              \
+    F(clRetainSampler)                              \
+    F(clReleaseSampler)                             \
+    F(clGetSamplerInfo)                             \
+    F(clCreateProgramWithSource)                    \
+    F(clCreateProgramWithBinary)                    \
+    F(clCreateProgramWithBuiltInKernels)            \
+    F(clRetainProgram)                              \
+    F(clReleaseProgram)                             \
+    F(clBuildProgram)                               \
+    F(clCompileProgram)                             \
+    F(clLinkProgram)                                \
+    F(clUnloadPlatformCompiler)                     \
+    F(clGetProgramInfo)                             \
+    F(clGetProgramBuildInfo)                        \
+    F(clCreateKernel)                               \
+    F(clCreateKernelsInProgram)                     \
+    F(clRetainKernel)                               \
+    F(clReleaseKernel)                              \
+    F(clSetKernelArg)                               \
+    F(clGetKernelInfo)                              \
+    F(clGetKernelArgInfo)                           \
+    F(clGetKernelWorkGroupInfo)                     \
+    F(clWaitForEvents)                              \
+    F(clGetEventInfo)                               \
+    F(clCreateUserEvent)                            \
+    F(clRetainEvent)                                \
+    F(clReleaseEvent)                               \
+    F(clSetUserEventStatus)                         \
+    F(clSetEventCallback)                           \
+    F(clGetEventProfilingInfo)                      \
+    F(clFlush)                                      \
+    F(clFinish)                                     \
+    F(clEnqueueReadBuffer)                          \
+    F(clEnqueueReadBufferRect)                      \
+    F(clEnqueueWriteBuffer)                         \
+    F(clEnqueueWriteBufferRect)                     \
+    F(clEnqueueFillBuffer)                          \
+    F(clEnqueueCopyBuffer)                          \
+    F(clEnqueueCopyBufferRect)                      \
+    F(clEnqueueReadImage)                           \
+    F(clEnqueueWriteImage)                          \
+    F(clEnqueueFillImage)                           \
+    F(clEnqueueCopyImage)                           \
+    F(clEnqueueCopyImageToBuffer)                   \
+    F(clEnqueueCopyBufferToImage)                   \
+    F(clEnqueueMapBuffer)                           \
+    F(clEnqueueMapImage)                            \
+    F(clEnqueueUnmapMemObject)                      \
+    F(clEnqueueMigrateMemObjects)                   \
+    F(clEnqueueNDRangeKernel)                       \
+    F(clEnqueueTask)                                \
+    F(clEnqueueNativeKernel)                        \
+    F(clEnqueueMarkerWithWaitList)                  \
+    F(clEnqueueBarrierWithWaitList)                 \
+    F(clGetExtensionFunctionAddressForPlatform)     \
+    F(clCreateImage2D)                              \
+    F(clCreateImage3D)                              \
+    F(clEnqueueMarker)                              \
+    F(clEnqueueWaitForEvents)                       \
+    F(clEnqueueBarrier)                             \
+    F(clUnloadCompiler)                             \
+    F(clGetExtensionFunctionAddress)                \
+    F(clCreateFromGLBuffer)                         \
+    F(clCreateFromGLTexture)                        \
+    F(clCreateFromGLRenderbuffer)                   \
+    F(clGetGLObjectInfo)                            \
+    F(clGetGLTextureInfo)                           \
+    F(clEnqueueAcquireGLObjects)                    \
+    F(clEnqueueReleaseGLObjects)                    \
+    F(clCreateFromGLTexture2D)                      \
+    F(clCreateFromGLTexture3D)                      \
+    F(clGetGLContextInfoKHR)
+
+// Every entry point is resolved once, when the stub is loaded, instead of
+// paying a dlsym() on each call. Symbols the library does not export stay
+// NULL and are recorded in `missing` so they are never looked up again. A
+// symbol that resolves back into the stub itself (e.g. when "libOpenCL.so"
+// found on the search path is this library, checked with dladdr) is treated
+// as missing.
+struct DispatchTable {
+#define DECLARE_ENTRY(name) f_##name name;
+    LIBOPENCL_STUB_ENTRY_POINTS(DECLARE_ENTRY)
+#ifdef CL_VERSION_2_0
+    DECLARE_ENTRY(clCreateCommandQueueWithProperties)
+    DECLARE_ENTRY(clSVMAlloc)
+    DECLARE_ENTRY(clSVMFree)
+    DECLARE_ENTRY(clSetKernelArgSVMPointer)
+    DECLARE_ENTRY(clEnqueueSVMMemcpy)
+    DECLARE_ENTRY(clEnqueueSVMMap)
+    DECLARE_ENTRY(clEnqueueSVMUnmap)
+    DECLARE_ENTRY(clEnqueueSVMFree)
+#endif
+#undef DECLARE_ENTRY
+};
+
+static const int kMaxEntryPoints = sizeof(DispatchTable) / sizeof(void*);
+
+// True when addr lies in the shared object loaded at base.
+static bool in_object(const void* base, const void* addr) {
+    Dl_info info;
+    return base && addr && dladdr(addr, &info) && info.dli_fbase == base;
+}
+
 struct SoHandleWrapper {
     SoHandleWrapper() {
       so_handle = NULL;
-      open_libopencl_so(&so_handle);
+      so_path = NULL;
+      num_missing = 0;
+      memset(&table, 0, sizeof(table));
+      open_libopencl_so(&so_handle, &so_path);
+      resolve();
     }
 
     ~SoHandleWrapper() {
+      memset(&table, 0, sizeof(table));
       if (so_handle) {
         dlclose(so_handle);
         so_handle = NULL;
       }
     }
+
+    void resolve() {
+      Dl_info self;
+      const void* self_base = dladdr((void*)&open_libopencl_so, &self) ? self.dli_fbase : NULL;
+#define RESOLVE_ENTRY(name)                                              \
+      table.name = so_handle ? (f_##name)dlsym(so_handle, #name) : NULL; \
+      if (in_object(self_base, (void*)table.name)) {                     \
+        table.name = NULL;                                               \
+      }                                                                  \
+      if (!table.name && num_missing < kMaxEntryPoints) {                \
+        missing[num_missing++] = #name;                                  \
+      }
+      LIBOPENCL_STUB_ENTRY_POINTS(RESOLVE_ENTRY)
+#ifdef CL_VERSION_2_0
+      RESOLVE_ENTRY(clCreateCommandQueueWithProperties)
+      RESOLVE_ENTRY(clSVMAlloc)
+      RESOLVE_ENTRY(clSVMFree)
+      RESOLVE_ENTRY(clSetKernelArgSVMPointer)
+      RESOLVE_ENTRY(clEnqueueSVMMemcpy)
+      RESOLVE_ENTRY(clEnqueueSVMMap)
+      RESOLVE_ENTRY(clEnqueueSVMUnmap)
+      RESOLVE_ENTRY(clEnqueueSVMFree)
+#endif
+#undef RESOLVE_ENTRY
+    }
+
     void* so_handle;
+    const char* so_path;
+    DispatchTable table;
+    const char* missing[kMaxEntryPoints];
+    int num_missing;
 };
 
-static void *so_handle() {
+static SoHandleWrapper& so_wrapper() {
   static SoHandleWrapper wrapper;
-  return wrapper.so_handle;
+  return wrapper;
+}
+
+static inline const DispatchTable& dispatch() {
+  return so_wrapper().table;
+}
+
+// Resolve the table while the library is loaded rather than on first use.
+static const DispatchTable& eager_dispatch = dispatch();
+
+void* libopencl_stub_so_handle(void) {
+  return so_wrapper().so_handle;
+}
+
+const char* libopencl_stub_so_path(void) {
+  return so_wrapper().so_path;
+}
+
+int libopencl_stub_num_missing_symbols(void) {
+  return so_wrapper().num_missing;
+}
+
+const char* libopencl_stub_missing_symbol(int index) {
+  const SoHandleWrapper& wrapper = so_wrapper();
+  return (index >= 0 && index < wrapper.num_missing) ? wrapper.missing[index]
+                                                     : NULL;
 }
 
 cl_int clGetPlatformIDs(cl_uint num_entries,
                         cl_platform_id* platforms,
                         cl_uint* num_platforms) {
-    f_clGetPlatformIDs func;
-
-    func = (f_clGetPlatformIDs)dlsym(so_handle(), "clGetPlatformIDs");
+    f_clGetPlatformIDs func = dispatch().clGetPlatformIDs;
     if (func) {
         return func(num_entries, platforms, num_platforms);
     } else {
@@ -114,10 +304,7 @@ cl_int clGetPlatformInfo(cl_platform_id platform,
                          size_t param_value_size,
                          void* param_value,
                          size_t* param_value_size_ret) {
-    f_clGetPlatformInfo func;
-
-
-    func = (f_clGetPlatformInfo)dlsym(so_handle(), "clGetPlatformInfo");
+    f_clGetPlatformInfo func = dispatch().clGetPlatformInfo;
     if (func) {
         return func(platform, param_name, param_value_size, param_value,
                     param_value_size_ret);
@@ -131,10 +318,7 @@ cl_int clGetDeviceIDs(cl_platform_id platform,
                       cl_uint num_entries,
                       cl_device_id* devices,
                       cl_uint* num_devices) {
-    f_clGetDeviceIDs func;
-
-
-    func = (f_clGetDeviceIDs)dlsym(so_handle(), "clGetDeviceIDs");
+    f_clGetDeviceIDs func = dispatch().clGetDeviceIDs;
     if (func) {
         return func(platform, device_type, num_entries, devices, num_devices);
     } else {
@@ -147,10 +331,7 @@ cl_int clGetDeviceInfo(cl_device_id device,
                        size_t param_value_size,
                        void* param_value,
                        size_t* param_value_size_ret) {
-    f_clGetDeviceInfo func;
-
-
-    func = (f_clGetDeviceInfo)dlsym(so_handle(), "clGetDeviceInfo");
+    f_clGetDeviceInfo func = dispatch().clGetDeviceInfo;
     if (func) {
         return func(device, param_name, param_value_size, param_value,
                     param_value_size_ret);
@@ -164,10 +345,7 @@ cl_int clCreateSubDevices(cl_device_id in_device,
                           cl_uint num_devices,
                           cl_device_id* out_devices,
                           cl_uint* num_devices_ret) {
-    f_clCreateSubDevices func;
-
-
-    func = (f_clCreateSubDevices)dlsym(so_handle(), "clCreateSubDevices");
+    f_clCreateSubDevices func = dispatch().clCreateSubDevices;
     if (func) {
         return func(in_device, properties, num_devices, out_devices,
                     num_devices_ret);
@@ -177,10 +355,7 @@ cl_int clCreateSubDevices(cl_device_id in_device,
 }
 
 cl_int clRetainDevice(cl_device_id device) {
-    f_clRetainDevice func;
-
-
-    func = (f_clRetainDevice)dlsym(so_handle(), "clRetainDevice");
+    f_clRetainDevice func = dispatch().clRetainDevice;
     if (func) {
         return func(device);
     } else {
@@ -189,10 +364,7 @@ cl_int clRetainDevice(cl_device_id device) {
 }
 
 cl_int clReleaseDevice(cl_device_id device) {
-    f_clReleaseDevice func;
-
-
-    func = (f_clReleaseDevice)dlsym(so_handle(), "clReleaseDevice");
+    f_clReleaseDevice func = dispatch().clReleaseDevice;
     if (func) {
         return func(device);
     } else {
@@ -207,10 +379,7 @@ cl_context clCreateContext(
     void (*pfn_notify)(const char*, const void*, size_t, void*),
     void* user_data,
     cl_int* errcode_ret) {
-    f_clCreateContext func;
-
-
-    func = (f_clCreateContext)dlsym(so_handle(), "clCreateContext");
+    f_clCreateContext func = dispatch().clCreateContext;
     if (func) {
         return func(properties, num_devices, devices, pfn_notify, user_data,
                     errcode_ret);
@@ -225,11 +394,7 @@ cl_context clCreateContextFromType(
     void (*pfn_notify)(const char*, const void*, size_t, void*),
     void* user_data,
     cl_int* errcode_ret) {
-    f_clCreateContextFromType func;
-
-
-    func =
-        (f_clCreateContextFromType)dlsym(so_handle(), "clCreateContextFromType");
+    f_clCreateContextFromType func = dispatch().clCreateContextFromType;
     if (func) {
         return func(properties, device_type, pfn_notify, user_data,
                     errcode_ret);
@@ -239,10 +404,7 @@ cl_context clCreateContextFromType(
 }
 
 cl_int clRetainContext(cl_context context) {
-    f_clRetainContext func;
-
-
-    func = (f_clRetainContext)dlsym(so_handle(), "clRetainContext");
+    f_clRetainContext func = dispatch().clRetainContext;
     if (func) {
         return func(context);
     } else {
@@ -251,10 +413,7 @@ cl_int clRetainContext(cl_context context) {
 }
 
 cl_int clReleaseContext(cl_context context) {
-    f_clReleaseContext func;
-
-
-    func = (f_clReleaseContext)dlsym(so_handle(), "clReleaseContext");
+    f_clReleaseContext func = dispatch().clReleaseContext;
     if (func) {
         return func(context);
     } else {
@@ -267,10 +426,7 @@ cl_int clGetContextInfo(cl_context context,
                         size_t param_value_size,
                         void* param_value,
                         size_t* param_value_size_ret) {
-    f_clGetContextInfo func;
-
-
-    func = (f_clGetContextInfo)dlsym(so_handle(), "clGetContextInfo");
+    f_clGetContextInfo func = dispatch().clGetContextInfo;
     if (func) {
         return func(context, param_name, param_value_size, param_value,
                     param_value_size_ret);
@@ -283,10 +439,7 @@ cl_command_queue clCreateCommandQueue(cl_context context,
                                       cl_device_id device,
                                       cl_command_queue_properties properties,
                                       cl_int* errcode_ret) {
-    f_clCreateCommandQueue func;
-
-
-    func = (f_clCreateCommandQueue)dlsym(so_handle(), "clCreateCommandQueue");
+    f_clCreateCommandQueue func = dispatch().clCreateCommandQueue;
     if (func) {
         return func(context, device, properties, errcode_ret);
     } else {
@@ -300,36 +453,123 @@ cl_command_queue clCreateCommandQueueWithProperties(
     cl_device_id device,
     const cl_queue_properties* properties,
     cl_int* errcode_ret) {
-    f_clCreateCommandQueueWithProperties func;
-
-
-    func = (f_clCreateCommandQueueWithProperties)dlsym(
-        so_handle(), "clCreateCommandQueueWithProperties");
+    f_clCreateCommandQueueWithProperties func = dispatch().clCreateCommandQueueWithProperties;
     if (func) {
         return func(context, device, properties, errcode_ret);
     } else {
         return NULL;
     }
 }
-#endif
 
-cl_int clRetainCommandQueue(cl_command_queue command_queue) {
-    f_clRetainCommandQueue func;
+void* clSVMAlloc(cl_context context,
+                 cl_svm_mem_flags flags,
+                 size_t size,
+                 cl_uint alignment) {
+    f_clSVMAlloc func = dispatch().clSVMAlloc;
+    if (func) {
+        return func(context, flags, size, alignment);
+    } else {
+        return NULL;
+    }
+}
 
+void clSVMFree(cl_context context, void* svm_pointer) {
+    f_clSVMFree func = dispatch().clSVMFree;
+    if (func) {
+        func(context, svm_pointer);
+    }
+}
 
-    func = (f_clRetainCommandQueue)dlsym(so_handle(), "clRetainCommandQueue");
+cl_int clSetKernelArgSVMPointer(cl_kernel kernel,
+                                cl_uint arg_index,
+                                const void* arg_value) {
+    f_clSetKernelArgSVMPointer func = dispatch().clSetKernelArgSVMPointer;
     if (func) {
-        return func(command_queue);
+        return func(kernel, arg_index, arg_value);
     } else {
         return CL_INVALID_PLATFORM;
     }
 }
 
-cl_int clReleaseCommandQueue(cl_command_queue command_queue) {
-    f_clReleaseCommandQueue func;
+cl_int clEnqueueSVMMemcpy(cl_command_queue command_queue,
+                          cl_bool blocking_copy,
+                          void* dst_ptr,
+                          const void* src_ptr,
+                          size_t size,
+                          cl_uint num_events_in_wait_list,
+                          const cl_event* event_wait_list,
+                          cl_event* event) {
+    f_clEnqueueSVMMemcpy func = dispatch().clEnqueueSVMMemcpy;
+    if (func) {
+        return func(command_queue, blocking_copy, dst_ptr, src_ptr, size,
+                    num_events_in_wait_list, event_wait_list, event);
+    } else {
+        return CL_INVALID_PLATFORM;
+    }
+}
+
+cl_int clEnqueueSVMMap(cl_command_queue command_queue,
+                       cl_bool blocking_map,
+                       cl_map_flags flags,
+                       void* svm_ptr,
+                       size_t size,
+                       cl_uint num_events_in_wait_list,
+                       const cl_event* event_wait_list,
+                       cl_event* event) {
+    f_clEnqueueSVMMap func = dispatch().clEnqueueSVMMap;
+    if (func) {
+        return func(command_queue, blocking_map, flags, svm_ptr, size,
+                    num_events_in_wait_list, event_wait_list, event);
+    } else {
+        return CL_INVALID_PLATFORM;
+    }
+}
+
+cl_int clEnqueueSVMUnmap(cl_command_queue command_queue,
+                         void* svm_ptr,
+                         cl_uint num_events_in_wait_list,
+                         const cl_event* event_wait_list,
+                         cl_event* event) {
+    f_clEnqueueSVMUnmap func = dispatch().clEnqueueSVMUnmap;
+    if (func) {
+        return func(command_queue, svm_ptr, num_events_in_wait_list, event_wait_list, event);
+    } else {
+        return CL_INVALID_PLATFORM;
+    }
+}
 
+cl_int clEnqueueSVMFree(cl_command_queue command_queue,
+                        cl_uint num_svm_pointers,
+                        void* svm_pointers[],
+                        void (CL_CALLBACK* pfn_free_func)(cl_command_queue queue,
+                                                          cl_uint num_svm_pointers,
+                                                          void* svm_pointers[],
+                                                          void* user_data),
+                        void* user_data,
+                        cl_uint num_events_in_wait_list,
+                        const cl_event* event_wait_list,
+                        cl_event* event) {
+    f_clEnqueueSVMFree func = dispatch().clEnqueueSVMFree;
+    if (func) {
+        return func(command_queue, num_svm_pointers, svm_pointers, pfn_free_func, user_data,
+                    num_events_in_wait_list, event_wait_list, event);
+    } else {
+        return CL_INVALID_PLATFORM;
+    }
+}
+#endif
+
+cl_int clRetainCommandQueue(cl_command_queue command_queue) {
+    f_clRetainCommandQueue func = dispatch().clRetainCommandQueue;
+    if (func) {
+        return func(command_queue);
+    } else {
+        return CL_INVALID_PLATFORM;
+    }
+}
 
-    func = (f_clReleaseCommandQueue)dlsym(so_handle(), "clReleaseCommandQueue");
+cl_int clReleaseCommandQueue(cl_command_queue command_queue) {
+    f_clReleaseCommandQueue func = dispatch().clReleaseCommandQueue;
     if (func) {
         return func(command_queue);
     } else {
@@ -342,10 +582,7 @@ cl_int clGetCommandQueueInfo(cl_command_queue command_queue,
                              size_t param_value_size,
                              void* param_value,
                              size_t* param_value_size_ret) {
-    f_clGetCommandQueueInfo func;
-
-
-    func = (f_clGetCommandQueueInfo)dlsym(so_handle(), "clGetCommandQueueInfo");
+    f_clGetCommandQueueInfo func = dispatch().clGetCommandQueueInfo;
     if (func) {
         return func(command_queue, param_name, param_value_size, param_value,
                     param_value_size_ret);
@@ -359,10 +596,7 @@ cl_mem clCreateBuffer(cl_context context,
                       size_t size,
                       void* host_ptr,
                       cl_int* errcode_ret) {
-    f_clCreateBuffer func;
-
-
-    func = (f_clCreateBuffer)dlsym(so_handle(), "clCreateBuffer");
+    f_clCreateBuffer func = dispatch().clCreateBuffer;
     if (func) {
         return func(context, flags, size, host_ptr, errcode_ret);
     } else {
@@ -375,10 +609,7 @@ cl_mem clCreateSubBuffer(cl_mem buffer,
                          cl_buffer_create_type buffer_create_type,
                          const void* buffer_create_info,
                          cl_int* errcode_ret) {
-    f_clCreateSubBuffer func;
-
-
-    func = (f_clCreateSubBuffer)dlsym(so_handle(), "clCreateSubBuffer");
+    f_clCreateSubBuffer func = dispatch().clCreateSubBuffer;
     if (func) {
         return func(buffer, flags, buffer_create_type, buffer_create_info,
                     errcode_ret);
@@ -393,10 +624,7 @@ cl_mem clCreateImage(cl_context context,
                      const cl_image_desc* image_desc,
                      void* host_ptr,
                      cl_int* errcode_ret) {
-    f_clCreateImage func;
-
-
-    func = (f_clCreateImage)dlsym(so_handle(), "clCreateImage");
+    f_clCreateImage func = dispatch().clCreateImage;
     if (func) {
         return func(context, flags, image_format, image_desc, host_ptr,
                     errcode_ret);
@@ -406,10 +634,7 @@ cl_mem clCreateImage(cl_context context,
 }
 
 cl_int clRetainMemObject(cl_mem memobj) {
-    f_clRetainMemObject func;
-
-
-    func = (f_clRetainMemObject)dlsym(so_handle(), "clRetainMemObject");
+    f_clRetainMemObject func = dispatch().clRetainMemObject;
     if (func) {
         return func(memobj);
     } else {
@@ -418,10 +643,7 @@ cl_int clRetainMemObject(cl_mem memobj) {
 }
 
 cl_int clReleaseMemObject(cl_mem memobj) {
-    f_clReleaseMemObject func;
-
-
-    func = (f_clReleaseMemObject)dlsym(so_handle(), "clReleaseMemObject");
+    f_clReleaseMemObject func = dispatch().clReleaseMemObject;
     if (func) {
         return func(memobj);
     } else {
@@ -435,11 +657,7 @@ cl_int clGetSupportedImageFormats(cl_context context,
                                   cl_uint num_entries,
                                   cl_image_format* image_formats,
                                   cl_uint* num_image_formats) {
-    f_clGetSupportedImageFormats func;
-
-
-    func = (f_clGetSupportedImageFormats)dlsym(so_handle(),
-                                               "clGetSupportedImageFormats");
+    f_clGetSupportedImageFormats func = dispatch().clGetSupportedImageFormats;
     if (func) {
         return func(context, flags, image_type, num_entries, image_formats,
                     num_image_formats);
@@ -453,10 +671,7 @@ cl_int clGetMemObjectInfo(cl_mem memobj,
                           size_t param_value_size,
                           void* param_value,
                           size_t* param_value_size_ret) {
-    f_clGetMemObjectInfo func;
-
-
-    func = (f_clGetMemObjectInfo)dlsym(so_handle(), "clGetMemObjectInfo");
+    f_clGetMemObjectInfo func = dispatch().clGetMemObjectInfo;
     if (func) {
         return func(memobj, param_name, param_value_size, param_value,
                     param_value_size_ret);
@@ -470,10 +685,7 @@ cl_int clGetImageInfo(cl_mem image,
                       size_t param_value_size,
                       void* param_value,
                       size_t* param_value_size_ret) {
-    f_clGetImageInfo func;
-
-
-    func = (f_clGetImageInfo)dlsym(so_handle(), "clGetImageInfo");
+    f_clGetImageInfo func = dispatch().clGetImageInfo;
     if (func) {
         return func(image, param_name, param_value_size, param_value,
                     param_value_size_ret);
@@ -486,11 +698,7 @@ cl_int clSetMemObjectDestructorCallback(cl_mem memobj,
                                         void (*pfn_notify)(cl_mem memobj,
                                                            void* user_data),
                                         void* user_data) {
-    f_clSetMemObjectDestructorCallback func;
-
-
-    func = (f_clSetMemObjectDestructorCallback)dlsym(
-        so_handle(), "clSetMemObjectDestructorCallback");
+    f_clSetMemObjectDestructorCallback func = dispatch().clSetMemObjectDestructorCallback;
     if (func) {
         return func(memobj, pfn_notify, user_data);
     } else {
@@ -503,10 +711,7 @@ cl_sampler clCreateSampler(cl_context context,
                            cl_addressing_mode addressing_mode,
                            cl_filter_mode filter_mode,
                            cl_int* errcode_ret) {
-    f_clCreateSampler func;
-
-
-    func = (f_clCreateSampler)dlsym(so_handle(), "clCreateSampler");
+    f_clCreateSampler func = dispatch().clCreateSampler;
     if (func) {
         return func(context, normalized_coords, addressing_mode, filter_mode,
                     errcode_ret);
@@ -516,10 +721,7 @@ cl_sampler clCreateSampler(cl_context context,
 }
 
 cl_int clRetainSampler(cl_sampler sampler) {
-    f_clRetainSampler func;
-
-
-    func = (f_clRetainSampler)dlsym(so_handle(), "clRetainSampler");
+    f_clRetainSampler func = dispatch().clRetainSampler;
     if (func) {
         return func(sampler);
     } else {
@@ -528,10 +730,7 @@ cl_int clRetainSampler(cl_sampler sampler) {
 }
 
 cl_int clReleaseSampler(cl_sampler sampler) {
-    f_clReleaseSampler func;
-
-
-    func = (f_clReleaseSampler)dlsym(so_handle(), "clReleaseSampler");
+    f_clReleaseSampler func = dispatch().clReleaseSampler;
     if (func) {
         return func(sampler);
     } else {
@@ -544,10 +743,7 @@ cl_int clGetSamplerInfo(cl_sampler sampler,
                         size_t param_value_size,
                         void* param_value,
                         size_t* param_value_size_ret) {
-    f_clGetSamplerInfo func;
-
-
-    func = (f_clGetSamplerInfo)dlsym(so_handle(), "clGetSamplerInfo");
+    f_clGetSamplerInfo func = dispatch().clGetSamplerInfo;
     if (func) {
         return func(sampler, param_name, param_value_size, param_value,
                     param_value_size_ret);
@@ -561,11 +757,7 @@ cl_program clCreateProgramWithSource(cl_context context,
                                      const char** strings,
                                      const size_t* lengths,
                                      cl_int* errcode_ret) {
-    f_clCreateProgramWithSource func;
-
-
-    func = (f_clCreateProgramWithSource)dlsym(so_handle(),
-                                              "clCreateProgramWithSource");
+    f_clCreateProgramWithSource func = dispatch().clCreateProgramWithSource;
     if (func) {
         return func(context, count, strings, lengths, errcode_ret);
     } else {
@@ -580,11 +772,7 @@ cl_program clCreateProgramWithBinary(cl_context context,
                                      const unsigned char** binaries,
                                      cl_int* binary_status,
                                      cl_int* errcode_ret) {
-    f_clCreateProgramWithBinary func;
-
-
-    func = (f_clCreateProgramWithBinary)dlsym(so_handle(),
-                                              "clCreateProgramWithBinary");
+    f_clCreateProgramWithBinary func = dispatch().clCreateProgramWithBinary;
     if (func) {
         return func(context, num_devices, device_list, lengths, binaries,
                     binary_status, errcode_ret);
@@ -598,11 +786,7 @@ cl_program clCreateProgramWithBuiltInKernels(cl_context context,
                                              const cl_device_id* device_list,
                                              const char* kernel_names,
                                              cl_int* errcode_ret) {
-    f_clCreateProgramWithBuiltInKernels func;
-
-
-    func = (f_clCreateProgramWithBuiltInKernels)dlsym(
-        so_handle(), "clCreateProgramWithBuiltInKernels");
+    f_clCreateProgramWithBuiltInKernels func = dispatch().clCreateProgramWithBuiltInKernels;
     if (func) {
         return func(context, num_devices, device_list, kernel_names,
                     errcode_ret);
@@ -612,10 +796,7 @@ cl_program clCreateProgramWithBuiltInKernels(cl_context context,
 }
 
 cl_int clRetainProgram(cl_program program) {
-    f_clRetainProgram func;
-
-
-    func = (f_clRetainProgram)dlsym(so_handle(), "clRetainProgram");
+    f_clRetainProgram func = dispatch().clRetainProgram;
     if (func) {
         return func(program);
     } else {
@@ -624,10 +805,7 @@ cl_int clRetainProgram(cl_program program) {
 }
 
 cl_int clReleaseProgram(cl_program program) {
-    f_clReleaseProgram func;
-
-
-    func = (f_clReleaseProgram)dlsym(so_handle(), "clReleaseProgram");
+    f_clReleaseProgram func = dispatch().clReleaseProgram;
     if (func) {
         return func(program);
     } else {
@@ -641,10 +819,7 @@ cl_int clBuildProgram(cl_program program,
                       const char* options,
                       void (*pfn_notify)(cl_program program, void* user_data),
                       void* user_data) {
-    f_clBuildProgram func;
-
-
-    func = (f_clBuildProgram)dlsym(so_handle(), "clBuildProgram");
+    f_clBuildProgram func = dispatch().clBuildProgram;
     if (func) {
         return func(program, num_devices, device_list, options, pfn_notify,
                     user_data);
@@ -662,10 +837,7 @@ cl_int clCompileProgram(cl_program program,
                         const char** header_include_names,
                         void (*pfn_notify)(cl_program program, void* user_data),
                         void* user_data) {
-    f_clCompileProgram func;
-
-
-    func = (f_clCompileProgram)dlsym(so_handle(), "clCompileProgram");
+    f_clCompileProgram func = dispatch().clCompileProgram;
     if (func) {
         return func(program, num_devices, device_list, options,
                     num_input_headers, input_headers, header_include_names,
@@ -685,10 +857,7 @@ cl_program clLinkProgram(cl_context context,
                                             void* user_data),
                          void* user_data,
                          cl_int* errcode_ret) {
-    f_clLinkProgram func;
-
-
-    func = (f_clLinkProgram)dlsym(so_handle(), "clLinkProgram");
+    f_clLinkProgram func = dispatch().clLinkProgram;
     if (func) {
         return func(context, num_devices, device_list, options,
                     num_input_programs, input_programs, pfn_notify, user_data,
@@ -699,11 +868,7 @@ cl_program clLinkProgram(cl_context context,
 }
 
 cl_int clUnloadPlatformCompiler(cl_platform_id platform) {
-    f_clUnloadPlatformCompiler func;
-
-
-    func = (f_clUnloadPlatformCompiler)dlsym(so_handle(),
-                                             "clUnloadPlatformCompiler");
+    f_clUnloadPlatformCompiler func = dispatch().clUnloadPlatformCompiler;
     if (func) {
         return func(platform);
     } else {
@@ -716,10 +881,7 @@ cl_int clGetProgramInfo(cl_program program,
                         size_t param_value_size,
                         void* param_value,
                         size_t* param_value_size_ret) {
-    f_clGetProgramInfo func;
-
-
-    func = (f_clGetProgramInfo)dlsym(so_handle(), "clGetProgramInfo");
+    f_clGetProgramInfo func = dispatch().clGetProgramInfo;
     if (func) {
         return func(program, param_name, param_value_size, param_value,
                     param_value_size_ret);
@@ -734,10 +896,7 @@ cl_int clGetProgramBuildInfo(cl_program program,
                              size_t param_value_size,
                              void* param_value,
                              size_t* param_value_size_ret) {
-    f_clGetProgramBuildInfo func;
-
-
-    func = (f_clGetProgramBuildInfo)dlsym(so_handle(), "clGetProgramBuildInfo");
+    f_clGetProgramBuildInfo func = dispatch().clGetProgramBuildInfo;
     if (func) {
         return func(program, device, param_name, param_value_size, param_value,
                     param_value_size_ret);
@@ -749,10 +908,7 @@ cl_int clGetProgramBuildInfo(cl_program program,
 cl_kernel clCreateKernel(cl_program program,
                          const char* kernel_name,
                          cl_int* errcode_ret) {
-    f_clCreateKernel func;
-
-
-    func = (f_clCreateKernel)dlsym(so_handle(), "clCreateKernel");
+    f_clCreateKernel func = dispatch().clCreateKernel;
     if (func) {
         return func(program, kernel_name, errcode_ret);
     } else {
@@ -764,11 +920,7 @@ cl_int clCreateKernelsInProgram(cl_program program,
                                 cl_uint num_kernels,
                                 cl_kernel* kernels,
                                 cl_uint* num_kernels_ret) {
-    f_clCreateKernelsInProgram func;
-
-
-    func = (f_clCreateKernelsInProgram)dlsym(so_handle(),
-                                             "clCreateKernelsInProgram");
+    f_clCreateKernelsInProgram func = dispatch().clCreateKernelsInProgram;
     if (func) {
         return func(program, num_kernels, kernels, num_kernels_ret);
     } else {
@@ -777,10 +929,7 @@ cl_int clCreateKernelsInProgram(cl_program program,
 }
 
 cl_int clRetainKernel(cl_kernel kernel) {
-    f_clRetainKernel func;
-
-
-    func = (f_clRetainKernel)dlsym(so_handle(), "clRetainKernel");
+    f_clRetainKernel func = dispatch().clRetainKernel;
     if (func) {
         return func(kernel);
     } else {
@@ -789,10 +938,7 @@ cl_int clRetainKernel(cl_kernel kernel) {
 }
 
 cl_int clReleaseKernel(cl_kernel kernel) {
-    f_clReleaseKernel func;
-
-
-    func = (f_clReleaseKernel)dlsym(so_handle(), "clReleaseKernel");
+    f_clReleaseKernel func = dispatch().clReleaseKernel;
     if (func) {
         return func(kernel);
     } else {
@@ -804,10 +950,7 @@ cl_int clSetKernelArg(cl_kernel kernel,
                       cl_uint arg_index,
                       size_t arg_size,
                       const void* arg_value) {
-    f_clSetKernelArg func;
-
-
-    func = (f_clSetKernelArg)dlsym(so_handle(), "clSetKernelArg");
+    f_clSetKernelArg func = dispatch().clSetKernelArg;
     if (func) {
         return func(kernel, arg_index, arg_size, arg_value);
     } else {
@@ -820,10 +963,7 @@ cl_int clGetKernelInfo(cl_kernel kernel,
                        size_t param_value_size,
                        void* param_value,
                        size_t* param_value_size_ret) {
-    f_clGetKernelInfo func;
-
-
-    func = (f_clGetKernelInfo)dlsym(so_handle(), "clGetKernelInfo");
+    f_clGetKernelInfo func = dispatch().clGetKernelInfo;
     if (func) {
         return func(kernel, param_name, param_value_size, param_value,
                     param_value_size_ret);
@@ -838,10 +978,7 @@ cl_int clGetKernelArgInfo(cl_kernel kernel,
                           size_t param_value_size,
                           void* param_value,
                           size_t* param_value_size_ret) {
-    f_clGetKernelArgInfo func;
-
-
-    func = (f_clGetKernelArgInfo)dlsym(so_handle(), "clGetKernelArgInfo");
+    f_clGetKernelArgInfo func = dispatch().clGetKernelArgInfo;
     if (func) {
         return func(kernel, arg_indx, param_name, param_value_size, param_value,
                     param_value_size_ret);
@@ -856,11 +993,7 @@ cl_int clGetKernelWorkGroupInfo(cl_kernel kernel,
                                 size_t param_value_size,
                                 void* param_value,
                                 size_t* param_value_size_ret) {
-    f_clGetKernelWorkGroupInfo func;
-
-
-    func = (f_clGetKernelWorkGroupInfo)dlsym(so_handle(),
-                                             "clGetKernelWorkGroupInfo");
+    f_clGetKernelWorkGroupInfo func = dispatch().clGetKernelWorkGroupInfo;
     if (func) {
         return func(kernel, device, param_name, param_value_size, param_value,
                     param_value_size_ret);
@@ -870,10 +1003,7 @@ cl_int clGetKernelWorkGroupInfo(cl_kernel kernel,
 }
 
 cl_int clWaitForEvents(cl_uint num_events, const cl_event* event_list) {
-    f_clWaitForEvents func;
-
-
-    func = (f_clWaitForEvents)dlsym(so_handle(), "clWaitForEvents");
+    f_clWaitForEvents func = dispatch().clWaitForEvents;
     if (func) {
         return func(num_events, event_list);
     } else {
@@ -886,10 +1016,7 @@ cl_int clGetEventInfo(cl_event event,
                       size_t param_value_size,
                       void* param_value,
                       size_t* param_value_size_ret) {
-    f_clGetEventInfo func;
-
-
-    func = (f_clGetEventInfo)dlsym(so_handle(), "clGetEventInfo");
+    f_clGetEventInfo func = dispatch().clGetEventInfo;
     if (func) {
         return func(event, param_name, param_value_size, param_value,
                     param_value_size_ret);
@@ -899,10 +1026,7 @@ cl_int clGetEventInfo(cl_event event,
 }
 
 cl_event clCreateUserEvent(cl_context context, cl_int* errcode_ret) {
-    f_clCreateUserEvent func;
-
-
-    func = (f_clCreateUserEvent)dlsym(so_handle(), "clCreateUserEvent");
+    f_clCreateUserEvent func = dispatch().clCreateUserEvent;
     if (func) {
         return func(context, errcode_ret);
     } else {
@@ -911,10 +1035,7 @@ cl_event clCreateUserEvent(cl_context context, cl_int* errcode_ret) {
 }
 
 cl_int clRetainEvent(cl_event event) {
-    f_clRetainEvent func;
-
-
-    func = (f_clRetainEvent)dlsym(so_handle(), "clRetainEvent");
+    f_clRetainEvent func = dispatch().clRetainEvent;
     if (func) {
         return func(event);
     } else {
@@ -923,10 +1044,7 @@ cl_int clRetainEvent(cl_event event) {
 }
 
 cl_int clReleaseEvent(cl_event event) {
-    f_clReleaseEvent func;
-
-
-    func = (f_clReleaseEvent)dlsym(so_handle(), "clReleaseEvent");
+    f_clReleaseEvent func = dispatch().clReleaseEvent;
     if (func) {
         return func(event);
     } else {
@@ -935,10 +1053,7 @@ cl_int clReleaseEvent(cl_event event) {
 }
 
 cl_int clSetUserEventStatus(cl_event event, cl_int execution_status) {
-    f_clSetUserEventStatus func;
-
-
-    func = (f_clSetUserEventStatus)dlsym(so_handle(), "clSetUserEventStatus");
+    f_clSetUserEventStatus func = dispatch().clSetUserEventStatus;
     if (func) {
         return func(event, execution_status);
     } else {
@@ -950,10 +1065,7 @@ cl_int clSetEventCallback(cl_event event,
                           cl_int command_exec_callback_type,
                           void (*pfn_notify)(cl_event, cl_int, void*),
                           void* user_data) {
-    f_clSetEventCallback func;
-
-
-    func = (f_clSetEventCallback)dlsym(so_handle(), "clSetEventCallback");
+    f_clSetEventCallback func = dispatch().clSetEventCallback;
     if (func) {
         return func(event, command_exec_callback_type, pfn_notify, user_data);
     } else {
@@ -966,11 +1078,7 @@ cl_int clGetEventProfilingInfo(cl_event event,
                                size_t param_value_size,
                                void* param_value,
                                size_t* param_value_size_ret) {
-    f_clGetEventProfilingInfo func;
-
-
-    func =
-        (f_clGetEventProfilingInfo)dlsym(so_handle(), "clGetEventProfilingInfo");
+    f_clGetEventProfilingInfo func = dispatch().clGetEventProfilingInfo;
     if (func) {
         return func(event, param_name, param_value_size, param_value,
                     param_value_size_ret);
@@ -980,10 +1088,7 @@ cl_int clGetEventProfilingInfo(cl_event event,
 }
 
 cl_int clFlush(cl_command_queue command_queue) {
-    f_clFlush func;
-
-
-    func = (f_clFlush)dlsym(so_handle(), "clFlush");
+    f_clFlush func = dispatch().clFlush;
     if (func) {
         return func(command_queue);
     } else {
@@ -992,10 +1097,7 @@ cl_int clFlush(cl_command_queue command_queue) {
 }
 
 cl_int clFinish(cl_command_queue command_queue) {
-    f_clFinish func;
-
-
-    func = (f_clFinish)dlsym(so_handle(), "clFinish");
+    f_clFinish func = dispatch().clFinish;
     if (func) {
         return func(command_queue);
     } else {
@@ -1012,10 +1114,7 @@ cl_int clEnqueueReadBuffer(cl_command_queue command_queue,
                            cl_uint num_events_in_wait_list,
                            const cl_event* event_wait_list,
                            cl_event* event) {
-    f_clEnqueueReadBuffer func;
-
-
-    func = (f_clEnqueueReadBuffer)dlsym(so_handle(), "clEnqueueReadBuffer");
+    f_clEnqueueReadBuffer func = dispatch().clEnqueueReadBuffer;
     if (func) {
         return func(command_queue, buffer, blocking_read, offset, size, ptr,
                     num_events_in_wait_list, event_wait_list, event);
@@ -1038,11 +1137,7 @@ cl_int clEnqueueReadBufferRect(cl_command_queue command_queue,
                                cl_uint num_events_in_wait_list,
                                const cl_event* event_wait_list,
                                cl_event* event) {
-    f_clEnqueueReadBufferRect func;
-
-
-    func =
-        (f_clEnqueueReadBufferRect)dlsym(so_handle(), "clEnqueueReadBufferRect");
+    f_clEnqueueReadBufferRect func = dispatch().clEnqueueReadBufferRect;
     if (func) {
         return func(command_queue, buffer, blocking_read, buffer_offset,
                     host_offset, region, buffer_row_pitch, buffer_slice_pitch,
@@ -1062,10 +1157,7 @@ cl_int clEnqueueWriteBuffer(cl_command_queue command_queue,
                             cl_uint num_events_in_wait_list,
                             const cl_event* event_wait_list,
                             cl_event* event) {
-    f_clEnqueueWriteBuffer func;
-
-
-    func = (f_clEnqueueWriteBuffer)dlsym(so_handle(), "clEnqueueWriteBuffer");
+    f_clEnqueueWriteBuffer func = dispatch().clEnqueueWriteBuffer;
     if (func) {
         return func(command_queue, buffer, blocking_write, offset, size, ptr,
                     num_events_in_wait_list, event_wait_list, event);
@@ -1088,11 +1180,7 @@ cl_int clEnqueueWriteBufferRect(cl_command_queue command_queue,
                                 cl_uint num_events_in_wait_list,
                                 const cl_event* event_wait_list,
                                 cl_event* event) {
-    f_clEnqueueWriteBufferRect func;
-
-
-    func = (f_clEnqueueWriteBufferRect)dlsym(so_handle(),
-                                             "clEnqueueWriteBufferRect");
+    f_clEnqueueWriteBufferRect func = dispatch().clEnqueueWriteBufferRect;
     if (func) {
         return func(command_queue, buffer, blocking_write, buffer_offset,
                     host_offset, region, buffer_row_pitch, buffer_slice_pitch,
@@ -1112,10 +1200,7 @@ cl_int clEnqueueFillBuffer(cl_command_queue command_queue,
                            cl_uint num_events_in_wait_list,
                            const cl_event* event_wait_list,
                            cl_event* event) {
-    f_clEnqueueFillBuffer func;
-
-
-    func = (f_clEnqueueFillBuffer)dlsym(so_handle(), "clEnqueueFillBuffer");
+    f_clEnqueueFillBuffer func = dispatch().clEnqueueFillBuffer;
     if (func) {
         return func(command_queue, buffer, pattern, pattern_size, offset, size,
                     num_events_in_wait_list, event_wait_list, event);
@@ -1133,10 +1218,7 @@ cl_int clEnqueueCopyBuffer(cl_command_queue command_queue,
                            cl_uint num_events_in_wait_list,
                            const cl_event* event_wait_list,
                            cl_event* event) {
-    f_clEnqueueCopyBuffer func;
-
-
-    func = (f_clEnqueueCopyBuffer)dlsym(so_handle(), "clEnqueueCopyBuffer");
+    f_clEnqueueCopyBuffer func = dispatch().clEnqueueCopyBuffer;
     if (func) {
         return func(command_queue, src_buffer, dst_buffer, src_offset,
                     dst_offset, size, num_events_in_wait_list, event_wait_list,
@@ -1159,11 +1241,7 @@ cl_int clEnqueueCopyBufferRect(cl_command_queue command_queue,
                                cl_uint num_events_in_wait_list,
                                const cl_event* event_wait_list,
                                cl_event* event) {
-    f_clEnqueueCopyBufferRect func;
-
-
-    func =
-        (f_clEnqueueCopyBufferRect)dlsym(so_handle(), "clEnqueueCopyBufferRect");
+    f_clEnqueueCopyBufferRect func = dispatch().clEnqueueCopyBufferRect;
     if (func) {
         return func(command_queue, src_buffer, dst_buffer, src_origin,
                     dst_origin, region, src_row_pitch, src_slice_pitch,
@@ -1185,10 +1263,7 @@ cl_int clEnqueueReadImage(cl_command_queue command_queue,
                           cl_uint num_events_in_wait_list,
                           const cl_event* event_wait_list,
                           cl_event* event) {
-    f_clEnqueueReadImage func;
-
-
-    func = (f_clEnqueueReadImage)dlsym(so_handle(), "clEnqueueReadImage");
+    f_clEnqueueReadImage func = dispatch().clEnqueueReadImage;
     if (func) {
         return func(command_queue, image, blocking_read, origin, region,
                     row_pitch, slice_pitch, ptr, num_events_in_wait_list,
@@ -1209,10 +1284,7 @@ cl_int clEnqueueWriteImage(cl_command_queue command_queue,
                            cl_uint num_events_in_wait_list,
                            const cl_event* event_wait_list,
                            cl_event* event) {
-    f_clEnqueueWriteImage func;
-
-
-    func = (f_clEnqueueWriteImage)dlsym(so_handle(), "clEnqueueWriteImage");
+    f_clEnqueueWriteImage func = dispatch().clEnqueueWriteImage;
     if (func) {
         return func(command_queue, image, blocking_write, origin, region,
                     input_row_pitch, input_slice_pitch, ptr,
@@ -1230,10 +1302,7 @@ cl_int clEnqueueFillImage(cl_command_queue command_queue,
                           cl_uint num_events_in_wait_list,
                           const cl_event* event_wait_list,
                           cl_event* event) {
-    f_clEnqueueFillImage func;
-
-
-    func = (f_clEnqueueFillImage)dlsym(so_handle(), "clEnqueueFillImage");
+    f_clEnqueueFillImage func = dispatch().clEnqueueFillImage;
     if (func) {
         return func(command_queue, image, fill_color, origin, region,
                     num_events_in_wait_list, event_wait_list, event);
@@ -1251,10 +1320,7 @@ cl_int clEnqueueCopyImage(cl_command_queue command_queue,
                           cl_uint num_events_in_wait_list,
                           const cl_event* event_wait_list,
                           cl_event* event) {
-    f_clEnqueueCopyImage func;
-
-
-    func = (f_clEnqueueCopyImage)dlsym(so_handle(), "clEnqueueCopyImage");
+    f_clEnqueueCopyImage func = dispatch().clEnqueueCopyImage;
     if (func) {
         return func(command_queue, src_image, dst_image, src_origin, dst_origin,
                     region, num_events_in_wait_list, event_wait_list, event);
@@ -1272,11 +1338,7 @@ cl_int clEnqueueCopyImageToBuffer(cl_command_queue command_queue,
                                   cl_uint num_events_in_wait_list,
                                   const cl_event* event_wait_list,
                                   cl_event* event) {
-    f_clEnqueueCopyImageToBuffer func;
-
-
-    func = (f_clEnqueueCopyImageToBuffer)dlsym(so_handle(),
-                                               "clEnqueueCopyImageToBuffer");
+    f_clEnqueueCopyImageToBuffer func = dispatch().clEnqueueCopyImageToBuffer;
     if (func) {
         return func(command_queue, src_image, dst_buffer, src_origin, region,
                     dst_offset, num_events_in_wait_list, event_wait_list,
@@ -1295,11 +1357,7 @@ cl_int clEnqueueCopyBufferToImage(cl_command_queue command_queue,
                                   cl_uint num_events_in_wait_list,
                                   const cl_event* event_wait_list,
                                   cl_event* event) {
-    f_clEnqueueCopyBufferToImage func;
-
-
-    func = (f_clEnqueueCopyBufferToImage)dlsym(so_handle(),
-                                               "clEnqueueCopyBufferToImage");
+    f_clEnqueueCopyBufferToImage func = dispatch().clEnqueueCopyBufferToImage;
     if (func) {
         return func(command_queue, src_buffer, dst_image, src_offset,
                     dst_origin, region, num_events_in_wait_list,
@@ -1319,10 +1377,7 @@ void* clEnqueueMapBuffer(cl_command_queue command_queue,
                          const cl_event* event_wait_list,
                          cl_event* event,
                          cl_int* errcode_ret) {
-    f_clEnqueueMapBuffer func;
-
-
-    func = (f_clEnqueueMapBuffer)dlsym(so_handle(), "clEnqueueMapBuffer");
+    f_clEnqueueMapBuffer func = dispatch().clEnqueueMapBuffer;
     if (func) {
         return func(command_queue, buffer, blocking_map, map_flags, offset,
                     size, num_events_in_wait_list, event_wait_list, event,
@@ -1344,10 +1399,7 @@ void* clEnqueueMapImage(cl_command_queue command_queue,
                         const cl_event* event_wait_list,
                         cl_event* event,
                         cl_int* errcode_ret) {
-    f_clEnqueueMapImage func;
-
-
-    func = (f_clEnqueueMapImage)dlsym(so_handle(), "clEnqueueMapImage");
+    f_clEnqueueMapImage func = dispatch().clEnqueueMapImage;
     if (func) {
         return func(command_queue, image, blocking_map, map_flags, origin,
                     region, image_row_pitch, image_slice_pitch,
@@ -1364,11 +1416,7 @@ cl_int clEnqueueUnmapMemObject(cl_command_queue command_queue,
                                cl_uint num_events_in_wait_list,
                                const cl_event* event_wait_list,
                                cl_event* event) {
-    f_clEnqueueUnmapMemObject func;
-
-
-    func =
-        (f_clEnqueueUnmapMemObject)dlsym(so_handle(), "clEnqueueUnmapMemObject");
+    f_clEnqueueUnmapMemObject func = dispatch().clEnqueueUnmapMemObject;
     if (func) {
         return func(command_queue, memobj, mapped_ptr, num_events_in_wait_list,
                     event_wait_list, event);
@@ -1384,11 +1432,7 @@ cl_int clEnqueueMigrateMemObjects(cl_command_queue command_queue,
                                   cl_uint num_events_in_wait_list,
                                   const cl_event* event_wait_list,
                                   cl_event* event) {
-    f_clEnqueueMigrateMemObjects func;
-
-
-    func = (f_clEnqueueMigrateMemObjects)dlsym(so_handle(),
-                                               "clEnqueueMigrateMemObjects");
+    f_clEnqueueMigrateMemObjects func = dispatch().clEnqueueMigrateMemObjects;
     if (func) {
         return func(command_queue, num_mem_objects, mem_objects, flags,
                     num_events_in_wait_list, event_wait_list, event);
@@ -1406,10 +1450,7 @@ cl_int clEnqueueNDRangeKernel(cl_command_queue command_queue,
                               cl_uint num_events_in_wait_list,
                               const cl_event* event_wait_list,
                               cl_event* event) {
-    f_clEnqueueNDRangeKernel func;
-
-
-    func = (f_clEnqueueNDRangeKernel)dlsym(so_handle(), "clEnqueueNDRangeKernel");
+    f_clEnqueueNDRangeKernel func = dispatch().clEnqueueNDRangeKernel;
     if (func) {
         return func(command_queue, kernel, work_dim, global_work_offset,
                     global_work_size, local_work_size, num_events_in_wait_list,
@@ -1424,10 +1465,7 @@ cl_int clEnqueueTask(cl_command_queue command_queue,
                      cl_uint num_events_in_wait_list,
                      const cl_event* event_wait_list,
                      cl_event* event) {
-    f_clEnqueueTask func;
-
-
-    func = (f_clEnqueueTask)dlsym(so_handle(), "clEnqueueTask");
+    f_clEnqueueTask func = dispatch().clEnqueueTask;
     if (func) {
         return func(command_queue, kernel, num_events_in_wait_list,
                     event_wait_list, event);
@@ -1446,10 +1484,7 @@ cl_int clEnqueueNativeKernel(cl_command_queue command_queue,
                              cl_uint num_events_in_wait_list,
                              const cl_event* event_wait_list,
                              cl_event* event) {
-    f_clEnqueueNativeKernel func;
-
-
-    func = (f_clEnqueueNativeKernel)dlsym(so_handle(), "clEnqueueNativeKernel");
+    f_clEnqueueNativeKernel func = dispatch().clEnqueueNativeKernel;
     if (func) {
         return func(command_queue, user_func, args, cb_args, num_mem_objects,
                     mem_list, args_mem_loc, num_events_in_wait_list,
@@ -1463,11 +1498,7 @@ cl_int clEnqueueMarkerWithWaitList(cl_command_queue command_queue,
                                    cl_uint num_events_in_wait_list,
                                    const cl_event* event_wait_list,
                                    cl_event* event) {
-    f_clEnqueueMarkerWithWaitList func;
-
-
-    func = (f_clEnqueueMarkerWithWaitList)dlsym(so_handle(),
-                                                "clEnqueueMarkerWithWaitList");
+    f_clEnqueueMarkerWithWaitList func = dispatch().clEnqueueMarkerWithWaitList;
     if (func) {
         return func(command_queue, num_events_in_wait_list, event_wait_list,
                     event);
@@ -1480,11 +1511,7 @@ cl_int clEnqueueBarrierWithWaitList(cl_command_queue command_queue,
                                     cl_uint num_events_in_wait_list,
                                     const cl_event* event_wait_list,
                                     cl_event* event) {
-    f_clEnqueueBarrierWithWaitList func;
-
-
-    func = (f_clEnqueueBarrierWithWaitList)dlsym(
-        so_handle(), "clEnqueueBarrierWithWaitList");
+    f_clEnqueueBarrierWithWaitList func = dispatch().clEnqueueBarrierWithWaitList;
     if (func) {
         return func(command_queue, num_events_in_wait_list, event_wait_list,
                     event);
@@ -1495,11 +1522,7 @@ cl_int clEnqueueBarrierWithWaitList(cl_command_queue command_queue,
 
 void* clGetExtensionFunctionAddressForPlatform(cl_platform_id platform,
                                                const char* func_name) {
-    f_clGetExtensionFunctionAddressForPlatform func;
-
-
-    func = (f_clGetExtensionFunctionAddressForPlatform)dlsym(
-        so_handle(), "clGetExtensionFunctionAddressForPlatform");
+    f_clGetExtensionFunctionAddressForPlatform func = dispatch().clGetExtensionFunctionAddressForPlatform;
     if (func) {
         return func(platform, func_name);
     } else {
@@ -1515,10 +1538,7 @@ cl_mem clCreateImage2D(cl_context context,
                        size_t image_row_pitch,
                        void* host_ptr,
                        cl_int* errcode_ret) {
-    f_clCreateImage2D func;
-
-
-    func = (f_clCreateImage2D)dlsym(so_handle(), "clCreateImage2D");
+    f_clCreateImage2D func = dispatch().clCreateImage2D;
     if (func) {
         return func(context, flags, image_format, image_width, image_height,
                     image_row_pitch, host_ptr, errcode_ret);
@@ -1537,10 +1557,7 @@ cl_mem clCreateImage3D(cl_context context,
                        size_t image_slice_pitch,
                        void* host_ptr,
                        cl_int* errcode_ret) {
-    f_clCreateImage3D func;
-
-
-    func = (f_clCreateImage3D)dlsym(so_handle(), "clCreateImage3D");
+    f_clCreateImage3D func = dispatch().clCreateImage3D;
     if (func) {
         return func(context, flags, image_format, image_width, image_height,
                     image_depth, image_row_pitch, image_slice_pitch, host_ptr,
@@ -1551,10 +1568,7 @@ cl_mem clCreateImage3D(cl_context context,
 }
 
 cl_int clEnqueueMarker(cl_command_queue command_queue, cl_event* event) {
-    f_clEnqueueMarker func;
-
-
-    func = (f_clEnqueueMarker)dlsym(so_handle(), "clEnqueueMarker");
+    f_clEnqueueMarker func = dispatch().clEnqueueMarker;
     if (func) {
         return func(command_queue, event);
     } else {
@@ -1565,10 +1579,7 @@ cl_int clEnqueueMarker(cl_command_queue command_queue, cl_event* event) {
 cl_int clEnqueueWaitForEvents(cl_command_queue command_queue,
                               cl_uint num_events,
                               const cl_event* event_list) {
-    f_clEnqueueWaitForEvents func;
-
-
-    func = (f_clEnqueueWaitForEvents)dlsym(so_handle(), "clEnqueueWaitForEvents");
+    f_clEnqueueWaitForEvents func = dispatch().clEnqueueWaitForEvents;
     if (func) {
         return func(command_queue, num_events, event_list);
     } else {
@@ -1577,10 +1588,7 @@ cl_int clEnqueueWaitForEvents(cl_command_queue command_queue,
 }
 
 cl_int clEnqueueBarrier(cl_command_queue command_queue) {
-    f_clEnqueueBarrier func;
-
-
-    func = (f_clEnqueueBarrier)dlsym(so_handle(), "clEnqueueBarrier");
+    f_clEnqueueBarrier func = dispatch().clEnqueueBarrier;
     if (func) {
         return func(command_queue);
     } else {
@@ -1589,10 +1597,7 @@ cl_int clEnqueueBarrier(cl_command_queue command_queue) {
 }
 
 cl_int clUnloadCompiler(void) {
-    f_clUnloadCompiler func;
-
-
-    func = (f_clUnloadCompiler)dlsym(so_handle(), "clUnloadCompiler");
+    f_clUnloadCompiler func = dispatch().clUnloadCompiler;
     if (func) {
         return func();
     } else {
@@ -1601,11 +1606,7 @@ cl_int clUnloadCompiler(void) {
 }
 
 void* clGetExtensionFunctionAddress(const char* func_name) {
-    f_clGetExtensionFunctionAddress func;
-
-
-    func = (f_clGetExtensionFunctionAddress)dlsym(
-        so_handle(), "clGetExtensionFunctionAddress");
+    f_clGetExtensionFunctionAddress func = dispatch().clGetExtensionFunctionAddress;
     if (func) {
         return func(func_name);
     } else {
@@ -1617,10 +1618,7 @@ cl_mem clCreateFromGLBuffer(cl_context context,
                             cl_mem_flags flags,
                             cl_GLuint bufobj,
                             int* errcode_ret) {
-    f_clCreateFromGLBuffer func;
-
-
-    func = (f_clCreateFromGLBuffer)dlsym(so_handle(), "clCreateFromGLBuffer");
+    f_clCreateFromGLBuffer func = dispatch().clCreateFromGLBuffer;
     if (func) {
         return func(context, flags, bufobj, errcode_ret);
     } else {
@@ -1634,10 +1632,7 @@ cl_mem clCreateFromGLTexture(cl_context context,
                              cl_GLint miplevel,
                              cl_GLuint texture,
                              cl_int* errcode_ret) {
-    f_clCreateFromGLTexture func;
-
-
-    func = (f_clCreateFromGLTexture)dlsym(so_handle(), "clCreateFromGLTexture");
+    f_clCreateFromGLTexture func = dispatch().clCreateFromGLTexture;
     if (func) {
         return func(context, flags, target, miplevel, texture, errcode_ret);
     } else {
@@ -1649,11 +1644,7 @@ cl_mem clCreateFromGLRenderbuffer(cl_context context,
                                   cl_mem_flags flags,
                                   cl_GLuint renderbuffer,
                                   cl_int* errcode_ret) {
-    f_clCreateFromGLRenderbuffer func;
-
-
-    func = (f_clCreateFromGLRenderbuffer)dlsym(so_handle(),
-                                               "clCreateFromGLRenderbuffer");
+    f_clCreateFromGLRenderbuffer func = dispatch().clCreateFromGLRenderbuffer;
     if (func) {
         return func(context, flags, renderbuffer, errcode_ret);
     } else {
@@ -1664,10 +1655,7 @@ cl_mem clCreateFromGLRenderbuffer(cl_context context,
 cl_int clGetGLObjectInfo(cl_mem memobj,
                          cl_gl_object_type* gl_object_type,
                          cl_GLuint* gl_object_name) {
-    f_clGetGLObjectInfo func;
-
-
-    func = (f_clGetGLObjectInfo)dlsym(so_handle(), "clGetGLObjectInfo");
+    f_clGetGLObjectInfo func = dispatch().clGetGLObjectInfo;
     if (func) {
         return func(memobj, gl_object_type, gl_object_name);
     } else {
@@ -1680,10 +1668,7 @@ cl_int clGetGLTextureInfo(cl_mem memobj,
                           size_t param_value_size,
                           void* param_value,
                           size_t* param_value_size_ret) {
-    f_clGetGLTextureInfo func;
-
-
-    func = (f_clGetGLTextureInfo)dlsym(so_handle(), "clGetGLTextureInfo");
+    f_clGetGLTextureInfo func = dispatch().clGetGLTextureInfo;
     if (func) {
         return func(memobj, param_name, param_value_size, param_value,
                     param_value_size_ret);
@@ -1698,11 +1683,7 @@ cl_int clEnqueueAcquireGLObjects(cl_command_queue command_queue,
                                  cl_uint num_events_in_wait_list,
                                  const cl_event* event_wait_list,
                                  cl_event* event) {
-    f_clEnqueueAcquireGLObjects func;
-
-
-    func = (f_clEnqueueAcquireGLObjects)dlsym(so_handle(),
-                                              "clEnqueueAcquireGLObjects");
+    f_clEnqueueAcquireGLObjects func = dispatch().clEnqueueAcquireGLObjects;
     if (func) {
         return func(command_queue, num_objects, mem_objects,
                     num_events_in_wait_list, event_wait_list, event);
@@ -1717,11 +1698,7 @@ cl_int clEnqueueReleaseGLObjects(cl_command_queue command_queue,
                                  cl_uint num_events_in_wait_list,
                                  const cl_event* event_wait_list,
                                  cl_event* event) {
-    f_clEnqueueReleaseGLObjects func;
-
-
-    func = (f_clEnqueueReleaseGLObjects)dlsym(so_handle(),
-                                              "clEnqueueReleaseGLObjects");
+    f_clEnqueueReleaseGLObjects func = dispatch().clEnqueueReleaseGLObjects;
     if (func) {
         return func(command_queue, num_objects, mem_objects,
                     num_events_in_wait_list, event_wait_list, event);
@@ -1736,11 +1713,7 @@ cl_mem clCreateFromGLTexture2D(cl_context context,
                                cl_GLint miplevel,
                                cl_GLuint texture,
                                cl_int* errcode_ret) {
-    f_clCreateFromGLTexture2D func;
-
-
-    func =
-        (f_clCreateFromGLTexture2D)dlsym(so_handle(), "clCreateFromGLTexture2D");
+    f_clCreateFromGLTexture2D func = dispatch().clCreateFromGLTexture2D;
     if (func) {
         return func(context, flags, target, miplevel, texture, errcode_ret);
     } else {
@@ -1754,11 +1727,7 @@ cl_mem clCreateFromGLTexture3D(cl_context context,
                                cl_GLint miplevel,
                                cl_GLuint texture,
                                cl_int* errcode_ret) {
-    f_clCreateFromGLTexture3D func;
-
-
-    func =
-        (f_clCreateFromGLTexture3D)dlsym(so_handle(), "clCreateFromGLTexture3D");
+    f_clCreateFromGLTexture3D func = dispatch().clCreateFromGLTexture3D;
     if (func) {
         return func(context, flags, target, miplevel, texture, errcode_ret);
     } else {
@@ -1771,10 +1740,7 @@ cl_int clGetGLContextInfoKHR(const cl_context_properties* properties,
                              size_t param_value_size,
                              void* param_value,
                              size_t* param_value_size_ret) {
-    f_clGetGLContextInfoKHR func;
-
-
-    func = (f_clGetGLContextInfoKHR)dlsym(so_handle(), "clGetGLContextInfoKHR");
+    f_clGetGLContextInfoKHR func = dispatch().clGetGLContextInfoKHR;
     if (func) {
         return func(properties, param_name, param_value_size, param_value,
                     param_value_size_ret);